@@ -4,8 +4,19 @@
 #include <vector>
 
 #include "Instruction.h"
+#include "SourceLocation.h"
 
 namespace lce::Assembler
 {
+    // Where the machine code of an instruction starts, relative to the start of the generated code
+    struct SourceMapEntry
+    {
+        uint16_t Offset = 0;
+        Common::SourceLocation Location;
+    };
+
     std::vector<uint8_t> GenerateMachineCode(const std::vector<Instruction>& Instructions);
+
+    // Also fills SourceMap with one entry per instruction, in the order of the instructions
+    std::vector<uint8_t> GenerateMachineCode(const std::vector<Instruction>& Instructions, std::vector<SourceMapEntry>& SourceMap);
 }
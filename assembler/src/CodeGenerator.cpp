@@ -155,15 +155,27 @@ namespace lce::Assembler
         }
     }
 
-    std::vector<uint8_t> GenerateMachineCode(const std::vector<Instruction>& Insturctions)
+    static std::vector<uint8_t> GenerateMachineCode(const std::vector<Instruction>& Instructions, std::vector<SourceMapEntry>* SourceMap)
     {
         std::vector<uint8_t> Result;
 
-        for (const auto& Instruction : Insturctions)
+        for (const auto& Instruction : Instructions)
         {
+            if (SourceMap)
+                SourceMap->push_back({ static_cast<uint16_t>(Result.size()), Instruction.Location });
             GenerateMachineCodeForInstruction(Instruction, Result);
         }
 
         return Result;
     }
+
+    std::vector<uint8_t> GenerateMachineCode(const std::vector<Instruction>& Instructions)
+    {
+        return GenerateMachineCode(Instructions, nullptr);
+    }
+
+    std::vector<uint8_t> GenerateMachineCode(const std::vector<Instruction>& Instructions, std::vector<SourceMapEntry>& SourceMap)
+    {
+        return GenerateMachineCode(Instructions, &SourceMap);
+    }
 } // namespace lce::Assembler
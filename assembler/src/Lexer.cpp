@@ -134,7 +134,8 @@ namespace lce::Assembler
                 NewLexem.Type = LexemType::NumericLiteral;
                 NewLexem.Location = StartLocation;
                 NewLexem.Text = std::string_view(m_Source.data() + StartOffset, m_CurrentOffset - StartOffset);
-                NewLexem.ParsedValue = std::strtoull(NewLexem.Text.data(), nullptr, 0);
+                // NOTE: the text is not null terminated, so strtoull has to get a copy or it would read past the literal
+                NewLexem.ParsedValue = std::strtoull(std::string(NewLexem.Text).c_str(), nullptr, 0);
 
                 break;
             }
@@ -149,6 +150,18 @@ namespace lce::Assembler
 
                 break;
             }
+
+            // Any other character can not start a lexem, it is passed on as it is so that the parser can report it
+            if (!IsWhitespace(Current) && Current != '\n' && !InsideComment)
+            {
+                NewLexem.Type = LexemType::Undefined;
+                NewLexem.Location = m_CurrentLocation;
+                NewLexem.Text = std::string_view(m_Source.data() + m_CurrentOffset, 1);
+
+                Current = Advance();
+
+                break;
+            }
         }
 
         m_CurrentLexem = NewLexem;
@@ -7,6 +7,7 @@
 #include "ErrorReporting.h"
 #include "Lexer.h"
 #include "Parser.h"
+#include "TypeChecker.h"
 
 using namespace lce::Assembler;
 
@@ -69,6 +70,8 @@ int main(int ArgumentCount, char** Arguments)
     std::vector<Instruction> Instructions;
     if (!Parse(Lexer, Instructions))
         return 0;
+    if (!CheckInstructionSequence(Instructions))
+        return 0;
     auto Bytes = GenerateMachineCode(Instructions);
 
     WriteFile("123.bin", Bytes);
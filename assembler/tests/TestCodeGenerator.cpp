@@ -139,3 +139,28 @@ TEST(TestCodeGenerator, FirstDoubleByteImmediateSecondRegister)
     EXPECT_EQ(GeneratedBytes[2], 420 % 256);
     EXPECT_EQ(GeneratedBytes[3], 420 >> 8);
 }
+
+TEST(TestCodeGenerator, SourceMap)
+{
+    lce::Assembler::Instruction First = {};
+    First.Opcode = lce::Assembler::Opcode::Push;
+    First.Operands[0].Type = lce::Assembler::OperandType::Immediate;
+    First.Operands[0].Value = 420ull;
+    First.Operands[1].Type = lce::Assembler::OperandType::None;
+    First.Location.Line = 3;
+
+    lce::Assembler::Instruction Second = {};
+    Second.Opcode = lce::Assembler::Opcode::Nop;
+    Second.Operands[0].Type = lce::Assembler::OperandType::None;
+    Second.Operands[1].Type = lce::Assembler::OperandType::None;
+    Second.Location.Line = 5;
+
+    std::vector<lce::Assembler::SourceMapEntry> SourceMap;
+    auto GeneratedBytes = lce::Assembler::GenerateMachineCode({ First, Second }, SourceMap);
+    ASSERT_EQ(GeneratedBytes.size(), 4);
+    ASSERT_EQ(SourceMap.size(), 2);
+    EXPECT_EQ(SourceMap[0].Offset, 0);
+    EXPECT_EQ(SourceMap[0].Location.Line, 3);
+    EXPECT_EQ(SourceMap[1].Offset, 3);
+    EXPECT_EQ(SourceMap[1].Location.Line, 5);
+}
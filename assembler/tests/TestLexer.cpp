@@ -105,3 +105,22 @@ TEST(TestLexer, Comments)
     EXPECT_EQ(Lexer.Pop().Type, lce::Assembler::LexemType::LineBreak);
     EXPECT_EQ(Lexer.Pop().Text, "i2");
 }
+
+TEST(TestLexer, UnknownCharacter)
+{
+    lce::Assembler::Lexer Lexer("i1 @ -", "test_file.lca");
+
+    EXPECT_EQ(Lexer.Pop().Text, "i1");
+    EXPECT_EQ(Lexer.Peek().Type, lce::Assembler::LexemType::Undefined);
+    EXPECT_EQ(Lexer.Pop().Text, "@");
+    EXPECT_EQ(Lexer.Pop().Text, "-");
+    EXPECT_EQ(Lexer.Pop().Type, lce::Assembler::LexemType::EndOfFile);
+}
+
+TEST(TestLexer, NumericLiteralIsNotReadPastItsEnd)
+{
+    std::string_view Source = "12345";
+    lce::Assembler::Lexer Lexer(Source.substr(0, 2), "test_file.lca");
+
+    EXPECT_EQ(std::get<uint64_t>(Lexer.Pop().ParsedValue), 12);
+}
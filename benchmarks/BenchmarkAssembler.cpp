@@ -0,0 +1,116 @@
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "CodeGenerator.h"
+#include "Instruction.h"
+#include "Lexer.h"
+#include "Parser.h"
+
+using namespace lce::Assembler;
+
+/*
+ * Generates a source file with the given number of lines. The lines cycle through every operand form with register
+ * names and immediates of both sizes, and every 16th line has a comment, which is roughly what handwritten code looks
+ * like to the lexer.
+ */
+static std::string GenerateSource(size_t Lines)
+{
+    static constexpr const char* Templates[] = {
+        "mov r{0}, r{1}\n",
+        "mov r{0}, {2}\n",
+        "lda r{0}, {3}\n",
+        "sta r{1}, r{0}\n",
+        "add r{0}, {2}\n",
+        "sub r{0}, r{1}\n",
+        "xor r{1}, {3}\n",
+        "shl r{0}, 1\n",
+        "push r{1}\n",
+        "pop r{0}\n",
+        "jz {3}\n",
+        "call {3}\n",
+        "ret\n",
+        "nop\n",
+        "and r{0}, {2}   ; keeps the low bits\n",
+        "hlt\n",
+    };
+
+    std::string Source;
+    Source.reserve(Lines * 16);
+    for (size_t Index = 0; Index < Lines; Index++)
+    {
+        std::string Line = Templates[Index % std::size(Templates)];
+        auto Replace = [&Line](const std::string& Placeholder, const std::string& Value)
+        {
+            for (auto Position = Line.find(Placeholder); Position != std::string::npos; Position = Line.find(Placeholder))
+                Line.replace(Position, Placeholder.size(), Value);
+        };
+        Replace("{0}", std::to_string(Index % 4));
+        Replace("{1}", std::to_string((Index / 4) % 4));
+        Replace("{2}", std::to_string(Index % 256));
+        Replace("{3}", std::to_string(32768 + Index % 32768));
+        Source += Line;
+    }
+    return Source;
+}
+
+static void BM_Lexer(benchmark::State& State)
+{
+    auto Source = GenerateSource(State.range(0));
+
+    for (auto _ : State)
+    {
+        Lexer Lexems(Source, "benchmark.lca");
+        while (Lexems.Pop().Type != LexemType::EndOfFile)
+        {
+        }
+    }
+
+    State.SetBytesProcessed(static_cast<int64_t>(State.iterations() * Source.size()));
+}
+BENCHMARK(BM_Lexer)->Arg(10000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+static void BM_Parse(benchmark::State& State)
+{
+    auto Source = GenerateSource(State.range(0));
+
+    for (auto _ : State)
+    {
+        Lexer Lexems(Source, "benchmark.lca");
+        std::vector<Instruction> Instructions;
+        if (!Parse(Lexems, Instructions))
+            State.SkipWithError("The generated source does not parse");
+        benchmark::DoNotOptimize(Instructions.data());
+    }
+
+    State.SetItemsProcessed(State.iterations() * State.range(0));
+    State.SetBytesProcessed(static_cast<int64_t>(State.iterations() * Source.size()));
+}
+BENCHMARK(BM_Parse)->Arg(10000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+static void BM_GenerateMachineCode(benchmark::State& State)
+{
+    auto Source = GenerateSource(State.range(0));
+    Lexer Lexems(Source, "benchmark.lca");
+    std::vector<Instruction> Instructions;
+    if (!Parse(Lexems, Instructions))
+    {
+        State.SkipWithError("The generated source does not parse");
+        return;
+    }
+
+    size_t CodeSize = 0;
+    for (auto _ : State)
+    {
+        auto Bytes = GenerateMachineCode(Instructions);
+        CodeSize = Bytes.size();
+        benchmark::DoNotOptimize(Bytes.data());
+    }
+
+    State.SetItemsProcessed(State.iterations() * State.range(0));
+    State.SetBytesProcessed(static_cast<int64_t>(State.iterations() * CodeSize));
+}
+BENCHMARK(BM_GenerateMachineCode)->Arg(10000)->Arg(1000000)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,156 @@
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "CodeGenerator.h"
+#include "CPU.h"
+#include "Instruction.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "RandomAccessMemoryBlock.h"
+
+using namespace lce::Assembler;
+using namespace lce::Emulator;
+
+static constexpr ExecutionEngine Engines[] = { ExecutionEngine::Interpreter, ExecutionEngine::Threaded, ExecutionEngine::BasicBlocks, ExecutionEngine::JIT };
+static constexpr const char* EngineNames[] = { "interpreter", "threaded", "blocks", "jit" };
+
+static constexpr uint16_t ProgramAddress = 0x8000;
+static constexpr uint16_t HalfAddressSpace = 0x8000;
+
+// NOTE: every loop below runs 50000 times with the counter in r1, which is zero once the program halts
+
+// Arithmetic and logic only, no memory accesses besides instruction fetches
+constexpr std::string_view ALULoop = "mov r1, 50000   \n" // 0x8000
+                                     "add r0, r1      \n" // 0x8004
+                                     "xor r2, r0      \n" // 0x8006
+                                     "shl r2, 1       \n" // 0x8008
+                                     "or r3, r2       \n" // 0x800B
+                                     "sub r1, 1       \n" // 0x800D
+                                     "jz 32790        \n" // 0x8010
+                                     "jmp 32772       \n" // 0x8013
+                                     "hlt             \n"; // 0x8016
+
+// Increments every word of a 16 KiB array, over and over
+constexpr std::string_view MemoryLoop = "mov r1, 50000   \n" // 0x8000
+                                        "mov r2, 4096    \n" // 0x8004
+                                        "lda r0, r2      \n" // 0x8008
+                                        "add r0, r1      \n" // 0x800A
+                                        "sta r2, r0      \n" // 0x800C
+                                        "add r2, 2       \n" // 0x800E
+                                        "and r2, 16383   \n" // 0x8011
+                                        "sub r1, 1       \n" // 0x8015
+                                        "jz 32798        \n" // 0x8018
+                                        "jmp 32776       \n" // 0x801B
+                                        "hlt             \n"; // 0x801E
+
+// Calls a short subroutine that also uses the stack on every iteration
+constexpr std::string_view CallLoop = "mov rsp, 8192   \n" // 0x8000
+                                      "mov r1, 50000   \n" // 0x8004
+                                      "call 32789      \n" // 0x8008
+                                      "sub r1, 1       \n" // 0x800B
+                                      "jz 32788        \n" // 0x800E
+                                      "jmp 32776       \n" // 0x8011
+                                      "hlt             \n" // 0x8014
+                                      "add r0, 1       \n" // 0x8015
+                                      "push r0         \n" // 0x8018
+                                      "pop r3          \n" // 0x801A
+                                      "ret             \n"; // 0x801C
+
+static std::vector<uint8_t> Assemble(std::string_view Source)
+{
+    Lexer Lexems(Source, "benchmark.lca");
+    std::vector<Instruction> Instructions;
+    if (!Parse(Lexems, Instructions))
+        return {};
+    return GenerateMachineCode(Instructions);
+}
+
+/*
+ * Creates a CPU with the program in its own block at 0x8000, and the lower half of the address space split evenly into
+ * DataBlockCount blocks
+ */
+static std::unique_ptr<CPU> CreateCPU(ExecutionEngine Engine, std::string_view Source, size_t DataBlockCount = 1)
+{
+    auto Processor = std::make_unique<CPU>(Engine);
+
+    auto DataBlockSize = static_cast<uint16_t>(HalfAddressSpace / DataBlockCount);
+    for (size_t Index = 0; Index < DataBlockCount; Index++)
+        Processor->AddMemoryBlock(std::make_unique<RandomAccessMemoryBlock>(DataBlockSize), static_cast<uint16_t>(Index * DataBlockSize));
+
+    auto Program = std::make_unique<RandomAccessMemoryBlock>(HalfAddressSpace);
+    Program->WriteRange(0, Assemble(Source));
+    Processor->AddMemoryBlock(std::move(Program), ProgramAddress);
+
+    return Processor;
+}
+
+// Runs the program to completion on every iteration and reports the emulated instructions per second
+static void RunProgram(benchmark::State& State, CPU& Processor)
+{
+    uint64_t Instructions = 0;
+    for (auto _ : State)
+    {
+        Processor.Reset();
+        Processor.Run(ProgramAddress);
+        Instructions += Processor.GetRetiredInstructionCount();
+    }
+
+    if (!Processor.IsHalted() || Processor.GetStopReason() != StopReason::Halted || Processor.GetRegister(Register::R1) != 0)
+        State.SkipWithError("The program did not run to completion");
+
+    State.SetItemsProcessed(static_cast<int64_t>(Instructions));
+    State.counters["MIPS"] = benchmark::Counter(static_cast<double>(Instructions) / 1e6, benchmark::Counter::kIsRate);
+}
+
+template <const std::string_view& Source>
+static void BM_Run(benchmark::State& State)
+{
+    auto EngineIndex = State.range(0);
+    State.SetLabel(EngineNames[EngineIndex]);
+
+    auto Processor = CreateCPU(Engines[EngineIndex], Source);
+    RunProgram(State, *Processor);
+}
+BENCHMARK_TEMPLATE(BM_Run, ALULoop)->Name("BM_RunALULoop")->DenseRange(0, std::size(Engines) - 1)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_Run, MemoryLoop)->Name("BM_RunMemoryLoop")->DenseRange(0, std::size(Engines) - 1)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_Run, CallLoop)->Name("BM_RunCallLoop")->DenseRange(0, std::size(Engines) - 1)->Unit(benchmark::kMicrosecond);
+
+// The memory loop with its data spread over many small blocks instead of a single one, on the interpreter
+static void BM_RunMemoryLoopWithManyBlocks(benchmark::State& State)
+{
+    auto Processor = CreateCPU(ExecutionEngine::Interpreter, MemoryLoop, State.range(0));
+    RunProgram(State, *Processor);
+}
+BENCHMARK(BM_RunMemoryLoopWithManyBlocks)->RangeMultiplier(8)->Range(1, 128)->Unit(benchmark::kMicrosecond);
+
+static void BM_AddMemoryBlock(benchmark::State& State)
+{
+    auto BlockCount = static_cast<size_t>(State.range(0));
+    auto BlockSize = static_cast<uint16_t>(HalfAddressSpace / BlockCount);
+
+    std::unique_ptr<CPU> Processor;
+    for (auto _ : State)
+    {
+        // NOTE: the CPU from the previous iteration is destroyed outside of the measured time too
+        State.PauseTiming();
+        Processor = std::make_unique<CPU>();
+        std::vector<std::unique_ptr<RandomAccessMemoryBlock>> Blocks;
+        for (size_t Index = 0; Index < BlockCount; Index++)
+            Blocks.push_back(std::make_unique<RandomAccessMemoryBlock>(BlockSize));
+        State.ResumeTiming();
+
+        for (size_t Index = 0; Index < BlockCount; Index++)
+        {
+            if (!Processor->AddMemoryBlock(std::move(Blocks[Index]), static_cast<uint16_t>(Index * BlockSize)))
+                State.SkipWithError("The blocks overlap");
+        }
+    }
+
+    State.SetItemsProcessed(static_cast<int64_t>(State.iterations() * BlockCount));
+}
+BENCHMARK(BM_AddMemoryBlock)->RangeMultiplier(8)->Range(1, 128);
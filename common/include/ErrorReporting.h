@@ -27,12 +27,14 @@ namespace lce::Common
      */
     void PrintFormattedError(ErrorSeverity Severity, const char* Message);
 
+    // Messages with a lower severity than the logging level are dropped, the default level is Warning
+    void SetLoggingLevel(ErrorSeverity Level);
+    ErrorSeverity GetLoggingLevel();
+
     template <typename... ArgTypes>
     void ReportError(ErrorSeverity Severity, const SourceLocation& Location, const char* Message, ArgTypes&&... Args)
     {
-        // FIXME: let user change this
-        constexpr ErrorSeverity LoggingLevel = ErrorSeverity::Warning;
-
+        auto LoggingLevel = GetLoggingLevel();
         if (Severity < LoggingLevel)
             return;
 
@@ -1,11 +1,14 @@
 #include "ErrorReporting.h"
 
+#include <atomic>
 #include <iostream>
 #include <stdarg.h>
 #include <unordered_map>
 
 namespace lce::Common
 {
+    static std::atomic<ErrorSeverity> LoggingLevel = ErrorSeverity::Warning;
+
     std::string ApplyGlobalFormattingToMessage(ErrorSeverity Severity, const SourceLocation& Location, const char* FormattedMessage)
     {
         static const std::unordered_map<ErrorSeverity, std::string_view> ErrorSeverityString = {
@@ -30,4 +33,14 @@ namespace lce::Common
             std::cout << Message << std::endl;
         }
     }
+
+    void SetLoggingLevel(ErrorSeverity Level)
+    {
+        LoggingLevel.store(Level, std::memory_order_relaxed);
+    }
+
+    ErrorSeverity GetLoggingLevel()
+    {
+        return LoggingLevel.load(std::memory_order_relaxed);
+    }
 } // namespace lce::Common
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+
+#include "MemoryBlock.h"
+
+namespace lce::Emulator
+{
+    /*
+     * Forwards every access to another block and counts the bytes that are read from and written to it. The block
+     * never exposes host memory, so the CPU has to go through Read and Write for every access, instruction fetches
+     * included, and nothing is missed. That makes it a lot slower than the block it wraps, so it is only meant for
+     * measurements.
+     */
+    class AccessCountingMemoryBlock : public MemoryBlock
+    {
+    public:
+        explicit AccessCountingMemoryBlock(std::unique_ptr<MemoryBlock> Inner);
+
+        virtual uint8_t Read(uint16_t RelativeAddress) const override;
+
+        virtual void Write(uint16_t RelativeAddress, uint8_t Value) override;
+
+        virtual uint16_t Size() const override;
+
+        virtual void ReadRange(uint16_t RelativeAddress, std::span<uint8_t> Bytes) const override;
+
+        virtual void WriteRange(uint16_t RelativeAddress, std::span<const uint8_t> Bytes) override;
+
+        virtual uint16_t ReadWord(uint16_t RelativeAddress) const override;
+
+        virtual void WriteWord(uint16_t RelativeAddress, uint16_t Value) override;
+
+        // NOTE: the copy wraps a copy of the inner block and starts counting from zero
+        virtual std::unique_ptr<MemoryBlock> Clone() const override;
+
+        uint64_t GetBytesRead() const;
+        uint64_t GetBytesWritten() const;
+
+    private:
+        std::unique_ptr<MemoryBlock> m_Inner;
+
+        mutable uint64_t m_BytesRead = 0;
+        uint64_t m_BytesWritten = 0;
+    };
+} // namespace lce::Emulator
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Instruction.h"
+
+namespace lce::Emulator
+{
+    // Number of lanes that every array passed to the batch kernels must be padded to
+    constexpr size_t BatchLaneAlignment = 16;
+
+    /*
+     * Data parallel operations used by CPUBatch. Every operation works on arrays that hold one 16-bit value per lane
+     * and only modifies lanes whose entry in Mask is 0xFFFF (lanes with 0 in Mask are left untouched). LaneCount must
+     * be a multiple of BatchLaneAlignment.
+     */
+    struct BatchKernels
+    {
+        const char* Name;
+
+        // Destination = Source, or Immediate if Source is nullptr
+        void (*Move)(uint16_t* Destination, const uint16_t* Source, uint16_t Immediate, const uint16_t* Mask, size_t LaneCount);
+
+        // Add, sub, and, or, xor and not. Source is nullptr if the immediate value should be used instead
+        void (*Arithmetic)(Assembler::Opcode Opcode, uint16_t* Destination, const uint16_t* Source, uint16_t Immediate,
+                           uint16_t* Flags, const uint16_t* Mask, size_t LaneCount);
+
+        // Shl and shr by the same number of bits in every lane
+        void (*Shift)(Assembler::Opcode Opcode, uint16_t* Destination, uint16_t Count, uint16_t* Flags, const uint16_t* Mask, size_t LaneCount);
+
+        /*
+         * Sets IP to the jump target in lanes where any bit of FlagMask is set in Flags (in all lanes if FlagMask is
+         * 0) and to NextAddress in the rest. The target is taken from Target, or TargetImmediate if Target is nullptr
+         */
+        void (*Jump)(uint16_t* IP, const uint16_t* Flags, uint16_t FlagMask, const uint16_t* Target, uint16_t TargetImmediate,
+                     uint16_t NextAddress, const uint16_t* Mask, size_t LaneCount);
+
+        // Load and store a word at the same address in every lane; each row holds one byte of that address for all lanes
+        void (*LoadWord)(const uint8_t* LowRow, const uint8_t* HighRow, uint16_t* Destination, const uint16_t* Mask, size_t LaneCount);
+        void (*StoreWord)(uint8_t* LowRow, uint8_t* HighRow, const uint16_t* Source, const uint16_t* Mask, size_t LaneCount);
+
+        // Returns the lowest IP among the lanes that are not halted, or 0xFFFF if all of them are
+        uint16_t (*MinimumIP)(const uint16_t* IP, const uint16_t* Halted, size_t LaneCount);
+
+        // Enables the lanes that are not halted and whose IP equals Address, returns the number of enabled lanes
+        size_t (*SelectLanes)(const uint16_t* IP, const uint16_t* Halted, uint16_t Address, uint16_t* Mask, size_t LaneCount);
+    };
+
+    const BatchKernels& GetScalarBatchKernels();
+
+    // NOTE: these return nullptr if the kernels were not compiled in. Whether the host can run them is up to the caller
+    const BatchKernels* GetSSE2BatchKernels();
+    const BatchKernels* GetAVX2BatchKernels();
+} // namespace lce::Emulator
@@ -0,0 +1,238 @@
+#pragma once
+
+#include "BatchKernels.h"
+#include "CPU.h"
+
+namespace lce::Emulator
+{
+    /*
+     * Batch kernels written against a vector type V, which describes how Width lanes of 16-bit values are loaded,
+     * stored and combined. Every instruction set instantiates them in its own translation unit that is compiled with
+     * the matching target flags.
+     *
+     * NOTE: V has to be defined in an anonymous namespace, and the kernels must not call anything that is not inlined
+     * into them, otherwise the linker could pick a copy that was compiled for a different instruction set.
+     */
+    template <typename V>
+    struct BatchKernelImplementation
+    {
+        using Vector = typename V::Type;
+
+        constexpr static uint16_t ZeroFlag = static_cast<uint16_t>(Flag::Zero);
+        constexpr static uint16_t NegativeFlag = static_cast<uint16_t>(Flag::Negative);
+        constexpr static uint16_t CarryFlag = static_cast<uint16_t>(Flag::Carry);
+        constexpr static uint16_t OverflowFlag = static_cast<uint16_t>(Flag::Overflow);
+        constexpr static uint16_t FlagMask = 0x000F;
+
+        // Takes lanes from A where Mask is set and from B elsewhere
+        static Vector Select(Vector Mask, Vector A, Vector B)
+        {
+            return V::Or(V::And(Mask, A), V::AndNot(Mask, B));
+        }
+
+        static void UpdateFlags(uint16_t* Flags, Vector Result, Vector CarryAndOverflow, Vector LaneMask)
+        {
+            auto Zero = V::And(V::Equal(Result, V::Zero()), V::Broadcast(ZeroFlag));
+            auto Negative = V::And(V::ShiftRight(Result, 14), V::Broadcast(NegativeFlag));
+
+            // NOTE: the rest of the bits are reserved, so we leave them untouched
+            auto OldFlags = V::Load(Flags);
+            auto NewFlags = V::Or(V::AndNot(V::Broadcast(FlagMask), OldFlags), V::Or(V::Or(Zero, Negative), CarryAndOverflow));
+            V::Store(Flags, Select(LaneMask, NewFlags, OldFlags));
+        }
+
+        static void Move(uint16_t* Destination, const uint16_t* Source, uint16_t Immediate, const uint16_t* Mask, size_t LaneCount)
+        {
+            auto ImmediateVector = V::Broadcast(Immediate);
+            for (size_t Lane = 0; Lane < LaneCount; Lane += V::Width)
+            {
+                auto Value = Source ? V::Load(Source + Lane) : ImmediateVector;
+                V::Store(Destination + Lane, Select(V::Load(Mask + Lane), Value, V::Load(Destination + Lane)));
+            }
+        }
+
+        template <Assembler::Opcode Opcode, bool HasSource>
+        static void ArithmeticLoop(uint16_t* Destination, const uint16_t* Source, uint16_t Immediate, uint16_t* Flags,
+                                   const uint16_t* Mask, size_t LaneCount)
+        {
+            auto ImmediateVector = V::Broadcast(Immediate);
+            for (size_t Lane = 0; Lane < LaneCount; Lane += V::Width)
+            {
+                auto LaneMask = V::Load(Mask + Lane);
+                auto Left = V::Load(Destination + Lane);
+                auto Right = HasSource ? V::Load(Source + Lane) : ImmediateVector;
+
+                Vector Result;
+                auto CarryAndOverflow = V::Zero();
+                if constexpr (Opcode == Assembler::Opcode::Add)
+                {
+                    // NOTE: saturating addition only differs from the wrapping one if the result does not fit into 16 bits
+                    Result = V::Add(Left, Right);
+                    auto Carry = V::AndNot(V::Equal(V::AddSaturate(Left, Right), Result), V::Broadcast(CarryFlag));
+                    auto Overflow = V::And(V::ShiftRight(V::And(V::Xor(Left, Result), V::Xor(Right, Result)), 12), V::Broadcast(OverflowFlag));
+                    CarryAndOverflow = V::Or(Carry, Overflow);
+                }
+                else if constexpr (Opcode == Assembler::Opcode::Sub)
+                {
+                    Result = V::Sub(Left, Right);
+                    auto Carry = V::AndNot(V::Equal(V::SubSaturate(Right, Left), V::Zero()), V::Broadcast(CarryFlag));
+                    auto Overflow = V::And(V::ShiftRight(V::And(V::Xor(Left, Right), V::Xor(Left, Result)), 12), V::Broadcast(OverflowFlag));
+                    CarryAndOverflow = V::Or(Carry, Overflow);
+                }
+                else if constexpr (Opcode == Assembler::Opcode::And)
+                {
+                    Result = V::And(Left, Right);
+                }
+                else if constexpr (Opcode == Assembler::Opcode::Or)
+                {
+                    Result = V::Or(Left, Right);
+                }
+                else if constexpr (Opcode == Assembler::Opcode::Xor)
+                {
+                    Result = V::Xor(Left, Right);
+                }
+                else if constexpr (Opcode == Assembler::Opcode::Not)
+                {
+                    Result = V::Xor(Left, V::Broadcast(0xFFFF));
+                }
+
+                // NOTE: flags are loaded after the result is stored, since the destination can be RFL itself
+                V::Store(Destination + Lane, Select(LaneMask, Result, Left));
+                UpdateFlags(Flags + Lane, Result, CarryAndOverflow, LaneMask);
+            }
+        }
+
+        static void Arithmetic(Assembler::Opcode Opcode, uint16_t* Destination, const uint16_t* Source, uint16_t Immediate,
+                               uint16_t* Flags, const uint16_t* Mask, size_t LaneCount)
+        {
+#define DISPATCH_ARITHMETIC(Name)                                                                                       \
+    case Assembler::Opcode::Name:                                                                                       \
+        if (Source)                                                                                                     \
+            ArithmeticLoop<Assembler::Opcode::Name, true>(Destination, Source, Immediate, Flags, Mask, LaneCount);      \
+        else                                                                                                            \
+            ArithmeticLoop<Assembler::Opcode::Name, false>(Destination, Source, Immediate, Flags, Mask, LaneCount);     \
+        break;
+            switch (Opcode)
+            {
+            DISPATCH_ARITHMETIC(Add)
+            DISPATCH_ARITHMETIC(Sub)
+            DISPATCH_ARITHMETIC(And)
+            DISPATCH_ARITHMETIC(Or)
+            DISPATCH_ARITHMETIC(Xor)
+            DISPATCH_ARITHMETIC(Not)
+            default:
+                break;
+            }
+#undef DISPATCH_ARITHMETIC
+        }
+
+        template <Assembler::Opcode Opcode>
+        static void ShiftLoop(uint16_t* Destination, uint16_t Count, uint16_t* Flags, const uint16_t* Mask, size_t LaneCount)
+        {
+            // NOTE: carry holds the last bit that was shifted out
+            bool HasCarry = Count > 0 && Count <= 16;
+            int CarryShift = 0;
+            if (HasCarry)
+                CarryShift = Opcode == Assembler::Opcode::Shl ? 16 - Count : Count - 1;
+
+            for (size_t Lane = 0; Lane < LaneCount; Lane += V::Width)
+            {
+                auto LaneMask = V::Load(Mask + Lane);
+                auto Left = V::Load(Destination + Lane);
+
+                auto Result = V::Zero();
+                if (Count < 16)
+                    Result = Opcode == Assembler::Opcode::Shl ? V::ShiftLeft(Left, Count) : V::ShiftRight(Left, Count);
+
+                auto Carry = V::Zero();
+                if (HasCarry)
+                    Carry = V::ShiftLeft(V::And(V::ShiftRight(Left, CarryShift), V::Broadcast(1)), 2);
+
+                V::Store(Destination + Lane, Select(LaneMask, Result, Left));
+                UpdateFlags(Flags + Lane, Result, Carry, LaneMask);
+            }
+        }
+
+        static void Shift(Assembler::Opcode Opcode, uint16_t* Destination, uint16_t Count, uint16_t* Flags, const uint16_t* Mask, size_t LaneCount)
+        {
+            if (Opcode == Assembler::Opcode::Shl)
+                ShiftLoop<Assembler::Opcode::Shl>(Destination, Count, Flags, Mask, LaneCount);
+            else
+                ShiftLoop<Assembler::Opcode::Shr>(Destination, Count, Flags, Mask, LaneCount);
+        }
+
+        static void Jump(uint16_t* IP, const uint16_t* Flags, uint16_t FlagMask, const uint16_t* Target, uint16_t TargetImmediate,
+                         uint16_t NextAddress, const uint16_t* Mask, size_t LaneCount)
+        {
+            auto TargetImmediateVector = V::Broadcast(TargetImmediate);
+            auto NextAddressVector = V::Broadcast(NextAddress);
+            auto FlagMaskVector = V::Broadcast(FlagMask);
+            for (size_t Lane = 0; Lane < LaneCount; Lane += V::Width)
+            {
+                auto LaneMask = V::Load(Mask + Lane);
+                auto TargetVector = Target ? V::Load(Target + Lane) : TargetImmediateVector;
+
+                auto Taken = V::Broadcast(0xFFFF);
+                if (FlagMask)
+                    Taken = V::AndNot(V::Equal(V::And(V::Load(Flags + Lane), FlagMaskVector), V::Zero()), Taken);
+
+                auto NewIP = Select(Taken, TargetVector, NextAddressVector);
+                V::Store(IP + Lane, Select(LaneMask, NewIP, V::Load(IP + Lane)));
+            }
+        }
+
+        static void LoadWord(const uint8_t* LowRow, const uint8_t* HighRow, uint16_t* Destination, const uint16_t* Mask, size_t LaneCount)
+        {
+            for (size_t Lane = 0; Lane < LaneCount; Lane += V::Width)
+            {
+                auto Value = V::Or(V::LoadBytes(LowRow + Lane), V::ShiftLeft(V::LoadBytes(HighRow + Lane), 8));
+                V::Store(Destination + Lane, Select(V::Load(Mask + Lane), Value, V::Load(Destination + Lane)));
+            }
+        }
+
+        static void StoreWord(uint8_t* LowRow, uint8_t* HighRow, const uint16_t* Source, const uint16_t* Mask, size_t LaneCount)
+        {
+            for (size_t Lane = 0; Lane < LaneCount; Lane += V::Width)
+            {
+                auto LaneMask = V::Load(Mask + Lane);
+                auto Value = V::Load(Source + Lane);
+                V::StoreBytes(LowRow + Lane, V::And(Value, V::Broadcast(0xFF)), LaneMask);
+                V::StoreBytes(HighRow + Lane, V::ShiftRight(Value, 8), LaneMask);
+            }
+        }
+
+        static uint16_t MinimumIP(const uint16_t* IP, const uint16_t* Halted, size_t LaneCount)
+        {
+            // NOTE: halted lanes hold 0xFFFF in Halted, which turns their IP into the largest possible value
+            auto Minimum = V::Broadcast(0xFFFF);
+            for (size_t Lane = 0; Lane < LaneCount; Lane += V::Width)
+                Minimum = V::Minimum(Minimum, V::Or(V::Load(IP + Lane), V::Load(Halted + Lane)));
+            return V::HorizontalMinimum(Minimum);
+        }
+
+        static size_t SelectLanes(const uint16_t* IP, const uint16_t* Halted, uint16_t Address, uint16_t* Mask, size_t LaneCount)
+        {
+            auto AddressVector = V::Broadcast(Address);
+            size_t Count = 0;
+            for (size_t Lane = 0; Lane < LaneCount; Lane += V::Width)
+            {
+                auto LaneMask = V::AndNot(V::Load(Halted + Lane), V::Equal(V::Load(IP + Lane), AddressVector));
+                V::Store(Mask + Lane, LaneMask);
+                Count += V::CountSet(LaneMask);
+            }
+            return Count;
+        }
+
+        constexpr static BatchKernels Table = {
+            V::Name,
+            &Move,
+            &Arithmetic,
+            &Shift,
+            &Jump,
+            &LoadWord,
+            &StoreWord,
+            &MinimumIP,
+            &SelectLanes
+        };
+    };
+} // namespace lce::Emulator
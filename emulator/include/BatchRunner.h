@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "CPU.h"
+
+namespace lce::Emulator
+{
+    /*
+     * A single program to run: a ROM image that is mapped at 0x0000 and an optional input file that is copied into RAM
+     */
+    struct BatchJob
+    {
+        std::filesystem::path ROMPath;
+        std::filesystem::path InputPath;
+    };
+
+    struct BatchJobOptions
+    {
+        ExecutionEngine Engine = ExecutionEngine::Interpreter;
+
+        uint16_t StartAddress = 0x7FF0;
+        uint16_t StackAddress = 0x8000;
+        uint16_t InputAddress = 0xA000;
+
+        // Programs that have not halted after this many cycles are stopped and reported as failed, 0 means no limit
+        uint64_t MaxCycles = 0;
+
+        // Range of RAM that is reported once the program halts, nothing is reported if OutputSize is 0
+        uint16_t OutputAddress = 0xA000;
+        uint16_t OutputSize = 0;
+    };
+
+    struct BatchJobResult
+    {
+        bool Succeeded = false;
+
+        // Error message if the job could not be started, otherwise the serialized state of the CPU after it stopped
+        std::string State;
+        std::vector<uint8_t> Output;
+
+        RunResult Run;
+    };
+
+    /*
+     * Parses a manifest with one job per line. Every line holds the path to a ROM image, optionally followed by the
+     * path to an input file. Relative paths are resolved against BaseDirectory; empty lines and lines that start with
+     * '#' are ignored.
+     */
+    bool ParseBatchManifest(std::string_view Manifest, std::string_view FileName, const std::filesystem::path& BaseDirectory,
+                            std::vector<BatchJob>& Jobs);
+
+    BatchJobResult RunBatchJob(const BatchJob& Job, const BatchJobOptions& Options);
+} // namespace lce::Emulator
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "InstructionCache.h"
+
+namespace lce::Emulator
+{
+    struct BlockOperation;
+
+    using BlockOperationHandler = void (CPU::*)(const BlockOperation& Operation);
+
+    /*
+     * A single step of a translated block. It executes either one instruction or a superinstruction made of two
+     * adjacent instructions (in which case both First and Second are used).
+     */
+    struct BlockOperation
+    {
+        BlockOperationHandler Handler = nullptr;
+
+        DecodedInstruction First;
+        DecodedInstruction Second;
+
+        // Guest address of the instruction that follows this operation
+        uint16_t NextAddress = 0;
+
+        bool MayWriteMemory = false;
+    };
+
+    /*
+     * Straight-line sequence of instructions that ends with a control transfer (jump, call, ret, hlt) or
+     * an instruction that can not be translated
+     */
+    struct TranslatedBlock
+    {
+        uint16_t StartAddress = 0;
+        uint32_t EndAddress = 0; // One past the last byte of the last instruction
+
+        uint32_t InstructionCount = 0;
+
+        // Cleared when guest code overwrites any byte of the block
+        bool IsValid = true;
+
+        // Number of times the block was executed without being compiled, used by the JIT to find hot blocks
+        uint32_t ExecutionCount = 0;
+
+        std::vector<BlockOperation> Operations;
+    };
+
+    class BlockCache
+    {
+    public:
+        TranslatedBlock* Find(uint16_t Address) const
+        {
+            const auto& Page = m_Entries[Address >> PageShift];
+            if (!Page)
+                return nullptr;
+            return (*Page)[Address & PageMask].get();
+        }
+
+        TranslatedBlock& Insert(std::unique_ptr<TranslatedBlock> Block);
+
+        /*
+         * Must be called whenever a byte of guest memory changes; invalidates every block that contains that byte.
+         * Invalidated blocks stay alive until ReleaseInvalidatedBlocks() is called, so a block can safely modify itself.
+         */
+        void OnMemoryWrite(uint16_t Address)
+        {
+            if (m_CodePages.test(Address >> PageShift))
+                InvalidateBlocksContaining(Address);
+        }
+
+        void ReleaseInvalidatedBlocks()
+        {
+            if (!m_InvalidatedBlocks.empty())
+                m_InvalidatedBlocks.clear();
+        }
+
+        void Clear();
+
+    private:
+        constexpr static size_t PageShift = 8;
+        constexpr static size_t PageSize = 1 << PageShift;
+        constexpr static size_t PageMask = PageSize - 1;
+        constexpr static size_t PageCount = 65536 / PageSize;
+
+        // Blocks indexed by their start address
+        std::array<std::unique_ptr<std::array<std::unique_ptr<TranslatedBlock>, PageSize>>, PageCount> m_Entries;
+
+        // Blocks that overlap each page, used to find the blocks affected by a write
+        std::array<std::vector<TranslatedBlock*>, PageCount> m_BlocksByPage;
+        std::bitset<PageCount> m_CodePages;
+
+        std::vector<std::unique_ptr<TranslatedBlock>> m_InvalidatedBlocks;
+
+        void InvalidateBlocksContaining(uint16_t Address);
+    };
+} // namespace lce::Emulator
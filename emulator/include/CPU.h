@@ -1,55 +1,400 @@
 #pragma once
 
+#include <array>
+#include <bitset>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <optional>
 #include <span>
+#include <string>
+#include <string_view>
 #include <vector>
 
+#include "BlockCache.h"
+#include "CPUCore.h"
+#include "DeviceBus.h"
 #include "Instruction.h"
+#include "InstructionCache.h"
 #include "MemoryBlock.h"
+#include "RealTimePacer.h"
 
 namespace lce::Emulator
 {
-    class CPU
+    enum class ExecutionEngine
+    {
+        // Executes instructions one at a time from a central loop
+        Interpreter,
+
+        // Every instruction handler dispatches the next instruction directly, without returning to a central loop
+        Threaded,
+
+        // Translates straight-line code into cached blocks with fused instruction pairs and executes a block at a time
+        BasicBlocks,
+
+        // Like BasicBlocks, but hot blocks are compiled to native code. Falls back to BasicBlocks on hosts other than x86-64
+        JIT
+    };
+
+    // Accepts the names used on the command line: interpreter, threaded, blocks and jit
+    bool ParseExecutionEngine(std::string_view Name, ExecutionEngine& Engine);
+
+    enum class StopReason
+    {
+        // The CPU executed hlt
+        Halted,
+
+        // The cycle budget of the run was used up
+        CycleLimit,
+
+        // The address or condition passed to RunUntil or a breakpoint was reached
+        Breakpoint,
+
+        // The guest accessed memory that is watched, the instruction that accessed it has been executed
+        Watchpoint,
+
+        // The CPU tried to execute an invalid instruction and halted
+        Fault
+    };
+
+    const char* GetStopReasonName(StopReason Reason);
+
+    struct RunResult
+    {
+        StopReason Reason = StopReason::Halted;
+
+        // Instructions retired and host time spent during this run only
+        uint64_t Instructions = 0;
+        std::chrono::nanoseconds WallTime{ 0 };
+    };
+
+    enum class WatchpointKind
+    {
+        Read,
+        Write,
+        // Either a read or a write
+        Access
+    };
+
+    /*
+     * Range of guest memory that stops the CPU when the guest accesses it. If Value is set, only accesses that read or
+     * write exactly that value count, which needs the range to be at most 2 bytes long (the value is stored
+     * little-endian, like a word in memory). An access that only touches one byte of the range compares that byte.
+     */
+    struct Watchpoint
+    {
+        uint16_t Address = 0;
+        uint16_t Size = 1;
+        WatchpointKind Kind = WatchpointKind::Write;
+        std::optional<uint16_t> Value = std::nullopt;
+
+        bool operator==(const Watchpoint&) const = default;
+    };
+
+    struct WatchpointHit
+    {
+        Watchpoint Trigger;
+
+        // First byte of the watched range that the access touched
+        uint16_t Address = 0;
+
+        // Word that the guest read or wrote and its address, which can start one byte before the range
+        uint16_t AccessAddress = 0;
+        uint16_t Value = 0;
+        bool IsWrite = false;
+    };
+
+    // Bytes that the guest read from and wrote to a single memory block
+    struct MemoryAccessCounts
+    {
+        // NOTE: includes instruction fetches
+        uint64_t BytesRead = 0;
+        uint64_t BytesWritten = 0;
+    };
+
+    class ExecutionProfiler;
+    class ExecutionTracer;
+    class InputLog;
+    class JITCompiler;
+
+    /*
+     * Complete state of a CPU: registers, IP and the contents of every memory block. Plain memory is shared page by
+     * page with the CPU that the snapshot was taken from and with every CPU that it is restored into, so a page is
+     * only copied once one of them writes to it.
+     */
+    struct CPUSnapshot
+    {
+        uint16_t IP = 0;
+        std::array<uint16_t, static_cast<size_t>(Assembler::Register::Count_)> Registers = {};
+        bool IsHalted = false;
+        bool HasFaulted = false;
+        uint64_t CycleCount = 0;
+
+        std::vector<std::pair<uint16_t, std::shared_ptr<const MemoryBlock>>> MemoryBlocks;
+    };
+
+    class CPU : public CPUCore<CPU>
     {
     public:
-        void Reset();
+        explicit CPU(ExecutionEngine Engine = ExecutionEngine::Interpreter);
+        ~CPU();
 
-        void ExecuteSingleInstruction(std::span<uint8_t> Bytes);
+        void Reset();
 
         void Run(uint16_t StartAddress);
 
+        /*
+         * Like Run, but keeps guest time in step with the host clock instead of running as fast as possible. Returns
+         * how closely the requested clock frequency was followed.
+         */
+        PacingStatistics RunRealTime(uint16_t StartAddress, const PacingOptions& Options = {});
+
+        /*
+         * Continues from the current IP until the CPU halts or MaxCycles cycles have been executed. The budget is only
+         * checked between blocks of straight-line code, so the run can end up to one block past it.
+         */
+        RunResult RunFor(uint64_t MaxCycles);
+
+        /*
+         * Continues from the current IP until the next instruction is at Address (or Predicate returns true after an
+         * instruction), the CPU halts or MaxCycles cycles have been executed. The instruction at the current IP is
+         * always executed, so calling RunUntil again continues to the next hit. These run one instruction at a time
+         * on every engine.
+         */
+        RunResult RunUntil(uint16_t Address, uint64_t MaxCycles = UINT64_MAX);
+        RunResult RunUntil(const std::function<bool(const CPU&)>& Predicate, uint64_t MaxCycles = UINT64_MAX);
+
+        // Why the last run stopped: Breakpoint or Watchpoint, Halted or Fault if the CPU is halted, CycleLimit otherwise
+        StopReason GetStopReason() const;
+
+        // NOTE: every instruction takes exactly one cycle, so this is always equal to the cycle count
+        uint64_t GetRetiredInstructionCount() const;
+
         bool AddMemoryBlock(std::unique_ptr<MemoryBlock> NewBlock, uint16_t StartAddress);
 
-        uint16_t GetRegister(Assembler::Register Register) const;
+        /*
+         * Maps the bus like a memory block and keeps its devices in step with the cycle count. Devices see time with
+         * the same granularity as the engine checks its cycle limit, i.e. per block on the block and JIT engines.
+         */
+        bool AddDeviceBus(std::unique_ptr<DeviceBus> Bus, uint16_t StartAddress);
+
+        /*
+         * Reads or writes guest memory on behalf of the host, e.g. a debugger, with the same effects as accesses from
+         * the guest: decoded instructions are kept up to date and devices see the accesses. Both return false without
+         * accessing anything if a byte of the range is not mapped.
+         */
+        bool ReadMemory(uint16_t Address, std::span<uint8_t> Bytes) const;
+        bool WriteMemory(uint16_t Address, std::span<const uint8_t> Bytes);
+
+        /*
+         * Counts the bytes read from and written to every memory block from now on, or stops counting. While counting,
+         * host memory is never accessed directly and no instructions are cached, so every access goes through the
+         * memory blocks and the guest runs a lot slower (the block and JIT engines run the threaded engine instead,
+         * like with watchpoints). Accesses through ReadMemory and WriteMemory are counted too. Enabling it resets
+         * the counts.
+         */
+        void CountMemoryAccesses(bool Enable);
+
+        // Returns one entry per memory block, in the order in which the blocks were added
+        const std::vector<MemoryAccessCounts>& GetMemoryAccessCounts() const;
+
+        // Returns true if the JIT engine has compiled the block that starts at Address to native code
+        bool HasNativeCode(uint16_t Address) const;
+
+        /*
+         * Makes every engine stop with StopReason::Watchpoint right after an instruction that accesses watched memory.
+         * Guest loads and stores only test a bit per page for their kind of access, and only accesses to marked pages
+         * are compared against the watchpoints, so memory that is not watched is accessed as fast as before. The block
+         * and JIT engines only stop between blocks, so the threaded engine runs instead of them while watchpoints are
+         * set. Accesses through ReadMemory and WriteMemory are never watched. AddWatchpoint returns false if the
+         * watchpoint is empty or has a value but is longer than 2 bytes, RemoveWatchpoint if there is no such one.
+         */
+        bool AddWatchpoint(const Watchpoint& NewWatchpoint);
+        bool RemoveWatchpoint(const Watchpoint& OldWatchpoint);
+
+        // Returns false unless the last run stopped at a watchpoint
+        bool GetWatchpointHit(WatchpointHit& Hit) const;
+
+        /*
+         * Records every instruction executed from now on into the tracer, or stops tracing if it is nullptr. While a
+         * tracer is set the CPU runs on the interpreter regardless of its engine. The tracer is not owned by the CPU.
+         */
+        void SetTracer(ExecutionTracer* Tracer);
+
+        // Like SetTracer, but counts instructions and call edges for a profile instead
+        void SetProfiler(ExecutionProfiler* Profiler);
 
-        // NOTE: this should probably be only used in the testing environment
-        void SetRegister(Assembler::Register Register, uint16_t Value);
+        /*
+         * Appends every byte that the guest reads from a device bus to the log, or stops recording if it is nullptr.
+         * The log is not owned by the CPU.
+         */
+        void RecordInputs(InputLog* Log);
 
-        std::string SerializeState() const;
+        /*
+         * Answers every read from a device bus with the next byte of the log instead of asking the devices, which are
+         * neither accessed nor advanced while replaying, or goes back to the devices if the log is nullptr. If the
+         * guest reads from another address than the recorded run did, the CPU halts with a fault (on the block and
+         * JIT engines at the end of the current block).
+         */
+        void ReplayInputs(InputLog* Log);
+
+        /*
+         * Drops all decoded instructions. Writes performed by the CPU itself keep the cache up to date automatically,
+         * so this is only needed if the contents of a memory block are changed directly by the host
+         */
+        void InvalidateInstructionCache();
+
+        // Returns false if one of the memory blocks cannot be copied (see MemoryBlock::Clone)
+        bool Snapshot(CPUSnapshot& Snapshot);
+
+        // Replaces the whole state of the CPU, including its memory blocks, with the one stored in the snapshot
+        void Restore(const CPUSnapshot& Snapshot);
+
+        // Creates a CPU with the same engine and state as this one, or returns nullptr if the state cannot be copied
+        std::unique_ptr<CPU> Fork();
 
     private:
-        using RegisterIndexUnderlyingType = std::underlying_type<Assembler::Register>::type;
-        constexpr static size_t RegisterCount = static_cast<RegisterIndexUnderlyingType>(Assembler::Register::Count_);
+        friend class CPUCore<CPU>;
+        friend class DeviceBus;
+        friend class JITCompiler;
 
-        bool m_IsHalted = false;
+        ExecutionEngine m_Engine;
 
-        uint16_t m_IP = 0;
-        uint16_t m_Registers[RegisterCount];
         std::vector<std::pair<uint16_t, std::unique_ptr<MemoryBlock>>> m_MemoryBlocks;
 
+        // NOTE: the buses are owned by m_MemoryBlocks
+        std::vector<DeviceBus*> m_DeviceBuses;
+        DeviceEventQueue m_DeviceEvents;
+
+        constexpr static size_t PageShift = 8;
+        constexpr static size_t PageSize = 1 << PageShift;
+        constexpr static size_t PageMask = PageSize - 1;
+        constexpr static size_t PageCount = AddressSpaceSize / PageSize;
+
+        static_assert(MemoryBlock::DirectPageSize % PageSize == 0);
+
+        /*
+         * Describes how the addresses of a single page are mapped onto memory blocks. A page that is fully covered
+         * by one block stores that block directly (and a host pointer to the page if the block is plain memory),
+         * while a page that is shared between several blocks or is only partially mapped stores the index of the
+         * owning block for each of its bytes.
+         */
+        struct MemoryPage
+        {
+            MemoryBlock* Block = nullptr;
+            uint16_t BlockStartAddress = 0;
+            // NOTE: index of Block in m_MemoryBlocks, only used to count accesses
+            uint16_t BlockIndex = 0;
+
+            // Host memory of the page if the block exposes it (see MemoryBlock::DirectPointer)
+            const uint8_t* HostMemory = nullptr;
+            // NOTE: nullptr while the page can not be written in place (e.g. because it is shared with a snapshot)
+            uint8_t* WritableHostMemory = nullptr;
+
+            // NOTE: indices are 1-based, 0 means that the byte is not mapped to any block
+            std::unique_ptr<std::array<uint16_t, PageSize>> BlockIndices;
+        };
+
+        std::array<MemoryPage, PageCount> m_Pages;
+
+        std::vector<Watchpoint> m_Watchpoints;
+
+        /*
+         * Pages that guest reads or writes have to be checked against the watchpoints for. A page is marked if a word
+         * that starts in it can touch a watched byte, so every access only has to test the page of its first byte.
+         */
+        std::bitset<PageCount> m_ReadWatchedPages;
+        std::bitset<PageCount> m_WriteWatchedPages;
+
+        bool m_IsAtWatchpoint = false;
+        WatchpointHit m_WatchpointHit;
+
+        // NOTE: only updated by the accesses that go through the memory blocks, see CountMemoryAccesses
+        bool m_IsCountingAccesses = false;
+        mutable std::vector<MemoryAccessCounts> m_AccessCounts;
+
+        InstructionCache m_InstructionCache;
+        DecodedInstruction m_UncachedInstruction;
+
+        BlockCache m_BlockCache;
+
+        // NOTE: created when the JIT engine runs for the first time
+        std::unique_ptr<JITCompiler> m_JIT;
+
+        ExecutionTracer* m_Tracer = nullptr;
+        ExecutionProfiler* m_Profiler = nullptr;
+
+        // NOTE: the log is either recorded into or replayed from, depending on m_IsReplayingInputs
+        InputLog* m_InputLog = nullptr;
+        bool m_IsReplayingInputs = false;
+
+        void MapMemoryBlockPages(size_t BlockIndex);
+        void UpdateHostMemory(MemoryPage& Page, size_t PageStartAddress);
+        void UpdateAllHostMemory();
+
         MemoryBlock* FindMemoryBlock(uint16_t AbsoluteAddress, uint16_t& StartAddress) const;
+        bool IsMapped(uint16_t Address, size_t Size) const;
 
         uint8_t ReadByte(uint16_t AbsoluteAddress) const;
         uint8_t ReadByteOr(uint16_t AbsoluteAddress, uint8_t Fallback) const;
-        uint16_t ReadWord(uint16_t AbsoluteAddress) const;
+        uint16_t LoadWord(uint16_t AbsoluteAddress) const;
 
         void WriteByte(uint16_t AbsoluteAddress, uint8_t Value);
+        void StoreWord(uint16_t AbsoluteAddress, uint16_t Value);
+        void OnMemoryWrite(uint16_t AbsoluteAddress);
+        void CountAccess(uint16_t AbsoluteAddress, uint64_t Size, bool IsWrite) const;
+        void OnBreakpointChanged(uint16_t Address);
+
+        // Accesses of the guest, which unlike LoadWord and StoreWord stop the CPU at watchpoints
+        uint16_t ReadWord(uint16_t AbsoluteAddress);
         void WriteWord(uint16_t AbsoluteAddress, uint16_t Value);
 
-        uint16_t ReadRegister(Assembler::Register Register) const;
-        void WriteRegister(Assembler::Register Register, uint16_t Value);
+        void UpdateWatchedPages();
+        void CheckWatchpoints(uint16_t AbsoluteAddress, uint16_t Value, bool IsWrite);
+
+        static DecodedInstruction DecodeInstruction(const uint8_t* Bytes);
+        static InstructionHandler GetInstructionHandler(HandlerID ID);
+
+        const DecodedInstruction& FetchInstruction(uint16_t Address);
+        void ExecuteDecodedInstruction(const DecodedInstruction& Instruction);
+        void ExecuteInstrumentedInstruction(const DecodedInstruction& Instruction);
+
+        // Runs from the current IP until the CPU halts, stops at a breakpoint or the cycle count reaches CycleLimit
+        void RunUntilCycle(uint64_t CycleLimit);
+
+        // Executes the instruction that the CPU stopped at if it stopped at a breakpoint, otherwise does nothing
+        void StepOverBreakpoint();
+
+        // Queues a device event and makes the running engine stop in time for it
+        void ScheduleDeviceEvent(DeviceBus& Bus, size_t DeviceIndex, uint64_t Cycle);
+
+        uint8_t ReplayInput(uint16_t AbsoluteAddress);
+
+        template <typename ConditionType>
+        RunResult StepUntil(const ConditionType& Condition, uint64_t MaxCycles);
+
+        void RunInterpreter();
+        void RunInstrumented();
+        void RunThreaded();
+        void RunBasicBlocks();
+        void RunJIT();
+
+        TranslatedBlock* TranslateBlock(uint16_t StartAddress);
+        void ExecuteBlock(const TranslatedBlock& Block);
+
+        template <HandlerID ID>
+        void ExecuteBlockOperation(const BlockOperation& Operation);
+        template <HandlerID First, HandlerID Second>
+        void ExecuteSuperinstruction(const BlockOperation& Operation);
+        static BlockOperationHandler GetBlockOperationHandler(HandlerID ID);
+        static BlockOperationHandler GetSuperinstructionHandler(HandlerID First, HandlerID Second);
 
-        void ExecuteMov(const uint8_t* Bytes, const uint8_t* EndOfStream);
+        // NOTE: only used by the threaded engine on compilers that do not support computed goto
+        using ThreadedHandler = void (*)(CPU& Processor, const DecodedInstruction& Instruction, uint32_t ChainLength);
+        template <HandlerID ID>
+        static void ExecuteThreaded(CPU& Processor, const DecodedInstruction& Instruction, uint32_t ChainLength);
+        static ThreadedHandler GetThreadedHandler(HandlerID ID);
     };
 } // namespace lce::Emulator
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "BatchKernels.h"
+#include "Instruction.h"
+#include "InstructionCache.h"
+#include "MemoryBlock.h"
+
+namespace lce::Emulator
+{
+    enum class BatchKernelSet
+    {
+        // Widest kernels that the host supports
+        Best,
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    /*
+     * Runs many instances ("lanes") of the same program in lockstep. The state is stored as a structure of arrays, with
+     * one array per register that holds its value for every lane, so a decoded instruction is applied to all lanes that
+     * are at the same IP with a single vector operation. When a branch sends lanes to different addresses, the lanes
+     * with the lowest IP run on their own while the rest are masked off, until they reach the same IP again.
+     *
+     * Memory added with AddMemoryBlock is shared by all lanes, while memory added with AddLaneMemory exists separately
+     * for every lane. Lane memory is stored address-major, so the bytes of all lanes at one address are contiguous.
+     */
+    class CPUBatch
+    {
+    public:
+        explicit CPUBatch(size_t LaneCount, BatchKernelSet KernelSet = BatchKernelSet::Best);
+
+        static bool IsKernelSetSupported(BatchKernelSet KernelSet);
+
+        size_t GetLaneCount() const;
+        const char* GetKernelName() const;
+
+        void Reset();
+
+        // Runs every lane that is not halted from StartAddress until all of them halt
+        void Run(uint16_t StartAddress);
+
+        bool AddMemoryBlock(std::unique_ptr<MemoryBlock> NewBlock, uint16_t StartAddress);
+        bool AddLaneMemory(uint16_t StartAddress, uint16_t Size);
+
+        // NOTE: these only work on memory that was added with AddLaneMemory
+        bool WriteLaneMemory(size_t Lane, uint16_t StartAddress, std::span<const uint8_t> Bytes);
+        uint8_t ReadLaneMemory(size_t Lane, uint16_t Address) const;
+
+        uint16_t GetRegister(size_t Lane, Assembler::Register Register) const;
+        void SetRegister(size_t Lane, Assembler::Register Register, uint16_t Value);
+
+        bool IsHalted(size_t Lane) const;
+
+        // Uses the same format as CPU::SerializeState
+        std::string SerializeState(size_t Lane) const;
+
+    private:
+        using RegisterIndexUnderlyingType = std::underlying_type<Assembler::Register>::type;
+        constexpr static size_t RegisterCount = static_cast<RegisterIndexUnderlyingType>(Assembler::Register::Count_);
+
+        constexpr static size_t AddressSpaceSize = 65536;
+        constexpr static size_t PageShift = 8;
+        constexpr static size_t PageSize = 1 << PageShift;
+        constexpr static size_t PageMask = PageSize - 1;
+        constexpr static size_t PageCount = AddressSpaceSize / PageSize;
+
+        const BatchKernels* m_Kernels;
+
+        size_t m_LaneCount;
+        // Lane count rounded up to BatchLaneAlignment; padding lanes are always halted
+        size_t m_Stride;
+
+        std::vector<uint16_t> m_IP;
+        std::vector<uint16_t> m_Registers;
+        // NOTE: 0xFFFF for halted lanes and 0 for the rest, so that it can be used as a mask directly
+        std::vector<uint16_t> m_Halted;
+        // Lanes that execute the current instruction
+        std::vector<uint16_t> m_Mask;
+
+        uint16_t m_CurrentIP = 0;
+        size_t m_SelectedLaneCount = 0;
+        size_t m_RunningLaneCount = 0;
+        bool m_NeedsLaneSelection = true;
+        // NOTE: IP of the selected lanes is only written back when they leave straight-line code
+        bool m_SelectedIPIsStale = false;
+
+        struct LaneMemoryRegion
+        {
+            uint16_t StartAddress;
+            uint32_t Size;
+            std::vector<uint8_t> Rows;
+        };
+
+        std::vector<LaneMemoryRegion> m_LaneMemory;
+        std::vector<std::pair<uint16_t, std::unique_ptr<MemoryBlock>>> m_MemoryBlocks;
+
+        /*
+         * Pages that are fully covered by lane memory or by a single shared block. Everything else is resolved by
+         * searching the regions and blocks.
+         */
+        struct MemoryPage
+        {
+            uint8_t* LaneRows = nullptr;
+
+            MemoryBlock* Block = nullptr;
+            uint16_t BlockStartAddress = 0;
+            uint8_t* HostMemory = nullptr;
+        };
+
+        std::array<MemoryPage, PageCount> m_Pages;
+
+        // NOTE: only holds instructions from shared plain memory, since lane memory can hold different code in every lane
+        InstructionCache m_InstructionCache;
+
+        uint16_t* Register(uint8_t Index);
+        const uint16_t* Register(uint8_t Index) const;
+
+        bool IsRangeFree(uint32_t StartAddress, uint32_t Size) const;
+        void MapPages();
+
+        uint8_t* FindLaneRow(uint16_t Address);
+        const uint8_t* FindLaneRow(uint16_t Address) const;
+        MemoryBlock* FindMemoryBlock(uint16_t Address, uint16_t& StartAddress) const;
+
+        uint8_t ReadByteOr(size_t Lane, uint16_t Address, uint8_t Fallback) const;
+        uint8_t ReadByte(size_t Lane, uint16_t Address) const;
+        uint16_t ReadWord(size_t Lane, uint16_t Address) const;
+        void WriteByte(size_t Lane, uint16_t Address, uint8_t Value);
+        void WriteWord(size_t Lane, uint16_t Address, uint16_t Value);
+
+        void SetArithmeticFlags(size_t Lane, uint16_t Result, bool Carry);
+
+        void SelectLanes();
+        void WriteBackSelectedIP();
+        void EndStraightLineCode();
+
+        template <typename Function>
+        void ForEachSelectedLane(Function&& Func);
+
+        DecodedInstruction FetchInstruction();
+        void Step();
+    };
+} // namespace lce::Emulator
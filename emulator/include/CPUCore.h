@@ -0,0 +1,551 @@
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <string>
+#include <type_traits>
+
+#include "ErrorReporting.h"
+#include "Instruction.h"
+#include "InstructionCache.h"
+#include "InstructionDecoder.h"
+
+namespace lce::Emulator
+{
+    /*
+     * Bits of the RFL register
+     */
+    enum class Flag : uint16_t
+    {
+        Zero = 1 << 0,
+        Negative = 1 << 1,
+        Carry = 1 << 2,
+        Overflow = 1 << 3
+    };
+
+    /*
+     * Registers, flags and instruction handlers shared by every CPU. The only thing that differs between CPUs is how
+     * guest memory is accessed, so the handlers reach memory through ReadWord and WriteWord of Derived and the CPUs
+     * themselves only add the memory map and the loop that fetches and dispatches instructions. Derived also has to
+     * provide OnBreakpointChanged, which is called whenever a breakpoint is set or cleared.
+     */
+    template <typename Derived>
+    class CPUCore
+    {
+    public:
+        void Reset();
+
+        void ExecuteSingleInstruction(std::span<uint8_t> Bytes);
+
+        uint16_t GetIP() const;
+        void SetIP(uint16_t Address);
+        bool IsHalted() const;
+
+        // Number of cycles executed since the last reset
+        uint64_t GetCycleCount() const;
+
+        uint16_t GetRegister(Assembler::Register Register) const;
+
+        // NOTE: this should probably be only used in the testing environment
+        void SetRegister(Assembler::Register Register, uint16_t Value);
+
+        std::string SerializeState() const;
+
+        /*
+         * Makes the CPU stop with StopReason::Breakpoint right before the instruction at Address is executed.
+         * Instead of being looked up for every instruction, the breakpoint replaces the decoded form of the
+         * instruction, so breakpoints cost nothing while none are set and only the flagged addresses are ever
+         * checked. The next run starts by executing the instruction that the CPU stopped at.
+         */
+        void AddBreakpoint(uint16_t Address);
+        void RemoveBreakpoint(uint16_t Address);
+        bool HasBreakpoint(uint16_t Address) const;
+
+    protected:
+        using RegisterIndexUnderlyingType = std::underlying_type<Assembler::Register>::type;
+        constexpr static size_t RegisterCount = static_cast<RegisterIndexUnderlyingType>(Assembler::Register::Count_);
+        constexpr static auto RFLIndex = static_cast<RegisterIndexUnderlyingType>(Assembler::Register::RFL);
+
+        constexpr static size_t AddressSpaceSize = 65536;
+
+        bool m_IsHalted = false;
+        // Set together with m_IsHalted when the CPU stops because of an invalid instruction
+        bool m_HasFaulted = false;
+        // Set when the CPU stopped at a breakpoint, which the next run has to step over
+        bool m_IsAtBreakpoint = false;
+
+        uint16_t m_IP = 0;
+        // NOTE: the flag bits of RFL are stale while m_FlagOperation is not None, see ReadFlags
+        uint16_t m_Registers[RegisterCount] = {};
+
+        /*
+         * Instructions that set flags only record what they did, and the flags are computed from that once they are
+         * actually looked at, which most of the time they are not. None means that RFL is up to date.
+         */
+        enum class FlagOperation : uint8_t
+        {
+            None,
+            Add,
+            Sub,
+            // Any operation that clears carry and overflow: and, or, xor and not
+            Logic,
+            Shl,
+            Shr
+        };
+
+        FlagOperation m_FlagOperation = FlagOperation::None;
+        uint16_t m_FlagLeft = 0;
+        uint16_t m_FlagRight = 0;
+        uint16_t m_FlagResult = 0;
+
+        uint64_t m_CycleCount = 0;
+        // NOTE: engines check the limit only between blocks, so they may run a few cycles past it
+        uint64_t m_CycleLimit = UINT64_MAX;
+
+        // NOTE: only looked at when an instruction is decoded, see AddBreakpoint
+        std::bitset<AddressSpaceSize> m_Breakpoints;
+
+        Derived& Self() { return static_cast<Derived&>(*this); }
+
+        // Decodes an instruction for Derived, which can hide this to fill in more of DecodedInstruction
+        static DecodedInstruction DecodeInstruction(const uint8_t* Bytes) { return Emulator::DecodeInstruction(Bytes); }
+
+        uint16_t ReadRegister(Assembler::Register Register) const;
+        void WriteRegister(Assembler::Register Register, uint16_t Value);
+
+        // Like ReadRegister and WriteRegister, but take the register index as it is stored in decoded instructions
+        uint16_t ReadRegister(uint8_t RegisterIndex) const;
+        void WriteRegister(uint8_t RegisterIndex, uint16_t Value);
+
+        void SetFlags(FlagOperation Operation, uint16_t Left, uint16_t Right, uint16_t Result);
+        bool IsFlagSet(Flag Flag) const;
+
+        // Returns the value of RFL including flags that have not been computed yet
+        uint16_t ReadFlags() const;
+
+        // Stores the pending flags in RFL, so that m_Registers can be accessed directly
+        void MaterializeFlags();
+
+        template <HandlerID ID>
+        void ExecuteHandler(const DecodedInstruction& Instruction);
+
+        template <bool HasImmediate>
+        uint16_t ReadSourceOperand(const DecodedInstruction& Instruction, uint8_t Register) const;
+
+        template <bool HasImmediate>
+        void ExecuteMov(const DecodedInstruction& Instruction);
+        template <bool HasImmediate>
+        void ExecuteLda(const DecodedInstruction& Instruction);
+        template <bool HasImmediate>
+        void ExecuteSta(const DecodedInstruction& Instruction);
+        template <Assembler::Opcode Opcode, bool HasImmediate>
+        void ExecuteArithmetic(const DecodedInstruction& Instruction);
+        void ExecuteNot(const DecodedInstruction& Instruction);
+        template <bool HasImmediate>
+        void ExecutePush(const DecodedInstruction& Instruction);
+        void ExecutePop(const DecodedInstruction& Instruction);
+        template <Assembler::Opcode Opcode, bool HasImmediate>
+        void ExecuteJump(const DecodedInstruction& Instruction);
+        template <bool HasImmediate>
+        void ExecuteCall(const DecodedInstruction& Instruction);
+        void ExecuteRet(const DecodedInstruction& Instruction);
+        void ExecuteNop(const DecodedInstruction& Instruction);
+        void ExecuteHlt(const DecodedInstruction& Instruction);
+        void ExecuteInvalid(const DecodedInstruction& Instruction);
+        void ExecuteBreakpoint(const DecodedInstruction& Instruction);
+    };
+
+    template <typename Derived>
+    void CPUCore<Derived>::Reset()
+    {
+        for (auto& Register : m_Registers)
+            Register = 0;
+        m_FlagOperation = FlagOperation::None;
+
+        m_IP = 0;
+        m_IsHalted = false;
+        m_HasFaulted = false;
+        m_IsAtBreakpoint = false;
+        m_CycleCount = 0;
+    }
+
+    template <typename Derived>
+    void CPUCore<Derived>::ExecuteSingleInstruction(std::span<uint8_t> Bytes)
+    {
+        assert(Bytes.size() > 0);
+
+        // NOTE: the decoder always looks at 4 bytes, so pad shorter instructions with NOPs
+        uint8_t PaddedBytes[4] = { EncodedNOP, EncodedNOP, EncodedNOP, EncodedNOP };
+        std::copy_n(Bytes.begin(), std::min<size_t>(Bytes.size(), std::size(PaddedBytes)), PaddedBytes);
+
+        Self().ExecuteDecodedInstruction(Derived::DecodeInstruction(PaddedBytes));
+    }
+
+    template <typename Derived>
+    uint16_t CPUCore<Derived>::GetIP() const
+    {
+        return m_IP;
+    }
+
+    template <typename Derived>
+    void CPUCore<Derived>::SetIP(uint16_t Address)
+    {
+        m_IP = Address;
+    }
+
+    template <typename Derived>
+    bool CPUCore<Derived>::IsHalted() const
+    {
+        return m_IsHalted;
+    }
+
+    template <typename Derived>
+    uint64_t CPUCore<Derived>::GetCycleCount() const
+    {
+        return m_CycleCount;
+    }
+
+    template <typename Derived>
+    uint16_t CPUCore<Derived>::GetRegister(Assembler::Register Register) const
+    {
+        return ReadRegister(Register);
+    }
+
+    template <typename Derived>
+    void CPUCore<Derived>::SetRegister(Assembler::Register Register, uint16_t Value)
+    {
+        WriteRegister(Register, Value);
+    }
+
+    template <typename Derived>
+    std::string CPUCore<Derived>::SerializeState() const
+    {
+        return fmt::format("ip: {:#06x}; r0: {:#06x}; r1: {:#06x}; r2: {:#06x}; r3: {:#06x}; rsp: {:#06x}; rfl: {:#06x}; halted: {}",
+                           m_IP, ReadRegister(Assembler::Register::R0), ReadRegister(Assembler::Register::R1),
+                           ReadRegister(Assembler::Register::R2), ReadRegister(Assembler::Register::R3),
+                           ReadRegister(Assembler::Register::RSP), ReadRegister(Assembler::Register::RFL),
+                           m_IsHalted ? "true" : "false");
+    }
+
+    template <typename Derived>
+    void CPUCore<Derived>::AddBreakpoint(uint16_t Address)
+    {
+        m_Breakpoints[Address] = true;
+        Self().OnBreakpointChanged(Address);
+    }
+
+    template <typename Derived>
+    void CPUCore<Derived>::RemoveBreakpoint(uint16_t Address)
+    {
+        if (!m_Breakpoints[Address])
+            return;
+
+        m_Breakpoints[Address] = false;
+        Self().OnBreakpointChanged(Address);
+    }
+
+    template <typename Derived>
+    bool CPUCore<Derived>::HasBreakpoint(uint16_t Address) const
+    {
+        return m_Breakpoints[Address];
+    }
+
+    template <typename Derived>
+    uint16_t CPUCore<Derived>::ReadRegister(Assembler::Register Register) const
+    {
+        auto RegisterIndex = static_cast<RegisterIndexUnderlyingType>(Register);
+        assert(RegisterIndex >= 0 && RegisterIndex < std::size(m_Registers));
+        return ReadRegister(RegisterIndex);
+    }
+
+    template <typename Derived>
+    void CPUCore<Derived>::WriteRegister(Assembler::Register Register, uint16_t Value)
+    {
+        auto RegisterIndex = static_cast<RegisterIndexUnderlyingType>(Register);
+        assert(RegisterIndex >= 0 && RegisterIndex < std::size(m_Registers));
+        WriteRegister(RegisterIndex, Value);
+    }
+
+    template <typename Derived>
+    uint16_t CPUCore<Derived>::ReadRegister(uint8_t RegisterIndex) const
+    {
+        if (RegisterIndex == RFLIndex)
+            return ReadFlags();
+        return m_Registers[RegisterIndex];
+    }
+
+    template <typename Derived>
+    void CPUCore<Derived>::WriteRegister(uint8_t RegisterIndex, uint16_t Value)
+    {
+        // NOTE: a write replaces the flags as well, so the ones that are still pending must not be computed anymore
+        if (RegisterIndex == RFLIndex)
+            m_FlagOperation = FlagOperation::None;
+        m_Registers[RegisterIndex] = Value;
+    }
+
+    template <typename Derived>
+    void CPUCore<Derived>::SetFlags(FlagOperation Operation, uint16_t Left, uint16_t Right, uint16_t Result)
+    {
+        m_FlagOperation = Operation;
+        m_FlagLeft = Left;
+        m_FlagRight = Right;
+        m_FlagResult = Result;
+    }
+
+    template <typename Derived>
+    bool CPUCore<Derived>::IsFlagSet(Flag Flag) const
+    {
+        if (m_FlagOperation == FlagOperation::None)
+            return m_Registers[RFLIndex] & static_cast<uint16_t>(Flag);
+
+        auto Left = m_FlagLeft;
+        auto Right = m_FlagRight;
+        auto Result = m_FlagResult;
+        switch (Flag)
+        {
+        case Flag::Zero:
+            return Result == 0;
+        case Flag::Negative:
+            return (Result & 0x8000) != 0;
+        case Flag::Carry:
+            if (m_FlagOperation == FlagOperation::Add)
+                return Left + Right > 0xFFFF;
+            if (m_FlagOperation == FlagOperation::Sub)
+                return Left < Right;
+            // NOTE: carry holds the last bit that was shifted out
+            if (m_FlagOperation == FlagOperation::Shl)
+                return Right > 0 && Right <= 16 && ((Left >> (16 - Right)) & 1);
+            if (m_FlagOperation == FlagOperation::Shr)
+                return Right > 0 && Right <= 16 && ((Left >> (Right - 1)) & 1);
+            return false;
+        case Flag::Overflow:
+            if (m_FlagOperation == FlagOperation::Add)
+                return ((Left ^ Result) & (Right ^ Result) & 0x8000) != 0;
+            if (m_FlagOperation == FlagOperation::Sub)
+                return ((Left ^ Right) & (Left ^ Result) & 0x8000) != 0;
+            return false;
+        }
+        return false;
+    }
+
+    template <typename Derived>
+    uint16_t CPUCore<Derived>::ReadFlags() const
+    {
+        if (m_FlagOperation == FlagOperation::None)
+            return m_Registers[RFLIndex];
+
+        uint16_t Flags = 0;
+        for (auto Bit : { Flag::Zero, Flag::Negative, Flag::Carry, Flag::Overflow })
+        {
+            if (IsFlagSet(Bit))
+                Flags |= static_cast<uint16_t>(Bit);
+        }
+
+        // NOTE: the rest of the bits are reserved, so we leave them untouched
+        constexpr uint16_t FlagMask = 0x000F;
+        return (m_Registers[RFLIndex] & ~FlagMask) | Flags;
+    }
+
+    template <typename Derived>
+    void CPUCore<Derived>::MaterializeFlags()
+    {
+        m_Registers[RFLIndex] = ReadFlags();
+        m_FlagOperation = FlagOperation::None;
+    }
+
+    template <typename Derived>
+    template <HandlerID ID>
+    void CPUCore<Derived>::ExecuteHandler(const DecodedInstruction& Instruction)
+    {
+        // NOTE: selects the handler at compile time so that it can be inlined into the caller
+#define INVOKE_HANDLER(Name, ...)           \
+    if constexpr (ID == HandlerID::Name)    \
+        __VA_ARGS__(Instruction);
+        ENUMERATE_INSTRUCTION_HANDLERS(INVOKE_HANDLER)
+#undef INVOKE_HANDLER
+    }
+
+    template <typename Derived>
+    template <bool HasImmediate>
+    uint16_t CPUCore<Derived>::ReadSourceOperand(const DecodedInstruction& Instruction, uint8_t Register) const
+    {
+        if constexpr (HasImmediate)
+            return Instruction.Immediate;
+        else
+            return ReadRegister(Register);
+    }
+
+    template <typename Derived>
+    template <bool HasImmediate>
+    void CPUCore<Derived>::ExecuteMov(const DecodedInstruction& Instruction)
+    {
+        WriteRegister(Instruction.FirstRegister, ReadSourceOperand<HasImmediate>(Instruction, Instruction.SecondRegister));
+    }
+
+    template <typename Derived>
+    template <bool HasImmediate>
+    void CPUCore<Derived>::ExecuteLda(const DecodedInstruction& Instruction)
+    {
+        auto Address = ReadSourceOperand<HasImmediate>(Instruction, Instruction.SecondRegister);
+        WriteRegister(Instruction.FirstRegister, Self().ReadWord(Address));
+    }
+
+    template <typename Derived>
+    template <bool HasImmediate>
+    void CPUCore<Derived>::ExecuteSta(const DecodedInstruction& Instruction)
+    {
+        auto Address = ReadSourceOperand<HasImmediate>(Instruction, Instruction.FirstRegister);
+        Self().WriteWord(Address, ReadRegister(Instruction.SecondRegister));
+    }
+
+    template <typename Derived>
+    template <Assembler::Opcode Opcode, bool HasImmediate>
+    void CPUCore<Derived>::ExecuteArithmetic(const DecodedInstruction& Instruction)
+    {
+        uint16_t Left = ReadRegister(Instruction.FirstRegister);
+        uint16_t Right = ReadSourceOperand<HasImmediate>(Instruction, Instruction.SecondRegister);
+
+        uint16_t Result = 0;
+        auto Operation = FlagOperation::Logic;
+        if constexpr (Opcode == Assembler::Opcode::Add)
+        {
+            Result = static_cast<uint16_t>(Left + Right);
+            Operation = FlagOperation::Add;
+        }
+        else if constexpr (Opcode == Assembler::Opcode::Sub)
+        {
+            Result = static_cast<uint16_t>(Left - Right);
+            Operation = FlagOperation::Sub;
+        }
+        else if constexpr (Opcode == Assembler::Opcode::And)
+        {
+            Result = Left & Right;
+        }
+        else if constexpr (Opcode == Assembler::Opcode::Or)
+        {
+            Result = Left | Right;
+        }
+        else if constexpr (Opcode == Assembler::Opcode::Xor)
+        {
+            Result = Left ^ Right;
+        }
+        else if constexpr (Opcode == Assembler::Opcode::Shl)
+        {
+            Result = Right < 16 ? static_cast<uint16_t>(Left << Right) : 0;
+            Operation = FlagOperation::Shl;
+        }
+        else if constexpr (Opcode == Assembler::Opcode::Shr)
+        {
+            Result = Right < 16 ? static_cast<uint16_t>(Left >> Right) : 0;
+            Operation = FlagOperation::Shr;
+        }
+
+        // NOTE: if the destination is RFL itself, the flags are applied on top of the result once they are computed
+        m_Registers[Instruction.FirstRegister] = Result;
+        SetFlags(Operation, Left, Right, Result);
+    }
+
+    template <typename Derived>
+    void CPUCore<Derived>::ExecuteNot(const DecodedInstruction& Instruction)
+    {
+        uint16_t Result = ~ReadRegister(Instruction.FirstRegister);
+        m_Registers[Instruction.FirstRegister] = Result;
+        SetFlags(FlagOperation::Logic, 0, 0, Result);
+    }
+
+    template <typename Derived>
+    template <bool HasImmediate>
+    void CPUCore<Derived>::ExecutePush(const DecodedInstruction& Instruction)
+    {
+        auto Value = ReadSourceOperand<HasImmediate>(Instruction, Instruction.FirstRegister);
+        auto StackPointer = ReadRegister(Assembler::Register::RSP);
+
+        Self().WriteWord(StackPointer, Value);
+        WriteRegister(Assembler::Register::RSP, StackPointer + 2);
+    }
+
+    template <typename Derived>
+    void CPUCore<Derived>::ExecutePop(const DecodedInstruction& Instruction)
+    {
+        uint16_t StackPointer = ReadRegister(Assembler::Register::RSP) - 2;
+        auto Value = Self().ReadWord(StackPointer);
+
+        WriteRegister(Assembler::Register::RSP, StackPointer);
+        WriteRegister(Instruction.FirstRegister, Value);
+    }
+
+    template <typename Derived>
+    template <Assembler::Opcode Opcode, bool HasImmediate>
+    void CPUCore<Derived>::ExecuteJump(const DecodedInstruction& Instruction)
+    {
+        bool ShouldJump = true;
+        if constexpr (Opcode == Assembler::Opcode::Jz)
+            ShouldJump = IsFlagSet(Flag::Zero);
+        else if constexpr (Opcode == Assembler::Opcode::Jv)
+            ShouldJump = IsFlagSet(Flag::Overflow);
+        else if constexpr (Opcode == Assembler::Opcode::Jc)
+            ShouldJump = IsFlagSet(Flag::Carry);
+        else if constexpr (Opcode == Assembler::Opcode::Jn)
+            ShouldJump = IsFlagSet(Flag::Negative);
+
+        if (ShouldJump)
+            m_IP = ReadSourceOperand<HasImmediate>(Instruction, Instruction.FirstRegister);
+    }
+
+    template <typename Derived>
+    template <bool HasImmediate>
+    void CPUCore<Derived>::ExecuteCall(const DecodedInstruction& Instruction)
+    {
+        auto Target = ReadSourceOperand<HasImmediate>(Instruction, Instruction.FirstRegister);
+        auto StackPointer = ReadRegister(Assembler::Register::RSP);
+
+        Self().WriteWord(StackPointer, m_IP);
+        WriteRegister(Assembler::Register::RSP, StackPointer + 2);
+        m_IP = Target;
+    }
+
+    template <typename Derived>
+    void CPUCore<Derived>::ExecuteRet(const DecodedInstruction& /*Instruction*/)
+    {
+        uint16_t StackPointer = ReadRegister(Assembler::Register::RSP) - 2;
+
+        WriteRegister(Assembler::Register::RSP, StackPointer);
+        m_IP = Self().ReadWord(StackPointer);
+    }
+
+    template <typename Derived>
+    void CPUCore<Derived>::ExecuteNop(const DecodedInstruction& /*Instruction*/)
+    {
+    }
+
+    template <typename Derived>
+    void CPUCore<Derived>::ExecuteHlt(const DecodedInstruction& /*Instruction*/)
+    {
+        m_IsHalted = true;
+    }
+
+    template <typename Derived>
+    void CPUCore<Derived>::ExecuteInvalid(const DecodedInstruction& Instruction)
+    {
+        uint16_t Address = m_IP - Instruction.Length;
+        Common::ReportError(Common::ErrorSeverity::Error, { __FILE__, 0, __LINE__, 0 }, "Invalid instruction at 0x{0:X}, halting", Address);
+        m_IP = Address;
+        m_IsHalted = true;
+        m_HasFaulted = true;
+    }
+
+    template <typename Derived>
+    void CPUCore<Derived>::ExecuteBreakpoint(const DecodedInstruction& Instruction)
+    {
+        // NOTE: every engine counts the instruction and moves IP past it before the handler runs, which is undone here
+        m_IP -= Instruction.Length;
+        m_CycleCount--;
+        m_IsAtBreakpoint = true;
+        m_CycleLimit = m_CycleCount;
+    }
+} // namespace lce::Emulator
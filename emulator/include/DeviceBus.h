@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "MemoryBlock.h"
+
+namespace lce::Emulator
+{
+    class CPU;
+    class DeviceBus;
+
+    /*
+     * Memory mapped peripheral. Devices are not polled while the CPU runs; instead they are advanced lazily right
+     * before the guest accesses one of their registers, and whenever the event that they asked for is due.
+     */
+    class Device
+    {
+    public:
+        virtual ~Device() = default;
+
+        // Number of registers (bytes) that the device occupies on the bus
+        virtual uint16_t Size() const = 0;
+
+        // NOTE: the device has already been advanced to the current cycle when these are called
+        virtual uint8_t Read(uint16_t Register) = 0;
+        virtual void Write(uint16_t Register, uint8_t Value) = 0;
+
+        // Moves the state of the device forward by the given number of cycles
+        virtual void Advance(uint64_t Cycles) = 0;
+
+        /*
+         * Number of cycles after which the device has to be advanced even if the guest does not touch it (e.g. to
+         * deliver output to the host on time), or UINT64_MAX if it only needs to be up to date when it is accessed.
+         * This is asked again after every access and every event.
+         */
+        virtual uint64_t GetCyclesUntilNextEvent() const { return UINT64_MAX; }
+    };
+
+    /*
+     * Min-heap of the cycles at which devices need to be advanced. The CPU runs its engines up to the earliest event
+     * and dispatches it before continuing, so devices without pending events cost nothing while the CPU runs.
+     */
+    class DeviceEventQueue
+    {
+    public:
+        uint64_t GetNextEventCycle() const
+        {
+            return m_Events.empty() ? UINT64_MAX : m_Events.front().Cycle;
+        }
+
+        void Schedule(DeviceBus& Bus, size_t DeviceIndex, uint64_t Cycle);
+
+        // Dispatches every event that is due at or before Cycle
+        void DispatchEvents(uint64_t Cycle);
+
+        void Clear();
+
+    private:
+        struct Event
+        {
+            uint64_t Cycle;
+            DeviceBus* Bus;
+            size_t DeviceIndex;
+        };
+
+        std::vector<Event> m_Events;
+
+        // Orders the heap so that the earliest event is at the front
+        static bool IsLater(const Event& Left, const Event& Right);
+    };
+
+    /*
+     * Memory block that maps the registers of several devices into one window of the address space (usually the I/O
+     * window at 0xC000) and keeps them in step with the CPU that it is attached to with CPU::AddDeviceBus.
+     */
+    class DeviceBus : public MemoryBlock
+    {
+    public:
+        explicit DeviceBus(uint16_t Size);
+
+        // Maps the registers of the device at RelativeAddress, which is relative to the start of the bus
+        bool AddDevice(std::unique_ptr<Device> NewDevice, uint16_t RelativeAddress);
+
+        virtual uint8_t Read(uint16_t RelativeAddress) const override;
+
+        virtual void Write(uint16_t RelativeAddress, uint8_t Value) override;
+
+        virtual uint16_t Size() const override;
+
+        // Advances every device to the current cycle of the CPU, e.g. before the host inspects them
+        void CatchUpAll();
+
+    private:
+        friend class CPU;
+        friend class DeviceEventQueue;
+
+        struct DeviceSlot
+        {
+            uint16_t StartAddress = 0;
+            std::unique_ptr<Device> Instance;
+
+            // Cycle that the device has been advanced to
+            uint64_t LastCycle = 0;
+
+            // Cycle of the next event of the device and of its earliest entry in the event queue
+            uint64_t ScheduledCycle = UINT64_MAX;
+            uint64_t QueuedCycle = UINT64_MAX;
+        };
+
+        uint16_t m_Size;
+        CPU* m_CPU = nullptr;
+        // Address of the bus in the address space of the CPU
+        uint16_t m_StartAddress = 0;
+
+        // NOTE: reads have to advance devices, so their bookkeeping can change even in const member functions
+        mutable std::vector<DeviceSlot> m_Devices;
+
+        // NOTE: indices are 1-based, 0 means that the byte is not mapped to any device
+        std::vector<uint8_t> m_DeviceIndices;
+
+        // Called when the bus is added to a CPU and whenever the cycle count of that CPU starts over
+        void Attach(CPU& Processor);
+
+        uint64_t GetCurrentCycle() const;
+        bool IsReplayingInputs() const;
+
+        void CatchUp(DeviceSlot& Slot) const;
+        void Reschedule(size_t DeviceIndex) const;
+        void OnEvent(size_t DeviceIndex, uint64_t Cycle);
+    };
+} // namespace lce::Emulator
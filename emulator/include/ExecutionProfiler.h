@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CodeGenerator.h"
+#include "InstructionCache.h"
+
+namespace lce::Emulator
+{
+    struct CallEdgeStatistics
+    {
+        uint16_t CallSite = 0;
+        uint16_t Target = 0;
+
+        uint64_t Calls = 0;
+
+        // Cycles from the call up to and including the matching ret, subroutines called from the target included
+        uint64_t Cycles = 0;
+    };
+
+    /*
+     * Counts how often every guest address and every handler is executed and how many cycles are spent behind every
+     * call edge, while keeping the call stack of the guest so that cycles can be attributed to whole stacks. Call
+     * stacks are followed through call and ret only, so code that adjusts RSP by hand to return confuses them (but
+     * not the per-address counts).
+     */
+    class ExecutionProfiler
+    {
+    public:
+        ExecutionProfiler();
+
+        // Called by the CPU after every instruction, with the IP that it started at and the IP that follows it
+        void Record(uint16_t IP, HandlerID ID, uint16_t NextIP, uint64_t Cycle);
+
+        /*
+         * Maps guest addresses back to the source lines they were assembled from, so that reports can show them.
+         * BaseAddress is the address that the generated code was loaded at.
+         */
+        void AddSourceMap(std::span<const Assembler::SourceMapEntry> SourceMap, uint16_t BaseAddress);
+
+        uint64_t GetInstructionCount() const;
+        uint64_t GetExecutionCount(uint16_t Address) const;
+        uint64_t GetExecutionCount(HandlerID ID) const;
+
+        // Sorted by the number of cycles, highest first
+        std::vector<CallEdgeStatistics> GetCallEdges() const;
+
+        /*
+         * Writes one line per distinct call stack with the number of instructions executed directly in its innermost
+         * subroutine, in the folded format that flame graph tools take as input
+         */
+        void WriteFoldedStacks(std::ostream& Output) const;
+
+        // Writes the hottest addresses, handlers and call edges, up to MaxEntries of each
+        void WriteReport(std::ostream& Output, size_t MaxEntries = 20) const;
+
+        void Reset();
+
+    private:
+        // NOTE: the guest stack wraps around long before this, so deeper stacks can only come from unmatched calls
+        constexpr static size_t MaxCallDepth = 32768;
+
+        // Node of the tree of every call stack seen so far, the root stands for the code that the profile started in
+        struct StackNode
+        {
+            uint16_t FunctionAddress = 0;
+            size_t Parent = 0;
+            uint64_t SelfInstructions = 0;
+        };
+
+        struct CallFrame
+        {
+            size_t Node;
+            uint32_t Edge;
+            uint64_t EntryCycle;
+        };
+
+        struct SourceLine
+        {
+            std::string FileName;
+            size_t Line;
+        };
+
+        std::vector<uint64_t> m_AddressCounts;
+        std::array<uint64_t, static_cast<size_t>(HandlerID::Count_)> m_HandlerCounts = {};
+        uint64_t m_InstructionCount = 0;
+
+        // NOTE: keyed by the call site in the upper and the target in the lower 16 bits
+        std::unordered_map<uint32_t, CallEdgeStatistics> m_CallEdges;
+
+        std::vector<StackNode> m_StackNodes;
+        // NOTE: keyed by the index of the parent node in the upper and the function address in the lower 16 bits
+        std::unordered_map<uint64_t, size_t> m_StackNodeChildren;
+        std::vector<CallFrame> m_CallStack;
+        size_t m_CurrentNode = 0;
+
+        std::unordered_map<uint16_t, SourceLine> m_SourceLines;
+
+        std::string DescribeAddress(uint16_t Address) const;
+    };
+} // namespace lce::Emulator
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "InstructionCache.h"
+
+namespace lce::Emulator
+{
+    // Registers that are recorded in a trace: R0 to R3, RSP and RFL
+    constexpr size_t TracedRegisterCount = 6;
+
+    /*
+     * A single executed instruction as it is read back from a trace
+     */
+    struct TraceRecord
+    {
+        uint16_t IP = 0;
+        HandlerID ID = HandlerID::Invalid;
+
+        // Values of the registers after the instruction
+        std::array<uint16_t, TracedRegisterCount> Registers = {};
+
+        // Word that the instruction loaded or stored, if any
+        bool HasMemoryAccess = false;
+        bool IsWrite = false;
+        uint16_t Address = 0;
+        uint16_t Value = 0;
+    };
+
+    struct TraceStatistics
+    {
+        uint64_t Records = 0;
+        uint64_t Bytes = 0;
+
+        // Number of times the CPU had to wait because the writer thread fell behind and the ring buffer was full
+        uint64_t Stalls = 0;
+    };
+
+    /*
+     * Records executed instructions into a compact binary file. Every record stores the handler ID, the registers
+     * that changed (XORed with their previous value) and the memory access of the instruction; the IP is only stored
+     * if it does not follow from the previous record, and the address of a memory access is stored relative to the
+     * previous one. The CPU encodes records into a small local buffer which is handed over through a lock-free
+     * single-producer ring buffer to a thread that writes it to the file, so the CPU never blocks on I/O unless the
+     * writer falls behind by a whole ring.
+     *
+     * File layout: the 8 byte magic "LCETRACE", a version byte and then records until the end of the file. A record
+     * starts with two bytes: the handler ID in the low 6 bits of the first one and bit 6 set if an IP follows; the
+     * second byte has one bit per changed register and the length of the instruction minus one in the top 2 bits.
+     * Then follow, in this order, the IP as a zigzag varint relative to the expected one, a varint for every changed
+     * register, and for handlers that access memory the address as a zigzag varint relative to the previous access
+     * followed by the value as two little-endian bytes (except for ret, which loads the IP of the next record).
+     */
+    class ExecutionTracer
+    {
+    public:
+        constexpr static size_t DefaultRingSize = 1 << 20;
+
+        // RingSize must be a power of two of at least 16 KiB, returns nullptr if the file can not be created
+        static std::unique_ptr<ExecutionTracer> Open(const std::filesystem::path& Path, size_t RingSize = DefaultRingSize);
+
+        ~ExecutionTracer();
+
+        ExecutionTracer(const ExecutionTracer&) = delete;
+        ExecutionTracer& operator=(const ExecutionTracer&) = delete;
+
+        /*
+         * Records an instruction that started at IP, given the registers before and after it. Must only be called
+         * from one thread at a time.
+         */
+        void Record(uint16_t IP, const DecodedInstruction& Instruction, const uint16_t* RegistersBefore, const uint16_t* RegistersAfter);
+
+        // Returns once every record so far has been written to the file
+        void Flush();
+
+        TraceStatistics GetStatistics() const;
+
+    private:
+        constexpr static size_t LocalBufferSize = 4096;
+        constexpr static size_t MaxRecordSize = 32;
+
+        std::ofstream m_Output;
+
+        // NOTE: the size is a power of two, positions only ever grow and are wrapped when the ring is accessed
+        std::unique_ptr<uint8_t[]> m_Ring;
+        size_t m_RingSize = 0;
+        alignas(64) std::atomic<size_t> m_WritePosition = 0;
+        alignas(64) std::atomic<size_t> m_ReadPosition = 0;
+        // Everything before this position has been flushed from m_Output to the file, see Flush
+        std::atomic<size_t> m_FlushedPosition = 0;
+        std::atomic<bool> m_IsStopping = false;
+        std::thread m_Writer;
+
+        // Records that have not been handed over to the ring yet
+        std::vector<uint8_t> m_LocalBuffer;
+
+        // State the next record is encoded relative to
+        uint16_t m_ExpectedIP = 0;
+        uint16_t m_LastAddress = 0;
+        std::array<uint16_t, TracedRegisterCount> m_Registers = {};
+
+        TraceStatistics m_Statistics;
+
+        ExecutionTracer() = default;
+
+        void PushToRing(std::span<const uint8_t> Bytes);
+        void WriterMain();
+    };
+
+    // Decodes a whole trace file, returns false if it is malformed
+    bool DecodeTrace(std::span<const uint8_t> Bytes, std::vector<TraceRecord>& Records);
+} // namespace lce::Emulator
@@ -0,0 +1,398 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CPU.h"
+#include "ErrorReporting.h"
+#include "Instruction.h"
+#include "InstructionCache.h"
+#include "InstructionDecoder.h"
+#include "MemoryBlock.h"
+
+namespace lce::Emulator
+{
+    /*
+     * Memory layout from doc/Architecture.md: ROM, RAM and mappable I/O follow each other in this order, so that
+     * everything below IOStart is plain memory.
+     */
+    struct StandardMemoryMap
+    {
+        constexpr static size_t ROMStart = 0x0000;
+        constexpr static size_t RAMStart = 0x8000;
+        constexpr static size_t IOStart = 0xC000;
+
+        constexpr static uint16_t EntryPoint = 0x7FF0;
+    };
+
+    /*
+     * Interpreter for a machine whose memory layout is known at compile time. ROM and RAM are stored in a single host
+     * array, so every access to them is a range check against a constant followed by an index into that array, and
+     * only the I/O window goes through the MemoryBlock interface. Everything else, from the registers and flags to
+     * the instruction handlers and breakpoints, is shared with CPU through CPUCore. Use CPU instead if the layout is
+     * only known at runtime or one of the other execution engines is needed.
+     */
+    template <typename MemoryMap = StandardMemoryMap>
+    class FixedMapCPU : public CPUCore<FixedMapCPU<MemoryMap>>
+    {
+    public:
+        static_assert(MemoryMap::ROMStart == 0, "ROM has to start at address 0");
+        static_assert(MemoryMap::ROMStart <= MemoryMap::RAMStart && MemoryMap::RAMStart <= MemoryMap::IOStart);
+        static_assert(MemoryMap::IOStart <= 65536);
+
+        FixedMapCPU();
+
+        void Run(uint16_t StartAddress);
+
+        // Continues from the current IP until the CPU halts, stops at a breakpoint or MaxCycles cycles have been executed
+        RunResult RunFor(uint64_t MaxCycles);
+
+        /*
+         * Copies Bytes into ROM or RAM. This is how programs get into ROM, since the CPU itself can not write to it.
+         * Returns false if the range does not lie entirely below the I/O window.
+         */
+        bool LoadMemory(uint16_t Address, std::span<const uint8_t> Bytes);
+
+        // Reads ROM and RAM directly, without the side effects that device reads can have
+        uint8_t PeekMemory(uint16_t Address) const;
+
+        // Maps a device into the I/O window, which is the only part of the address space that can be changed
+        bool AddDevice(std::unique_ptr<MemoryBlock> Device, uint16_t StartAddress);
+
+    private:
+        using Core = CPUCore<FixedMapCPU<MemoryMap>>;
+        friend Core;
+
+        using Core::AddressSpaceSize;
+        using Core::m_Breakpoints;
+        using Core::m_CycleCount;
+        using Core::m_CycleLimit;
+        using Core::m_HasFaulted;
+        using Core::m_IP;
+        using Core::m_IsAtBreakpoint;
+        using Core::m_IsHalted;
+
+        constexpr static size_t PlainMemorySize = MemoryMap::IOStart;
+        constexpr static size_t IOSize = AddressSpaceSize - MemoryMap::IOStart;
+
+        // ROM followed by RAM
+        std::unique_ptr<std::array<uint8_t, PlainMemorySize>> m_Memory;
+
+        std::vector<std::pair<uint16_t, std::unique_ptr<MemoryBlock>>> m_Devices;
+        // NOTE: indices are 1-based, 0 means that the byte is not mapped to any device
+        std::unique_ptr<std::array<uint16_t, IOSize>> m_DeviceIndices;
+
+        InstructionCache m_InstructionCache;
+        DecodedInstruction m_UncachedInstruction;
+
+        constexpr static bool IsPlainMemory(size_t Address) { return Address < MemoryMap::IOStart; }
+        constexpr static bool IsWritableMemory(size_t Address) { return Address >= MemoryMap::RAMStart && Address < MemoryMap::IOStart; }
+
+        MemoryBlock* FindDevice(uint16_t AbsoluteAddress, uint16_t& StartAddress) const;
+
+        uint8_t ReadByte(uint16_t AbsoluteAddress) const;
+        uint8_t ReadByteOr(uint16_t AbsoluteAddress, uint8_t Fallback) const;
+        uint16_t ReadWord(uint16_t AbsoluteAddress) const;
+
+        void WriteByte(uint16_t AbsoluteAddress, uint8_t Value);
+        void WriteWord(uint16_t AbsoluteAddress, uint16_t Value);
+
+        void OnBreakpointChanged(uint16_t Address);
+
+        const DecodedInstruction& FetchInstruction(uint16_t Address);
+        void ExecuteDecodedInstruction(const DecodedInstruction& Instruction);
+
+        void RunUntilCycle(uint64_t CycleLimit);
+
+        // Executes the instruction that the CPU stopped at if it stopped at a breakpoint, otherwise does nothing
+        void StepOverBreakpoint();
+    };
+
+    template <typename MemoryMap>
+    FixedMapCPU<MemoryMap>::FixedMapCPU()
+        : m_Memory(std::make_unique<std::array<uint8_t, PlainMemorySize>>())
+        , m_DeviceIndices(std::make_unique<std::array<uint16_t, IOSize>>())
+    {
+    }
+
+    template <typename MemoryMap>
+    void FixedMapCPU<MemoryMap>::Run(uint16_t StartAddress)
+    {
+        m_IP = StartAddress;
+        RunUntilCycle(UINT64_MAX);
+    }
+
+    template <typename MemoryMap>
+    RunResult FixedMapCPU<MemoryMap>::RunFor(uint64_t MaxCycles)
+    {
+        auto StartTime = std::chrono::steady_clock::now();
+        auto StartCycle = m_CycleCount;
+
+        RunUntilCycle(MaxCycles > UINT64_MAX - m_CycleCount ? UINT64_MAX : m_CycleCount + MaxCycles);
+
+        RunResult Result;
+        if (m_IsAtBreakpoint)
+            Result.Reason = StopReason::Breakpoint;
+        else if (m_IsHalted)
+            Result.Reason = m_HasFaulted ? StopReason::Fault : StopReason::Halted;
+        else
+            Result.Reason = StopReason::CycleLimit;
+        Result.Instructions = m_CycleCount - StartCycle;
+        Result.WallTime = std::chrono::steady_clock::now() - StartTime;
+        return Result;
+    }
+
+    template <typename MemoryMap>
+    bool FixedMapCPU<MemoryMap>::LoadMemory(uint16_t Address, std::span<const uint8_t> Bytes)
+    {
+        if (Address + Bytes.size() > PlainMemorySize)
+        {
+            Common::ReportError(Common::ErrorSeverity::Error, { __FILE__, 0, __LINE__, 0 }, "Cannot load 0x{0:X} bytes at 0x{1:X} outside of ROM and RAM", Bytes.size(), Address);
+            return false;
+        }
+
+        std::memcpy(m_Memory->data() + Address, Bytes.data(), Bytes.size());
+        for (size_t Offset = 0; Offset < Bytes.size(); Offset++)
+            m_InstructionCache.OnMemoryWrite(static_cast<uint16_t>(Address + Offset));
+        return true;
+    }
+
+    template <typename MemoryMap>
+    uint8_t FixedMapCPU<MemoryMap>::PeekMemory(uint16_t Address) const
+    {
+        return IsPlainMemory(Address) ? (*m_Memory)[Address] : 0;
+    }
+
+    template <typename MemoryMap>
+    bool FixedMapCPU<MemoryMap>::AddDevice(std::unique_ptr<MemoryBlock> Device, uint16_t StartAddress)
+    {
+        size_t EndAddress = StartAddress + Device->Size(); // First byte past the device
+        if (StartAddress < MemoryMap::IOStart || EndAddress > AddressSpaceSize)
+        {
+            Common::ReportError(Common::ErrorSeverity::Fatal, { __FILE__, 0, __LINE__, 0 }, "Cannot add device at 0x{0:X} that does not fit into the I/O window", StartAddress);
+            return false;
+        }
+
+        for (size_t Address = StartAddress; Address < EndAddress; Address++)
+        {
+            if ((*m_DeviceIndices)[Address - MemoryMap::IOStart] != 0)
+            {
+                Common::ReportError(Common::ErrorSeverity::Fatal, { __FILE__, 0, __LINE__, 0 }, "Cannot add device that overlaps existing ones");
+                return false;
+            }
+        }
+
+        m_Devices.emplace_back(StartAddress, std::move(Device));
+        std::fill(m_DeviceIndices->begin() + (StartAddress - MemoryMap::IOStart), m_DeviceIndices->begin() + (EndAddress - MemoryMap::IOStart),
+                  static_cast<uint16_t>(m_Devices.size()));
+        return true;
+    }
+
+    template <typename MemoryMap>
+    MemoryBlock* FixedMapCPU<MemoryMap>::FindDevice(uint16_t AbsoluteAddress, uint16_t& StartAddress) const
+    {
+        assert(!IsPlainMemory(AbsoluteAddress));
+
+        auto DeviceIndex = (*m_DeviceIndices)[AbsoluteAddress - MemoryMap::IOStart];
+        if (DeviceIndex == 0)
+            return nullptr;
+
+        const auto& Device = m_Devices[DeviceIndex - 1];
+        StartAddress = Device.first;
+        return Device.second.get();
+    }
+
+    template <typename MemoryMap>
+    uint8_t FixedMapCPU<MemoryMap>::ReadByte(uint16_t AbsoluteAddress) const
+    {
+        if (IsPlainMemory(AbsoluteAddress))
+            return (*m_Memory)[AbsoluteAddress];
+
+        uint16_t StartAddress;
+        auto* Device = FindDevice(AbsoluteAddress, StartAddress);
+
+        if (!Device)
+        {
+            Common::ReportError(Common::ErrorSeverity::Warning, { __FILE__, 0, __LINE__, 0 }, "Reading from invalid memory location 0x{0:X}", AbsoluteAddress);
+            return 0;
+        }
+
+        return Device->Read(AbsoluteAddress - StartAddress);
+    }
+
+    template <typename MemoryMap>
+    uint8_t FixedMapCPU<MemoryMap>::ReadByteOr(uint16_t AbsoluteAddress, uint8_t Fallback) const
+    {
+        if (IsPlainMemory(AbsoluteAddress))
+            return (*m_Memory)[AbsoluteAddress];
+
+        uint16_t StartAddress;
+        auto* Device = FindDevice(AbsoluteAddress, StartAddress);
+
+        if (Device)
+            return Device->Read(AbsoluteAddress - StartAddress);
+        return Fallback;
+    }
+
+    template <typename MemoryMap>
+    uint16_t FixedMapCPU<MemoryMap>::ReadWord(uint16_t AbsoluteAddress) const
+    {
+        if (IsPlainMemory(AbsoluteAddress + 1))
+        {
+            const auto* Bytes = m_Memory->data() + AbsoluteAddress;
+            return Bytes[0] | (Bytes[1] << 8);
+        }
+
+        auto Low = ReadByte(AbsoluteAddress);
+        auto High = ReadByte(AbsoluteAddress + 1);
+
+        uint16_t Result = (High << 8) | Low;
+        return Result;
+    }
+
+    template <typename MemoryMap>
+    void FixedMapCPU<MemoryMap>::WriteByte(uint16_t AbsoluteAddress, uint8_t Value)
+    {
+        if (IsWritableMemory(AbsoluteAddress))
+        {
+            m_InstructionCache.OnMemoryWrite(AbsoluteAddress);
+            (*m_Memory)[AbsoluteAddress] = Value;
+            return;
+        }
+
+        if (IsPlainMemory(AbsoluteAddress))
+        {
+            Common::ReportError(Common::ErrorSeverity::Warning, { __FILE__, 0, __LINE__, 0 }, "Writing to read-only memory location 0x{0:X}", AbsoluteAddress);
+            return;
+        }
+
+        uint16_t StartAddress;
+        auto* Device = FindDevice(AbsoluteAddress, StartAddress);
+
+        if (!Device)
+        {
+            Common::ReportError(Common::ErrorSeverity::Warning, { __FILE__, 0, __LINE__, 0 }, "Writing to invalid memory location 0x{0:X}", AbsoluteAddress);
+            return;
+        }
+
+        Device->Write(AbsoluteAddress - StartAddress, Value);
+    }
+
+    template <typename MemoryMap>
+    void FixedMapCPU<MemoryMap>::WriteWord(uint16_t AbsoluteAddress, uint16_t Value)
+    {
+        // NOTE: a word at the end of a region is split up, so that each byte goes where its own address says
+        if (IsWritableMemory(AbsoluteAddress) && IsWritableMemory(AbsoluteAddress + 1))
+        {
+            m_InstructionCache.OnMemoryWrite(AbsoluteAddress);
+            m_InstructionCache.OnMemoryWrite(AbsoluteAddress + 1);
+
+            auto* Bytes = m_Memory->data() + AbsoluteAddress;
+            Bytes[0] = static_cast<uint8_t>(Value & 0xFF);
+            Bytes[1] = static_cast<uint8_t>(Value >> 8);
+            return;
+        }
+
+        WriteByte(AbsoluteAddress, static_cast<uint8_t>(Value & 0xFF));
+        WriteByte(AbsoluteAddress + 1, static_cast<uint8_t>(Value >> 8));
+    }
+
+    template <typename MemoryMap>
+    void FixedMapCPU<MemoryMap>::OnBreakpointChanged(uint16_t Address)
+    {
+        // NOTE: the breakpoint only takes effect once the instruction is decoded again, just like after a write to it
+        m_InstructionCache.OnMemoryWrite(Address);
+    }
+
+    template <typename MemoryMap>
+    const DecodedInstruction& FixedMapCPU<MemoryMap>::FetchInstruction(uint16_t Address)
+    {
+        if (const auto* CachedInstruction = m_InstructionCache.Find(Address))
+            return *CachedInstruction;
+
+        // NOTE: plain memory can be decoded in place, devices are only read as far as the instruction goes
+        if (IsPlainMemory(Address + MaxInstructionLength - 1))
+        {
+            m_UncachedInstruction = DecodeInstruction(m_Memory->data() + Address);
+        }
+        else
+        {
+            uint8_t Bytes[MaxInstructionLength];
+            FetchInstructionBytes(Address, Bytes, [this](uint16_t ByteAddress) { return ReadByteOr(ByteAddress, EncodedNOP); });
+            m_UncachedInstruction = DecodeInstruction(Bytes);
+        }
+
+        if (m_Breakpoints[Address])
+            m_UncachedInstruction.ID = HandlerID::Breakpoint;
+
+        // Only instructions that are stored in plain memory can be cached, since devices can return different values on every read
+        if (IsPlainMemory(Address + m_UncachedInstruction.Length - 1))
+            return m_InstructionCache.Insert(Address, m_UncachedInstruction);
+
+        return m_UncachedInstruction;
+    }
+
+    template <typename MemoryMap>
+    void FixedMapCPU<MemoryMap>::ExecuteDecodedInstruction(const DecodedInstruction& Instruction)
+    {
+        // NOTE: IP points to the next instruction while the current one is being executed, jumps simply overwrite it
+        m_IP += Instruction.Length;
+        m_CycleCount++;
+
+        // NOTE: the handler member of the instruction belongs to CPU, so we dispatch on the ID instead
+        switch (Instruction.ID)
+        {
+#define HANDLER_CASE(Name, ...)                                             \
+    case HandlerID::Name:                                                   \
+        this->template ExecuteHandler<HandlerID::Name>(Instruction);        \
+        break;
+            ENUMERATE_INSTRUCTION_HANDLERS(HANDLER_CASE)
+#undef HANDLER_CASE
+        default:
+            this->ExecuteInvalid(Instruction);
+            break;
+        }
+    }
+
+    template <typename MemoryMap>
+    void FixedMapCPU<MemoryMap>::RunUntilCycle(uint64_t CycleLimit)
+    {
+        // NOTE: a breakpoint stops the loop by lowering the limit to the current cycle
+        m_CycleLimit = CycleLimit;
+        if (m_CycleCount < m_CycleLimit)
+            StepOverBreakpoint();
+
+        while (!m_IsHalted && m_CycleCount < m_CycleLimit)
+        {
+            const auto& Instruction = FetchInstruction(m_IP);
+            ExecuteDecodedInstruction(Instruction);
+        }
+    }
+
+    template <typename MemoryMap>
+    void FixedMapCPU<MemoryMap>::StepOverBreakpoint()
+    {
+        if (!m_IsAtBreakpoint)
+            return;
+        m_IsAtBreakpoint = false;
+
+        // NOTE: the decoded instruction at IP is the breakpoint itself, so the real one is decoded again and executed on its own
+        uint8_t Bytes[MaxInstructionLength];
+        FetchInstructionBytes(m_IP, Bytes, [this](uint16_t Address) { return ReadByteOr(Address, EncodedNOP); });
+        ExecuteDecodedInstruction(DecodeInstruction(Bytes));
+    }
+
+    // The machine described in doc/Architecture.md
+    using StandardCPU = FixedMapCPU<StandardMemoryMap>;
+} // namespace lce::Emulator
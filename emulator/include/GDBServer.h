@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "CPU.h"
+
+namespace lce::Emulator
+{
+    /*
+     * Lets a debugger that speaks the GDB Remote Serial Protocol control a CPU: read and write registers and memory,
+     * single-step, continue, interrupt a running program, set breakpoints (see CPU::AddBreakpoint, so they cost
+     * nothing while none are set) and watch memory (see CPU::AddWatchpoint). The registers are r0-r3, rsp, rfl and
+     * ip, 16 bits each, in that order; the debugger gets them from the target description.
+     *
+     * Program states are reported like this: hlt as an exit with status 0, an invalid instruction as SIGILL, a
+     * breakpoint, watchpoint or finished step as SIGTRAP and an interrupt from the debugger as SIGINT.
+     */
+    class GDBServer
+    {
+    public:
+        // Cycles that the CPU runs for between two checks for an interrupt from the debugger while it is continuing
+        constexpr static uint64_t DefaultSliceCycles = 1 << 20;
+
+        explicit GDBServer(CPU& Processor, uint64_t SliceCycles = DefaultSliceCycles);
+        ~GDBServer();
+
+        GDBServer(const GDBServer&) = delete;
+        GDBServer& operator=(const GDBServer&) = delete;
+
+        /*
+         * Start listening for a debugger on a TCP port of the loopback interface (port 0 picks a free one) or on a Unix
+         * domain socket. Return false if the socket can not be created or the host has no sockets.
+         */
+        bool ListenTCP(uint16_t Port);
+        bool ListenUnix(const std::filesystem::path& Path);
+
+        // Port that ListenTCP is listening on
+        uint16_t GetPort() const;
+
+        /*
+         * Waits for a debugger to connect and serves it until it detaches, kills the program or disconnects. Returns
+         * false if no connection could be accepted.
+         */
+        bool Serve();
+
+        /*
+         * Handles a single packet, without the framing and checksum, and returns the reply. Packets that are not
+         * supported get an empty reply, as the protocol requires. While the CPU runs because of a continue packet,
+         * InterruptCheck is called between slices and stops it once it returns true.
+         */
+        std::string HandlePacket(std::string_view Packet);
+
+        void SetInterruptCheck(std::function<bool()> InterruptCheck);
+
+        // Set once the debugger has detached or killed the program, the CPU is left as it is either way
+        bool HasDetached() const;
+        bool HasKilled() const;
+
+    private:
+        CPU& m_CPU;
+        uint64_t m_SliceCycles;
+
+        std::function<bool()> m_InterruptCheck;
+        std::string m_LastStopReply = "S05";
+
+        bool m_HasDetached = false;
+        bool m_HasKilled = false;
+        bool m_IsAckModeEnabled = true;
+
+        // NOTE: -1 while there is no socket
+        int m_ListenSocket = -1;
+        int m_Connection = -1;
+        uint16_t m_Port = 0;
+        std::filesystem::path m_UnixSocketPath;
+
+        // Bytes received from the debugger that have not been handled yet
+        std::string m_ReceiveBuffer;
+        // Packet that was sent last, it is sent again if the debugger did not receive it correctly
+        std::string m_LastSentPacket;
+
+        std::string HandleQuery(std::string_view Packet);
+        std::string ReadRegisters() const;
+        bool WriteRegister(size_t Index, uint16_t Value);
+        std::string Resume(std::string_view Arguments, bool IsStep);
+        std::string SetBreakpoint(std::string_view Arguments, bool IsInsert);
+        std::string GetStopReply(StopReason Reason) const;
+
+        bool ReceiveByte(char& Byte);
+        bool ReceivePacket(std::string& Packet);
+        bool Send(std::string_view Bytes);
+        bool SendPacket(std::string_view Packet);
+
+        // Reads whatever the debugger has sent without waiting, returns true if it asked to interrupt the program
+        bool PollInterrupt();
+
+        void CloseSockets();
+    };
+} // namespace lce::Emulator
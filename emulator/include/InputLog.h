@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+namespace lce::Emulator
+{
+    // A byte that the guest read from a device, and the cycle count when it did so
+    struct InputEvent
+    {
+        uint64_t Cycle = 0;
+        uint16_t Address = 0;
+        uint8_t Value = 0;
+    };
+
+    /*
+     * Every input that the guest received from the outside world during a run, in the order it was read. Devices are
+     * the only source of nondeterminism the guest can observe (including any host time that a device exposes), so
+     * replaying the log into a CPU that starts from the same state reproduces the run exactly.
+     */
+    class InputLog
+    {
+    public:
+        void Record(uint64_t Cycle, uint16_t Address, uint8_t Value);
+
+        /*
+         * Returns the value of the next logged read, or false if the log is exhausted or the next read was from a
+         * different address, which means that the replayed run has diverged from the recorded one
+         */
+        bool Replay(uint16_t Address, uint8_t& Value);
+
+        // Starts replaying from the first event again
+        void Rewind();
+
+        bool IsExhausted() const;
+
+        const std::vector<InputEvent>& GetEvents() const;
+
+        bool Save(const std::filesystem::path& Path) const;
+
+        // Returns nullptr if the file can not be read or is not an input log
+        static std::unique_ptr<InputLog> Load(const std::filesystem::path& Path);
+
+    private:
+        std::vector<InputEvent> m_Events;
+        size_t m_ReplayPosition = 0;
+    };
+} // namespace lce::Emulator
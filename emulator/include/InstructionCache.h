@@ -0,0 +1,145 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "Instruction.h"
+
+namespace lce::Emulator
+{
+    class CPU;
+    struct DecodedInstruction;
+
+    using InstructionHandler = void (CPU::*)(const DecodedInstruction& Instruction);
+
+    /*
+     * Every distinct instruction handler together with the CPU member function that implements it. Instructions that
+     * can take either a register or an immediate value get a separate handler for each form. Breakpoint is never
+     * decoded from memory, it replaces the decoded form of instructions at addresses that have a breakpoint.
+     */
+#define ENUMERATE_INSTRUCTION_HANDLERS(Func)                                         \
+    Func(Invalid, ExecuteInvalid)                                                    \
+    Func(MovRegister, ExecuteMov<false>)                                             \
+    Func(MovImmediate, ExecuteMov<true>)                                             \
+    Func(LdaRegister, ExecuteLda<false>)                                             \
+    Func(LdaImmediate, ExecuteLda<true>)                                             \
+    Func(StaRegister, ExecuteSta<false>)                                             \
+    Func(StaImmediate, ExecuteSta<true>)                                             \
+    Func(AddRegister, ExecuteArithmetic<Assembler::Opcode::Add, false>)              \
+    Func(AddImmediate, ExecuteArithmetic<Assembler::Opcode::Add, true>)              \
+    Func(SubRegister, ExecuteArithmetic<Assembler::Opcode::Sub, false>)              \
+    Func(SubImmediate, ExecuteArithmetic<Assembler::Opcode::Sub, true>)              \
+    Func(AndRegister, ExecuteArithmetic<Assembler::Opcode::And, false>)              \
+    Func(AndImmediate, ExecuteArithmetic<Assembler::Opcode::And, true>)              \
+    Func(OrRegister, ExecuteArithmetic<Assembler::Opcode::Or, false>)                \
+    Func(OrImmediate, ExecuteArithmetic<Assembler::Opcode::Or, true>)                \
+    Func(XorRegister, ExecuteArithmetic<Assembler::Opcode::Xor, false>)              \
+    Func(XorImmediate, ExecuteArithmetic<Assembler::Opcode::Xor, true>)              \
+    Func(Not, ExecuteNot)                                                            \
+    Func(ShlRegister, ExecuteArithmetic<Assembler::Opcode::Shl, false>)              \
+    Func(ShlImmediate, ExecuteArithmetic<Assembler::Opcode::Shl, true>)              \
+    Func(ShrRegister, ExecuteArithmetic<Assembler::Opcode::Shr, false>)              \
+    Func(ShrImmediate, ExecuteArithmetic<Assembler::Opcode::Shr, true>)              \
+    Func(PushRegister, ExecutePush<false>)                                           \
+    Func(PushImmediate, ExecutePush<true>)                                           \
+    Func(Pop, ExecutePop)                                                            \
+    Func(JmpRegister, ExecuteJump<Assembler::Opcode::Jmp, false>)                    \
+    Func(JmpImmediate, ExecuteJump<Assembler::Opcode::Jmp, true>)                    \
+    Func(JzRegister, ExecuteJump<Assembler::Opcode::Jz, false>)                      \
+    Func(JzImmediate, ExecuteJump<Assembler::Opcode::Jz, true>)                      \
+    Func(JvRegister, ExecuteJump<Assembler::Opcode::Jv, false>)                      \
+    Func(JvImmediate, ExecuteJump<Assembler::Opcode::Jv, true>)                      \
+    Func(JcRegister, ExecuteJump<Assembler::Opcode::Jc, false>)                      \
+    Func(JcImmediate, ExecuteJump<Assembler::Opcode::Jc, true>)                      \
+    Func(JnRegister, ExecuteJump<Assembler::Opcode::Jn, false>)                      \
+    Func(JnImmediate, ExecuteJump<Assembler::Opcode::Jn, true>)                      \
+    Func(CallRegister, ExecuteCall<false>)                                           \
+    Func(CallImmediate, ExecuteCall<true>)                                           \
+    Func(Ret, ExecuteRet)                                                            \
+    Func(Nop, ExecuteNop)                                                            \
+    Func(Hlt, ExecuteHlt)                                                            \
+    Func(Breakpoint, ExecuteBreakpoint)
+
+    enum class HandlerID : uint8_t
+    {
+#define ENUMERATION_FUNC(Name, ...) Name,
+        ENUMERATE_INSTRUCTION_HANDLERS(ENUMERATION_FUNC)
+#undef ENUMERATION_FUNC
+        Count_
+    };
+
+    /*
+     * Instruction with all of its fields already extracted from the raw bytes, so that it can be executed
+     * without looking at the encoding again
+     */
+    struct DecodedInstruction
+    {
+        InstructionHandler Handler = nullptr;
+        HandlerID ID = HandlerID::Invalid;
+
+        Assembler::Opcode Opcode = Assembler::Opcode::Hlt;
+        uint8_t Length = 0;
+
+        uint8_t FirstRegister = 0;
+        uint8_t SecondRegister = 0;
+
+        uint16_t Immediate = 0;
+    };
+
+    /*
+     * Cache of decoded instructions keyed by their guest address. Storage is allocated lazily per page,
+     * so only pages that actually contain executed code take up host memory.
+     */
+    class InstructionCache
+    {
+    public:
+        const DecodedInstruction* Find(uint16_t Address) const
+        {
+            const auto& Page = m_Pages[Address >> PageShift];
+            if (!Page)
+                return nullptr;
+
+            // NOTE: every decoded instruction is at least one byte long, so empty entries are the ones with zero length
+            const auto& Entry = (*Page)[Address & PageMask];
+            return Entry.Length ? &Entry : nullptr;
+        }
+
+        const DecodedInstruction& Insert(uint16_t Address, const DecodedInstruction& Instruction);
+
+        /*
+         * Must be called whenever a byte of guest memory changes; drops every cached instruction that
+         * could have been decoded from that byte
+         */
+        void OnMemoryWrite(uint16_t Address)
+        {
+            if (m_CodePages.test(Address >> PageShift))
+                InvalidateInstructionsOverlapping(Address);
+        }
+
+        // Returns true if any cached instruction has a byte on the page that contains the address
+        bool ContainsCode(uint16_t Address) const
+        {
+            return m_CodePages.test(Address >> PageShift);
+        }
+
+        void Clear();
+
+    private:
+        constexpr static size_t PageShift = 8;
+        constexpr static size_t PageSize = 1 << PageShift;
+        constexpr static size_t PageMask = PageSize - 1;
+        constexpr static size_t PageCount = 65536 / PageSize;
+
+        constexpr static uint16_t MaxInstructionLength = 4;
+
+        std::array<std::unique_ptr<std::array<DecodedInstruction, PageSize>>, PageCount> m_Pages;
+
+        // Pages that hold at least one byte of a cached instruction
+        std::bitset<PageCount> m_CodePages;
+
+        void InvalidateInstructionsOverlapping(uint16_t Address);
+    };
+} // namespace lce::Emulator
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "InstructionCache.h"
+
+namespace lce::Emulator
+{
+    // Encoding of nop, used to pad instructions that are fetched past the end of mapped memory
+    constexpr uint8_t EncodedNOP = 0x54;
+
+    constexpr size_t MaxInstructionLength = 4;
+
+    /*
+     * Everything about an instruction that follows from its opcode and operand types, which are all stored in the first
+     * byte and the two highest bits of the second one. The rest of the second byte only holds register numbers.
+     */
+    struct DecodeTableEntry
+    {
+        HandlerID ID = HandlerID::Invalid;
+        Assembler::Opcode Opcode = Assembler::Opcode::Hlt;
+        uint8_t Length = 1;
+
+        // NOTE: 0 if the instruction has no immediate operand
+        uint8_t ImmediateOffset = 0;
+        uint8_t ImmediateSize = 0;
+
+        // Set if the instruction has two operands, whose types are only known once the second byte is read
+        bool NeedsSecondByte = false;
+    };
+
+    constexpr size_t DecodeTableSize = 256 * 4;
+
+    constexpr size_t GetDecodeTableIndex(uint8_t FirstByte, uint8_t SecondByte)
+    {
+        return (static_cast<size_t>(FirstByte) << 2) | (SecondByte >> 6);
+    }
+
+    // Generated at compile time, see GetDecodeTableIndex for how it is indexed
+    extern const std::array<DecodeTableEntry, DecodeTableSize> DecodeTable;
+
+    /*
+     * Reads the instruction at Address into Bytes through ReadByte, which is called with the address of every byte.
+     * Only the bytes that belong to the instruction are read, so it is safe to fetch from memory mapped devices.
+     * Returns the length of the instruction.
+     */
+    template <typename ReadByteFunction>
+    uint8_t FetchInstructionBytes(uint16_t Address, uint8_t (&Bytes)[MaxInstructionLength], const ReadByteFunction& ReadByte)
+    {
+        uint8_t Fetched = 1;
+        Bytes[0] = ReadByte(Address);
+        Bytes[1] = 0;
+        if (DecodeTable[GetDecodeTableIndex(Bytes[0], 0)].NeedsSecondByte)
+            Bytes[Fetched++] = ReadByte(static_cast<uint16_t>(Address + 1));
+
+        auto Length = DecodeTable[GetDecodeTableIndex(Bytes[0], Bytes[1])].Length;
+        // NOTE: no entry is longer than MaxInstructionLength, but the compiler can not see that through the table
+        for (uint8_t Offset = Fetched; Offset < std::min<uint8_t>(Length, MaxInstructionLength); Offset++)
+            Bytes[Offset] = ReadByte(static_cast<uint16_t>(Address + Offset));
+        return Length;
+    }
+
+    /*
+     * Decodes the instruction at Bytes with a single lookup in DecodeTable. Bytes must hold the whole instruction (see
+     * FetchInstructionBytes), and at least two bytes even if the instruction is shorter. The handler of the result is
+     * left empty, since it depends on the engine that is going to execute the instruction.
+     */
+    DecodedInstruction DecodeInstruction(const uint8_t* Bytes);
+} // namespace lce::Emulator
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "BlockCache.h"
+#include "InstructionCache.h"
+#include "X86Emitter.h"
+
+namespace lce::Emulator
+{
+    class CPU;
+
+    /*
+     * Translates hot basic blocks into native x86-64 code. While native code runs, guest registers live in host
+     * registers and flags are taken directly from the host condition codes. Loads and stores to plain memory are
+     * done inline, everything else (memory mapped devices, writes to pages that contain code) goes through the CPU.
+     * Blocks that overwrite their own code are invalidated and their pages are left to the interpreter from then on.
+     */
+    class JITCompiler
+    {
+    public:
+        explicit JITCompiler(CPU& Processor);
+        ~JITCompiler();
+
+        JITCompiler(const JITCompiler&) = delete;
+        JITCompiler& operator=(const JITCompiler&) = delete;
+
+        // Returns false if native code can not be generated or executed on this host
+        bool IsAvailable() const;
+
+        bool HasNativeCode(uint16_t Address) const
+        {
+            const auto* Page = m_Context.NativeCode[Address >> PageShift];
+            return Page && Page[Address & PageMask];
+        }
+
+        /*
+         * Generates native code for the block. Only the longest prefix of the block that the compiler supports is
+         * translated; returns false if not even the first instruction could be translated.
+         */
+        bool Compile(const TranslatedBlock& Block);
+
+        /*
+         * Runs native code starting at IP until it reaches code that has not been compiled, the CPU halts or its
+         * cycle limit is reached. The limit is checked before every block, so it may be exceeded by up to one block.
+         */
+        void Execute();
+
+        // Makes native code that is running right now stop once the CPU reaches CycleLimit
+        void LowerCycleLimit(uint64_t CycleLimit);
+
+        // Must be called whenever a byte of guest memory changes
+        void OnMemoryWrite(uint16_t Address)
+        {
+            if (m_NativeCodePages.test(Address >> PageShift))
+                InvalidateNativeCodeContaining(Address);
+        }
+
+        // Must be called when a breakpoint is added or removed, which unlike a write does not make the page self-modifying
+        void OnBreakpointChanged(uint16_t Address)
+        {
+            if (m_NativeCodePages.test(Address >> PageShift))
+                DropNativeCodeContaining(Address);
+        }
+
+        // Must be called when an instruction is added to the instruction cache, so that inline stores to its pages stop
+        void OnCodeCached(uint16_t Address, uint8_t Length);
+
+        // Rebuilds the tables that are used by inline memory accesses after the memory map of the CPU has changed
+        void SyncMemoryMap();
+
+        // Drops all generated code
+        void Flush();
+
+    private:
+        constexpr static size_t PageShift = 8;
+        constexpr static size_t PageSize = 1 << PageShift;
+        constexpr static size_t PageMask = PageSize - 1;
+        constexpr static size_t PageCount = 65536 / PageSize;
+
+        constexpr static size_t MappedRegisterCount = 6;
+
+        /*
+         * State shared with the generated code, which keeps a pointer to it in a host register
+         */
+        struct Context
+        {
+            uint16_t Registers[MappedRegisterCount];
+            uint16_t IP;
+            uint8_t IsHalted;
+
+            // NOTE: every block subtracts its length on entry, and the dispatcher exits once this is no longer positive
+            int64_t CyclesLeft;
+
+            JITCompiler* Compiler;
+
+            // Host memory of every page that can be accessed directly, nullptr if the access has to go through the CPU
+            std::array<const uint8_t*, PageCount> ReadPages;
+            std::array<uint8_t*, PageCount> WritePages;
+
+            // Entry points of compiled blocks indexed by their guest address
+            std::array<const uint8_t**, PageCount> NativeCode;
+        };
+
+        struct NativeBlock
+        {
+            uint16_t StartAddress;
+            uint32_t EndAddress;
+        };
+
+        // Instruction of a block together with its guest address
+        struct GuestInstruction
+        {
+            uint16_t Address;
+            DecodedInstruction Instruction;
+        };
+
+        using EntryFunction = void (*)(Context* Context, const uint8_t* Target);
+
+        CPU& m_CPU;
+        Context m_Context = {};
+
+        uint8_t* m_CodeMemory = nullptr;
+        size_t m_CodeMemorySize = 0;
+        size_t m_CodeMemoryUsed = 0;
+        size_t m_RuntimeSize = 0;
+
+        const uint8_t* m_Dispatcher = nullptr;
+        const uint8_t* m_Exit = nullptr;
+        EntryFunction m_Enter = nullptr;
+
+        std::array<std::unique_ptr<std::array<const uint8_t*, PageSize>>, PageCount> m_NativeEntries;
+        std::array<std::vector<NativeBlock>, PageCount> m_NativeBlocksByPage;
+        std::bitset<PageCount> m_NativeCodePages;
+
+        // Pages where guest code has overwritten compiled code; they are never compiled again
+        std::bitset<PageCount> m_SelfModifyingPages;
+
+        bool m_NativeCodeInvalidated = false;
+
+        // Cycle count of the CPU and budget at the start of Execute, used to tell the current cycle while it runs
+        bool m_IsExecuting = false;
+        uint64_t m_StartCycleCount = 0;
+        int64_t m_CycleBudget = 0;
+
+        void EmitRuntime();
+        void EmitBlock(X86::Emitter& Emitter, const std::vector<GuestInstruction>& Instructions, uint32_t EndAddress) const;
+        bool CommitCode(const X86::Emitter& Emitter);
+
+        void EmitFlagSettingInstruction(X86::Emitter& Emitter, const DecodedInstruction& Instruction) const;
+        void EmitMaterializeFlags(X86::Emitter& Emitter, bool IncludeOverflow) const;
+        void EmitMergeFlags(X86::Emitter& Emitter) const;
+        void EmitConditionalJump(X86::Emitter& Emitter, const DecodedInstruction& Instruction, uint16_t NextAddress, bool FlagsPending, bool HostFlagsValid) const;
+        void EmitLoadJumpTarget(X86::Emitter& Emitter, const DecodedInstruction& Instruction) const;
+        void EmitReadWord(X86::Emitter& Emitter) const;
+        void EmitWriteWord(X86::Emitter& Emitter, const DecodedInstruction& Instruction, uint16_t NextAddress, uint32_t FollowingInstructionCount) const;
+        void EmitHelperCall(X86::Emitter& Emitter, const void* Helper) const;
+
+        void InvalidateNativeCodeContaining(uint16_t Address);
+
+        // Removes the entries of all compiled blocks that contain Address, returns false if there were none
+        bool DropNativeCodeContaining(uint16_t Address);
+
+        // Brings the cycle count of the CPU up to date before native code calls into it
+        void SyncCycleCount();
+
+        static uint32_t ReadWordFromGuest(JITCompiler* Compiler, uint32_t Address);
+        static uint32_t WriteWordToGuest(JITCompiler* Compiler, uint32_t Address, uint32_t Value);
+    };
+} // namespace lce::Emulator
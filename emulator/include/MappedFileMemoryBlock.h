@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+#include "MemoryBlock.h"
+
+namespace lce::Emulator
+{
+    /*
+     * Read-only view of a file, e.g. an assembled ROM image, that is padded with zeros up to a fixed size. On POSIX
+     * hosts the file is mapped into memory instead of being read, so opening it does not depend on its size and all
+     * mappings of the same file share the host's page cache. One MappedFile can back any number of memory blocks.
+     */
+    class MappedFile
+    {
+    public:
+        // Returns nullptr if the file can not be opened or is larger than Size
+        static std::shared_ptr<const MappedFile> Open(const std::filesystem::path& Path, uint16_t Size);
+
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const uint8_t* Data() const { return m_Data; }
+        uint16_t Size() const { return m_Size; }
+
+        // Number of bytes that come from the file, the rest of the view reads as zero
+        size_t FileSize() const { return m_FileSize; }
+
+    private:
+        MappedFile() = default;
+
+        const uint8_t* m_Data = nullptr;
+        uint16_t m_Size = 0;
+        size_t m_FileSize = 0;
+
+        // NOTE: holds the contents on hosts without mmap, otherwise empty
+        std::vector<uint8_t> m_Buffer;
+        size_t m_MappingSize = 0;
+    };
+
+    /*
+     * Memory block that serves reads straight from a MappedFile. Writes are ignored and reported as a warning.
+     */
+    class MappedFileMemoryBlock : public MemoryBlock
+    {
+    public:
+        explicit MappedFileMemoryBlock(std::shared_ptr<const MappedFile> File);
+
+        virtual uint8_t Read(uint16_t RelativeAddress) const override;
+
+        virtual void Write(uint16_t RelativeAddress, uint8_t Value) override;
+
+        virtual uint16_t Size() const override;
+
+        virtual void ReadRange(uint16_t RelativeAddress, std::span<uint8_t> Bytes) const override;
+
+        virtual void WriteRange(uint16_t RelativeAddress, std::span<const uint8_t> Bytes) override;
+
+        virtual uint16_t ReadWord(uint16_t RelativeAddress) const override;
+
+        virtual const uint8_t* DirectPointer(uint16_t RelativeAddress) const override;
+
+        // NOTE: copies share the file, nothing is copied
+        virtual std::unique_ptr<MemoryBlock> Clone() const override;
+
+    private:
+        std::shared_ptr<const MappedFile> m_File;
+    };
+} // namespace lce::Emulator
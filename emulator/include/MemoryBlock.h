@@ -1,12 +1,17 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
+#include <span>
 
 namespace lce::Emulator
 {
     class MemoryBlock
     {
     public:
+        // Granularity of the host memory returned by DirectPointer and DirectWritePointer
+        constexpr static uint16_t DirectPageSize = 256;
+
         virtual ~MemoryBlock() = default;
 
         virtual uint8_t Read(uint16_t RelativeAddress) const = 0;
@@ -14,5 +19,54 @@ namespace lce::Emulator
         virtual void Write(uint16_t RelativeAddress, uint8_t Value) = 0;
 
         virtual uint16_t Size() const = 0;
+
+        /*
+         * Bulk and word accessors. The default implementations go through Read and Write byte by byte, blocks that
+         * are backed by host memory should override them. Words are stored in little-endian order.
+         */
+        virtual void ReadRange(uint16_t RelativeAddress, std::span<uint8_t> Bytes) const
+        {
+            for (size_t Offset = 0; Offset < Bytes.size(); Offset++)
+                Bytes[Offset] = Read(static_cast<uint16_t>(RelativeAddress + Offset));
+        }
+
+        virtual void WriteRange(uint16_t RelativeAddress, std::span<const uint8_t> Bytes)
+        {
+            for (size_t Offset = 0; Offset < Bytes.size(); Offset++)
+                Write(static_cast<uint16_t>(RelativeAddress + Offset), Bytes[Offset]);
+        }
+
+        virtual uint16_t ReadWord(uint16_t RelativeAddress) const
+        {
+            // NOTE: reads can have side effects, so the low byte is always read first
+            auto Low = Read(RelativeAddress);
+            auto High = Read(RelativeAddress + 1);
+            return Low | (High << 8);
+        }
+
+        virtual void WriteWord(uint16_t RelativeAddress, uint16_t Value)
+        {
+            Write(RelativeAddress, static_cast<uint8_t>(Value & 0xFF));
+            Write(RelativeAddress + 1, static_cast<uint8_t>(Value >> 8));
+        }
+
+        /*
+         * Returns host memory that holds the bytes from RelativeAddress up to the next multiple of DirectPageSize, or
+         * nullptr if the block is not backed by plain memory (e.g. because reads have side effects). The pointer
+         * stays valid until the next call to Write, WriteRange or WriteWord.
+         */
+        virtual const uint8_t* DirectPointer(uint16_t /*RelativeAddress*/) const { return nullptr; }
+
+        /*
+         * Like DirectPointer, but the memory can also be written to. Returns nullptr if the memory is read-only or
+         * can not be written in place right now; writing a byte through Write makes it writable again in that case.
+         */
+        virtual uint8_t* DirectWritePointer(uint16_t /*RelativeAddress*/) { return nullptr; }
+
+        /*
+         * Creates an independent copy of the block that is used for CPU snapshots. Blocks that cannot be copied
+         * (e.g. because they represent a device that exists only once) return nullptr.
+         */
+        virtual std::unique_ptr<MemoryBlock> Clone() const { return nullptr; }
     };
 } // namespace lce::Emulator
@@ -1,15 +1,26 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <vector>
 
 #include "MemoryBlock.h"
 
 namespace lce::Emulator
 {
+    /*
+     * Plain memory that is stored in fixed size pages. Copies made with Clone share all pages with the original block,
+     * and a page is only copied once one of the blocks that share it is written to.
+     */
     class RandomAccessMemoryBlock : public MemoryBlock
     {
     public:
+        constexpr static size_t PageShift = 8;
+        constexpr static size_t PageSize = 1 << PageShift;
+        static_assert(PageSize == DirectPageSize);
+
         RandomAccessMemoryBlock(uint16_t Size);
 
         virtual uint8_t Read(uint16_t RelativeAddress) const override;
@@ -18,7 +29,28 @@ namespace lce::Emulator
 
         virtual uint16_t Size() const override;
 
+        virtual void ReadRange(uint16_t RelativeAddress, std::span<uint8_t> Bytes) const override;
+
+        virtual void WriteRange(uint16_t RelativeAddress, std::span<const uint8_t> Bytes) override;
+
+        virtual uint16_t ReadWord(uint16_t RelativeAddress) const override;
+
+        virtual void WriteWord(uint16_t RelativeAddress, uint16_t Value) override;
+
+        virtual const uint8_t* DirectPointer(uint16_t RelativeAddress) const override;
+
+        // NOTE: returns nullptr while the page is shared with another block
+        virtual uint8_t* DirectWritePointer(uint16_t RelativeAddress) override;
+
+        virtual std::unique_ptr<MemoryBlock> Clone() const override;
+
+        // Copies the page first if it is shared with another block
+        uint8_t* MakePagePrivate(uint16_t RelativeAddress);
+
     private:
-        std::vector<uint8_t> m_Memory;
+        using Page = std::array<uint8_t, PageSize>;
+
+        std::vector<std::shared_ptr<Page>> m_Pages;
+        uint16_t m_Size;
     };
 }
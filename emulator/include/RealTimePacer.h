@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace lce::Emulator
+{
+    struct PacingOptions
+    {
+        // Guest clock frequency in Hz, the architecture specifies 1 MHz
+        uint64_t ClockFrequency = 1'000'000;
+
+        // Number of cycles that are executed flat out between two synchronizations with the host clock
+        uint64_t SliceCycles = 1000;
+
+        /*
+         * If the guest falls behind by more than this (e.g. because the host was suspended or overloaded), the
+         * schedule is restarted from the current time instead of running flat out until the guest has caught up
+         */
+        std::chrono::microseconds MaxLag{ 50'000 };
+    };
+
+    struct PacingStatistics
+    {
+        uint64_t Cycles = 0;
+        uint64_t Slices = 0;
+
+        // Number of times the schedule was restarted because the guest fell behind by more than MaxLag
+        uint64_t Resyncs = 0;
+
+        std::chrono::nanoseconds WallTime{ 0 };
+        std::chrono::nanoseconds GuestTime{ 0 };
+
+        // Difference between the host time at which a slice ended and the time at which it was supposed to end
+        std::chrono::nanoseconds MeanError{ 0 };
+        std::chrono::nanoseconds MaxError{ 0 };
+    };
+
+    /*
+     * Keeps guest time in step with the host clock. The guest runs in slices and the pacer blocks after each of them
+     * until the host has caught up. Deadlines are always computed from the start of the schedule rather than from the
+     * previous slice, so rounding errors and late wake-ups do not accumulate into drift. Waits sleep for most of the
+     * remaining time and spin for the rest; the spin window adapts to how late the host usually wakes up from a sleep.
+     */
+    class RealTimePacer
+    {
+    public:
+        explicit RealTimePacer(const PacingOptions& Options = {});
+
+        void Start();
+
+        // Blocks until the host time that corresponds to Cycles (counted since Start) has been reached
+        void WaitForCycle(uint64_t Cycles);
+
+        PacingStatistics GetStatistics() const;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        PacingOptions m_Options;
+
+        Clock::time_point m_StartTime;
+        Clock::time_point m_LastWakeTime;
+
+        // Schedule that deadlines are computed from, moved forward whenever the guest falls too far behind
+        Clock::time_point m_ScheduleStart;
+        uint64_t m_ScheduleStartCycle = 0;
+
+        std::chrono::nanoseconds m_SpinWindow;
+
+        uint64_t m_Cycles = 0;
+        uint64_t m_Slices = 0;
+        uint64_t m_Resyncs = 0;
+        std::chrono::nanoseconds m_TotalError{ 0 };
+        std::chrono::nanoseconds m_MaxError{ 0 };
+
+        std::chrono::nanoseconds CyclesToTime(uint64_t Cycles) const;
+    };
+} // namespace lce::Emulator
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "CPU.h"
+
+namespace lce::Emulator
+{
+    struct ReverseDebuggerOptions
+    {
+        // Cycles between checkpoints at the start, the interval doubles every time the checkpoints have to be thinned out
+        uint64_t InitialInterval = 4096;
+
+        // Upper bound on the interval, which bounds the number of cycles that have to be re-executed for a reverse step
+        uint64_t MaxInterval = 1 << 20;
+
+        // Upper bound on the number of checkpoints kept. Once the interval can not grow anymore, the oldest ones are dropped
+        size_t MaxCheckpoints = 256;
+    };
+
+    /*
+     * Runs a CPU forward while taking periodic checkpoints, so that it can also be moved backwards: going back means
+     * restoring the nearest earlier checkpoint and executing forward again up to the requested cycle. Checkpoints are
+     * CPU snapshots, which share memory with the CPU page by page, so each of them only holds the pages that were
+     * written after it was taken.
+     *
+     * Execution has to be deterministic for this to work, so the CPU must not have device buses (restoring a snapshot
+     * drops them anyway), and it should only be run through the debugger while the debugger is in use. If the state
+     * of the CPU can not be copied (see CPU::Snapshot), no history is kept and it can not be moved backwards.
+     */
+    class ReverseDebugger
+    {
+    public:
+        explicit ReverseDebugger(CPU& Processor, const ReverseDebuggerOptions& Options = {});
+
+        // Like CPU::RunFor and CPU::RunUntil, but takes checkpoints on the way
+        RunResult RunFor(uint64_t MaxCycles);
+        RunResult RunUntil(uint16_t Address, uint64_t MaxCycles = UINT64_MAX);
+
+        /*
+         * Moves back by one instruction. Returns false if the CPU is already at the oldest point that is still
+         * covered by a checkpoint.
+         */
+        bool ReverseStep();
+
+        /*
+         * Moves back to the latest earlier point at which the next instruction is at Address (or Predicate returns
+         * true). Returns false and stops at the oldest covered point if there is none.
+         */
+        bool ReverseContinue(uint16_t Address);
+        bool ReverseContinue(const std::function<bool(const CPU&)>& Predicate);
+
+        // Moves the CPU to the state it had after Cycle cycles, returns false if that is not covered by the history
+        bool GoToCycle(uint64_t Cycle);
+
+        uint64_t GetOldestCycle() const;
+        size_t GetCheckpointCount() const;
+        uint64_t GetCheckpointInterval() const;
+
+    private:
+        struct Checkpoint
+        {
+            uint64_t Cycle;
+            CPUSnapshot State;
+        };
+
+        CPU& m_CPU;
+        ReverseDebuggerOptions m_Options;
+        uint64_t m_Interval;
+
+        // NOTE: ordered by cycle, the first one is taken when the debugger is created
+        std::vector<Checkpoint> m_Checkpoints;
+
+        template <typename RunFunction>
+        RunResult RunForward(uint64_t MaxCycles, const RunFunction& Run);
+
+        void TakeCheckpoint();
+        void ThinOutCheckpoints();
+
+        // Restores the latest checkpoint that was taken at or before Cycle
+        const Checkpoint& RestoreCheckpointBefore(uint64_t Cycle);
+    };
+} // namespace lce::Emulator
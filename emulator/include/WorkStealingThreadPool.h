@@ -0,0 +1,62 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lce::Emulator
+{
+    /*
+     * Runs batches of independent tasks on a fixed set of worker threads. Tasks are identified by their index, and
+     * every worker starts with an equal share of the index range. A worker that runs out of tasks steals half of the
+     * remaining range of another worker, so uneven task durations do not leave cores idle.
+     */
+    class WorkStealingThreadPool
+    {
+    public:
+        using Task = std::function<void(size_t TaskIndex, size_t WorkerIndex)>;
+
+        // A thread count of 0 uses one thread per host core
+        explicit WorkStealingThreadPool(size_t ThreadCount = 0, bool PinThreads = false);
+        ~WorkStealingThreadPool();
+
+        WorkStealingThreadPool(const WorkStealingThreadPool&) = delete;
+        WorkStealingThreadPool& operator=(const WorkStealingThreadPool&) = delete;
+
+        size_t GetThreadCount() const;
+
+        // Calls Function once for every index in [0, TaskCount) and returns after all calls have finished
+        void Run(size_t TaskCount, const Task& Function);
+
+    private:
+        // NOTE: aligned to a cache line so that workers do not slow each other down when updating their own range
+        struct alignas(64) WorkerQueue
+        {
+            std::mutex Mutex;
+            size_t Begin = 0;
+            size_t End = 0;
+        };
+
+        std::vector<std::thread> m_Threads;
+        std::unique_ptr<WorkerQueue[]> m_Queues;
+
+        std::mutex m_Mutex;
+        std::condition_variable m_WorkAvailable;
+        std::condition_variable m_WorkFinished;
+        const Task* m_Task = nullptr;
+        uint64_t m_Generation = 0;
+        size_t m_FinishedWorkers = 0;
+        bool m_IsStopping = false;
+
+        void WorkerMain(size_t WorkerIndex);
+        bool PopTask(size_t WorkerIndex, size_t& TaskIndex);
+        bool StealTasks(size_t WorkerIndex);
+
+        static void PinCurrentThread(size_t WorkerIndex);
+    };
+} // namespace lce::Emulator
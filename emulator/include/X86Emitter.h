@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace lce::Emulator::X86
+{
+    enum class Register : uint8_t
+    {
+        RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+        R8, R9, R10, R11, R12, R13, R14, R15
+    };
+
+    // NOTE: values match the condition code field of jcc and setcc
+    enum class Condition : uint8_t
+    {
+        Overflow = 0x0,
+        NoOverflow = 0x1,
+        Carry = 0x2,
+        NoCarry = 0x3,
+        Zero = 0x4,
+        NotZero = 0x5,
+        Sign = 0x8,
+        NoSign = 0x9,
+        LessOrEqual = 0xE
+    };
+
+    // NOTE: values match the /digit field of the 0x81 opcode group
+    enum class AluOperation : uint8_t
+    {
+        Add = 0,
+        Or = 1,
+        And = 4,
+        Sub = 5,
+        Xor = 6,
+        Cmp = 7
+    };
+
+    // NOTE: values match the /digit field of the 0xC1 opcode group
+    enum class ShiftOperation : uint8_t
+    {
+        Shl = 4,
+        Shr = 5
+    };
+
+    /*
+     * Minimal x86-64 machine code emitter that only knows the instructions needed by the JIT. Code is collected in a
+     * buffer and later copied to BaseAddress, which is used to compute relative jumps to code outside of the buffer.
+     */
+    class Emitter
+    {
+    public:
+        // Position of a rel32 field that has to be patched once the target is known
+        using Fixup = size_t;
+
+        explicit Emitter(const uint8_t* BaseAddress);
+
+        const std::vector<uint8_t>& Code() const;
+        const uint8_t* CurrentAddress() const;
+
+        // 16-bit operations on the low word of a register
+        void MovImmediate16(Register Destination, uint16_t Value);
+        void Mov16(Register Destination, Register Source);
+        void Alu16(AluOperation Operation, Register Destination, Register Source);
+        void AluImmediate16(AluOperation Operation, Register Destination, uint16_t Value);
+        void Not16(Register Destination);
+        void Test16(Register Left, Register Right);
+        void ShiftImmediate16(ShiftOperation Operation, Register Destination, uint8_t Count);
+
+        // 32-bit operations, which zero the upper half of the destination
+        void MovImmediate32(Register Destination, uint32_t Value);
+        void Mov32(Register Destination, Register Source);
+        void MovZeroExtend16(Register Destination, Register Source);
+        void MovZeroExtend8(Register Destination, Register Source);
+        void AluImmediate32(AluOperation Operation, Register Destination, uint32_t Value);
+        void Alu32(AluOperation Operation, Register Destination, Register Source);
+        void ShiftImmediate32(ShiftOperation Operation, Register Destination, uint8_t Count);
+        void TestImmediate32(Register Destination, uint32_t Value);
+        void CmpImmediate8(Register Destination, uint8_t Value);
+        void SetCondition(Condition Condition, Register Destination);
+
+        // Destination = Base + Index * Scale, does not modify flags
+        void Lea32(Register Destination, Register Base, Register Index, uint8_t Scale);
+
+        // 64-bit operations
+        void MovImmediate64(Register Destination, uint64_t Value);
+        void Mov64(Register Destination, Register Source);
+        void Test64(Register Left, Register Right);
+        void AddImmediate64(Register Destination, int8_t Value);
+        void SubImmediate64(Register Destination, int8_t Value);
+        void Push(Register Source);
+        void Pop(Register Destination);
+
+        // Memory accesses of the form [Base + Index * Scale + Displacement]
+        void Load64(Register Destination, Register Base, Register Index, uint8_t Scale, int32_t Displacement);
+        void Load64(Register Destination, Register Base, int32_t Displacement);
+        void LoadZeroExtend16(Register Destination, Register Base, Register Index, int32_t Displacement);
+        void LoadZeroExtend16(Register Destination, Register Base, int32_t Displacement);
+        void Store16(Register Base, Register Index, int32_t Displacement, Register Source);
+        void Store16(Register Base, int32_t Displacement, Register Source);
+        void StoreImmediate8(Register Base, int32_t Displacement, uint8_t Value);
+        void AluImmediate64(AluOperation Operation, Register Base, int32_t Displacement, int32_t Value);
+
+        // Control flow
+        Fixup JumpForward();
+        Fixup JumpForward(Condition Condition);
+        void Bind(Fixup Fixup);
+        void Jump(const uint8_t* Target);
+        void Jump(Register Target);
+        void Call(Register Target);
+        void Return();
+
+    private:
+        const uint8_t* m_BaseAddress;
+        std::vector<uint8_t> m_Code;
+
+        void Emit8(uint8_t Value);
+        void Emit16(uint16_t Value);
+        void Emit32(uint32_t Value);
+        void Emit64(uint64_t Value);
+
+        void EmitRex(bool Wide, uint8_t Reg, uint8_t Index, uint8_t Base, bool ForceRex = false);
+        void EmitRegisterOperand(uint8_t Reg, uint8_t RM);
+        void EmitMemoryOperand(uint8_t Reg, Register Base, Register Index, uint8_t Scale, int32_t Displacement);
+        void EmitMemoryOperand(uint8_t Reg, Register Base, int32_t Displacement);
+    };
+} // namespace lce::Emulator::X86
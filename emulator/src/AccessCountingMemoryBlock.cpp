@@ -0,0 +1,71 @@
+#include "AccessCountingMemoryBlock.h"
+
+#include <cassert>
+
+namespace lce::Emulator
+{
+    AccessCountingMemoryBlock::AccessCountingMemoryBlock(std::unique_ptr<MemoryBlock> Inner)
+        : m_Inner(std::move(Inner))
+    {
+        assert(m_Inner);
+    }
+
+    uint8_t AccessCountingMemoryBlock::Read(uint16_t RelativeAddress) const
+    {
+        m_BytesRead++;
+        return m_Inner->Read(RelativeAddress);
+    }
+
+    void AccessCountingMemoryBlock::Write(uint16_t RelativeAddress, uint8_t Value)
+    {
+        m_BytesWritten++;
+        m_Inner->Write(RelativeAddress, Value);
+    }
+
+    uint16_t AccessCountingMemoryBlock::Size() const
+    {
+        return m_Inner->Size();
+    }
+
+    void AccessCountingMemoryBlock::ReadRange(uint16_t RelativeAddress, std::span<uint8_t> Bytes) const
+    {
+        m_BytesRead += Bytes.size();
+        m_Inner->ReadRange(RelativeAddress, Bytes);
+    }
+
+    void AccessCountingMemoryBlock::WriteRange(uint16_t RelativeAddress, std::span<const uint8_t> Bytes)
+    {
+        m_BytesWritten += Bytes.size();
+        m_Inner->WriteRange(RelativeAddress, Bytes);
+    }
+
+    uint16_t AccessCountingMemoryBlock::ReadWord(uint16_t RelativeAddress) const
+    {
+        m_BytesRead += 2;
+        return m_Inner->ReadWord(RelativeAddress);
+    }
+
+    void AccessCountingMemoryBlock::WriteWord(uint16_t RelativeAddress, uint16_t Value)
+    {
+        m_BytesWritten += 2;
+        m_Inner->WriteWord(RelativeAddress, Value);
+    }
+
+    std::unique_ptr<MemoryBlock> AccessCountingMemoryBlock::Clone() const
+    {
+        auto InnerCopy = m_Inner->Clone();
+        if (!InnerCopy)
+            return nullptr;
+        return std::make_unique<AccessCountingMemoryBlock>(std::move(InnerCopy));
+    }
+
+    uint64_t AccessCountingMemoryBlock::GetBytesRead() const
+    {
+        return m_BytesRead;
+    }
+
+    uint64_t AccessCountingMemoryBlock::GetBytesWritten() const
+    {
+        return m_BytesWritten;
+    }
+} // namespace lce::Emulator
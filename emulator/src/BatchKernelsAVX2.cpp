@@ -0,0 +1,74 @@
+#include "BatchKernelsImpl.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace lce::Emulator
+{
+    // NOTE: this file is compiled with AVX2 enabled, so nothing in it may run before the host has been checked for support
+#if defined(__AVX2__)
+    namespace
+    {
+        struct AVX2Vector
+        {
+            using Type = __m256i;
+            constexpr static size_t Width = 16;
+            constexpr static const char* Name = "AVX2";
+
+            static Type Load(const uint16_t* Source) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Source)); }
+            static void Store(uint16_t* Destination, Type Value) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(Destination), Value); }
+            static Type LoadBytes(const uint8_t* Source)
+            {
+                return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(Source)));
+            }
+            static void StoreBytes(uint8_t* Destination, Type Value, Type Mask)
+            {
+                // NOTE: packing works within 128-bit halves, so the halves are packed separately
+                auto Bytes = _mm_packus_epi16(_mm256_castsi256_si128(Value), _mm256_extracti128_si256(Value, 1));
+                auto ByteMask = _mm_packs_epi16(_mm256_castsi256_si128(Mask), _mm256_extracti128_si256(Mask, 1));
+                auto Old = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Destination));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(Destination), _mm_blendv_epi8(Old, Bytes, ByteMask));
+            }
+
+            static Type Broadcast(uint16_t Value) { return _mm256_set1_epi16(static_cast<short>(Value)); }
+            static Type Zero() { return _mm256_setzero_si256(); }
+
+            static Type Add(Type Left, Type Right) { return _mm256_add_epi16(Left, Right); }
+            static Type Sub(Type Left, Type Right) { return _mm256_sub_epi16(Left, Right); }
+            static Type AddSaturate(Type Left, Type Right) { return _mm256_adds_epu16(Left, Right); }
+            static Type SubSaturate(Type Left, Type Right) { return _mm256_subs_epu16(Left, Right); }
+            static Type And(Type Left, Type Right) { return _mm256_and_si256(Left, Right); }
+            static Type AndNot(Type Left, Type Right) { return _mm256_andnot_si256(Left, Right); }
+            static Type Or(Type Left, Type Right) { return _mm256_or_si256(Left, Right); }
+            static Type Xor(Type Left, Type Right) { return _mm256_xor_si256(Left, Right); }
+            static Type ShiftLeft(Type Value, int Count) { return _mm256_sll_epi16(Value, _mm_cvtsi32_si128(Count)); }
+            static Type ShiftRight(Type Value, int Count) { return _mm256_srl_epi16(Value, _mm_cvtsi32_si128(Count)); }
+            static Type Equal(Type Left, Type Right) { return _mm256_cmpeq_epi16(Left, Right); }
+            static Type Minimum(Type Left, Type Right) { return _mm256_min_epu16(Left, Right); }
+
+            static uint16_t HorizontalMinimum(Type Value)
+            {
+                auto Minimum = _mm_min_epu16(_mm256_castsi256_si128(Value), _mm256_extracti128_si256(Value, 1));
+                return static_cast<uint16_t>(_mm_cvtsi128_si32(_mm_minpos_epu16(Minimum)));
+            }
+
+            static size_t CountSet(Type Mask)
+            {
+                // NOTE: every 16-bit lane sets two bits of the byte mask
+                return static_cast<size_t>(__builtin_popcount(static_cast<unsigned>(_mm256_movemask_epi8(Mask)))) / 2;
+            }
+        };
+    } // namespace
+
+    const BatchKernels* GetAVX2BatchKernels()
+    {
+        return &BatchKernelImplementation<AVX2Vector>::Table;
+    }
+#else
+    const BatchKernels* GetAVX2BatchKernels()
+    {
+        return nullptr;
+    }
+#endif
+} // namespace lce::Emulator
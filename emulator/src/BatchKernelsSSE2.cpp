@@ -0,0 +1,85 @@
+#include "BatchKernelsImpl.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace lce::Emulator
+{
+#if defined(__SSE2__)
+    namespace
+    {
+        struct SSE2Vector
+        {
+            using Type = __m128i;
+            constexpr static size_t Width = 8;
+            constexpr static const char* Name = "SSE2";
+
+            static Type Load(const uint16_t* Source) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(Source)); }
+            static void Store(uint16_t* Destination, Type Value) { _mm_storeu_si128(reinterpret_cast<__m128i*>(Destination), Value); }
+            static Type LoadBytes(const uint8_t* Source)
+            {
+                return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(Source)), _mm_setzero_si128());
+            }
+            static void StoreBytes(uint8_t* Destination, Type Value, Type Mask)
+            {
+                auto Bytes = _mm_packus_epi16(Value, _mm_setzero_si128());
+                auto ByteMask = _mm_packs_epi16(Mask, _mm_setzero_si128());
+                auto Old = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(Destination));
+                auto New = _mm_or_si128(_mm_and_si128(ByteMask, Bytes), _mm_andnot_si128(ByteMask, Old));
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(Destination), New);
+            }
+
+            static Type Broadcast(uint16_t Value) { return _mm_set1_epi16(static_cast<short>(Value)); }
+            static Type Zero() { return _mm_setzero_si128(); }
+
+            static Type Add(Type Left, Type Right) { return _mm_add_epi16(Left, Right); }
+            static Type Sub(Type Left, Type Right) { return _mm_sub_epi16(Left, Right); }
+            static Type AddSaturate(Type Left, Type Right) { return _mm_adds_epu16(Left, Right); }
+            static Type SubSaturate(Type Left, Type Right) { return _mm_subs_epu16(Left, Right); }
+            static Type And(Type Left, Type Right) { return _mm_and_si128(Left, Right); }
+            static Type AndNot(Type Left, Type Right) { return _mm_andnot_si128(Left, Right); }
+            static Type Or(Type Left, Type Right) { return _mm_or_si128(Left, Right); }
+            static Type Xor(Type Left, Type Right) { return _mm_xor_si128(Left, Right); }
+            static Type ShiftLeft(Type Value, int Count) { return _mm_sll_epi16(Value, _mm_cvtsi32_si128(Count)); }
+            static Type ShiftRight(Type Value, int Count) { return _mm_srl_epi16(Value, _mm_cvtsi32_si128(Count)); }
+            static Type Equal(Type Left, Type Right) { return _mm_cmpeq_epi16(Left, Right); }
+
+            static Type Minimum(Type Left, Type Right)
+            {
+                // NOTE: SSE2 only has a signed minimum, flipping the sign bit makes it compare unsigned values
+                auto SignBit = _mm_set1_epi16(static_cast<short>(0x8000));
+                auto Result = _mm_min_epi16(_mm_xor_si128(Left, SignBit), _mm_xor_si128(Right, SignBit));
+                return _mm_xor_si128(Result, SignBit);
+            }
+
+            static uint16_t HorizontalMinimum(Type Value)
+            {
+                alignas(16) uint16_t Lanes[Width];
+                _mm_store_si128(reinterpret_cast<__m128i*>(Lanes), Value);
+
+                uint16_t Result = Lanes[0];
+                for (size_t Lane = 1; Lane < Width; Lane++)
+                    Result = Lanes[Lane] < Result ? Lanes[Lane] : Result;
+                return Result;
+            }
+
+            static size_t CountSet(Type Mask)
+            {
+                // NOTE: every 16-bit lane sets two bits of the byte mask
+                return static_cast<size_t>(__builtin_popcount(static_cast<unsigned>(_mm_movemask_epi8(Mask)))) / 2;
+            }
+        };
+    } // namespace
+
+    const BatchKernels* GetSSE2BatchKernels()
+    {
+        return &BatchKernelImplementation<SSE2Vector>::Table;
+    }
+#else
+    const BatchKernels* GetSSE2BatchKernels()
+    {
+        return nullptr;
+    }
+#endif
+} // namespace lce::Emulator
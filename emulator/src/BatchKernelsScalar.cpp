@@ -0,0 +1,48 @@
+#include "BatchKernelsImpl.h"
+
+namespace lce::Emulator
+{
+    namespace
+    {
+        // Fallback that processes a single lane at a time, each "vector" is just one value
+        struct ScalarVector
+        {
+            using Type = uint16_t;
+            constexpr static size_t Width = 1;
+            constexpr static const char* Name = "Scalar";
+
+            static Type Load(const uint16_t* Source) { return *Source; }
+            static void Store(uint16_t* Destination, Type Value) { *Destination = Value; }
+            static Type LoadBytes(const uint8_t* Source) { return *Source; }
+            static void StoreBytes(uint8_t* Destination, Type Value, Type Mask)
+            {
+                if (Mask)
+                    *Destination = static_cast<uint8_t>(Value);
+            }
+
+            static Type Broadcast(uint16_t Value) { return Value; }
+            static Type Zero() { return 0; }
+
+            static Type Add(Type Left, Type Right) { return static_cast<Type>(Left + Right); }
+            static Type Sub(Type Left, Type Right) { return static_cast<Type>(Left - Right); }
+            static Type AddSaturate(Type Left, Type Right) { return Left + Right > 0xFFFF ? 0xFFFF : static_cast<Type>(Left + Right); }
+            static Type SubSaturate(Type Left, Type Right) { return Left > Right ? static_cast<Type>(Left - Right) : 0; }
+            static Type And(Type Left, Type Right) { return Left & Right; }
+            static Type AndNot(Type Left, Type Right) { return static_cast<Type>(~Left & Right); }
+            static Type Or(Type Left, Type Right) { return Left | Right; }
+            static Type Xor(Type Left, Type Right) { return Left ^ Right; }
+            static Type ShiftLeft(Type Value, int Count) { return static_cast<Type>(Value << Count); }
+            static Type ShiftRight(Type Value, int Count) { return static_cast<Type>(Value >> Count); }
+            static Type Equal(Type Left, Type Right) { return Left == Right ? 0xFFFF : 0; }
+            static Type Minimum(Type Left, Type Right) { return Left < Right ? Left : Right; }
+
+            static uint16_t HorizontalMinimum(Type Value) { return Value; }
+            static size_t CountSet(Type Mask) { return Mask ? 1 : 0; }
+        };
+    } // namespace
+
+    const BatchKernels& GetScalarBatchKernels()
+    {
+        return BatchKernelImplementation<ScalarVector>::Table;
+    }
+} // namespace lce::Emulator
@@ -0,0 +1,136 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+
+#include <cxxopts.hpp>
+
+#include "BatchRunner.h"
+#include "ErrorReporting.h"
+#include "WorkStealingThreadPool.h"
+
+using namespace lce::Emulator;
+
+static bool ReadManifest(const std::string& File, std::string& Contents)
+{
+    std::ifstream Input(File);
+    if (!Input.is_open())
+    {
+        lce::Common::ReportError(lce::Common::ErrorSeverity::Fatal, {}, "Cannot open manifest {} for reading", File.c_str());
+        return false;
+    }
+
+    std::stringstream Buffer;
+    Buffer << Input.rdbuf();
+    Contents = Buffer.str();
+    return true;
+}
+
+/*
+ * Prints one line per finished job: its index in the manifest, the ROM image and either the final state of the CPU
+ * (followed by the requested output bytes in hex) or the reason why the job could not be run
+ */
+static void PrintResult(size_t JobIndex, const BatchJob& Job, const BatchJobResult& Result)
+{
+    std::string Line = fmt::format("{}\t{}\t{}{}", JobIndex, Job.ROMPath.string(), Result.Succeeded ? "" : "error: ", Result.State);
+    if (!Result.Output.empty())
+    {
+        Line += '\t';
+        for (auto Byte : Result.Output)
+            Line += fmt::format("{:02x}", Byte);
+    }
+    Line += '\n';
+
+    std::fwrite(Line.data(), 1, Line.size(), stdout);
+    std::fflush(stdout);
+}
+
+int main(int ArgumentCount, char** Arguments)
+{
+    cxxopts::Options Options("lce-batch", "Runs every program listed in a manifest on its own Little Computer CPU");
+    Options.add_options()
+        ("manifest", "File with one job per line: a ROM image followed by an optional input file", cxxopts::value<std::string>())
+        ("t,threads", "Number of worker threads, 0 uses all host cores", cxxopts::value<size_t>()->default_value("0"))
+        ("pin-threads", "Pin every worker thread to its own core")
+        ("e,engine", "Execution engine: interpreter, threaded, blocks or jit", cxxopts::value<std::string>()->default_value("interpreter"))
+        ("start-address", "Address at which the programs start", cxxopts::value<uint16_t>()->default_value("0x7FF0"))
+        ("stack-address", "Initial value of the stack pointer", cxxopts::value<uint16_t>()->default_value("0x8000"))
+        ("input-address", "RAM address at which input files are loaded", cxxopts::value<uint16_t>()->default_value("0xA000"))
+        ("output-address", "Start of the RAM range that is printed after a program halts", cxxopts::value<uint16_t>()->default_value("0xA000"))
+        ("output-size", "Number of bytes to print after a program halts", cxxopts::value<uint16_t>()->default_value("0"))
+        ("max-cycles", "Stop programs that have not halted after this many cycles and report them as failed, 0 means no limit", cxxopts::value<uint64_t>()->default_value("0"))
+        ("h,help", "Print usage");
+    Options.parse_positional("manifest");
+
+    std::string ManifestFileName;
+    BatchJobOptions JobOptions;
+    size_t ThreadCount;
+    bool PinThreads;
+    try
+    {
+        auto Result = Options.parse(ArgumentCount, Arguments);
+        if (Result.count("help"))
+        {
+            std::cout << Options.help() << std::endl;
+            return 0;
+        }
+
+        ManifestFileName = Result["manifest"].as<std::string>();
+        ThreadCount = Result["threads"].as<size_t>();
+        PinThreads = Result["pin-threads"].as<bool>();
+        JobOptions.StartAddress = Result["start-address"].as<uint16_t>();
+        JobOptions.StackAddress = Result["stack-address"].as<uint16_t>();
+        JobOptions.InputAddress = Result["input-address"].as<uint16_t>();
+        JobOptions.OutputAddress = Result["output-address"].as<uint16_t>();
+        JobOptions.OutputSize = Result["output-size"].as<uint16_t>();
+        JobOptions.MaxCycles = Result["max-cycles"].as<uint64_t>();
+
+        auto EngineName = Result["engine"].as<std::string>();
+        if (!ParseExecutionEngine(EngineName, JobOptions.Engine))
+        {
+            std::cout << "Unknown execution engine " << EngineName << std::endl;
+            return 1;
+        }
+    }
+    catch (...)
+    {
+        std::cout << "No manifest provided" << std::endl;
+        std::cout << Options.help() << std::endl;
+        return 1;
+    }
+
+    std::string Manifest;
+    if (!ReadManifest(ManifestFileName, Manifest))
+        return 1;
+
+    std::vector<BatchJob> Jobs;
+    auto BaseDirectory = std::filesystem::path(ManifestFileName).parent_path();
+    if (!ParseBatchManifest(Manifest, ManifestFileName, BaseDirectory, Jobs))
+        return 1;
+
+    auto StartTime = std::chrono::steady_clock::now();
+
+    std::mutex OutputMutex;
+    std::atomic<size_t> FailedJobCount = 0;
+    std::atomic<uint64_t> InstructionCount = 0;
+    WorkStealingThreadPool Pool(ThreadCount, PinThreads);
+    Pool.Run(Jobs.size(), [&](size_t JobIndex, size_t)
+    {
+        auto Result = RunBatchJob(Jobs[JobIndex], JobOptions);
+        if (!Result.Succeeded)
+            FailedJobCount++;
+        InstructionCount += Result.Run.Instructions;
+
+        // NOTE: results are printed in the order in which the jobs finish, so that they can be consumed while the batch is still running
+        std::lock_guard Lock(OutputMutex);
+        PrintResult(JobIndex, Jobs[JobIndex], Result);
+    });
+
+    auto Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - StartTime).count();
+    std::cerr << fmt::format("Ran {} jobs on {} threads in {:.3f}s ({} instructions, {:.1f} MIPS), {} failed", Jobs.size(), Pool.GetThreadCount(), Seconds,
+                             InstructionCount.load(), InstructionCount.load() / Seconds / 1e6, FailedJobCount.load()) << std::endl;
+    return FailedJobCount > 0 ? 1 : 0;
+}
@@ -0,0 +1,120 @@
+#include "BatchRunner.h"
+
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include "ErrorReporting.h"
+#include "MappedFileMemoryBlock.h"
+#include "RandomAccessMemoryBlock.h"
+
+namespace lce::Emulator
+{
+    static constexpr uint16_t ROMAddress = 0x0000;
+    static constexpr uint16_t ROMSize = 0x8000;
+    static constexpr uint16_t RAMAddress = 0x8000;
+    static constexpr uint16_t RAMSize = 0x4000;
+
+    static bool ReadBinaryFile(const std::filesystem::path& Path, std::vector<uint8_t>& Bytes)
+    {
+        std::ifstream Input(Path, std::ios::binary);
+        if (!Input.is_open())
+            return false;
+
+        Bytes.assign(std::istreambuf_iterator<char>(Input), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    bool ParseBatchManifest(std::string_view Manifest, std::string_view FileName, const std::filesystem::path& BaseDirectory,
+                            std::vector<BatchJob>& Jobs)
+    {
+        std::istringstream Input{ std::string(Manifest) };
+        std::string Line;
+        size_t LineNumber = 0;
+        while (std::getline(Input, Line))
+        {
+            LineNumber++;
+
+            std::istringstream Fields(Line);
+            std::string ROMPath, InputPath, Extra;
+            if (!(Fields >> ROMPath) || ROMPath.starts_with('#'))
+                continue;
+            Fields >> InputPath;
+
+            if (Fields >> Extra)
+            {
+                Common::ReportError(Common::ErrorSeverity::Error, { FileName, 0, LineNumber, 1 }, "Unexpected '{}' after the input file of a job", Extra);
+                return false;
+            }
+
+            BatchJob Job;
+            Job.ROMPath = BaseDirectory / ROMPath;
+            if (!InputPath.empty())
+                Job.InputPath = BaseDirectory / InputPath;
+            Jobs.push_back(std::move(Job));
+        }
+        return true;
+    }
+
+    BatchJobResult RunBatchJob(const BatchJob& Job, const BatchJobOptions& Options)
+    {
+        BatchJobResult Result;
+
+        // NOTE: the image is mapped rather than read, so jobs that share a ROM also share its pages in host memory
+        std::error_code Error;
+        auto ROMImageSize = std::filesystem::file_size(Job.ROMPath, Error);
+        if (!Error && ROMImageSize > ROMSize)
+        {
+            Result.State = fmt::format("ROM image {} is larger than {} bytes", Job.ROMPath.string(), ROMSize);
+            return Result;
+        }
+        auto ROMImage = MappedFile::Open(Job.ROMPath, ROMSize);
+        if (Error || !ROMImage)
+        {
+            Result.State = fmt::format("cannot read ROM image {}", Job.ROMPath.string());
+            return Result;
+        }
+
+        std::vector<uint8_t> InputData;
+        if (!Job.InputPath.empty() && !ReadBinaryFile(Job.InputPath, InputData))
+        {
+            Result.State = fmt::format("cannot read input file {}", Job.InputPath.string());
+            return Result;
+        }
+        if (!InputData.empty() && (Options.InputAddress < RAMAddress || Options.InputAddress + InputData.size() > RAMAddress + RAMSize))
+        {
+            Result.State = fmt::format("input file {} does not fit into RAM at 0x{:X}", Job.InputPath.string(), Options.InputAddress);
+            return Result;
+        }
+
+        auto ROM = std::make_unique<MappedFileMemoryBlock>(std::move(ROMImage));
+
+        auto RAM = std::make_unique<RandomAccessMemoryBlock>(RAMSize);
+        auto* RAMPointer = RAM.get();
+        RAM->WriteRange(static_cast<uint16_t>(Options.InputAddress - RAMAddress), InputData);
+
+        CPU Processor(Options.Engine);
+        Processor.Reset();
+        Processor.AddMemoryBlock(std::move(ROM), ROMAddress);
+        Processor.AddMemoryBlock(std::move(RAM), RAMAddress);
+        Processor.SetRegister(Assembler::Register::RSP, Options.StackAddress);
+        Processor.SetIP(Options.StartAddress);
+        Result.Run = Processor.RunFor(Options.MaxCycles ? Options.MaxCycles : UINT64_MAX);
+
+        // NOTE: the state is still reported for programs that did not halt, since it usually shows where they got stuck
+        Result.Succeeded = Result.Run.Reason == StopReason::Halted;
+        Result.State = Processor.SerializeState();
+        if (Result.Run.Reason == StopReason::CycleLimit)
+            Result.State = fmt::format("no hlt within {} cycles, {}", Options.MaxCycles, Result.State);
+        else if (Result.Run.Reason == StopReason::Fault)
+            Result.State = fmt::format("invalid instruction at 0x{:X}, {}", Processor.GetIP(), Result.State);
+        else if (!Result.Succeeded)
+            Result.State = fmt::format("stopped at a {}, {}", GetStopReasonName(Result.Run.Reason), Result.State);
+        for (uint32_t Address = Options.OutputAddress; Address < Options.OutputAddress + Options.OutputSize; Address++)
+        {
+            bool IsInRAM = Address >= RAMAddress && Address < RAMAddress + RAMSize;
+            Result.Output.push_back(IsInRAM ? RAMPointer->Read(static_cast<uint16_t>(Address - RAMAddress)) : 0);
+        }
+        return Result;
+    }
+} // namespace lce::Emulator
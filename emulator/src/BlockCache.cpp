@@ -0,0 +1,74 @@
+#include "BlockCache.h"
+
+#include <algorithm>
+
+namespace lce::Emulator
+{
+    TranslatedBlock& BlockCache::Insert(std::unique_ptr<TranslatedBlock> Block)
+    {
+        auto& Page = m_Entries[Block->StartAddress >> PageShift];
+        if (!Page)
+            Page = std::make_unique<std::array<std::unique_ptr<TranslatedBlock>, PageSize>>();
+
+        auto& Entry = (*Page)[Block->StartAddress & PageMask];
+        if (Entry)
+            InvalidateBlocksContaining(Entry->StartAddress);
+
+        // NOTE: blocks never wrap around the end of the address space, so the page range is always increasing
+        for (size_t PageIndex = Block->StartAddress >> PageShift; PageIndex <= static_cast<size_t>(Block->EndAddress - 1) >> PageShift; PageIndex++)
+        {
+            m_BlocksByPage[PageIndex].push_back(Block.get());
+            m_CodePages.set(PageIndex);
+        }
+
+        Entry = std::move(Block);
+        return *Entry;
+    }
+
+    void BlockCache::Clear()
+    {
+        for (auto& Page : m_Entries)
+        {
+            if (!Page)
+                continue;
+
+            // Blocks can be cleared while one of them is executing, so they are released later
+            for (auto& Entry : *Page)
+            {
+                if (Entry)
+                {
+                    Entry->IsValid = false;
+                    m_InvalidatedBlocks.push_back(std::move(Entry));
+                }
+            }
+            Page.reset();
+        }
+
+        for (auto& Blocks : m_BlocksByPage)
+            Blocks.clear();
+        m_CodePages.reset();
+    }
+
+    void BlockCache::InvalidateBlocksContaining(uint16_t Address)
+    {
+        auto& Blocks = m_BlocksByPage[Address >> PageShift];
+        size_t Index = 0;
+        while (Index < Blocks.size())
+        {
+            auto* Block = Blocks[Index];
+            if (Address < Block->StartAddress || Address >= Block->EndAddress)
+            {
+                Index++;
+                continue;
+            }
+
+            Block->IsValid = false;
+
+            for (size_t PageIndex = Block->StartAddress >> PageShift; PageIndex <= static_cast<size_t>(Block->EndAddress - 1) >> PageShift; PageIndex++)
+                std::erase(m_BlocksByPage[PageIndex], Block);
+
+            auto& Entry = (*m_Entries[Block->StartAddress >> PageShift])[Block->StartAddress & PageMask];
+            m_InvalidatedBlocks.push_back(std::move(Entry));
+        }
+    }
+} // namespace lce::Emulator
@@ -1,98 +1,298 @@
 #include "CPU.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <iterator>
+#include <optional>
 
 #include "ErrorReporting.h"
+#include "ExecutionProfiler.h"
+#include "ExecutionTracer.h"
+#include "InputLog.h"
 #include "Instruction.h"
-
-#define TODO()                                                                                     \
-    do                                                                                             \
-    {                                                                                              \
-        Common::ReportError(Common::ErrorSeverity::Fatal, { __FILE__, 0, __LINE__, 1 }, "TODO()"); \
-        assert(false);                                                                             \
-    } while (0);
+#include "InstructionDecoder.h"
+#include "JITCompiler.h"
 
 namespace lce::Emulator
 {
-    static constexpr uint8_t EncodedNOP = 0x54;
+    bool ParseExecutionEngine(std::string_view Name, ExecutionEngine& Engine)
+    {
+        if (Name == "interpreter")
+            Engine = ExecutionEngine::Interpreter;
+        else if (Name == "threaded")
+            Engine = ExecutionEngine::Threaded;
+        else if (Name == "blocks")
+            Engine = ExecutionEngine::BasicBlocks;
+        else if (Name == "jit")
+            Engine = ExecutionEngine::JIT;
+        else
+            return false;
+        return true;
+    }
+
+    const char* GetStopReasonName(StopReason Reason)
+    {
+        switch (Reason)
+        {
+        case StopReason::Halted:
+            return "halted";
+        case StopReason::CycleLimit:
+            return "cycle limit";
+        case StopReason::Breakpoint:
+            return "breakpoint";
+        case StopReason::Watchpoint:
+            return "watchpoint";
+        case StopReason::Fault:
+            return "fault";
+        }
+        return "unknown";
+    }
 
-    enum class OperandType
+    // Cycle count after running for Cycles more cycles, saturated so that UINT64_MAX means no limit
+    static uint64_t AddCycles(uint64_t CycleCount, uint64_t Cycles)
     {
-        Register = 0b00,
-        OneByteImmediate = 0b10,
-        TwoByteImmediate = 0b11
-    };
+        return Cycles > UINT64_MAX - CycleCount ? UINT64_MAX : CycleCount + Cycles;
+    }
 
-    static Assembler::Opcode ExtractOpcode(uint8_t FirstByte)
+    CPU::CPU(ExecutionEngine Engine)
+        : m_Engine(Engine)
     {
-        return static_cast<Assembler::Opcode>((FirstByte >> 2) & 0x1F);
     }
 
-    static OperandType ExtractFirstOperandType(uint8_t FirstByte)
+    CPU::~CPU() = default;
+
+    void CPU::Reset()
     {
-        return static_cast<OperandType>(FirstByte & 0x03);
+        CPUCore::Reset();
+        m_IsAtWatchpoint = false;
+
+        // NOTE: devices count time relative to the cycle count, so they have to start over together with it
+        m_DeviceEvents.Clear();
+        for (auto* Bus : m_DeviceBuses)
+            Bus->Attach(*this);
     }
 
-    static OperandType ExtractSecondOperandType(uint8_t SecondByte)
+    void CPU::Run(uint16_t StartAddress)
     {
-        return static_cast<OperandType>(SecondByte >> 6);
+        m_IP = StartAddress;
+        RunUntilCycle(UINT64_MAX);
     }
 
-    static Assembler::Register ExtractFirstRegister(uint8_t SecondByte)
+    PacingStatistics CPU::RunRealTime(uint16_t StartAddress, const PacingOptions& Options)
     {
-        return static_cast<Assembler::Register>((SecondByte >> 3) & 0x07);
+        m_IP = StartAddress;
+
+        RealTimePacer Pacer(Options);
+        Pacer.Start();
+
+        auto StartCycle = m_CycleCount;
+        auto SliceCycles = std::max<uint64_t>(Options.SliceCycles, 1);
+        do
+        {
+            RunUntilCycle(m_CycleCount + SliceCycles);
+            Pacer.WaitForCycle(m_CycleCount - StartCycle);
+        } while (!m_IsHalted && !m_IsAtBreakpoint && !m_IsAtWatchpoint);
+
+        return Pacer.GetStatistics();
     }
 
-    static Assembler::Register ExtractSecondRegister(uint8_t SecondByte)
+    RunResult CPU::RunFor(uint64_t MaxCycles)
     {
-        return static_cast<Assembler::Register>(SecondByte & 0x07);
+        auto StartTime = std::chrono::steady_clock::now();
+        auto StartCycle = m_CycleCount;
+
+        RunUntilCycle(AddCycles(m_CycleCount, MaxCycles));
+
+        RunResult Result;
+        Result.Reason = GetStopReason();
+        Result.Instructions = m_CycleCount - StartCycle;
+        Result.WallTime = std::chrono::steady_clock::now() - StartTime;
+        return Result;
     }
 
-    void CPU::Reset()
+    RunResult CPU::RunUntil(uint16_t Address, uint64_t MaxCycles)
     {
-        for (auto& Register : m_Registers)
-            Register = 0;
+        return StepUntil([&]() { return m_IP == Address; }, MaxCycles);
     }
 
-    void CPU::ExecuteSingleInstruction(std::span<uint8_t> Bytes)
+    RunResult CPU::RunUntil(const std::function<bool(const CPU&)>& Predicate, uint64_t MaxCycles)
     {
-        assert(Bytes.size() > 0);
+        return StepUntil([&]() { return Predicate(*this); }, MaxCycles);
+    }
+
+    template <typename ConditionType>
+    RunResult CPU::StepUntil(const ConditionType& Condition, uint64_t MaxCycles)
+    {
+        auto StartTime = std::chrono::steady_clock::now();
+        auto StartCycle = m_CycleCount;
+        auto CycleLimit = AddCycles(m_CycleCount, MaxCycles);
 
-        auto Opcode = ExtractOpcode(Bytes[0]);
-        switch (Opcode)
+        RunResult Result;
+        Result.Reason = StopReason::CycleLimit;
+        m_IsAtWatchpoint = false;
+        bool IsFirstInstruction = true;
+        while (!m_IsHalted && m_CycleCount < CycleLimit)
         {
-        case Assembler::Opcode::Mov:
-            ExecuteMov(Bytes.data(), Bytes.data() + Bytes.size_bytes());
-            break;
-        default:
-            TODO();
+            if (IsFirstInstruction && m_IsAtBreakpoint)
+                StepOverBreakpoint();
+            else if (m_Tracer || m_Profiler)
+                ExecuteInstrumentedInstruction(FetchInstruction(m_IP));
+            else
+                ExecuteDecodedInstruction(FetchInstruction(m_IP));
+            IsFirstInstruction = false;
+
+            if (m_CycleCount >= m_DeviceEvents.GetNextEventCycle())
+                m_DeviceEvents.DispatchEvents(m_CycleCount);
+            if (m_IsAtBreakpoint || m_IsAtWatchpoint || (!m_IsHalted && Condition()))
+            {
+                Result.Reason = m_IsAtWatchpoint ? StopReason::Watchpoint : StopReason::Breakpoint;
+                break;
+            }
         }
+
+        if (m_IsHalted)
+            Result.Reason = GetStopReason();
+        Result.Instructions = m_CycleCount - StartCycle;
+        Result.WallTime = std::chrono::steady_clock::now() - StartTime;
+        return Result;
     }
 
-    void CPU::Run(uint16_t StartAddress)
+    StopReason CPU::GetStopReason() const
     {
-        m_IP = StartAddress;
+        if (m_IsAtBreakpoint)
+            return StopReason::Breakpoint;
+        if (m_IsAtWatchpoint)
+            return StopReason::Watchpoint;
+        if (m_IsHalted)
+            return m_HasFaulted ? StopReason::Fault : StopReason::Halted;
+        return StopReason::CycleLimit;
+    }
+
+    uint64_t CPU::GetRetiredInstructionCount() const
+    {
+        return m_CycleCount;
+    }
+
+    void CPU::RunUntilCycle(uint64_t CycleLimit)
+    {
+        m_IsAtWatchpoint = false;
+        if (m_CycleCount < CycleLimit)
+            StepOverBreakpoint();
+
+        while (!m_IsHalted && !m_IsAtBreakpoint && !m_IsAtWatchpoint && m_CycleCount < CycleLimit)
+        {
+            // NOTE: the engines only have to stop for device events, devices catch up on their own when they are accessed
+            m_CycleLimit = std::min(CycleLimit, m_DeviceEvents.GetNextEventCycle());
+
+            // NOTE: checked once per run rather than per instruction, so the engines cost nothing extra while instrumentation is off
+            if (m_Tracer || m_Profiler)
+            {
+                RunInstrumented();
+            }
+            else
+            {
+                /*
+                 * NOTE: a watchpoint has to stop the CPU right after the access, which the block engines can not do,
+                 * and while accesses are counted they could not translate anything but would still fetch every instruction
+                 */
+                auto Engine = m_Engine;
+                if ((!m_Watchpoints.empty() || m_IsCountingAccesses) && (Engine == ExecutionEngine::BasicBlocks || Engine == ExecutionEngine::JIT))
+                    Engine = ExecutionEngine::Threaded;
+
+                switch (Engine)
+                {
+                case ExecutionEngine::Interpreter:
+                    RunInterpreter();
+                    break;
+                case ExecutionEngine::Threaded:
+                    RunThreaded();
+                    break;
+                case ExecutionEngine::BasicBlocks:
+                    RunBasicBlocks();
+                    break;
+                case ExecutionEngine::JIT:
+                    RunJIT();
+                    break;
+                }
+            }
+
+            m_DeviceEvents.DispatchEvents(m_CycleCount);
+        }
+    }
+
+    void CPU::StepOverBreakpoint()
+    {
+        if (!m_IsAtBreakpoint)
+            return;
+        m_IsAtBreakpoint = false;
+
+        // NOTE: the decoded instruction at IP is the breakpoint itself, so the real one is decoded again and executed on its own
+        uint8_t Bytes[MaxInstructionLength];
+        FetchInstructionBytes(m_IP, Bytes, [this](uint16_t Address) { return ReadByteOr(Address, EncodedNOP); });
+        auto Instruction = DecodeInstruction(Bytes);
+        if (m_Tracer || m_Profiler)
+            ExecuteInstrumentedInstruction(Instruction);
+        else
+            ExecuteDecodedInstruction(Instruction);
+
+        if (m_CycleCount >= m_DeviceEvents.GetNextEventCycle())
+            m_DeviceEvents.DispatchEvents(m_CycleCount);
+    }
+
+    void CPU::ScheduleDeviceEvent(DeviceBus& Bus, size_t DeviceIndex, uint64_t Cycle)
+    {
+        m_DeviceEvents.Schedule(Bus, DeviceIndex, Cycle);
 
-        while (!m_IsHalted)
+        // NOTE: the event can be earlier than the limit that the running engine is working towards
+        if (Cycle < m_CycleLimit)
         {
-            // NOTE: instructions are at most 4 bytes, so we can fetch 4 bytes or fewer and pass them to the instruction handler
-            uint8_t Bytes[4] = { ReadByteOr(m_IP, EncodedNOP), ReadByteOr(m_IP + 1, EncodedNOP), ReadByteOr(m_IP + 2, EncodedNOP), ReadByteOr(m_IP + 3, EncodedNOP) };
-            ExecuteSingleInstruction(Bytes);
+            m_CycleLimit = Cycle;
+            if (m_JIT)
+                m_JIT->LowerCycleLimit(Cycle);
         }
     }
 
+    uint8_t CPU::ReplayInput(uint16_t AbsoluteAddress)
+    {
+        uint8_t Value = 0;
+        if (m_InputLog->Replay(AbsoluteAddress, Value))
+            return Value;
+
+        if (!m_HasFaulted)
+            Common::ReportError(Common::ErrorSeverity::Error, { __FILE__, 0, __LINE__, 0 }, "Replay diverged from the input log when reading from 0x{0:X} at cycle {1}", AbsoluteAddress, m_CycleCount);
+
+        m_IsHalted = true;
+        m_HasFaulted = true;
+        m_CycleLimit = m_CycleCount;
+        if (m_JIT)
+            m_JIT->LowerCycleLimit(m_CycleCount);
+        return 0;
+    }
+
     bool CPU::AddMemoryBlock(std::unique_ptr<MemoryBlock> NewBlock, uint16_t StartAddress)
     {
+        if (NewBlock->Size() == 0)
+        {
+            Common::ReportError(Common::ErrorSeverity::Fatal, { __FILE__, 0, __LINE__, 1 }, "Cannot add memory block without any bytes");
+            return false;
+        }
+
         // Check that there is no overlap with existing memory blocks
-        auto EndAddress = StartAddress + NewBlock->Size() - 1; // Last byte that belongs to current memory block
+        size_t EndAddress = static_cast<size_t>(StartAddress) + NewBlock->Size() - 1; // Last byte that belongs to current memory block
+        if (EndAddress >= AddressSpaceSize)
+        {
+            Common::ReportError(Common::ErrorSeverity::Fatal, { __FILE__, 0, __LINE__, 1 }, "Cannot add memory block that does not fit into the address space");
+            return false;
+        }
+
         for (const auto& Block : m_MemoryBlocks)
         {
-            auto CurrentBlockStartAddress = Block.first;
-            auto CurrentBlockEndAddress = CurrentBlockStartAddress + Block.second->Size() - 1;
+            // NOTE: blocks without any bytes are never added, so the end address can not underflow
+            size_t CurrentBlockStartAddress = Block.first;
+            size_t CurrentBlockEndAddress = CurrentBlockStartAddress + Block.second->Size() - 1;
 
-            if (StartAddress >= CurrentBlockStartAddress && StartAddress <= CurrentBlockEndAddress ||
-                EndAddress   >= CurrentBlockStartAddress && EndAddress   <= CurrentBlockEndAddress)
+            if (StartAddress <= CurrentBlockEndAddress && EndAddress >= CurrentBlockStartAddress)
             {
                 Common::ReportError(Common::ErrorSeverity::Fatal, { __FILE__, 0, __LINE__, 1 }, "Cannot add memory block that overlaps existing ones");
                 return false;
@@ -100,34 +300,366 @@ namespace lce::Emulator
         }
 
         m_MemoryBlocks.emplace_back(StartAddress, std::move(NewBlock));
+        MapMemoryBlockPages(m_MemoryBlocks.size() - 1);
+        if (m_JIT)
+            m_JIT->SyncMemoryMap();
+        if (m_IsCountingAccesses)
+            m_AccessCounts.resize(m_MemoryBlocks.size());
+        return true;
+    }
+
+    bool CPU::AddDeviceBus(std::unique_ptr<DeviceBus> Bus, uint16_t StartAddress)
+    {
+        auto* BusPointer = Bus.get();
+        if (!AddMemoryBlock(std::move(Bus), StartAddress))
+            return false;
+
+        m_DeviceBuses.push_back(BusPointer);
+        BusPointer->m_StartAddress = StartAddress;
+        BusPointer->Attach(*this);
+        return true;
+    }
+
+    bool CPU::IsMapped(uint16_t Address, size_t Size) const
+    {
+        if (Address + Size > AddressSpaceSize)
+            return false;
+
+        uint16_t StartAddress;
+        for (size_t Offset = 0; Offset < Size; Offset++)
+        {
+            if (!FindMemoryBlock(static_cast<uint16_t>(Address + Offset), StartAddress))
+                return false;
+        }
+        return true;
+    }
+
+    bool CPU::ReadMemory(uint16_t Address, std::span<uint8_t> Bytes) const
+    {
+        if (!IsMapped(Address, Bytes.size()))
+            return false;
+
+        for (size_t Offset = 0; Offset < Bytes.size(); Offset++)
+            Bytes[Offset] = ReadByte(static_cast<uint16_t>(Address + Offset));
+        return true;
+    }
+
+    bool CPU::WriteMemory(uint16_t Address, std::span<const uint8_t> Bytes)
+    {
+        if (!IsMapped(Address, Bytes.size()))
+            return false;
+
+        for (size_t Offset = 0; Offset < Bytes.size(); Offset++)
+            WriteByte(static_cast<uint16_t>(Address + Offset), Bytes[Offset]);
+        return true;
+    }
+
+    void CPU::CountMemoryAccesses(bool Enable)
+    {
+        m_IsCountingAccesses = Enable;
+        m_AccessCounts.assign(Enable ? m_MemoryBlocks.size() : 0, {});
+
+        // NOTE: cached instructions would not be fetched again, and host memory would bypass the blocks
+        InvalidateInstructionCache();
+    }
+
+    const std::vector<MemoryAccessCounts>& CPU::GetMemoryAccessCounts() const
+    {
+        return m_AccessCounts;
+    }
+
+    void CPU::OnBreakpointChanged(uint16_t Address)
+    {
+        // NOTE: the breakpoint only takes effect once the instruction is decoded again, just like after a write to it
+        m_InstructionCache.OnMemoryWrite(Address);
+        m_BlockCache.OnMemoryWrite(Address);
+        if (m_JIT)
+            m_JIT->OnBreakpointChanged(Address);
+    }
+
+    bool CPU::HasNativeCode(uint16_t Address) const
+    {
+        return m_JIT && m_JIT->HasNativeCode(Address);
+    }
+
+    bool CPU::AddWatchpoint(const Watchpoint& NewWatchpoint)
+    {
+        if (NewWatchpoint.Size == 0 || (NewWatchpoint.Value && NewWatchpoint.Size > 2))
+        {
+            Common::ReportError(Common::ErrorSeverity::Error, { __FILE__, 0, __LINE__, 0 }, "Cannot watch {} bytes at 0x{:X}{}", NewWatchpoint.Size,
+                                NewWatchpoint.Address, NewWatchpoint.Value ? " for a value" : "");
+            return false;
+        }
+
+        m_Watchpoints.push_back(NewWatchpoint);
+        UpdateWatchedPages();
+        return true;
+    }
+
+    bool CPU::RemoveWatchpoint(const Watchpoint& OldWatchpoint)
+    {
+        auto Iterator = std::find(m_Watchpoints.begin(), m_Watchpoints.end(), OldWatchpoint);
+        if (Iterator == m_Watchpoints.end())
+            return false;
+
+        m_Watchpoints.erase(Iterator);
+        UpdateWatchedPages();
+        return true;
+    }
+
+    bool CPU::GetWatchpointHit(WatchpointHit& Hit) const
+    {
+        if (!m_IsAtWatchpoint)
+            return false;
+        Hit = m_WatchpointHit;
+        return true;
+    }
+
+    void CPU::UpdateWatchedPages()
+    {
+        m_ReadWatchedPages.reset();
+        m_WriteWatchedPages.reset();
+        for (const auto& Watchpoint : m_Watchpoints)
+        {
+            // NOTE: starts one byte early, since a word that starts right before the range reaches into it
+            for (uint32_t Offset = 0; Offset <= Watchpoint.Size; Offset++)
+            {
+                auto PageIndex = static_cast<uint16_t>(Watchpoint.Address - 1 + Offset) >> PageShift;
+                if (Watchpoint.Kind != WatchpointKind::Write)
+                    m_ReadWatchedPages.set(PageIndex);
+                if (Watchpoint.Kind != WatchpointKind::Read)
+                    m_WriteWatchedPages.set(PageIndex);
+            }
+        }
+    }
+
+    void CPU::CheckWatchpoints(uint16_t AbsoluteAddress, uint16_t Value, bool IsWrite)
+    {
+        // NOTE: an instruction that hits several watchpoints reports the first one
+        if (m_IsAtWatchpoint)
+            return;
+
+        for (const auto& Watchpoint : m_Watchpoints)
+        {
+            if (Watchpoint.Kind == (IsWrite ? WatchpointKind::Read : WatchpointKind::Write))
+                continue;
+
+            bool IsTouched = false;
+            bool HasValue = true;
+            uint16_t FirstTouchedAddress = 0;
+            for (uint16_t ByteIndex = 0; ByteIndex < 2; ByteIndex++)
+            {
+                auto ByteAddress = static_cast<uint16_t>(AbsoluteAddress + ByteIndex);
+                auto Offset = static_cast<uint16_t>(ByteAddress - Watchpoint.Address);
+                if (Offset >= Watchpoint.Size)
+                    continue;
+
+                if (!IsTouched)
+                    FirstTouchedAddress = ByteAddress;
+                IsTouched = true;
+
+                // Only the bytes of the access that belong to the range are compared with the value
+                auto Byte = static_cast<uint8_t>(Value >> (8 * ByteIndex));
+                if (Watchpoint.Value && Byte != static_cast<uint8_t>(*Watchpoint.Value >> (8 * Offset)))
+                    HasValue = false;
+            }
+            if (!IsTouched || !HasValue)
+                continue;
+
+            m_IsAtWatchpoint = true;
+            m_WatchpointHit = { Watchpoint, FirstTouchedAddress, AbsoluteAddress, Value, IsWrite };
+
+            // The access happens in the middle of an instruction, which is finished before the engine stops
+            m_CycleLimit = m_CycleCount;
+            if (m_JIT)
+                m_JIT->LowerCycleLimit(m_CycleCount);
+            return;
+        }
+    }
+
+    void CPU::SetTracer(ExecutionTracer* Tracer)
+    {
+        m_Tracer = Tracer;
+    }
+
+    void CPU::SetProfiler(ExecutionProfiler* Profiler)
+    {
+        m_Profiler = Profiler;
+    }
+
+    void CPU::RecordInputs(InputLog* Log)
+    {
+        ReplayInputs(nullptr);
+        m_InputLog = Log;
+    }
+
+    void CPU::ReplayInputs(InputLog* Log)
+    {
+        bool WasReplaying = m_IsReplayingInputs;
+        m_InputLog = Log;
+        m_IsReplayingInputs = Log != nullptr;
+        if (WasReplaying == m_IsReplayingInputs)
+            return;
+
+        // NOTE: devices do not see the time that passes during a replay, and their events are not needed meanwhile
+        m_DeviceEvents.Clear();
+        for (auto* Bus : m_DeviceBuses)
+            Bus->Attach(*this);
+    }
+
+    void CPU::InvalidateInstructionCache()
+    {
+        m_InstructionCache.Clear();
+        m_BlockCache.Clear();
+        if (m_JIT)
+            m_JIT->Flush();
+
+        // NOTE: writes made by the host can also have given blocks private copies of pages that were shared
+        UpdateAllHostMemory();
+    }
+
+    bool CPU::Snapshot(CPUSnapshot& Snapshot)
+    {
+        Snapshot.IP = m_IP;
+        MaterializeFlags();
+        std::copy(std::begin(m_Registers), std::end(m_Registers), Snapshot.Registers.begin());
+        Snapshot.IsHalted = m_IsHalted;
+        Snapshot.HasFaulted = m_HasFaulted;
+        Snapshot.CycleCount = m_CycleCount;
+
+        Snapshot.MemoryBlocks.clear();
+        for (const auto& [StartAddress, Block] : m_MemoryBlocks)
+        {
+            std::shared_ptr<const MemoryBlock> Copy = Block->Clone();
+            if (!Copy)
+            {
+                Common::ReportError(Common::ErrorSeverity::Error, { __FILE__, 0, __LINE__, 0 }, "Memory block at 0x{0:X} cannot be copied into a snapshot", StartAddress);
+                return false;
+            }
+            Snapshot.MemoryBlocks.emplace_back(StartAddress, std::move(Copy));
+        }
+
+        // NOTE: all pages of plain memory are now shared with the snapshot, so the next write to each of them has to copy it
+        UpdateAllHostMemory();
         return true;
     }
 
-    uint16_t CPU::GetRegister(Assembler::Register Register) const
+    void CPU::Restore(const CPUSnapshot& Snapshot)
     {
-        return m_Registers[static_cast<RegisterIndexUnderlyingType>(Register)];
+        m_IP = Snapshot.IP;
+        std::copy(Snapshot.Registers.begin(), Snapshot.Registers.end(), std::begin(m_Registers));
+        m_FlagOperation = FlagOperation::None;
+        m_IsHalted = Snapshot.IsHalted;
+        m_HasFaulted = Snapshot.HasFaulted;
+        m_IsAtBreakpoint = false;
+        m_IsAtWatchpoint = false;
+        m_CycleCount = Snapshot.CycleCount;
+
+        // NOTE: device buses can not be copied into snapshots, so none of them survive this
+        m_DeviceBuses.clear();
+        m_DeviceEvents.Clear();
+
+        m_MemoryBlocks.clear();
+        for (auto& Page : m_Pages)
+            Page = MemoryPage();
+        for (const auto& [StartAddress, Block] : Snapshot.MemoryBlocks)
+        {
+            m_MemoryBlocks.emplace_back(StartAddress, Block->Clone());
+            MapMemoryBlockPages(m_MemoryBlocks.size() - 1);
+        }
+        if (m_IsCountingAccesses)
+            m_AccessCounts.assign(m_MemoryBlocks.size(), {});
+
+        InvalidateInstructionCache();
     }
 
-    void CPU::SetRegister(Assembler::Register Register, uint16_t Value)
+    std::unique_ptr<CPU> CPU::Fork()
     {
-        m_Registers[static_cast<RegisterIndexUnderlyingType>(Register)] = Value;
+        CPUSnapshot State;
+        if (!Snapshot(State))
+            return nullptr;
+
+        auto Child = std::make_unique<CPU>(m_Engine);
+        Child->Restore(State);
+        return Child;
     }
 
-    std::string CPU::SerializeState() const
+    void CPU::MapMemoryBlockPages(size_t BlockIndex)
     {
-        return fmt::format("ip: {:#06x}; r1: {:#06x}; r2: {:#06x}; r3: {:#06x}; rsp: {:#06x}; rfl: {:#06x}; halted: {}",
-                           m_IP, ReadRegister(Assembler::Register::R0), ReadRegister(Assembler::Register::R1),
-                           ReadRegister(Assembler::Register::R2), ReadRegister(Assembler::Register::R3),
-                           ReadRegister(Assembler::Register::RSP), ReadRegister(Assembler::Register::RFL),
-                           m_IsHalted ? "true" : "false");
+        auto& [StartAddress, Block] = m_MemoryBlocks[BlockIndex];
+        if (Block->Size() == 0)
+            return;
+
+        size_t EndAddress = StartAddress + Block->Size(); // One past the last byte of the block
+
+        for (size_t PageIndex = StartAddress >> PageShift; PageIndex <= ((EndAddress - 1) >> PageShift); PageIndex++)
+        {
+            auto& Page = m_Pages[PageIndex];
+            size_t PageStartAddress = PageIndex << PageShift;
+            size_t PageEndAddress = PageStartAddress + PageSize;
+
+            bool CoversWholePage = StartAddress <= PageStartAddress && EndAddress >= PageEndAddress;
+            if (CoversWholePage && !Page.Block && !Page.BlockIndices)
+            {
+                Page.Block = Block.get();
+                Page.BlockStartAddress = StartAddress;
+                Page.BlockIndex = static_cast<uint16_t>(BlockIndex);
+                UpdateHostMemory(Page, PageStartAddress);
+                continue;
+            }
+
+            // The page is shared between several blocks, so we have to fall back to per-byte mapping
+            if (!Page.BlockIndices)
+                Page.BlockIndices = std::make_unique<std::array<uint16_t, PageSize>>();
+
+            auto FirstByte = std::max<size_t>(StartAddress, PageStartAddress) - PageStartAddress;
+            auto LastByte = std::min<size_t>(EndAddress, PageEndAddress) - PageStartAddress;
+            for (auto Offset = FirstByte; Offset < LastByte; Offset++)
+                (*Page.BlockIndices)[Offset] = static_cast<uint16_t>(BlockIndex + 1);
+        }
+    }
+
+    void CPU::UpdateHostMemory(MemoryPage& Page, size_t PageStartAddress)
+    {
+        // NOTE: host memory of a block can only be used if its pages line up with the pages of the address space
+        auto RelativeAddress = static_cast<uint16_t>(PageStartAddress - Page.BlockStartAddress);
+        if (!Page.Block || RelativeAddress % MemoryBlock::DirectPageSize != 0)
+            return;
+
+        if (m_IsCountingAccesses)
+        {
+            Page.HostMemory = nullptr;
+            Page.WritableHostMemory = nullptr;
+            return;
+        }
+
+        Page.HostMemory = Page.Block->DirectPointer(RelativeAddress);
+        Page.WritableHostMemory = Page.Block->DirectWritePointer(RelativeAddress);
+    }
+
+    void CPU::UpdateAllHostMemory()
+    {
+        for (size_t PageIndex = 0; PageIndex < PageCount; PageIndex++)
+            UpdateHostMemory(m_Pages[PageIndex], PageIndex << PageShift);
+        if (m_JIT)
+            m_JIT->SyncMemoryMap();
     }
 
     MemoryBlock* CPU::FindMemoryBlock(uint16_t AbsoluteAddress, uint16_t& StartAddress) const
     {
-        for (const auto& Block : m_MemoryBlocks)
+        const auto& Page = m_Pages[AbsoluteAddress >> PageShift];
+        if (Page.Block)
         {
-            if (Block.first <= AbsoluteAddress && Block.first + Block.second->Size() > AbsoluteAddress)
+            StartAddress = Page.BlockStartAddress;
+            return Page.Block;
+        }
+
+        if (Page.BlockIndices)
+        {
+            auto BlockIndex = (*Page.BlockIndices)[AbsoluteAddress & PageMask];
+            if (BlockIndex > 0)
             {
+                const auto& Block = m_MemoryBlocks[BlockIndex - 1];
                 StartAddress = Block.first;
                 return Block.second.get();
             }
@@ -138,6 +670,10 @@ namespace lce::Emulator
 
     uint8_t CPU::ReadByte(uint16_t AbsoluteAddress) const
     {
+        const auto& Page = m_Pages[AbsoluteAddress >> PageShift];
+        if (Page.HostMemory)
+            return Page.HostMemory[AbsoluteAddress & PageMask];
+
         uint16_t StartAddress;
         auto* Block = FindMemoryBlock(AbsoluteAddress, StartAddress);
 
@@ -147,21 +683,47 @@ namespace lce::Emulator
             return 0;
         }
 
+        if (m_IsCountingAccesses)
+            CountAccess(AbsoluteAddress, 1, false);
         return Block->Read(AbsoluteAddress - StartAddress);
     }
 
     uint8_t CPU::ReadByteOr(uint16_t AbsoluteAddress, uint8_t Fallback) const
     {
+        const auto& Page = m_Pages[AbsoluteAddress >> PageShift];
+        if (Page.HostMemory)
+            return Page.HostMemory[AbsoluteAddress & PageMask];
+
         uint16_t StartAddress;
         auto* Block = FindMemoryBlock(AbsoluteAddress, StartAddress);
 
-        if (Block)
-            return Block->Read(AbsoluteAddress - StartAddress);
-        return Fallback;
+        if (!Block)
+            return Fallback;
+
+        if (m_IsCountingAccesses)
+            CountAccess(AbsoluteAddress, 1, false);
+        return Block->Read(AbsoluteAddress - StartAddress);
     }
 
-    uint16_t CPU::ReadWord(uint16_t AbsoluteAddress) const
+    uint16_t CPU::LoadWord(uint16_t AbsoluteAddress) const
     {
+        // NOTE: the two bytes of a word that crosses a page boundary can belong to different blocks
+        if ((AbsoluteAddress & PageMask) != PageMask)
+        {
+            const auto& Page = m_Pages[AbsoluteAddress >> PageShift];
+            if (Page.HostMemory)
+            {
+                const auto* Bytes = Page.HostMemory + (AbsoluteAddress & PageMask);
+                return Bytes[0] | (Bytes[1] << 8);
+            }
+            if (Page.Block)
+            {
+                if (m_IsCountingAccesses)
+                    CountAccess(AbsoluteAddress, 2, false);
+                return Page.Block->ReadWord(AbsoluteAddress - Page.BlockStartAddress);
+            }
+        }
+
         auto Low = ReadByte(AbsoluteAddress);
         auto High = ReadByte(AbsoluteAddress + 1);
 
@@ -171,6 +733,26 @@ namespace lce::Emulator
 
     void CPU::WriteByte(uint16_t AbsoluteAddress, uint8_t Value)
     {
+        OnMemoryWrite(AbsoluteAddress);
+
+        auto& Page = m_Pages[AbsoluteAddress >> PageShift];
+        if (Page.WritableHostMemory)
+        {
+            Page.WritableHostMemory[AbsoluteAddress & PageMask] = Value;
+            return;
+        }
+
+        // The memory can not be written in place (e.g. because it is shared with a snapshot or a forked CPU), so the
+        // block has to handle the write, which can move the page to a different place in host memory
+        if (Page.HostMemory)
+        {
+            Page.Block->Write(AbsoluteAddress - Page.BlockStartAddress, Value);
+            UpdateHostMemory(Page, AbsoluteAddress & ~PageMask);
+            if (m_JIT)
+                m_JIT->SyncMemoryMap();
+            return;
+        }
+
         uint16_t StartAddress;
         auto* Block = FindMemoryBlock(AbsoluteAddress, StartAddress);
 
@@ -180,11 +762,37 @@ namespace lce::Emulator
             return;
         }
 
+        if (m_IsCountingAccesses)
+            CountAccess(AbsoluteAddress, 1, true);
         Block->Write(AbsoluteAddress - StartAddress, Value);
     }
 
-    void CPU::WriteWord(uint16_t AbsoluteAddress, uint16_t Value)
+    void CPU::StoreWord(uint16_t AbsoluteAddress, uint16_t Value)
     {
+        if ((AbsoluteAddress & PageMask) != PageMask)
+        {
+            auto& Page = m_Pages[AbsoluteAddress >> PageShift];
+            if (Page.WritableHostMemory || (Page.Block && !Page.HostMemory))
+            {
+                OnMemoryWrite(AbsoluteAddress);
+                OnMemoryWrite(AbsoluteAddress + 1);
+
+                if (Page.WritableHostMemory)
+                {
+                    auto* Bytes = Page.WritableHostMemory + (AbsoluteAddress & PageMask);
+                    Bytes[0] = static_cast<uint8_t>(Value & 0xFF);
+                    Bytes[1] = static_cast<uint8_t>(Value >> 8);
+                }
+                else
+                {
+                    if (m_IsCountingAccesses)
+                        CountAccess(AbsoluteAddress, 2, true);
+                    Page.Block->WriteWord(AbsoluteAddress - Page.BlockStartAddress, Value);
+                }
+                return;
+            }
+        }
+
         uint8_t Low = static_cast<uint8_t>(Value & 0xFF);
         uint8_t High = static_cast<uint8_t>((Value >> 8) & 0xFF);
 
@@ -192,48 +800,485 @@ namespace lce::Emulator
         WriteByte(AbsoluteAddress + 1, High);
     }
 
+    uint16_t CPU::ReadWord(uint16_t AbsoluteAddress)
+    {
+        auto Value = LoadWord(AbsoluteAddress);
+        if (m_ReadWatchedPages[AbsoluteAddress >> PageShift])
+            CheckWatchpoints(AbsoluteAddress, Value, false);
+        return Value;
+    }
+
+    void CPU::WriteWord(uint16_t AbsoluteAddress, uint16_t Value)
+    {
+        StoreWord(AbsoluteAddress, Value);
+        if (m_WriteWatchedPages[AbsoluteAddress >> PageShift])
+            CheckWatchpoints(AbsoluteAddress, Value, true);
+    }
+
+    void CPU::OnMemoryWrite(uint16_t AbsoluteAddress)
+    {
+        m_InstructionCache.OnMemoryWrite(AbsoluteAddress);
+        m_BlockCache.OnMemoryWrite(AbsoluteAddress);
+        if (m_JIT)
+            m_JIT->OnMemoryWrite(AbsoluteAddress);
+    }
+
+    void CPU::CountAccess(uint16_t AbsoluteAddress, uint64_t Size, bool IsWrite) const
+    {
+        // NOTE: only called for mapped addresses, so a page without a block of its own has per-byte indices
+        const auto& Page = m_Pages[AbsoluteAddress >> PageShift];
+        size_t BlockIndex = Page.Block ? Page.BlockIndex : (*Page.BlockIndices)[AbsoluteAddress & PageMask] - 1;
+
+        auto& Counts = m_AccessCounts[BlockIndex];
+        (IsWrite ? Counts.BytesWritten : Counts.BytesRead) += Size;
+    }
 
-    uint16_t CPU::ReadRegister(Assembler::Register Register) const
+    DecodedInstruction CPU::DecodeInstruction(const uint8_t* Bytes)
     {
-        auto RegisterIndex = static_cast<RegisterIndexUnderlyingType>(Register);
-        assert(RegisterIndex >= 0 && RegisterIndex < std::size(m_Registers));
-        return m_Registers[RegisterIndex];
+        auto Result = Emulator::DecodeInstruction(Bytes);
+        Result.Handler = GetInstructionHandler(Result.ID);
+        return Result;
     }
 
-    void CPU::WriteRegister(Assembler::Register Register, uint16_t Value)
+    InstructionHandler CPU::GetInstructionHandler(HandlerID ID)
     {
-        auto RegisterIndex = static_cast<RegisterIndexUnderlyingType>(Register);
-        assert(RegisterIndex >= 0 && RegisterIndex < std::size(m_Registers));
-        m_Registers[RegisterIndex] = Value;
+        static constexpr InstructionHandler Handlers[] = {
+#define HANDLER_TABLE_ENTRY(Name, ...) &CPU::__VA_ARGS__,
+            ENUMERATE_INSTRUCTION_HANDLERS(HANDLER_TABLE_ENTRY)
+#undef HANDLER_TABLE_ENTRY
+        };
+
+        return Handlers[static_cast<size_t>(ID)];
     }
 
-    void CPU::ExecuteMov(const uint8_t* Bytes, const uint8_t* EndOfStream)
+    const DecodedInstruction& CPU::FetchInstruction(uint16_t Address)
     {
-        assert(Bytes + 1 < EndOfStream); // Mov is at least 2 bytes long
+        if (const auto* CachedInstruction = m_InstructionCache.Find(Address))
+            return *CachedInstruction;
+
+        // NOTE: plain memory can be decoded in place, anything else is read one byte at a time and only as far as the instruction goes
+        const auto& Page = m_Pages[Address >> PageShift];
+        if (Page.HostMemory && (Address & PageMask) + MaxInstructionLength <= PageSize)
+        {
+            m_UncachedInstruction = DecodeInstruction(Page.HostMemory + (Address & PageMask));
+        }
+        else
+        {
+            uint8_t Bytes[MaxInstructionLength];
+            FetchInstructionBytes(Address, Bytes, [this](uint16_t ByteAddress) { return ReadByteOr(ByteAddress, EncodedNOP); });
+            m_UncachedInstruction = DecodeInstruction(Bytes);
+        }
 
-        auto FirstOperandType = ExtractFirstOperandType(Bytes[0]);
-        auto SecondOperandType = ExtractSecondOperandType(Bytes[1]);
+        if (m_Breakpoints[Address])
+        {
+            m_UncachedInstruction.ID = HandlerID::Breakpoint;
+            m_UncachedInstruction.Handler = GetInstructionHandler(HandlerID::Breakpoint);
+        }
 
-        uint16_t Value = 0;
-        if (SecondOperandType == OperandType::Register)
+        // Only instructions that are stored in plain memory can be cached, since memory mapped devices can return different values on every read
+        uint16_t LastByteAddress = Address + m_UncachedInstruction.Length - 1;
+        if (m_Pages[Address >> PageShift].HostMemory && m_Pages[LastByteAddress >> PageShift].HostMemory)
         {
-            auto SourceRegister = ExtractSecondRegister(Bytes[1]);
-            Value = ReadRegister(SourceRegister);
+            if (m_JIT)
+                m_JIT->OnCodeCached(Address, m_UncachedInstruction.Length);
+            return m_InstructionCache.Insert(Address, m_UncachedInstruction);
         }
-        else if (SecondOperandType == OperandType::OneByteImmediate)
+
+        return m_UncachedInstruction;
+    }
+
+    void CPU::ExecuteDecodedInstruction(const DecodedInstruction& Instruction)
+    {
+        // NOTE: IP points to the next instruction while the current one is being executed, jumps simply overwrite it
+        m_IP += Instruction.Length;
+        m_CycleCount++;
+        (this->*Instruction.Handler)(Instruction);
+    }
+
+    void CPU::ExecuteInstrumentedInstruction(const DecodedInstruction& Instruction)
+    {
+        // NOTE: a breakpoint does not execute anything, the instruction it stands in for is recorded once it is stepped over
+        if (Instruction.ID == HandlerID::Breakpoint)
         {
-            assert(Bytes + 2 < EndOfStream);
-            Value = Bytes[2];
+            ExecuteDecodedInstruction(Instruction);
+            return;
         }
-        else if (SecondOperandType == OperandType::TwoByteImmediate)
+
+        // NOTE: the instruction is copied because it can overwrite itself, which drops its cache entry
+        auto IP = m_IP;
+        auto Copy = Instruction;
+        uint16_t RegistersBefore[RegisterCount];
+        MaterializeFlags();
+        std::copy(std::begin(m_Registers), std::end(m_Registers), RegistersBefore);
+
+        ExecuteDecodedInstruction(Copy);
+        MaterializeFlags();
+        if (m_Tracer)
+            m_Tracer->Record(IP, Copy, RegistersBefore, m_Registers);
+        if (m_Profiler)
+            m_Profiler->Record(IP, Copy.ID, m_IP, m_CycleCount);
+    }
+
+    void CPU::RunInterpreter()
+    {
+        while (!m_IsHalted && m_CycleCount < m_CycleLimit)
         {
-            assert(Bytes + 3 < EndOfStream);
-            Value = Bytes[2] | (Bytes[3] << 8);
+            const auto& Instruction = FetchInstruction(m_IP);
+            ExecuteDecodedInstruction(Instruction);
         }
+    }
+
+    void CPU::RunInstrumented()
+    {
+        while (!m_IsHalted && m_CycleCount < m_CycleLimit)
+            ExecuteInstrumentedInstruction(FetchInstruction(m_IP));
+    }
+
+#if defined(__GNUC__) && !defined(LCE_THREADED_DISPATCH_USE_TAIL_CALLS)
+    void CPU::RunThreaded()
+    {
+        if (m_IsHalted || m_CycleCount >= m_CycleLimit)
+            return;
+
+        static const void* const Labels[] = {
+#define LABEL_TABLE_ENTRY(Name, ...) &&Execute##Name,
+            ENUMERATE_INSTRUCTION_HANDLERS(LABEL_TABLE_ENTRY)
+#undef LABEL_TABLE_ENTRY
+        };
+
+        const DecodedInstruction* Instruction = nullptr;
+
+        // NOTE: the count is kept in a local variable so that it can stay in a host register, it is only ever stored so
+        //       that devices see the current cycle. The limit has to be read every time, since a device can lower it
+        uint64_t CycleCount = m_CycleCount;
+
+        // NOTE: every handler ends with its own copy of the dispatch code, so the branch predictor can learn which
+        //       instruction usually follows which one instead of sharing a single indirect jump for all of them
+#define DISPATCH()                                              \
+    do                                                          \
+    {                                                           \
+        if (CycleCount >= m_CycleLimit)                         \
+            goto Exit;                                          \
+        m_CycleCount = ++CycleCount;                            \
+        Instruction = &FetchInstruction(m_IP);                  \
+        m_IP += Instruction->Length;                            \
+        goto* Labels[static_cast<size_t>(Instruction->ID)];     \
+    } while (0)
+
+        DISPATCH();
 
-        assert(FirstOperandType == OperandType::Register);
-        auto DestRegister = ExtractFirstRegister(Bytes[1]);
+        // Only hlt, invalid instructions and breakpoints can stop the CPU, so no other handler needs to check for that
+#define HANDLER_LABEL(Name, ...)                                                          \
+    Execute##Name:                                                                        \
+        __VA_ARGS__(*Instruction);                                                        \
+        if constexpr (HandlerID::Name == HandlerID::Hlt || HandlerID::Name == HandlerID::Invalid || \
+                      HandlerID::Name == HandlerID::Breakpoint)                           \
+            goto Exit;                                                                    \
+        DISPATCH();
 
-        WriteRegister(DestRegister, Value);
+        ENUMERATE_INSTRUCTION_HANDLERS(HANDLER_LABEL)
+#undef HANDLER_LABEL
+#undef DISPATCH
+
+    Exit:
+        return;
     }
+#else
+#if defined(__has_cpp_attribute)
+#if __has_cpp_attribute(clang::musttail)
+#define LCE_MUSTTAIL [[clang::musttail]]
+#endif
+#endif
+
+#ifdef LCE_MUSTTAIL
+    static constexpr uint32_t MaxThreadedChainLength = UINT32_MAX;
+#else
+#define LCE_MUSTTAIL
+    // Without guaranteed tail calls every handler adds a stack frame, so the chain has to be cut regularly
+    static constexpr uint32_t MaxThreadedChainLength = 64;
+#endif
+
+    void CPU::RunThreaded()
+    {
+        while (!m_IsHalted && m_CycleCount < m_CycleLimit)
+        {
+            const auto& Instruction = FetchInstruction(m_IP);
+            m_IP += Instruction.Length;
+            m_CycleCount++;
+            GetThreadedHandler(Instruction.ID)(*this, Instruction, 0);
+        }
+    }
+
+    template <HandlerID ID>
+    void CPU::ExecuteThreaded(CPU& Processor, const DecodedInstruction& Instruction, uint32_t ChainLength)
+    {
+        Processor.ExecuteHandler<ID>(Instruction);
+
+        if constexpr (ID != HandlerID::Hlt && ID != HandlerID::Invalid && ID != HandlerID::Breakpoint)
+        {
+            if (ChainLength >= MaxThreadedChainLength || Processor.m_CycleCount >= Processor.m_CycleLimit)
+                return;
+
+            const auto& NextInstruction = Processor.FetchInstruction(Processor.m_IP);
+            Processor.m_IP += NextInstruction.Length;
+            Processor.m_CycleCount++;
+            LCE_MUSTTAIL return GetThreadedHandler(NextInstruction.ID)(Processor, NextInstruction, ChainLength + 1);
+        }
+    }
+
+    CPU::ThreadedHandler CPU::GetThreadedHandler(HandlerID ID)
+    {
+        static constexpr ThreadedHandler Handlers[] = {
+#define HANDLER_TABLE_ENTRY(Name, ...) &CPU::ExecuteThreaded<HandlerID::Name>,
+            ENUMERATE_INSTRUCTION_HANDLERS(HANDLER_TABLE_ENTRY)
+#undef HANDLER_TABLE_ENTRY
+        };
+
+        return Handlers[static_cast<size_t>(ID)];
+    }
+#undef LCE_MUSTTAIL
+#endif
+
+    static bool IsBlockTerminator(HandlerID ID)
+    {
+        switch (ID)
+        {
+        case HandlerID::JmpRegister:
+        case HandlerID::JmpImmediate:
+        case HandlerID::JzRegister:
+        case HandlerID::JzImmediate:
+        case HandlerID::JvRegister:
+        case HandlerID::JvImmediate:
+        case HandlerID::JcRegister:
+        case HandlerID::JcImmediate:
+        case HandlerID::JnRegister:
+        case HandlerID::JnImmediate:
+        case HandlerID::CallRegister:
+        case HandlerID::CallImmediate:
+        case HandlerID::Ret:
+        case HandlerID::Hlt:
+        case HandlerID::Invalid:
+        case HandlerID::Breakpoint:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    static bool MayWriteMemory(HandlerID ID)
+    {
+        return ID == HandlerID::StaRegister || ID == HandlerID::StaImmediate || ID == HandlerID::PushRegister || ID == HandlerID::PushImmediate;
+    }
+
+    // Upper bound on the number of instructions in a block, so that a single translation stays cheap
+    static constexpr uint32_t MaxInstructionsPerBlock = 64;
+
+    void CPU::RunBasicBlocks()
+    {
+        while (!m_IsHalted && m_CycleCount < m_CycleLimit)
+        {
+            m_BlockCache.ReleaseInvalidatedBlocks();
+
+            const TranslatedBlock* Block = m_BlockCache.Find(m_IP);
+            if (!Block)
+                Block = TranslateBlock(m_IP);
+
+            // Code that can not be translated (e.g. it is fetched from a memory mapped device) is interpreted instead
+            if (!Block)
+            {
+                ExecuteDecodedInstruction(FetchInstruction(m_IP));
+                continue;
+            }
+
+            ExecuteBlock(*Block);
+        }
+    }
+
+    // Number of times a block has to be executed before it is compiled to native code
+    static constexpr uint32_t JITCompilationThreshold = 16;
+
+    void CPU::RunJIT()
+    {
+        if (!m_JIT)
+            m_JIT = std::make_unique<JITCompiler>(*this);
+
+        if (!m_JIT->IsAvailable())
+        {
+            RunBasicBlocks();
+            return;
+        }
+
+        while (!m_IsHalted && m_CycleCount < m_CycleLimit)
+        {
+            if (m_JIT->HasNativeCode(m_IP))
+            {
+                m_JIT->Execute();
+                continue;
+            }
+
+            m_BlockCache.ReleaseInvalidatedBlocks();
+
+            TranslatedBlock* Block = m_BlockCache.Find(m_IP);
+            if (!Block)
+                Block = TranslateBlock(m_IP);
+
+            if (!Block)
+            {
+                ExecuteDecodedInstruction(FetchInstruction(m_IP));
+                continue;
+            }
+
+            // NOTE: compilation is attempted only once per block, blocks that can not be compiled stay interpreted
+            if (++Block->ExecutionCount == JITCompilationThreshold && m_JIT->Compile(*Block))
+                continue;
+
+            ExecuteBlock(*Block);
+        }
+    }
+
+    TranslatedBlock* CPU::TranslateBlock(uint16_t StartAddress)
+    {
+        auto Block = std::make_unique<TranslatedBlock>();
+        Block->StartAddress = StartAddress;
+
+        uint32_t Address = StartAddress;
+        bool ReachedTerminator = false;
+        std::optional<DecodedInstruction> Pending;
+        while (!ReachedTerminator && Block->InstructionCount < MaxInstructionsPerBlock && Address < AddressSpaceSize)
+        {
+            // Only instructions that end up in the instruction cache are known to come from plain memory
+            const auto& Fetched = FetchInstruction(static_cast<uint16_t>(Address));
+            if (&Fetched == &m_UncachedInstruction || Address + Fetched.Length > AddressSpaceSize)
+                break;
+
+            auto Instruction = Fetched;
+            Address += Instruction.Length;
+            Block->InstructionCount++;
+            ReachedTerminator = IsBlockTerminator(Instruction.ID);
+
+            if (Pending)
+            {
+                if (auto Handler = GetSuperinstructionHandler(Pending->ID, Instruction.ID))
+                {
+                    Block->Operations.push_back({ Handler, *Pending, Instruction, static_cast<uint16_t>(Address), MayWriteMemory(Pending->ID) || MayWriteMemory(Instruction.ID) });
+                    Pending.reset();
+                    continue;
+                }
+
+                auto PendingNextAddress = static_cast<uint16_t>(Address - Instruction.Length);
+                Block->Operations.push_back({ GetBlockOperationHandler(Pending->ID), *Pending, {}, PendingNextAddress, MayWriteMemory(Pending->ID) });
+                Pending.reset();
+            }
+
+            Pending = Instruction;
+        }
+
+        if (Pending)
+            Block->Operations.push_back({ GetBlockOperationHandler(Pending->ID), *Pending, {}, static_cast<uint16_t>(Address), MayWriteMemory(Pending->ID) });
+
+        if (Block->Operations.empty())
+            return nullptr;
+
+        Block->EndAddress = Address;
+        return &m_BlockCache.Insert(std::move(Block));
+    }
+
+    void CPU::ExecuteBlock(const TranslatedBlock& Block)
+    {
+        // NOTE: instructions inside of a block never look at IP, so it only has to be correct for the last one
+        m_IP = static_cast<uint16_t>(Block.EndAddress);
+        m_CycleCount += Block.InstructionCount;
+
+        for (const auto& Operation : Block.Operations)
+        {
+            (this->*Operation.Handler)(Operation);
+
+            // The block has overwritten its own code, so the rest of it has to be translated again
+            if (Operation.MayWriteMemory && !Block.IsValid)
+            {
+                if (&Operation != &Block.Operations.back())
+                    m_IP = Operation.NextAddress;
+
+                // NOTE: the instructions after this operation did not run
+                for (auto* Skipped = &Operation + 1; Skipped != Block.Operations.data() + Block.Operations.size(); Skipped++)
+                    m_CycleCount -= Skipped->Second.Length ? 2 : 1;
+                return;
+            }
+        }
+    }
+
+    template <HandlerID ID>
+    void CPU::ExecuteBlockOperation(const BlockOperation& Operation)
+    {
+        ExecuteHandler<ID>(Operation.First);
+    }
+
+    template <HandlerID First, HandlerID Second>
+    void CPU::ExecuteSuperinstruction(const BlockOperation& Operation)
+    {
+        ExecuteHandler<First>(Operation.First);
+        ExecuteHandler<Second>(Operation.Second);
+    }
+
+    BlockOperationHandler CPU::GetBlockOperationHandler(HandlerID ID)
+    {
+        static constexpr BlockOperationHandler Handlers[] = {
+#define HANDLER_TABLE_ENTRY(Name, ...) &CPU::ExecuteBlockOperation<HandlerID::Name>,
+            ENUMERATE_INSTRUCTION_HANDLERS(HANDLER_TABLE_ENTRY)
+#undef HANDLER_TABLE_ENTRY
+        };
+
+        return Handlers[static_cast<size_t>(ID)];
+    }
+
+    // Instructions that set flags and are therefore often followed by a conditional jump
+#define ENUMERATE_FLAG_SETTING_HANDLERS(Func, Next) \
+    Func(AddRegister, Next)                         \
+    Func(AddImmediate, Next)                        \
+    Func(SubRegister, Next)                         \
+    Func(SubImmediate, Next)                        \
+    Func(AndRegister, Next)                         \
+    Func(AndImmediate, Next)                        \
+    Func(OrRegister, Next)                          \
+    Func(OrImmediate, Next)                         \
+    Func(XorRegister, Next)                         \
+    Func(XorImmediate, Next)                        \
+    Func(Not, Next)                                 \
+    Func(ShlRegister, Next)                         \
+    Func(ShlImmediate, Next)                        \
+    Func(ShrRegister, Next)                         \
+    Func(ShrImmediate, Next)
+
+    /*
+     * Pairs of adjacent instructions that are executed as a single block operation
+     */
+#define ENUMERATE_SUPERINSTRUCTIONS(Func)                    \
+    Func(MovRegister, AddRegister)                           \
+    Func(MovRegister, AddImmediate)                          \
+    Func(MovImmediate, AddRegister)                          \
+    Func(MovRegister, SubRegister)                           \
+    Func(MovRegister, SubImmediate)                          \
+    Func(MovImmediate, SubRegister)                          \
+    ENUMERATE_FLAG_SETTING_HANDLERS(Func, JzImmediate)       \
+    ENUMERATE_FLAG_SETTING_HANDLERS(Func, JnImmediate)       \
+    ENUMERATE_FLAG_SETTING_HANDLERS(Func, JcImmediate)       \
+    ENUMERATE_FLAG_SETTING_HANDLERS(Func, JvImmediate)       \
+    Func(PushRegister, CallImmediate)                        \
+    Func(PushImmediate, CallImmediate)                       \
+    Func(PushRegister, CallRegister)                         \
+    Func(PushImmediate, CallRegister)
+
+    BlockOperationHandler CPU::GetSuperinstructionHandler(HandlerID First, HandlerID Second)
+    {
+#define SELECT_SUPERINSTRUCTION(FirstName, SecondName)                   \
+    if (First == HandlerID::FirstName && Second == HandlerID::SecondName) \
+        return &CPU::ExecuteSuperinstruction<HandlerID::FirstName, HandlerID::SecondName>;
+        ENUMERATE_SUPERINSTRUCTIONS(SELECT_SUPERINSTRUCTION)
+#undef SELECT_SUPERINSTRUCTION
+
+        return nullptr;
+    }
+
+#undef ENUMERATE_SUPERINSTRUCTIONS
+#undef ENUMERATE_FLAG_SETTING_HANDLERS
 } // namespace lce::Emulator
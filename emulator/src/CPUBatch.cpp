@@ -0,0 +1,625 @@
+#include "CPUBatch.h"
+
+#include <algorithm>
+
+#include "CPU.h"
+#include "ErrorReporting.h"
+#include "InstructionDecoder.h"
+#include "RandomAccessMemoryBlock.h"
+
+namespace lce::Emulator
+{
+    static bool HostSupportsAVX2()
+    {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+
+    static const BatchKernels* FindKernels(BatchKernelSet KernelSet)
+    {
+        switch (KernelSet)
+        {
+        case BatchKernelSet::Best:
+            if (auto* Kernels = FindKernels(BatchKernelSet::AVX2))
+                return Kernels;
+            if (auto* Kernels = FindKernels(BatchKernelSet::SSE2))
+                return Kernels;
+            return &GetScalarBatchKernels();
+        case BatchKernelSet::Scalar:
+            return &GetScalarBatchKernels();
+        case BatchKernelSet::SSE2:
+            return GetSSE2BatchKernels();
+        case BatchKernelSet::AVX2:
+            return HostSupportsAVX2() ? GetAVX2BatchKernels() : nullptr;
+        }
+        return nullptr;
+    }
+
+    static uint16_t GetJumpFlagMask(Assembler::Opcode Opcode)
+    {
+        switch (Opcode)
+        {
+        case Assembler::Opcode::Jz:
+            return static_cast<uint16_t>(Flag::Zero);
+        case Assembler::Opcode::Jv:
+            return static_cast<uint16_t>(Flag::Overflow);
+        case Assembler::Opcode::Jc:
+            return static_cast<uint16_t>(Flag::Carry);
+        case Assembler::Opcode::Jn:
+            return static_cast<uint16_t>(Flag::Negative);
+        default:
+            return 0;
+        }
+    }
+
+    CPUBatch::CPUBatch(size_t LaneCount, BatchKernelSet KernelSet)
+        : m_Kernels(FindKernels(KernelSet))
+        , m_LaneCount(LaneCount)
+        , m_Stride((LaneCount + BatchLaneAlignment - 1) / BatchLaneAlignment * BatchLaneAlignment)
+        , m_IP(m_Stride)
+        , m_Registers(RegisterCount * m_Stride)
+        , m_Halted(m_Stride, 0xFFFF)
+        , m_Mask(m_Stride)
+    {
+        if (!m_Kernels)
+        {
+            Common::ReportError(Common::ErrorSeverity::Warning, { __FILE__, 0, __LINE__, 0 }, "Requested batch kernels are not supported by the host, falling back to scalar ones");
+            m_Kernels = &GetScalarBatchKernels();
+        }
+        Reset();
+    }
+
+    bool CPUBatch::IsKernelSetSupported(BatchKernelSet KernelSet)
+    {
+        return FindKernels(KernelSet) != nullptr;
+    }
+
+    size_t CPUBatch::GetLaneCount() const
+    {
+        return m_LaneCount;
+    }
+
+    const char* CPUBatch::GetKernelName() const
+    {
+        return m_Kernels->Name;
+    }
+
+    void CPUBatch::Reset()
+    {
+        std::fill(m_IP.begin(), m_IP.end(), 0);
+        std::fill(m_Registers.begin(), m_Registers.end(), 0);
+        std::fill(m_Halted.begin(), m_Halted.begin() + m_LaneCount, 0);
+        std::fill(m_Mask.begin(), m_Mask.end(), 0);
+    }
+
+    void CPUBatch::Run(uint16_t StartAddress)
+    {
+        m_RunningLaneCount = 0;
+        for (size_t Lane = 0; Lane < m_LaneCount; Lane++)
+        {
+            if (m_Halted[Lane])
+                continue;
+            m_IP[Lane] = StartAddress;
+            m_RunningLaneCount++;
+        }
+
+        m_NeedsLaneSelection = true;
+        m_SelectedIPIsStale = false;
+        while (m_RunningLaneCount > 0)
+        {
+            if (m_NeedsLaneSelection)
+                SelectLanes();
+            Step();
+        }
+    }
+
+    bool CPUBatch::AddMemoryBlock(std::unique_ptr<MemoryBlock> NewBlock, uint16_t StartAddress)
+    {
+        if (!IsRangeFree(StartAddress, NewBlock->Size()))
+            return false;
+
+        m_MemoryBlocks.emplace_back(StartAddress, std::move(NewBlock));
+        MapPages();
+        return true;
+    }
+
+    bool CPUBatch::AddLaneMemory(uint16_t StartAddress, uint16_t Size)
+    {
+        if (!IsRangeFree(StartAddress, Size))
+            return false;
+
+        m_LaneMemory.push_back({ StartAddress, Size, std::vector<uint8_t>(static_cast<size_t>(Size) * m_Stride) });
+        MapPages();
+        return true;
+    }
+
+    bool CPUBatch::WriteLaneMemory(size_t Lane, uint16_t StartAddress, std::span<const uint8_t> Bytes)
+    {
+        for (size_t Offset = 0; Offset < Bytes.size(); Offset++)
+        {
+            auto* Row = FindLaneRow(static_cast<uint16_t>(StartAddress + Offset));
+            if (!Row || Lane >= m_LaneCount)
+            {
+                Common::ReportError(Common::ErrorSeverity::Error, { __FILE__, 0, __LINE__, 0 }, "Address 0x{0:X} is not mapped to lane memory", StartAddress + Offset);
+                return false;
+            }
+            Row[Lane] = Bytes[Offset];
+        }
+        return true;
+    }
+
+    uint8_t CPUBatch::ReadLaneMemory(size_t Lane, uint16_t Address) const
+    {
+        const auto* Row = FindLaneRow(Address);
+        return Row && Lane < m_LaneCount ? Row[Lane] : 0;
+    }
+
+    uint16_t CPUBatch::GetRegister(size_t Lane, Assembler::Register Register) const
+    {
+        return this->Register(static_cast<RegisterIndexUnderlyingType>(Register))[Lane];
+    }
+
+    void CPUBatch::SetRegister(size_t Lane, Assembler::Register Register, uint16_t Value)
+    {
+        this->Register(static_cast<RegisterIndexUnderlyingType>(Register))[Lane] = Value;
+    }
+
+    bool CPUBatch::IsHalted(size_t Lane) const
+    {
+        return m_Halted[Lane] != 0;
+    }
+
+    std::string CPUBatch::SerializeState(size_t Lane) const
+    {
+        return fmt::format("ip: {:#06x}; r0: {:#06x}; r1: {:#06x}; r2: {:#06x}; r3: {:#06x}; rsp: {:#06x}; rfl: {:#06x}; halted: {}",
+                           m_IP[Lane], GetRegister(Lane, Assembler::Register::R0), GetRegister(Lane, Assembler::Register::R1),
+                           GetRegister(Lane, Assembler::Register::R2), GetRegister(Lane, Assembler::Register::R3),
+                           GetRegister(Lane, Assembler::Register::RSP), GetRegister(Lane, Assembler::Register::RFL),
+                           IsHalted(Lane) ? "true" : "false");
+    }
+
+    uint16_t* CPUBatch::Register(uint8_t Index)
+    {
+        return m_Registers.data() + Index * m_Stride;
+    }
+
+    const uint16_t* CPUBatch::Register(uint8_t Index) const
+    {
+        return m_Registers.data() + Index * m_Stride;
+    }
+
+    bool CPUBatch::IsRangeFree(uint32_t StartAddress, uint32_t Size) const
+    {
+        auto EndAddress = StartAddress + Size; // One past the last byte of the new range
+        if (EndAddress > AddressSpaceSize)
+        {
+            Common::ReportError(Common::ErrorSeverity::Fatal, { __FILE__, 0, __LINE__, 1 }, "Cannot add memory that does not fit into the address space");
+            return false;
+        }
+
+        auto Overlaps = [&](uint32_t OtherStartAddress, uint32_t OtherSize)
+        {
+            return StartAddress < OtherStartAddress + OtherSize && OtherStartAddress < EndAddress;
+        };
+
+        bool IsFree = true;
+        for (const auto& [BlockStartAddress, Block] : m_MemoryBlocks)
+            IsFree &= !Overlaps(BlockStartAddress, Block->Size());
+        for (const auto& Region : m_LaneMemory)
+            IsFree &= !Overlaps(Region.StartAddress, Region.Size);
+
+        if (!IsFree)
+            Common::ReportError(Common::ErrorSeverity::Fatal, { __FILE__, 0, __LINE__, 1 }, "Cannot add memory that overlaps existing memory");
+        return IsFree;
+    }
+
+    void CPUBatch::MapPages()
+    {
+        for (size_t PageIndex = 0; PageIndex < PageCount; PageIndex++)
+        {
+            auto& Page = m_Pages[PageIndex];
+            Page = {};
+
+            uint32_t PageStartAddress = static_cast<uint32_t>(PageIndex << PageShift);
+            uint32_t PageEndAddress = PageStartAddress + PageSize;
+
+            for (auto& Region : m_LaneMemory)
+            {
+                if (Region.StartAddress <= PageStartAddress && Region.StartAddress + Region.Size >= PageEndAddress)
+                    Page.LaneRows = Region.Rows.data() + (PageStartAddress - Region.StartAddress) * m_Stride;
+            }
+
+            for (auto& [StartAddress, Block] : m_MemoryBlocks)
+            {
+                if (StartAddress > PageStartAddress || StartAddress + Block->Size() < PageEndAddress)
+                    continue;
+
+                Page.Block = Block.get();
+                Page.BlockStartAddress = StartAddress;
+                // NOTE: pages shared with other blocks are copied right away, since the batch writes to host memory directly
+                auto* RAM = dynamic_cast<RandomAccessMemoryBlock*>(Block.get());
+                if (RAM && StartAddress % RandomAccessMemoryBlock::PageSize == 0)
+                    Page.HostMemory = RAM->MakePagePrivate(static_cast<uint16_t>(PageStartAddress - StartAddress));
+            }
+        }
+    }
+
+    uint8_t* CPUBatch::FindLaneRow(uint16_t Address)
+    {
+        return const_cast<uint8_t*>(static_cast<const CPUBatch*>(this)->FindLaneRow(Address));
+    }
+
+    const uint8_t* CPUBatch::FindLaneRow(uint16_t Address) const
+    {
+        const auto& Page = m_Pages[Address >> PageShift];
+        if (Page.LaneRows)
+            return Page.LaneRows + (Address & PageMask) * m_Stride;
+        if (Page.Block)
+            return nullptr;
+
+        for (const auto& Region : m_LaneMemory)
+        {
+            if (Address >= Region.StartAddress && static_cast<uint32_t>(Address - Region.StartAddress) < Region.Size)
+                return Region.Rows.data() + (Address - Region.StartAddress) * m_Stride;
+        }
+        return nullptr;
+    }
+
+    MemoryBlock* CPUBatch::FindMemoryBlock(uint16_t Address, uint16_t& StartAddress) const
+    {
+        const auto& Page = m_Pages[Address >> PageShift];
+        if (Page.Block)
+        {
+            StartAddress = Page.BlockStartAddress;
+            return Page.Block;
+        }
+
+        for (const auto& Block : m_MemoryBlocks)
+        {
+            if (Address >= Block.first && Address - Block.first < Block.second->Size())
+            {
+                StartAddress = Block.first;
+                return Block.second.get();
+            }
+        }
+        return nullptr;
+    }
+
+    uint8_t CPUBatch::ReadByteOr(size_t Lane, uint16_t Address, uint8_t Fallback) const
+    {
+        const auto& Page = m_Pages[Address >> PageShift];
+        if (Page.HostMemory)
+            return Page.HostMemory[Address & PageMask];
+
+        if (const auto* Row = FindLaneRow(Address))
+            return Row[Lane];
+
+        uint16_t StartAddress;
+        if (auto* Block = FindMemoryBlock(Address, StartAddress))
+            return Block->Read(Address - StartAddress);
+        return Fallback;
+    }
+
+    uint8_t CPUBatch::ReadByte(size_t Lane, uint16_t Address) const
+    {
+        const auto& Page = m_Pages[Address >> PageShift];
+        if (Page.HostMemory)
+            return Page.HostMemory[Address & PageMask];
+
+        if (const auto* Row = FindLaneRow(Address))
+            return Row[Lane];
+
+        uint16_t StartAddress;
+        auto* Block = FindMemoryBlock(Address, StartAddress);
+        if (!Block)
+        {
+            Common::ReportError(Common::ErrorSeverity::Warning, { __FILE__, 0, __LINE__, 0 }, "Reading from invalid memory location 0x{0:X}", Address);
+            return 0;
+        }
+        return Block->Read(Address - StartAddress);
+    }
+
+    uint16_t CPUBatch::ReadWord(size_t Lane, uint16_t Address) const
+    {
+        auto Low = ReadByte(Lane, Address);
+        auto High = ReadByte(Lane, Address + 1);
+        return static_cast<uint16_t>((High << 8) | Low);
+    }
+
+    void CPUBatch::WriteByte(size_t Lane, uint16_t Address, uint8_t Value)
+    {
+        if (auto* Row = FindLaneRow(Address))
+        {
+            Row[Lane] = Value;
+            return;
+        }
+
+        m_InstructionCache.OnMemoryWrite(Address);
+
+        auto& Page = m_Pages[Address >> PageShift];
+        if (Page.HostMemory)
+        {
+            Page.HostMemory[Address & PageMask] = Value;
+            return;
+        }
+
+        uint16_t StartAddress;
+        auto* Block = FindMemoryBlock(Address, StartAddress);
+        if (!Block)
+        {
+            Common::ReportError(Common::ErrorSeverity::Warning, { __FILE__, 0, __LINE__, 0 }, "Writing to invalid memory location 0x{0:X}", Address);
+            return;
+        }
+        Block->Write(Address - StartAddress, Value);
+    }
+
+    void CPUBatch::WriteWord(size_t Lane, uint16_t Address, uint16_t Value)
+    {
+        WriteByte(Lane, Address, static_cast<uint8_t>(Value & 0xFF));
+        WriteByte(Lane, Address + 1, static_cast<uint8_t>((Value >> 8) & 0xFF));
+    }
+
+    void CPUBatch::SetArithmeticFlags(size_t Lane, uint16_t Result, bool Carry)
+    {
+        uint16_t Flags = 0;
+        if (Result == 0)
+            Flags |= static_cast<uint16_t>(Flag::Zero);
+        if (Result & 0x8000)
+            Flags |= static_cast<uint16_t>(Flag::Negative);
+        if (Carry)
+            Flags |= static_cast<uint16_t>(Flag::Carry);
+
+        // NOTE: the rest of the bits are reserved, so we leave them untouched
+        constexpr uint16_t FlagMask = 0x000F;
+        auto& RFL = Register(static_cast<RegisterIndexUnderlyingType>(Assembler::Register::RFL))[Lane];
+        RFL = (RFL & ~FlagMask) | Flags;
+    }
+
+    void CPUBatch::SelectLanes()
+    {
+        WriteBackSelectedIP();
+        m_CurrentIP = m_Kernels->MinimumIP(m_IP.data(), m_Halted.data(), m_Stride);
+        m_SelectedLaneCount = m_Kernels->SelectLanes(m_IP.data(), m_Halted.data(), m_CurrentIP, m_Mask.data(), m_Stride);
+        m_NeedsLaneSelection = false;
+    }
+
+    void CPUBatch::WriteBackSelectedIP()
+    {
+        if (!m_SelectedIPIsStale)
+            return;
+        m_Kernels->Move(m_IP.data(), nullptr, m_CurrentIP, m_Mask.data(), m_Stride);
+        m_SelectedIPIsStale = false;
+    }
+
+    void CPUBatch::EndStraightLineCode()
+    {
+        // NOTE: the instruction has already written IP of every selected lane
+        m_SelectedIPIsStale = false;
+        m_NeedsLaneSelection = true;
+    }
+
+    template <typename Function>
+    void CPUBatch::ForEachSelectedLane(Function&& Func)
+    {
+        for (size_t Lane = 0; Lane < m_LaneCount; Lane++)
+        {
+            if (m_Mask[Lane])
+                Func(Lane);
+        }
+    }
+
+    DecodedInstruction CPUBatch::FetchInstruction()
+    {
+        if (const auto* Cached = m_InstructionCache.Find(m_CurrentIP))
+            return *Cached;
+
+        size_t FirstLane = 0;
+        while (!m_Mask[FirstLane])
+            FirstLane++;
+
+        uint8_t Bytes[MaxInstructionLength];
+        FetchInstructionBytes(m_CurrentIP, Bytes, [this, FirstLane](uint16_t Address) { return ReadByteOr(FirstLane, Address, EncodedNOP); });
+        auto Instruction = DecodeInstruction(Bytes);
+
+        bool IsCacheable = true;
+        bool IsInLaneMemory = false;
+        for (uint16_t Offset = 0; Offset < Instruction.Length; Offset++)
+        {
+            uint16_t Address = m_CurrentIP + Offset;
+            IsCacheable &= m_Pages[Address >> PageShift].HostMemory != nullptr;
+            IsInLaneMemory |= FindLaneRow(Address) != nullptr;
+        }
+
+        if (IsCacheable)
+            return m_InstructionCache.Insert(m_CurrentIP, Instruction);
+
+        if (IsInLaneMemory)
+        {
+            // NOTE: every lane can hold different code in its own memory, so only lanes with the same bytes as the first one run it now
+            WriteBackSelectedIP();
+            ForEachSelectedLane([&](size_t Lane)
+            {
+                for (uint16_t Offset = 0; Offset < Instruction.Length; Offset++)
+                {
+                    if (ReadByteOr(Lane, m_CurrentIP + Offset, EncodedNOP) != Bytes[Offset])
+                    {
+                        m_Mask[Lane] = 0;
+                        m_SelectedLaneCount--;
+                        break;
+                    }
+                }
+            });
+        }
+        return Instruction;
+    }
+
+    void CPUBatch::Step()
+    {
+        auto Instruction = FetchInstruction();
+        uint16_t NextAddress = m_CurrentIP + Instruction.Length;
+
+        auto* Mask = m_Mask.data();
+        auto* Flags = Register(static_cast<RegisterIndexUnderlyingType>(Assembler::Register::RFL));
+        auto* StackPointer = Register(static_cast<RegisterIndexUnderlyingType>(Assembler::Register::RSP));
+        auto* First = Register(Instruction.FirstRegister);
+        auto* Second = Register(Instruction.SecondRegister);
+
+        switch (Instruction.ID)
+        {
+        case HandlerID::MovRegister:
+        case HandlerID::MovImmediate:
+            m_Kernels->Move(First, Instruction.ID == HandlerID::MovRegister ? Second : nullptr, Instruction.Immediate, Mask, m_Stride);
+            break;
+        case HandlerID::LdaImmediate:
+        {
+            const auto* LowRow = FindLaneRow(Instruction.Immediate);
+            const auto* HighRow = FindLaneRow(Instruction.Immediate + 1);
+            if (LowRow && HighRow)
+                m_Kernels->LoadWord(LowRow, HighRow, First, Mask, m_Stride);
+            else
+                ForEachSelectedLane([&](size_t Lane) { First[Lane] = ReadWord(Lane, Instruction.Immediate); });
+            break;
+        }
+        case HandlerID::LdaRegister:
+            ForEachSelectedLane([&](size_t Lane) { First[Lane] = ReadWord(Lane, Second[Lane]); });
+            break;
+        case HandlerID::StaImmediate:
+        {
+            auto* LowRow = FindLaneRow(Instruction.Immediate);
+            auto* HighRow = FindLaneRow(Instruction.Immediate + 1);
+            if (LowRow && HighRow)
+                m_Kernels->StoreWord(LowRow, HighRow, Second, Mask, m_Stride);
+            else
+                ForEachSelectedLane([&](size_t Lane) { WriteWord(Lane, Instruction.Immediate, Second[Lane]); });
+            break;
+        }
+        case HandlerID::StaRegister:
+            ForEachSelectedLane([&](size_t Lane) { WriteWord(Lane, First[Lane], Second[Lane]); });
+            break;
+        case HandlerID::AddRegister:
+        case HandlerID::SubRegister:
+        case HandlerID::AndRegister:
+        case HandlerID::OrRegister:
+        case HandlerID::XorRegister:
+            m_Kernels->Arithmetic(Instruction.Opcode, First, Second, 0, Flags, Mask, m_Stride);
+            break;
+        case HandlerID::AddImmediate:
+        case HandlerID::SubImmediate:
+        case HandlerID::AndImmediate:
+        case HandlerID::OrImmediate:
+        case HandlerID::XorImmediate:
+        case HandlerID::Not:
+            m_Kernels->Arithmetic(Instruction.Opcode, First, nullptr, Instruction.Immediate, Flags, Mask, m_Stride);
+            break;
+        case HandlerID::ShlImmediate:
+        case HandlerID::ShrImmediate:
+            m_Kernels->Shift(Instruction.Opcode, First, Instruction.Immediate, Flags, Mask, m_Stride);
+            break;
+        case HandlerID::ShlRegister:
+        case HandlerID::ShrRegister:
+            // NOTE: the shift count differs between lanes, which the kernels do not support
+            ForEachSelectedLane([&](size_t Lane)
+            {
+                uint16_t Left = First[Lane];
+                uint16_t Right = Second[Lane];
+
+                uint16_t Result = 0;
+                bool Carry = false;
+                if (Instruction.Opcode == Assembler::Opcode::Shl)
+                {
+                    Result = Right < 16 ? static_cast<uint16_t>(Left << Right) : 0;
+                    Carry = Right > 0 && Right <= 16 && ((Left >> (16 - Right)) & 1);
+                }
+                else
+                {
+                    Result = Right < 16 ? static_cast<uint16_t>(Left >> Right) : 0;
+                    Carry = Right > 0 && Right <= 16 && ((Left >> (Right - 1)) & 1);
+                }
+
+                First[Lane] = Result;
+                SetArithmeticFlags(Lane, Result, Carry);
+            });
+            break;
+        case HandlerID::PushRegister:
+        case HandlerID::PushImmediate:
+            ForEachSelectedLane([&](size_t Lane)
+            {
+                auto Value = Instruction.ID == HandlerID::PushImmediate ? Instruction.Immediate : First[Lane];
+                WriteWord(Lane, StackPointer[Lane], Value);
+                StackPointer[Lane] += 2;
+            });
+            break;
+        case HandlerID::Pop:
+            ForEachSelectedLane([&](size_t Lane)
+            {
+                StackPointer[Lane] -= 2;
+                First[Lane] = ReadWord(Lane, StackPointer[Lane]);
+            });
+            break;
+        case HandlerID::JmpImmediate:
+            // NOTE: if all running lanes are selected, none of them can be left behind, so there is no need to select them again
+            if (m_SelectedLaneCount == m_RunningLaneCount)
+            {
+                m_CurrentIP = Instruction.Immediate;
+                m_SelectedIPIsStale = true;
+                return;
+            }
+            [[fallthrough]];
+        case HandlerID::JzImmediate:
+        case HandlerID::JvImmediate:
+        case HandlerID::JcImmediate:
+        case HandlerID::JnImmediate:
+            m_Kernels->Jump(m_IP.data(), Flags, GetJumpFlagMask(Instruction.Opcode), nullptr, Instruction.Immediate, NextAddress, Mask, m_Stride);
+            EndStraightLineCode();
+            return;
+        case HandlerID::JmpRegister:
+        case HandlerID::JzRegister:
+        case HandlerID::JvRegister:
+        case HandlerID::JcRegister:
+        case HandlerID::JnRegister:
+            m_Kernels->Jump(m_IP.data(), Flags, GetJumpFlagMask(Instruction.Opcode), First, 0, NextAddress, Mask, m_Stride);
+            EndStraightLineCode();
+            return;
+        case HandlerID::CallRegister:
+        case HandlerID::CallImmediate:
+            ForEachSelectedLane([&](size_t Lane)
+            {
+                auto Target = Instruction.ID == HandlerID::CallImmediate ? Instruction.Immediate : First[Lane];
+                WriteWord(Lane, StackPointer[Lane], NextAddress);
+                StackPointer[Lane] += 2;
+                m_IP[Lane] = Target;
+            });
+            EndStraightLineCode();
+            return;
+        case HandlerID::Ret:
+            ForEachSelectedLane([&](size_t Lane)
+            {
+                StackPointer[Lane] -= 2;
+                m_IP[Lane] = ReadWord(Lane, StackPointer[Lane]);
+            });
+            EndStraightLineCode();
+            return;
+        case HandlerID::Nop:
+            break;
+        case HandlerID::Hlt:
+        case HandlerID::Invalid:
+        default:
+            if (Instruction.ID != HandlerID::Hlt)
+            {
+                Common::ReportError(Common::ErrorSeverity::Error, { __FILE__, 0, __LINE__, 0 }, "Invalid instruction at 0x{0:X}, halting", m_CurrentIP);
+                NextAddress = m_CurrentIP;
+            }
+            m_Kernels->Move(m_IP.data(), nullptr, NextAddress, Mask, m_Stride);
+            m_Kernels->Move(m_Halted.data(), nullptr, 0xFFFF, Mask, m_Stride);
+            m_RunningLaneCount -= m_SelectedLaneCount;
+            EndStraightLineCode();
+            return;
+        }
+
+        m_CurrentIP = NextAddress;
+        m_SelectedIPIsStale = true;
+    }
+} // namespace lce::Emulator
@@ -0,0 +1,204 @@
+#include "DeviceBus.h"
+
+#include <algorithm>
+
+#include "CPU.h"
+#include "ErrorReporting.h"
+#include "InputLog.h"
+
+namespace lce::Emulator
+{
+    void DeviceEventQueue::Schedule(DeviceBus& Bus, size_t DeviceIndex, uint64_t Cycle)
+    {
+        m_Events.push_back({ Cycle, &Bus, DeviceIndex });
+        std::push_heap(m_Events.begin(), m_Events.end(), IsLater);
+    }
+
+    void DeviceEventQueue::DispatchEvents(uint64_t Cycle)
+    {
+        while (!m_Events.empty() && m_Events.front().Cycle <= Cycle)
+        {
+            std::pop_heap(m_Events.begin(), m_Events.end(), IsLater);
+            auto Due = m_Events.back();
+            m_Events.pop_back();
+
+            Due.Bus->OnEvent(Due.DeviceIndex, Due.Cycle);
+        }
+    }
+
+    void DeviceEventQueue::Clear()
+    {
+        m_Events.clear();
+    }
+
+    bool DeviceEventQueue::IsLater(const Event& Left, const Event& Right)
+    {
+        return Left.Cycle > Right.Cycle;
+    }
+
+    DeviceBus::DeviceBus(uint16_t Size)
+        : m_Size(Size)
+        , m_DeviceIndices(Size, 0)
+    {
+    }
+
+    bool DeviceBus::AddDevice(std::unique_ptr<Device> NewDevice, uint16_t RelativeAddress)
+    {
+        size_t EndAddress = RelativeAddress + NewDevice->Size(); // First byte past the device
+        if (EndAddress > m_Size)
+        {
+            Common::ReportError(Common::ErrorSeverity::Fatal, { __FILE__, 0, __LINE__, 0 }, "Cannot add device at 0x{0:X} that does not fit onto the bus", RelativeAddress);
+            return false;
+        }
+        if (m_Devices.size() == UINT8_MAX)
+        {
+            Common::ReportError(Common::ErrorSeverity::Fatal, { __FILE__, 0, __LINE__, 0 }, "Cannot add more than {0} devices to a bus", UINT8_MAX);
+            return false;
+        }
+        if (std::any_of(m_DeviceIndices.begin() + RelativeAddress, m_DeviceIndices.begin() + EndAddress, [](uint8_t Index) { return Index != 0; }))
+        {
+            Common::ReportError(Common::ErrorSeverity::Fatal, { __FILE__, 0, __LINE__, 0 }, "Cannot add device that overlaps existing ones");
+            return false;
+        }
+
+        auto& Slot = m_Devices.emplace_back();
+        Slot.StartAddress = RelativeAddress;
+        Slot.Instance = std::move(NewDevice);
+        Slot.LastCycle = GetCurrentCycle();
+        std::fill(m_DeviceIndices.begin() + RelativeAddress, m_DeviceIndices.begin() + EndAddress, static_cast<uint8_t>(m_Devices.size()));
+
+        Reschedule(m_Devices.size() - 1);
+        return true;
+    }
+
+    uint8_t DeviceBus::Read(uint16_t RelativeAddress) const
+    {
+        auto AbsoluteAddress = static_cast<uint16_t>(m_StartAddress + RelativeAddress);
+        if (IsReplayingInputs())
+            return m_CPU->ReplayInput(AbsoluteAddress);
+
+        uint8_t Value = 0;
+        auto Index = m_DeviceIndices[RelativeAddress];
+        if (Index == 0)
+        {
+            Common::ReportError(Common::ErrorSeverity::Warning, { __FILE__, 0, __LINE__, 0 }, "Reading from unmapped device register 0x{0:X}", RelativeAddress);
+        }
+        else
+        {
+            auto& Slot = m_Devices[Index - 1];
+            CatchUp(Slot);
+            Value = Slot.Instance->Read(RelativeAddress - Slot.StartAddress);
+            Reschedule(Index - 1);
+        }
+
+        if (m_CPU && m_CPU->m_InputLog)
+            m_CPU->m_InputLog->Record(GetCurrentCycle(), AbsoluteAddress, Value);
+        return Value;
+    }
+
+    void DeviceBus::Write(uint16_t RelativeAddress, uint8_t Value)
+    {
+        // NOTE: output only ever reaches the host, so it can be dropped without changing what the guest sees
+        if (IsReplayingInputs())
+            return;
+
+        auto Index = m_DeviceIndices[RelativeAddress];
+        if (Index == 0)
+        {
+            Common::ReportError(Common::ErrorSeverity::Warning, { __FILE__, 0, __LINE__, 0 }, "Writing to unmapped device register 0x{0:X}", RelativeAddress);
+            return;
+        }
+
+        auto& Slot = m_Devices[Index - 1];
+        CatchUp(Slot);
+        Slot.Instance->Write(RelativeAddress - Slot.StartAddress, Value);
+        Reschedule(Index - 1);
+    }
+
+    uint16_t DeviceBus::Size() const
+    {
+        return m_Size;
+    }
+
+    void DeviceBus::CatchUpAll()
+    {
+        for (size_t Index = 0; Index < m_Devices.size(); Index++)
+        {
+            CatchUp(m_Devices[Index]);
+            Reschedule(Index);
+        }
+    }
+
+    void DeviceBus::Attach(CPU& Processor)
+    {
+        m_CPU = &Processor;
+        for (size_t Index = 0; Index < m_Devices.size(); Index++)
+        {
+            auto& Slot = m_Devices[Index];
+            Slot.LastCycle = GetCurrentCycle();
+            Slot.ScheduledCycle = UINT64_MAX;
+            Slot.QueuedCycle = UINT64_MAX;
+            Reschedule(Index);
+        }
+    }
+
+    uint64_t DeviceBus::GetCurrentCycle() const
+    {
+        return m_CPU ? m_CPU->GetCycleCount() : 0;
+    }
+
+    bool DeviceBus::IsReplayingInputs() const
+    {
+        return m_CPU && m_CPU->m_IsReplayingInputs;
+    }
+
+    void DeviceBus::CatchUp(DeviceSlot& Slot) const
+    {
+        auto Cycle = GetCurrentCycle();
+        if (Cycle > Slot.LastCycle)
+        {
+            Slot.Instance->Advance(Cycle - Slot.LastCycle);
+            Slot.LastCycle = Cycle;
+        }
+    }
+
+    void DeviceBus::Reschedule(size_t DeviceIndex) const
+    {
+        auto& Slot = m_Devices[DeviceIndex];
+
+        // NOTE: an event is always at least one cycle in the future, otherwise the CPU could not make progress
+        auto Delay = std::max<uint64_t>(Slot.Instance->GetCyclesUntilNextEvent(), 1);
+        Slot.ScheduledCycle = Delay > UINT64_MAX - Slot.LastCycle ? UINT64_MAX : Slot.LastCycle + Delay;
+
+        // A later event than the one already in the queue is picked up once the queued one turns out to be too early
+        if (!m_CPU || IsReplayingInputs() || Slot.ScheduledCycle >= Slot.QueuedCycle)
+            return;
+
+        Slot.QueuedCycle = Slot.ScheduledCycle;
+        m_CPU->ScheduleDeviceEvent(const_cast<DeviceBus&>(*this), DeviceIndex, Slot.ScheduledCycle);
+    }
+
+    void DeviceBus::OnEvent(size_t DeviceIndex, uint64_t Cycle)
+    {
+        auto& Slot = m_Devices[DeviceIndex];
+
+        // NOTE: the queue can still hold entries that were superseded by earlier ones
+        if (Cycle != Slot.QueuedCycle)
+            return;
+        Slot.QueuedCycle = UINT64_MAX;
+
+        if (Slot.ScheduledCycle > Cycle)
+        {
+            // The event was moved to a later cycle after it had been queued
+            if (Slot.ScheduledCycle != UINT64_MAX)
+            {
+                Slot.QueuedCycle = Slot.ScheduledCycle;
+                m_CPU->ScheduleDeviceEvent(*this, DeviceIndex, Slot.ScheduledCycle);
+            }
+            return;
+        }
+
+        CatchUp(Slot);
+        Reschedule(DeviceIndex);
+    }
+} // namespace lce::Emulator
@@ -0,0 +1,179 @@
+#include "ExecutionProfiler.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include <fmt/format.h>
+
+namespace lce::Emulator
+{
+    static constexpr const char* HandlerNames[] = {
+#define HANDLER_NAME(Name, ...) #Name,
+        ENUMERATE_INSTRUCTION_HANDLERS(HANDLER_NAME)
+#undef HANDLER_NAME
+    };
+
+    static constexpr size_t AddressSpaceSize = 65536;
+
+    ExecutionProfiler::ExecutionProfiler()
+    {
+        Reset();
+    }
+
+    void ExecutionProfiler::Record(uint16_t IP, HandlerID ID, uint16_t NextIP, uint64_t Cycle)
+    {
+        if (m_InstructionCount == 0 && m_CallStack.empty())
+            m_StackNodes[0].FunctionAddress = IP;
+
+        m_InstructionCount++;
+        m_AddressCounts[IP]++;
+        m_HandlerCounts[static_cast<size_t>(ID)]++;
+        m_StackNodes[m_CurrentNode].SelfInstructions++;
+
+        if (ID == HandlerID::CallRegister || ID == HandlerID::CallImmediate)
+        {
+            auto EdgeKey = (static_cast<uint32_t>(IP) << 16) | NextIP;
+            auto& Edge = m_CallEdges[EdgeKey];
+            Edge.CallSite = IP;
+            Edge.Target = NextIP;
+            Edge.Calls++;
+
+            // NOTE: the call is still counted, but without a frame its cycles can not be measured
+            if (m_CallStack.size() == MaxCallDepth)
+                return;
+
+            auto ChildKey = (static_cast<uint64_t>(m_CurrentNode) << 16) | NextIP;
+            auto [Child, IsNew] = m_StackNodeChildren.try_emplace(ChildKey, m_StackNodes.size());
+            if (IsNew)
+                m_StackNodes.push_back({ NextIP, m_CurrentNode, 0 });
+
+            // The call itself belongs to the caller, so the callee starts counting with the next cycle
+            m_CallStack.push_back({ m_CurrentNode, EdgeKey, Cycle });
+            m_CurrentNode = Child->second;
+        }
+        else if (ID == HandlerID::Ret && !m_CallStack.empty())
+        {
+            auto Frame = m_CallStack.back();
+            m_CallStack.pop_back();
+
+            m_CallEdges[Frame.Edge].Cycles += Cycle - Frame.EntryCycle + 1;
+            m_CurrentNode = Frame.Node;
+        }
+    }
+
+    void ExecutionProfiler::AddSourceMap(std::span<const Assembler::SourceMapEntry> SourceMap, uint16_t BaseAddress)
+    {
+        for (const auto& Entry : SourceMap)
+        {
+            auto Address = static_cast<uint16_t>(BaseAddress + Entry.Offset);
+            m_SourceLines[Address] = { std::string(Entry.Location.FileName), Entry.Location.Line };
+        }
+    }
+
+    uint64_t ExecutionProfiler::GetInstructionCount() const
+    {
+        return m_InstructionCount;
+    }
+
+    uint64_t ExecutionProfiler::GetExecutionCount(uint16_t Address) const
+    {
+        return m_AddressCounts[Address];
+    }
+
+    uint64_t ExecutionProfiler::GetExecutionCount(HandlerID ID) const
+    {
+        return m_HandlerCounts[static_cast<size_t>(ID)];
+    }
+
+    std::vector<CallEdgeStatistics> ExecutionProfiler::GetCallEdges() const
+    {
+        std::vector<CallEdgeStatistics> Edges;
+        Edges.reserve(m_CallEdges.size());
+        for (const auto& [Key, Edge] : m_CallEdges)
+            Edges.push_back(Edge);
+
+        std::sort(Edges.begin(), Edges.end(), [](const auto& Left, const auto& Right)
+                  { return Left.Cycles != Right.Cycles ? Left.Cycles > Right.Cycles : Left.CallSite < Right.CallSite; });
+        return Edges;
+    }
+
+    void ExecutionProfiler::WriteFoldedStacks(std::ostream& Output) const
+    {
+        std::vector<std::string> Stacks(m_StackNodes.size());
+        for (size_t Index = 0; Index < m_StackNodes.size(); Index++)
+        {
+            // NOTE: children are always created after their parent, so the stack of the parent is already known
+            const auto& Node = m_StackNodes[Index];
+            auto Frame = DescribeAddress(Node.FunctionAddress);
+            Stacks[Index] = Index == 0 ? Frame : Stacks[Node.Parent] + ";" + Frame;
+
+            if (Node.SelfInstructions > 0)
+                Output << Stacks[Index] << ' ' << Node.SelfInstructions << '\n';
+        }
+    }
+
+    void ExecutionProfiler::WriteReport(std::ostream& Output, size_t MaxEntries) const
+    {
+        auto Percentage = [this](uint64_t Count) { return m_InstructionCount ? 100.0 * Count / m_InstructionCount : 0.0; };
+
+        Output << fmt::format("Instructions executed: {}\n", m_InstructionCount);
+
+        std::vector<uint16_t> Addresses;
+        for (size_t Address = 0; Address < AddressSpaceSize; Address++)
+        {
+            if (m_AddressCounts[Address])
+                Addresses.push_back(static_cast<uint16_t>(Address));
+        }
+        auto AddressCount = std::min(MaxEntries, Addresses.size());
+        std::partial_sort(Addresses.begin(), Addresses.begin() + AddressCount, Addresses.end(), [this](uint16_t Left, uint16_t Right)
+                          { return m_AddressCounts[Left] != m_AddressCounts[Right] ? m_AddressCounts[Left] > m_AddressCounts[Right] : Left < Right; });
+
+        Output << "\nHottest addresses:\n";
+        for (size_t Index = 0; Index < AddressCount; Index++)
+        {
+            auto Count = m_AddressCounts[Addresses[Index]];
+            Output << fmt::format("{:>14} {:>6.2f}%  {}\n", Count, Percentage(Count), DescribeAddress(Addresses[Index]));
+        }
+
+        std::vector<size_t> Handlers(m_HandlerCounts.size());
+        std::iota(Handlers.begin(), Handlers.end(), 0);
+        std::stable_sort(Handlers.begin(), Handlers.end(), [this](size_t Left, size_t Right) { return m_HandlerCounts[Left] > m_HandlerCounts[Right]; });
+
+        Output << "\nHottest instructions:\n";
+        for (size_t Index = 0; Index < std::min(MaxEntries, Handlers.size()) && m_HandlerCounts[Handlers[Index]]; Index++)
+        {
+            auto Count = m_HandlerCounts[Handlers[Index]];
+            Output << fmt::format("{:>14} {:>6.2f}%  {}\n", Count, Percentage(Count), HandlerNames[Handlers[Index]]);
+        }
+
+        auto Edges = GetCallEdges();
+        Output << "\nCall edges by cycles:\n";
+        for (size_t Index = 0; Index < std::min(MaxEntries, Edges.size()); Index++)
+        {
+            const auto& Edge = Edges[Index];
+            Output << fmt::format("{:>14} {:>6.2f}%  {} calls  {} -> {}\n", Edge.Cycles, Percentage(Edge.Cycles), Edge.Calls, DescribeAddress(Edge.CallSite),
+                                  DescribeAddress(Edge.Target));
+        }
+    }
+
+    void ExecutionProfiler::Reset()
+    {
+        m_AddressCounts.assign(AddressSpaceSize, 0);
+        m_HandlerCounts.fill(0);
+        m_InstructionCount = 0;
+        m_CallEdges.clear();
+
+        m_StackNodes.assign(1, StackNode{});
+        m_StackNodeChildren.clear();
+        m_CallStack.clear();
+        m_CurrentNode = 0;
+    }
+
+    std::string ExecutionProfiler::DescribeAddress(uint16_t Address) const
+    {
+        auto Line = m_SourceLines.find(Address);
+        if (Line == m_SourceLines.end())
+            return fmt::format("0x{:04X}", Address);
+        return fmt::format("0x{:04X} {}:{}", Address, Line->second.FileName, Line->second.Line);
+    }
+} // namespace lce::Emulator
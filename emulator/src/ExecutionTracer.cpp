@@ -0,0 +1,345 @@
+#include "ExecutionTracer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+
+namespace lce::Emulator
+{
+    static constexpr uint8_t TraceMagic[8] = { 'L', 'C', 'E', 'T', 'R', 'A', 'C', 'E' };
+    static constexpr uint8_t TraceVersion = 1;
+
+    static constexpr uint8_t HasIPBit = 1 << 6;
+    static constexpr uint8_t HandlerIDMask = 0x3F;
+    static constexpr uint8_t LengthShift = 6;
+
+    static constexpr size_t StackPointerIndex = static_cast<size_t>(Assembler::Register::RSP);
+
+    static_assert(static_cast<size_t>(HandlerID::Count_) <= HandlerIDMask + 1);
+
+    static uint8_t* EncodeVarint(uint8_t* Output, uint32_t Value)
+    {
+        while (Value >= 0x80)
+        {
+            *Output++ = static_cast<uint8_t>(Value | 0x80);
+            Value >>= 7;
+        }
+        *Output++ = static_cast<uint8_t>(Value);
+        return Output;
+    }
+
+    // Maps small negative and positive differences between 16-bit values to small unsigned numbers
+    static uint32_t EncodeZigzag(uint16_t Value, uint16_t Reference)
+    {
+        auto Difference = static_cast<int16_t>(Value - Reference);
+        return (static_cast<uint32_t>(Difference) << 1) ^ static_cast<uint32_t>(Difference >> 15);
+    }
+
+    static uint16_t DecodeZigzag(uint32_t Value, uint16_t Reference)
+    {
+        auto Difference = static_cast<int32_t>(Value >> 1) ^ -static_cast<int32_t>(Value & 1);
+        return static_cast<uint16_t>(Reference + Difference);
+    }
+
+    static bool DecodeVarint(std::span<const uint8_t> Bytes, size_t& Offset, uint32_t& Value)
+    {
+        Value = 0;
+        for (uint32_t Shift = 0; Shift < 21; Shift += 7)
+        {
+            if (Offset >= Bytes.size())
+                return false;
+            auto Byte = Bytes[Offset++];
+            Value |= static_cast<uint32_t>(Byte & 0x7F) << Shift;
+            if (!(Byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    // Returns true if instructions with the handler load or store a word, which is then stored with the record
+    static bool AccessesMemory(HandlerID ID, bool& IsWrite)
+    {
+        switch (ID)
+        {
+        case HandlerID::LdaRegister:
+        case HandlerID::LdaImmediate:
+        case HandlerID::Pop:
+        case HandlerID::Ret:
+            IsWrite = false;
+            return true;
+        case HandlerID::StaRegister:
+        case HandlerID::StaImmediate:
+        case HandlerID::PushRegister:
+        case HandlerID::PushImmediate:
+        case HandlerID::CallRegister:
+        case HandlerID::CallImmediate:
+            IsWrite = true;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    /*
+     * Works out which word the instruction loaded or stored from the registers around it, so that the memory
+     * accessors of the CPU do not need a hook that would cost something even while tracing is disabled
+     */
+    static void GetMemoryAccess(uint16_t IP, const DecodedInstruction& Instruction, const uint16_t* Before, const uint16_t* After,
+                                uint16_t& Address, uint16_t& Value)
+    {
+        switch (Instruction.ID)
+        {
+        case HandlerID::LdaRegister:
+        case HandlerID::LdaImmediate:
+            Address = Instruction.ID == HandlerID::LdaImmediate ? Instruction.Immediate : Before[Instruction.SecondRegister];
+            Value = After[Instruction.FirstRegister];
+            break;
+        case HandlerID::StaRegister:
+        case HandlerID::StaImmediate:
+            Address = Instruction.ID == HandlerID::StaImmediate ? Instruction.Immediate : Before[Instruction.FirstRegister];
+            Value = Before[Instruction.SecondRegister];
+            break;
+        case HandlerID::PushRegister:
+        case HandlerID::PushImmediate:
+            Address = Before[StackPointerIndex];
+            Value = Instruction.ID == HandlerID::PushImmediate ? Instruction.Immediate : Before[Instruction.FirstRegister];
+            break;
+        case HandlerID::CallRegister:
+        case HandlerID::CallImmediate:
+            Address = Before[StackPointerIndex];
+            Value = static_cast<uint16_t>(IP + Instruction.Length);
+            break;
+        case HandlerID::Pop:
+        case HandlerID::Ret:
+            Address = static_cast<uint16_t>(Before[StackPointerIndex] - 2);
+            // NOTE: ret loads the IP of the next record, so its value is not stored
+            Value = Instruction.ID == HandlerID::Pop ? After[Instruction.FirstRegister] : 0;
+            break;
+        default:
+            Address = Value = 0;
+            break;
+        }
+    }
+
+    std::unique_ptr<ExecutionTracer> ExecutionTracer::Open(const std::filesystem::path& Path, size_t RingSize)
+    {
+        assert(RingSize >= 4 * LocalBufferSize && (RingSize & (RingSize - 1)) == 0);
+
+        std::unique_ptr<ExecutionTracer> Tracer(new ExecutionTracer);
+        Tracer->m_Output.open(Path, std::ios::binary | std::ios::trunc);
+        if (!Tracer->m_Output.is_open())
+            return nullptr;
+
+        Tracer->m_Output.write(reinterpret_cast<const char*>(TraceMagic), sizeof(TraceMagic));
+        Tracer->m_Output.put(static_cast<char>(TraceVersion));
+        // NOTE: Flush only waits for records, so the header has to reach the file on its own
+        Tracer->m_Output.flush();
+
+        Tracer->m_Ring = std::make_unique<uint8_t[]>(RingSize);
+        Tracer->m_RingSize = RingSize;
+        Tracer->m_LocalBuffer.reserve(LocalBufferSize);
+        Tracer->m_Writer = std::thread(&ExecutionTracer::WriterMain, Tracer.get());
+        return Tracer;
+    }
+
+    ExecutionTracer::~ExecutionTracer()
+    {
+        if (!m_Writer.joinable())
+            return;
+
+        PushToRing(m_LocalBuffer);
+        m_IsStopping.store(true, std::memory_order_release);
+        m_Writer.join();
+    }
+
+    void ExecutionTracer::Record(uint16_t IP, const DecodedInstruction& Instruction, const uint16_t* RegistersBefore, const uint16_t* RegistersAfter)
+    {
+        uint8_t Bytes[MaxRecordSize];
+        uint8_t* Output = Bytes + 2;
+
+        uint8_t Header = static_cast<uint8_t>(Instruction.ID);
+        uint8_t Flags = static_cast<uint8_t>((Instruction.Length - 1) << LengthShift);
+
+        if (IP != m_ExpectedIP)
+        {
+            Header |= HasIPBit;
+            Output = EncodeVarint(Output, EncodeZigzag(IP, m_ExpectedIP));
+        }
+
+        for (size_t Index = 0; Index < TracedRegisterCount; Index++)
+        {
+            if (RegistersAfter[Index] == m_Registers[Index])
+                continue;
+            Flags |= 1 << Index;
+            Output = EncodeVarint(Output, RegistersAfter[Index] ^ m_Registers[Index]);
+            m_Registers[Index] = RegistersAfter[Index];
+        }
+
+        bool IsWrite;
+        if (AccessesMemory(Instruction.ID, IsWrite))
+        {
+            uint16_t Address, Value;
+            GetMemoryAccess(IP, Instruction, RegistersBefore, RegistersAfter, Address, Value);
+            Output = EncodeVarint(Output, EncodeZigzag(Address, m_LastAddress));
+            if (Instruction.ID != HandlerID::Ret)
+            {
+                *Output++ = static_cast<uint8_t>(Value & 0xFF);
+                *Output++ = static_cast<uint8_t>(Value >> 8);
+            }
+            m_LastAddress = Address;
+        }
+
+        Bytes[0] = Header;
+        Bytes[1] = Flags;
+        m_ExpectedIP = static_cast<uint16_t>(IP + Instruction.Length);
+
+        auto Size = static_cast<size_t>(Output - Bytes);
+        if (m_LocalBuffer.size() + Size > LocalBufferSize)
+        {
+            PushToRing(m_LocalBuffer);
+            m_LocalBuffer.clear();
+        }
+        m_LocalBuffer.insert(m_LocalBuffer.end(), Bytes, Output);
+
+        m_Statistics.Records++;
+        m_Statistics.Bytes += Size;
+    }
+
+    void ExecutionTracer::Flush()
+    {
+        PushToRing(m_LocalBuffer);
+        m_LocalBuffer.clear();
+
+        // NOTE: the writer only flushes the stream once the ring is empty, so waiting for the read position is not enough
+        while (m_FlushedPosition.load(std::memory_order_acquire) != m_WritePosition.load(std::memory_order_relaxed))
+            std::this_thread::yield();
+    }
+
+    TraceStatistics ExecutionTracer::GetStatistics() const
+    {
+        return m_Statistics;
+    }
+
+    void ExecutionTracer::PushToRing(std::span<const uint8_t> Bytes)
+    {
+        if (Bytes.empty())
+            return;
+
+        auto WritePosition = m_WritePosition.load(std::memory_order_relaxed);
+        if (WritePosition + Bytes.size() - m_ReadPosition.load(std::memory_order_acquire) > m_RingSize)
+        {
+            m_Statistics.Stalls++;
+            while (WritePosition + Bytes.size() - m_ReadPosition.load(std::memory_order_acquire) > m_RingSize)
+                std::this_thread::yield();
+        }
+
+        auto Offset = WritePosition & (m_RingSize - 1);
+        auto FirstPart = std::min(Bytes.size(), m_RingSize - Offset);
+        std::memcpy(m_Ring.get() + Offset, Bytes.data(), FirstPart);
+        std::memcpy(m_Ring.get(), Bytes.data() + FirstPart, Bytes.size() - FirstPart);
+
+        m_WritePosition.store(WritePosition + Bytes.size(), std::memory_order_release);
+    }
+
+    void ExecutionTracer::WriterMain()
+    {
+        while (true)
+        {
+            // NOTE: checked before looking at the ring, so that everything pushed before stopping is still written
+            bool IsStopping = m_IsStopping.load(std::memory_order_acquire);
+
+            auto ReadPosition = m_ReadPosition.load(std::memory_order_relaxed);
+            auto WritePosition = m_WritePosition.load(std::memory_order_acquire);
+            if (ReadPosition == WritePosition)
+            {
+                if (IsStopping)
+                    break;
+
+                m_Output.flush();
+                m_FlushedPosition.store(ReadPosition, std::memory_order_release);
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                continue;
+            }
+
+            auto Offset = ReadPosition & (m_RingSize - 1);
+            auto Size = std::min(WritePosition - ReadPosition, m_RingSize - Offset);
+            m_Output.write(reinterpret_cast<const char*>(m_Ring.get() + Offset), static_cast<std::streamsize>(Size));
+            m_ReadPosition.store(ReadPosition + Size, std::memory_order_release);
+        }
+
+        m_Output.flush();
+    }
+
+    bool DecodeTrace(std::span<const uint8_t> Bytes, std::vector<TraceRecord>& Records)
+    {
+        if (Bytes.size() < sizeof(TraceMagic) + 1 || !std::equal(std::begin(TraceMagic), std::end(TraceMagic), Bytes.begin()) ||
+            Bytes[sizeof(TraceMagic)] != TraceVersion)
+            return false;
+
+        TraceRecord Current;
+        uint16_t ExpectedIP = 0;
+        uint16_t LastAddress = 0;
+        size_t Offset = sizeof(TraceMagic) + 1;
+        size_t PendingRet = SIZE_MAX;
+        while (Offset < Bytes.size())
+        {
+            if (Offset + 2 > Bytes.size())
+                return false;
+            uint8_t Header = Bytes[Offset++];
+            uint8_t Flags = Bytes[Offset++];
+
+            Current.ID = static_cast<HandlerID>(Header & HandlerIDMask);
+            if (Current.ID >= HandlerID::Count_)
+                return false;
+
+            uint32_t Value;
+            Current.IP = ExpectedIP;
+            if (Header & HasIPBit)
+            {
+                if (!DecodeVarint(Bytes, Offset, Value))
+                    return false;
+                Current.IP = DecodeZigzag(Value, ExpectedIP);
+            }
+
+            // NOTE: ret loads the address of the next instruction, which is only known from the record that follows
+            if (PendingRet != SIZE_MAX)
+                Records[PendingRet].Value = Current.IP;
+
+            for (size_t Index = 0; Index < TracedRegisterCount; Index++)
+            {
+                if (!(Flags & (1 << Index)))
+                    continue;
+                if (!DecodeVarint(Bytes, Offset, Value))
+                    return false;
+                Current.Registers[Index] ^= static_cast<uint16_t>(Value);
+            }
+
+            Current.IsWrite = false;
+            Current.Address = 0;
+            Current.Value = 0;
+            Current.HasMemoryAccess = AccessesMemory(Current.ID, Current.IsWrite);
+            if (Current.HasMemoryAccess)
+            {
+                if (!DecodeVarint(Bytes, Offset, Value))
+                    return false;
+                Current.Address = LastAddress = DecodeZigzag(Value, LastAddress);
+                if (Current.ID != HandlerID::Ret)
+                {
+                    if (Offset + 2 > Bytes.size())
+                        return false;
+                    Current.Value = static_cast<uint16_t>(Bytes[Offset] | (Bytes[Offset + 1] << 8));
+                    Offset += 2;
+                }
+            }
+
+            // NOTE: the index is kept rather than a pointer, since the vector can grow before the next record
+            PendingRet = Current.ID == HandlerID::Ret ? Records.size() : SIZE_MAX;
+            Records.push_back(Current);
+
+            ExpectedIP = static_cast<uint16_t>(Current.IP + (Flags >> LengthShift) + 1);
+        }
+
+        return true;
+    }
+} // namespace lce::Emulator
@@ -0,0 +1,683 @@
+#include "GDBServer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "ErrorReporting.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define LCE_GDB_SERVER_USE_SOCKETS
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace lce::Emulator
+{
+    // Largest packet the debugger may send, which also bounds the size of memory reads
+    static constexpr size_t MaxPacketSize = 0x1000;
+
+    // Registers in the order of the target description, ip comes last
+    static constexpr size_t GuestRegisterCount = 6;
+    static constexpr size_t IPRegisterIndex = GuestRegisterCount;
+
+    static constexpr std::string_view TargetDescription = R"(<?xml version="1.0"?>
+<!DOCTYPE target SYSTEM "gdb-target.dtd">
+<target version="1.0">
+  <feature name="org.lce.core">
+    <reg name="r0" bitsize="16" type="int"/>
+    <reg name="r1" bitsize="16" type="int"/>
+    <reg name="r2" bitsize="16" type="int"/>
+    <reg name="r3" bitsize="16" type="int"/>
+    <reg name="rsp" bitsize="16" type="data_ptr"/>
+    <reg name="rfl" bitsize="16" type="int"/>
+    <reg name="ip" bitsize="16" type="code_ptr"/>
+  </feature>
+</target>
+)";
+
+    static bool ParseHex(std::string_view Text, uint32_t& Value)
+    {
+        auto [End, Error] = std::from_chars(Text.data(), Text.data() + Text.size(), Value, 16);
+        return !Text.empty() && Error == std::errc() && End == Text.data() + Text.size();
+    }
+
+    // Parses "ADDRESS,LENGTH", as used by memory and breakpoint packets
+    static bool ParseAddressAndLength(std::string_view Text, uint32_t& Address, uint32_t& Length)
+    {
+        auto Separator = Text.find(',');
+        return Separator != std::string_view::npos && ParseHex(Text.substr(0, Separator), Address) && Address <= 0xFFFF &&
+               ParseHex(Text.substr(Separator + 1), Length);
+    }
+
+    static std::string EncodeHex(std::span<const uint8_t> Bytes)
+    {
+        std::string Result;
+        Result.reserve(Bytes.size() * 2);
+        for (auto Byte : Bytes)
+            Result += fmt::format("{:02x}", Byte);
+        return Result;
+    }
+
+    static bool DecodeHex(std::string_view Text, std::vector<uint8_t>& Bytes)
+    {
+        if (Text.size() % 2 != 0)
+            return false;
+
+        Bytes.resize(Text.size() / 2);
+        for (size_t Index = 0; Index < Bytes.size(); Index++)
+        {
+            uint32_t Value;
+            if (!ParseHex(Text.substr(Index * 2, 2), Value))
+                return false;
+            Bytes[Index] = static_cast<uint8_t>(Value);
+        }
+        return true;
+    }
+
+    // NOTE: registers are sent in the byte order of the target, i.e. little-endian
+    static std::string EncodeRegister(uint16_t Value)
+    {
+        uint8_t Bytes[] = { static_cast<uint8_t>(Value & 0xFF), static_cast<uint8_t>(Value >> 8) };
+        return EncodeHex(Bytes);
+    }
+
+    static bool DecodeRegister(std::string_view Text, uint16_t& Value)
+    {
+        std::vector<uint8_t> Bytes;
+        if (Text.size() != 4 || !DecodeHex(Text, Bytes))
+            return false;
+        Value = Bytes[0] | (Bytes[1] << 8);
+        return true;
+    }
+
+    // Escapes the characters that can not appear in the data of a packet
+    static std::string EscapeBinary(std::string_view Data)
+    {
+        std::string Result;
+        for (auto Character : Data)
+        {
+            if (Character == '$' || Character == '#' || Character == '}' || Character == '*')
+            {
+                Result += '}';
+                Result += static_cast<char>(Character ^ 0x20);
+            }
+            else
+            {
+                Result += Character;
+            }
+        }
+        return Result;
+    }
+
+    GDBServer::GDBServer(CPU& Processor, uint64_t SliceCycles)
+        : m_CPU(Processor)
+        , m_SliceCycles(std::max<uint64_t>(SliceCycles, 1))
+    {
+    }
+
+    GDBServer::~GDBServer()
+    {
+        CloseSockets();
+    }
+
+    std::string GDBServer::HandlePacket(std::string_view Packet)
+    {
+        if (Packet.empty())
+            return "";
+
+        auto Arguments = Packet.substr(1);
+        switch (Packet[0])
+        {
+        case '?':
+            return m_LastStopReply;
+        case 'g':
+            return ReadRegisters();
+        case 'G':
+        {
+            if (Arguments.size() != (GuestRegisterCount + 1) * 4)
+                return "E01";
+
+            uint16_t Values[GuestRegisterCount + 1];
+            for (size_t Index = 0; Index < std::size(Values); Index++)
+            {
+                if (!DecodeRegister(Arguments.substr(Index * 4, 4), Values[Index]))
+                    return "E01";
+            }
+            for (size_t Index = 0; Index < std::size(Values); Index++)
+                WriteRegister(Index, Values[Index]);
+            return "OK";
+        }
+        case 'p':
+        {
+            uint32_t Index;
+            if (!ParseHex(Arguments, Index) || Index > IPRegisterIndex)
+                return "E01";
+            return ReadRegisters().substr(Index * 4, 4);
+        }
+        case 'P':
+        {
+            auto Separator = Arguments.find('=');
+            uint32_t Index;
+            uint16_t Value;
+            if (Separator == std::string_view::npos || !ParseHex(Arguments.substr(0, Separator), Index) ||
+                !DecodeRegister(Arguments.substr(Separator + 1), Value) || !WriteRegister(Index, Value))
+                return "E01";
+            return "OK";
+        }
+        case 'm':
+        {
+            uint32_t Address, Length;
+            if (!ParseAddressAndLength(Arguments, Address, Length))
+                return "E01";
+
+            std::vector<uint8_t> Bytes(std::min<size_t>(Length, MaxPacketSize / 2));
+            if (!m_CPU.ReadMemory(static_cast<uint16_t>(Address), Bytes))
+                return "E14";
+            return EncodeHex(Bytes);
+        }
+        case 'M':
+        {
+            auto Separator = Arguments.find(':');
+            uint32_t Address, Length;
+            std::vector<uint8_t> Bytes;
+            if (Separator == std::string_view::npos || !ParseAddressAndLength(Arguments.substr(0, Separator), Address, Length) ||
+                !DecodeHex(Arguments.substr(Separator + 1), Bytes) || Bytes.size() != Length)
+                return "E01";
+            if (!m_CPU.WriteMemory(static_cast<uint16_t>(Address), Bytes))
+                return "E14";
+            return "OK";
+        }
+        case 'c':
+            return Resume(Arguments, false);
+        case 's':
+            return Resume(Arguments, true);
+        case 'Z':
+            return SetBreakpoint(Arguments, true);
+        case 'z':
+            return SetBreakpoint(Arguments, false);
+        case 'D':
+            m_HasDetached = true;
+            return "OK";
+        case 'k':
+            // NOTE: kill has no reply
+            m_HasKilled = true;
+            return "";
+        case 'H':
+        case 'T':
+            // There is only a single thread, so selecting or checking it always succeeds
+            return "OK";
+        case 'q':
+        case 'Q':
+            return HandleQuery(Packet);
+        case 'v':
+            if (Packet.starts_with("vKill"))
+            {
+                m_HasKilled = true;
+                return "OK";
+            }
+            return "";
+        default:
+            return "";
+        }
+    }
+
+    std::string GDBServer::HandleQuery(std::string_view Packet)
+    {
+        if (Packet.starts_with("qSupported"))
+            return fmt::format("PacketSize={:x};qXfer:features:read+;QStartNoAckMode+", MaxPacketSize);
+        if (Packet == "QStartNoAckMode")
+        {
+            // NOTE: the packet itself is still acknowledged, which already happened when it was received
+            m_IsAckModeEnabled = false;
+            return "OK";
+        }
+        if (Packet == "qAttached")
+            return "1";
+        if (Packet == "qC")
+            return "QC1";
+        if (Packet == "qfThreadInfo")
+            return "m1";
+        if (Packet == "qsThreadInfo")
+            return "l";
+
+        constexpr std::string_view TargetDescriptionQuery = "qXfer:features:read:target.xml:";
+        if (Packet.starts_with(TargetDescriptionQuery))
+        {
+            uint32_t Offset, Length;
+            if (!ParseAddressAndLength(Packet.substr(TargetDescriptionQuery.size()), Offset, Length))
+                return "E01";
+            if (Offset >= TargetDescription.size())
+                return "l";
+
+            auto Chunk = TargetDescription.substr(Offset, std::min<size_t>(Length, MaxPacketSize / 2));
+            bool IsLast = Offset + Chunk.size() >= TargetDescription.size();
+            return (IsLast ? "l" : "m") + EscapeBinary(Chunk);
+        }
+
+        return "";
+    }
+
+    std::string GDBServer::ReadRegisters() const
+    {
+        std::string Result;
+        for (size_t Index = 0; Index < GuestRegisterCount; Index++)
+            Result += EncodeRegister(m_CPU.GetRegister(static_cast<Assembler::Register>(Index)));
+        Result += EncodeRegister(m_CPU.GetIP());
+        return Result;
+    }
+
+    bool GDBServer::WriteRegister(size_t Index, uint16_t Value)
+    {
+        if (Index < GuestRegisterCount)
+            m_CPU.SetRegister(static_cast<Assembler::Register>(Index), Value);
+        else if (Index == IPRegisterIndex)
+            m_CPU.SetIP(Value);
+        else
+            return false;
+        return true;
+    }
+
+    std::string GDBServer::Resume(std::string_view Arguments, bool IsStep)
+    {
+        if (!Arguments.empty())
+        {
+            uint32_t Address;
+            if (!ParseHex(Arguments, Address) || Address > 0xFFFF)
+                return "E01";
+            m_CPU.SetIP(static_cast<uint16_t>(Address));
+        }
+
+        if (IsStep)
+        {
+            auto Result = m_CPU.RunUntil([](const CPU&) { return true; }, 1);
+            m_LastStopReply = GetStopReply(Result.Reason);
+            return m_LastStopReply;
+        }
+
+        // NOTE: the CPU runs in slices, so that the debugger can interrupt it without a check after every instruction
+        while (true)
+        {
+            auto Result = m_CPU.RunFor(m_SliceCycles);
+            if (Result.Reason != StopReason::CycleLimit)
+            {
+                m_LastStopReply = GetStopReply(Result.Reason);
+                break;
+            }
+            if (m_InterruptCheck && m_InterruptCheck())
+            {
+                m_LastStopReply = "S02";
+                break;
+            }
+        }
+        return m_LastStopReply;
+    }
+
+    std::string GDBServer::SetBreakpoint(std::string_view Arguments, bool IsInsert)
+    {
+        auto TypeSeparator = Arguments.find(',');
+        if (TypeSeparator == std::string_view::npos)
+            return "E01";
+
+        auto Type = Arguments.substr(0, TypeSeparator);
+        if (Type.size() != 1 || Type[0] < '0' || Type[0] > '4')
+            return "";
+
+        uint32_t Address, Kind;
+        if (!ParseAddressAndLength(Arguments.substr(TypeSeparator + 1), Address, Kind))
+            return "E01";
+
+        // NOTE: software and hardware breakpoints are the same thing here, the kind (the length of the instruction) is not needed
+        if (Type == "0" || Type == "1")
+        {
+            if (IsInsert)
+                m_CPU.AddBreakpoint(static_cast<uint16_t>(Address));
+            else
+                m_CPU.RemoveBreakpoint(static_cast<uint16_t>(Address));
+            return "OK";
+        }
+
+        // Watchpoints, for which the kind is the number of bytes to watch
+        static constexpr WatchpointKind Kinds[] = { WatchpointKind::Write, WatchpointKind::Read, WatchpointKind::Access };
+        if (Kind == 0 || Kind > 0xFFFF)
+            return "E01";
+
+        Watchpoint Range;
+        Range.Address = static_cast<uint16_t>(Address);
+        Range.Size = static_cast<uint16_t>(Kind);
+        Range.Kind = Kinds[Type[0] - '2'];
+        if (IsInsert ? !m_CPU.AddWatchpoint(Range) : !m_CPU.RemoveWatchpoint(Range))
+            return "E01";
+        return "OK";
+    }
+
+    std::string GDBServer::GetStopReply(StopReason Reason) const
+    {
+        switch (Reason)
+        {
+        case StopReason::Halted:
+            return "W00";
+        case StopReason::Fault:
+            return "S04";
+        case StopReason::Watchpoint:
+        {
+            // NOTE: the debugger finds the watchpoint by an address inside of its range
+            WatchpointHit Hit;
+            if (!m_CPU.GetWatchpointHit(Hit))
+                return "S05";
+
+            static constexpr const char* Names[] = { "rwatch", "watch", "awatch" };
+            return fmt::format("T05{}:{:x};", Names[static_cast<size_t>(Hit.Trigger.Kind)], Hit.Address);
+        }
+        default:
+            return "S05";
+        }
+    }
+
+    void GDBServer::SetInterruptCheck(std::function<bool()> InterruptCheck)
+    {
+        m_InterruptCheck = std::move(InterruptCheck);
+    }
+
+    bool GDBServer::HasDetached() const
+    {
+        return m_HasDetached;
+    }
+
+    bool GDBServer::HasKilled() const
+    {
+        return m_HasKilled;
+    }
+
+    uint16_t GDBServer::GetPort() const
+    {
+        return m_Port;
+    }
+
+#ifdef LCE_GDB_SERVER_USE_SOCKETS
+#ifdef MSG_NOSIGNAL
+    // A debugger that disconnects must not kill the emulator with SIGPIPE
+    static constexpr int SendFlags = MSG_NOSIGNAL;
+#else
+    static constexpr int SendFlags = 0;
+#endif
+
+    static void ReportSocketError(const char* Operation)
+    {
+        Common::ReportError(Common::ErrorSeverity::Error, { __FILE__, 0, __LINE__, 0 }, "GDB server: {} failed: {}", Operation, std::strerror(errno));
+    }
+
+    bool GDBServer::ListenTCP(uint16_t Port)
+    {
+        CloseSockets();
+
+        m_ListenSocket = socket(AF_INET, SOCK_STREAM, 0);
+        if (m_ListenSocket < 0)
+        {
+            ReportSocketError("socket");
+            return false;
+        }
+
+        int Enable = 1;
+        setsockopt(m_ListenSocket, SOL_SOCKET, SO_REUSEADDR, &Enable, sizeof(Enable));
+
+        // NOTE: only the loopback interface, the protocol has no authentication whatsoever
+        sockaddr_in Address = {};
+        Address.sin_family = AF_INET;
+        Address.sin_port = htons(Port);
+        Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t AddressLength = sizeof(Address);
+        if (bind(m_ListenSocket, reinterpret_cast<sockaddr*>(&Address), sizeof(Address)) < 0 || listen(m_ListenSocket, 1) < 0 ||
+            getsockname(m_ListenSocket, reinterpret_cast<sockaddr*>(&Address), &AddressLength) < 0)
+        {
+            ReportSocketError("listening on the loopback interface");
+            CloseSockets();
+            return false;
+        }
+
+        m_Port = ntohs(Address.sin_port);
+        return true;
+    }
+
+    bool GDBServer::ListenUnix(const std::filesystem::path& Path)
+    {
+        CloseSockets();
+
+        sockaddr_un Address = {};
+        Address.sun_family = AF_UNIX;
+        auto PathString = Path.string();
+        if (PathString.size() >= sizeof(Address.sun_path))
+        {
+            Common::ReportError(Common::ErrorSeverity::Error, { __FILE__, 0, __LINE__, 0 }, "GDB server: socket path {} is too long", PathString);
+            return false;
+        }
+        std::memcpy(Address.sun_path, PathString.c_str(), PathString.size() + 1);
+
+        m_ListenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (m_ListenSocket < 0)
+        {
+            ReportSocketError("socket");
+            return false;
+        }
+
+        // NOTE: a socket that is left over from an earlier run would make bind fail
+        std::error_code Error;
+        if (std::filesystem::is_socket(Path, Error))
+            std::filesystem::remove(Path, Error);
+
+        if (bind(m_ListenSocket, reinterpret_cast<sockaddr*>(&Address), sizeof(Address)) < 0 || listen(m_ListenSocket, 1) < 0)
+        {
+            ReportSocketError("listening on a Unix domain socket");
+            CloseSockets();
+            return false;
+        }
+
+        m_UnixSocketPath = Path;
+        return true;
+    }
+
+    bool GDBServer::Serve()
+    {
+        if (m_ListenSocket < 0)
+            return false;
+
+        m_Connection = accept(m_ListenSocket, nullptr, nullptr);
+        if (m_Connection < 0)
+        {
+            ReportSocketError("accept");
+            return false;
+        }
+
+        // NOTE: packets are small and every one of them waits for a reply, so they must not be delayed (fails harmlessly on Unix sockets)
+        int Enable = 1;
+        setsockopt(m_Connection, IPPROTO_TCP, TCP_NODELAY, &Enable, sizeof(Enable));
+
+        m_IsAckModeEnabled = true;
+        m_ReceiveBuffer.clear();
+        SetInterruptCheck([this] { return PollInterrupt(); });
+
+        std::string Packet;
+        while (!m_HasDetached && !m_HasKilled && ReceivePacket(Packet))
+        {
+            auto Reply = HandlePacket(Packet);
+            if (!m_HasKilled && !SendPacket(Reply))
+                break;
+        }
+
+        close(m_Connection);
+        m_Connection = -1;
+        return true;
+    }
+
+    bool GDBServer::ReceiveByte(char& Byte)
+    {
+        if (m_ReceiveBuffer.empty())
+        {
+            char Buffer[MaxPacketSize];
+            auto Received = recv(m_Connection, Buffer, sizeof(Buffer), 0);
+            if (Received <= 0)
+                return false;
+            m_ReceiveBuffer.assign(Buffer, Received);
+        }
+
+        Byte = m_ReceiveBuffer.front();
+        m_ReceiveBuffer.erase(0, 1);
+        return true;
+    }
+
+    bool GDBServer::ReceivePacket(std::string& Packet)
+    {
+        char Byte;
+        while (ReceiveByte(Byte))
+        {
+            // NOTE: acknowledgements are not waited for, so only a request to send the last packet again matters
+            if (Byte == '-' && !m_LastSentPacket.empty())
+                Send(m_LastSentPacket);
+            if (Byte != '$')
+                continue;
+
+            Packet.clear();
+            uint8_t Checksum = 0;
+            while (ReceiveByte(Byte) && Byte != '#')
+            {
+                Packet += Byte;
+                Checksum += static_cast<uint8_t>(Byte);
+            }
+
+            char ChecksumText[2];
+            if (!ReceiveByte(ChecksumText[0]) || !ReceiveByte(ChecksumText[1]))
+                return false;
+
+            uint32_t ReceivedChecksum;
+            if (m_IsAckModeEnabled && (!ParseHex({ ChecksumText, 2 }, ReceivedChecksum) || ReceivedChecksum != Checksum))
+            {
+                Send("-");
+                continue;
+            }
+
+            if (m_IsAckModeEnabled)
+                Send("+");
+            return true;
+        }
+        return false;
+    }
+
+    bool GDBServer::Send(std::string_view Bytes)
+    {
+        while (!Bytes.empty())
+        {
+            auto Sent = send(m_Connection, Bytes.data(), Bytes.size(), SendFlags);
+            if (Sent <= 0)
+                return false;
+            Bytes.remove_prefix(Sent);
+        }
+        return true;
+    }
+
+    bool GDBServer::SendPacket(std::string_view Packet)
+    {
+        uint8_t Checksum = 0;
+        for (auto Character : Packet)
+            Checksum += static_cast<uint8_t>(Character);
+
+        m_LastSentPacket = fmt::format("${}#{:02x}", Packet, Checksum);
+        return Send(m_LastSentPacket);
+    }
+
+    bool GDBServer::PollInterrupt()
+    {
+        bool IsInterrupted = false;
+        pollfd Descriptor = { m_Connection, POLLIN, 0 };
+        while (poll(&Descriptor, 1, 0) > 0)
+        {
+            char Buffer[MaxPacketSize];
+            auto Received = recv(m_Connection, Buffer, sizeof(Buffer), 0);
+
+            // NOTE: a debugger that went away stops the program too, Serve notices it once it tries to reply
+            if (Received <= 0)
+                return true;
+
+            // Anything but the interrupt byte is kept until the program stops
+            for (ssize_t Index = 0; Index < Received; Index++)
+            {
+                if (Buffer[Index] == '\x03')
+                    IsInterrupted = true;
+                else
+                    m_ReceiveBuffer += Buffer[Index];
+            }
+        }
+        return IsInterrupted;
+    }
+
+    void GDBServer::CloseSockets()
+    {
+        if (m_Connection >= 0)
+            close(m_Connection);
+        if (m_ListenSocket >= 0)
+            close(m_ListenSocket);
+        m_Connection = m_ListenSocket = -1;
+        m_Port = 0;
+
+        if (!m_UnixSocketPath.empty())
+        {
+            std::error_code Error;
+            std::filesystem::remove(m_UnixSocketPath, Error);
+            m_UnixSocketPath.clear();
+        }
+    }
+#else
+    bool GDBServer::ListenTCP(uint16_t Port)
+    {
+        Common::ReportError(Common::ErrorSeverity::Error, { __FILE__, 0, __LINE__, 0 }, "GDB server: sockets are not supported on this host");
+        return false;
+    }
+
+    bool GDBServer::ListenUnix(const std::filesystem::path& Path)
+    {
+        return ListenTCP(0);
+    }
+
+    bool GDBServer::Serve()
+    {
+        return false;
+    }
+
+    bool GDBServer::ReceiveByte(char& Byte)
+    {
+        return false;
+    }
+
+    bool GDBServer::ReceivePacket(std::string& Packet)
+    {
+        return false;
+    }
+
+    bool GDBServer::Send(std::string_view Bytes)
+    {
+        return false;
+    }
+
+    bool GDBServer::SendPacket(std::string_view Packet)
+    {
+        return false;
+    }
+
+    bool GDBServer::PollInterrupt()
+    {
+        return false;
+    }
+
+    void GDBServer::CloseSockets()
+    {
+    }
+#endif
+} // namespace lce::Emulator
@@ -0,0 +1,93 @@
+#include "InputLog.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+namespace lce::Emulator
+{
+    static constexpr char InputLogMagic[8] = { 'L', 'C', 'E', 'I', 'N', 'P', 'U', 'T' };
+    static constexpr uint8_t InputLogVersion = 1;
+
+    // NOTE: every event is stored as the little-endian cycle, address and value
+    static constexpr size_t EncodedEventSize = 8 + 2 + 1;
+
+    void InputLog::Record(uint64_t Cycle, uint16_t Address, uint8_t Value)
+    {
+        m_Events.push_back({ Cycle, Address, Value });
+    }
+
+    bool InputLog::Replay(uint16_t Address, uint8_t& Value)
+    {
+        if (IsExhausted() || m_Events[m_ReplayPosition].Address != Address)
+            return false;
+
+        Value = m_Events[m_ReplayPosition++].Value;
+        return true;
+    }
+
+    void InputLog::Rewind()
+    {
+        m_ReplayPosition = 0;
+    }
+
+    bool InputLog::IsExhausted() const
+    {
+        return m_ReplayPosition >= m_Events.size();
+    }
+
+    const std::vector<InputEvent>& InputLog::GetEvents() const
+    {
+        return m_Events;
+    }
+
+    bool InputLog::Save(const std::filesystem::path& Path) const
+    {
+        std::ofstream Output(Path, std::ios::binary | std::ios::trunc);
+        if (!Output.is_open())
+            return false;
+
+        Output.write(InputLogMagic, sizeof(InputLogMagic));
+        Output.put(static_cast<char>(InputLogVersion));
+
+        for (const auto& Event : m_Events)
+        {
+            char Bytes[EncodedEventSize];
+            for (size_t Index = 0; Index < 8; Index++)
+                Bytes[Index] = static_cast<char>(Event.Cycle >> (Index * 8));
+            Bytes[8] = static_cast<char>(Event.Address & 0xFF);
+            Bytes[9] = static_cast<char>(Event.Address >> 8);
+            Bytes[10] = static_cast<char>(Event.Value);
+            Output.write(Bytes, sizeof(Bytes));
+        }
+
+        return Output.good();
+    }
+
+    std::unique_ptr<InputLog> InputLog::Load(const std::filesystem::path& Path)
+    {
+        std::ifstream Input(Path, std::ios::binary);
+        if (!Input.is_open())
+            return nullptr;
+
+        std::vector<uint8_t> Bytes{ std::istreambuf_iterator<char>(Input), std::istreambuf_iterator<char>() };
+        constexpr size_t HeaderSize = sizeof(InputLogMagic) + 1;
+        if (Bytes.size() < HeaderSize || !std::equal(std::begin(InputLogMagic), std::end(InputLogMagic), Bytes.begin()) ||
+            Bytes[sizeof(InputLogMagic)] != InputLogVersion || (Bytes.size() - HeaderSize) % EncodedEventSize != 0)
+            return nullptr;
+
+        auto Log = std::make_unique<InputLog>();
+        Log->m_Events.reserve((Bytes.size() - HeaderSize) / EncodedEventSize);
+        for (size_t Offset = HeaderSize; Offset < Bytes.size(); Offset += EncodedEventSize)
+        {
+            InputEvent Event;
+            for (size_t Index = 0; Index < 8; Index++)
+                Event.Cycle |= static_cast<uint64_t>(Bytes[Offset + Index]) << (Index * 8);
+            Event.Address = static_cast<uint16_t>(Bytes[Offset + 8] | (Bytes[Offset + 9] << 8));
+            Event.Value = Bytes[Offset + 10];
+            Log->m_Events.push_back(Event);
+        }
+
+        return Log;
+    }
+} // namespace lce::Emulator
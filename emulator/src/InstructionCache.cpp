@@ -0,0 +1,43 @@
+#include "InstructionCache.h"
+
+namespace lce::Emulator
+{
+    const DecodedInstruction& InstructionCache::Insert(uint16_t Address, const DecodedInstruction& Instruction)
+    {
+        auto& Page = m_Pages[Address >> PageShift];
+        if (!Page)
+            Page = std::make_unique<std::array<DecodedInstruction, PageSize>>();
+
+        // NOTE: an instruction can cross the page boundary, in which case writes to both pages have to invalidate it
+        m_CodePages.set(Address >> PageShift);
+        m_CodePages.set(static_cast<uint16_t>(Address + Instruction.Length - 1) >> PageShift);
+
+        auto& Entry = (*Page)[Address & PageMask];
+        Entry = Instruction;
+        return Entry;
+    }
+
+    void InstructionCache::Clear()
+    {
+        for (auto& Page : m_Pages)
+            Page.reset();
+        m_CodePages.reset();
+    }
+
+    void InstructionCache::InvalidateInstructionsOverlapping(uint16_t Address)
+    {
+        // Any instruction that starts at most MaxInstructionLength - 1 bytes before the modified byte might include it
+        for (uint16_t Offset = 0; Offset < MaxInstructionLength; Offset++)
+        {
+            uint16_t StartAddress = Address - Offset;
+
+            auto& Page = m_Pages[StartAddress >> PageShift];
+            if (!Page)
+                continue;
+
+            auto& Entry = (*Page)[StartAddress & PageMask];
+            if (Entry.Length > Offset)
+                Entry.Length = 0;
+        }
+    }
+} // namespace lce::Emulator
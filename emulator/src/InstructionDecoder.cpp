@@ -0,0 +1,246 @@
+#include "InstructionDecoder.h"
+
+namespace lce::Emulator
+{
+    enum class OperandType
+    {
+        Register = 0b00,
+        OneByteImmediate = 0b10,
+        TwoByteImmediate = 0b11
+    };
+
+    static constexpr Assembler::Opcode ExtractOpcode(uint8_t FirstByte)
+    {
+        return static_cast<Assembler::Opcode>((FirstByte >> 2) & 0x1F);
+    }
+
+    static constexpr OperandType ExtractFirstOperandType(uint8_t FirstByte)
+    {
+        return static_cast<OperandType>(FirstByte & 0x03);
+    }
+
+    static constexpr OperandType ExtractSecondOperandType(uint8_t SecondByte)
+    {
+        return static_cast<OperandType>(SecondByte >> 6);
+    }
+
+    static constexpr Assembler::Register ExtractFirstRegister(uint8_t SecondByte)
+    {
+        return static_cast<Assembler::Register>((SecondByte >> 3) & 0x07);
+    }
+
+    static constexpr Assembler::Register ExtractSecondRegister(uint8_t SecondByte)
+    {
+        return static_cast<Assembler::Register>(SecondByte & 0x07);
+    }
+
+    static constexpr size_t GetOperandCount(Assembler::Opcode Opcode)
+    {
+        switch (Opcode)
+        {
+        case Assembler::Opcode::Mov:
+        case Assembler::Opcode::Lda:
+        case Assembler::Opcode::Sta:
+        case Assembler::Opcode::Add:
+        case Assembler::Opcode::Sub:
+        case Assembler::Opcode::And:
+        case Assembler::Opcode::Or:
+        case Assembler::Opcode::Xor:
+        case Assembler::Opcode::Shl:
+        case Assembler::Opcode::Shr:
+            return 2;
+        case Assembler::Opcode::Not:
+        case Assembler::Opcode::Push:
+        case Assembler::Opcode::Pop:
+        case Assembler::Opcode::Jmp:
+        case Assembler::Opcode::Jz:
+        case Assembler::Opcode::Jv:
+        case Assembler::Opcode::Jc:
+        case Assembler::Opcode::Jn:
+        case Assembler::Opcode::Call:
+            return 1;
+        default:
+            return 0;
+        }
+    }
+
+    static constexpr HandlerID SelectHandler(Assembler::Opcode Opcode, bool HasImmediate, bool ImmediateIsFirstOperand)
+    {
+        // NOTE: sta is the only instruction that takes an immediate value as its first operand
+        if (ImmediateIsFirstOperand != (Opcode == Assembler::Opcode::Sta && HasImmediate) && GetOperandCount(Opcode) == 2)
+            return HandlerID::Invalid;
+
+#define SELECT_HANDLER(Name) (HasImmediate ? HandlerID::Name##Immediate : HandlerID::Name##Register)
+        switch (Opcode)
+        {
+        case Assembler::Opcode::Mov:
+            return SELECT_HANDLER(Mov);
+        case Assembler::Opcode::Lda:
+            return SELECT_HANDLER(Lda);
+        case Assembler::Opcode::Sta:
+            return SELECT_HANDLER(Sta);
+        case Assembler::Opcode::Add:
+            return SELECT_HANDLER(Add);
+        case Assembler::Opcode::Sub:
+            return SELECT_HANDLER(Sub);
+        case Assembler::Opcode::And:
+            return SELECT_HANDLER(And);
+        case Assembler::Opcode::Or:
+            return SELECT_HANDLER(Or);
+        case Assembler::Opcode::Xor:
+            return SELECT_HANDLER(Xor);
+        case Assembler::Opcode::Not:
+            return HasImmediate ? HandlerID::Invalid : HandlerID::Not;
+        case Assembler::Opcode::Shl:
+            return SELECT_HANDLER(Shl);
+        case Assembler::Opcode::Shr:
+            return SELECT_HANDLER(Shr);
+        case Assembler::Opcode::Push:
+            return SELECT_HANDLER(Push);
+        case Assembler::Opcode::Pop:
+            return HasImmediate ? HandlerID::Invalid : HandlerID::Pop;
+        case Assembler::Opcode::Jmp:
+            return SELECT_HANDLER(Jmp);
+        case Assembler::Opcode::Jz:
+            return SELECT_HANDLER(Jz);
+        case Assembler::Opcode::Jv:
+            return SELECT_HANDLER(Jv);
+        case Assembler::Opcode::Jc:
+            return SELECT_HANDLER(Jc);
+        case Assembler::Opcode::Jn:
+            return SELECT_HANDLER(Jn);
+        case Assembler::Opcode::Call:
+            return SELECT_HANDLER(Call);
+        case Assembler::Opcode::Ret:
+            return HandlerID::Ret;
+        case Assembler::Opcode::Nop:
+            return HandlerID::Nop;
+        case Assembler::Opcode::Hlt:
+            return HandlerID::Hlt;
+        default:
+            return HandlerID::Invalid;
+        }
+#undef SELECT_HANDLER
+    }
+
+    static constexpr DecodeTableEntry DecodeOperandTypes(uint8_t FirstByte, uint8_t SecondByte)
+    {
+        DecodeTableEntry Result = {};
+        Result.Opcode = ExtractOpcode(FirstByte);
+        Result.Length = 1;
+
+        auto FirstOperandType = ExtractFirstOperandType(FirstByte);
+        auto SecondOperandType = ExtractSecondOperandType(SecondByte);
+
+        bool IsValid = true;
+        auto OperandCount = GetOperandCount(Result.Opcode);
+        if (OperandCount == 1)
+        {
+            // NOTE: the immediate value of single operand instructions immediately follows the first byte
+            if (FirstOperandType == OperandType::Register)
+            {
+                Result.Length = 2;
+            }
+            else if (FirstOperandType == OperandType::OneByteImmediate)
+            {
+                Result.Length = 2;
+                Result.ImmediateOffset = 1;
+                Result.ImmediateSize = 1;
+            }
+            else if (FirstOperandType == OperandType::TwoByteImmediate)
+            {
+                Result.Length = 3;
+                Result.ImmediateOffset = 1;
+                Result.ImmediateSize = 2;
+            }
+            else
+            {
+                IsValid = false;
+            }
+        }
+        else if (OperandCount == 2)
+        {
+            // NOTE: only one of the operands can be an immediate, and it is always stored in the third and fourth bytes
+            Result.NeedsSecondByte = true;
+            auto ImmediateType = FirstOperandType != OperandType::Register ? FirstOperandType : SecondOperandType;
+            if (FirstOperandType != OperandType::Register && SecondOperandType != OperandType::Register)
+            {
+                IsValid = false;
+            }
+            else if (ImmediateType == OperandType::Register)
+            {
+                Result.Length = 2;
+            }
+            else if (ImmediateType == OperandType::OneByteImmediate)
+            {
+                Result.Length = 3;
+                Result.ImmediateOffset = 2;
+                Result.ImmediateSize = 1;
+            }
+            else if (ImmediateType == OperandType::TwoByteImmediate)
+            {
+                Result.Length = 4;
+                Result.ImmediateOffset = 2;
+                Result.ImmediateSize = 2;
+            }
+            else
+            {
+                IsValid = false;
+            }
+        }
+
+        bool HasImmediate = Result.ImmediateSize > 0;
+        bool ImmediateIsFirstOperand = HasImmediate && FirstOperandType != OperandType::Register;
+        Result.ID = IsValid ? SelectHandler(Result.Opcode, HasImmediate, ImmediateIsFirstOperand) : HandlerID::Invalid;
+        if (Result.ID == HandlerID::Invalid)
+        {
+            // NOTE: invalid instructions are skipped one byte at a time, whatever their operands were meant to be
+            Result.Length = 1;
+            Result.ImmediateOffset = 0;
+            Result.ImmediateSize = 0;
+        }
+
+        return Result;
+    }
+
+    static constexpr std::array<DecodeTableEntry, DecodeTableSize> GenerateDecodeTable()
+    {
+        std::array<DecodeTableEntry, DecodeTableSize> Table = {};
+        for (size_t FirstByte = 0; FirstByte < 256; FirstByte++)
+        {
+            for (size_t OperandTypeBits = 0; OperandTypeBits < 4; OperandTypeBits++)
+            {
+                auto SecondByte = static_cast<uint8_t>(OperandTypeBits << 6);
+                Table[GetDecodeTableIndex(static_cast<uint8_t>(FirstByte), SecondByte)] = DecodeOperandTypes(static_cast<uint8_t>(FirstByte), SecondByte);
+            }
+        }
+        return Table;
+    }
+
+    constexpr std::array<DecodeTableEntry, DecodeTableSize> DecodeTable = GenerateDecodeTable();
+
+    static_assert(DecodeTable[GetDecodeTableIndex(EncodedNOP, 0)].ID == HandlerID::Nop);
+    static_assert(DecodeTable[GetDecodeTableIndex(EncodedNOP, 0xFF)].ID == HandlerID::Nop);
+
+    DecodedInstruction DecodeInstruction(const uint8_t* Bytes)
+    {
+        // NOTE: entries of instructions that have fewer than two operands do not depend on the second byte
+        const auto& Entry = DecodeTable[GetDecodeTableIndex(Bytes[0], Bytes[1])];
+
+        DecodedInstruction Result = {};
+        Result.ID = Entry.ID;
+        Result.Opcode = Entry.Opcode;
+        Result.Length = Entry.Length;
+        if (Entry.Length > 1)
+        {
+            Result.FirstRegister = static_cast<uint8_t>(ExtractFirstRegister(Bytes[1]));
+            Result.SecondRegister = static_cast<uint8_t>(ExtractSecondRegister(Bytes[1]));
+        }
+        if (Entry.ImmediateSize == 1)
+            Result.Immediate = Bytes[Entry.ImmediateOffset];
+        else if (Entry.ImmediateSize == 2)
+            Result.Immediate = Bytes[Entry.ImmediateOffset] | (Bytes[Entry.ImmediateOffset + 1] << 8);
+
+        return Result;
+    }
+} // namespace lce::Emulator
@@ -0,0 +1,824 @@
+#include "JITCompiler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+
+#ifdef LCE_ENABLE_JIT
+#include <sys/mman.h>
+#endif
+
+#include "CPU.h"
+
+namespace lce::Emulator
+{
+    using X86::Register;
+
+    // Size of the buffer that holds generated code; once it is full all code is dropped and compiled again when needed
+    static constexpr size_t CodeMemorySize = 4 * 1024 * 1024;
+
+    static constexpr Register ContextRegister = Register::RBX;
+
+    /*
+     * Host registers that hold R0-R3, RSP and RFL while native code runs. All of them except R10 are callee-saved,
+     * so R10 is the only one that has to be preserved around calls into the CPU.
+     */
+    static constexpr Register GuestRegisterMap[] = { Register::R12, Register::R13, Register::R14, Register::R15, Register::RBP, Register::R10 };
+
+    static constexpr Register StackRegister = GuestRegisterMap[static_cast<uint8_t>(Assembler::Register::RSP)];
+    static constexpr Register FlagsRegister = GuestRegisterMap[static_cast<uint8_t>(Assembler::Register::RFL)];
+
+    static constexpr Register CalleeSavedRegisters[] = { Register::RBX, Register::RBP, Register::R12, Register::R13, Register::R14, Register::R15 };
+
+    static constexpr uint32_t GuestFlagMask = 0x000F;
+
+#ifdef LCE_ENABLE_JIT
+    static uint8_t* AllocateCodeMemory(size_t Size)
+    {
+        void* Memory = mmap(nullptr, Size, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return Memory == MAP_FAILED ? nullptr : static_cast<uint8_t*>(Memory);
+    }
+
+    // NOTE: code memory is never writable and executable at the same time
+    static bool SetCodeMemoryWritable(uint8_t* Memory, size_t Size, bool Writable)
+    {
+        return mprotect(Memory, Size, Writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC) == 0;
+    }
+
+    static void FreeCodeMemory(uint8_t* Memory, size_t Size)
+    {
+        munmap(Memory, Size);
+    }
+#else
+    static uint8_t* AllocateCodeMemory(size_t)
+    {
+        return nullptr;
+    }
+
+    static bool SetCodeMemoryWritable(uint8_t*, size_t, bool)
+    {
+        return false;
+    }
+
+    static void FreeCodeMemory(uint8_t*, size_t)
+    {
+    }
+#endif
+
+    static Register MapRegister(uint8_t GuestRegister)
+    {
+        return GuestRegisterMap[GuestRegister];
+    }
+
+    // Bit mask of the guest registers that the instruction names explicitly
+    static uint8_t GetRegisterOperands(const DecodedInstruction& Instruction)
+    {
+        uint8_t First = 1 << Instruction.FirstRegister;
+        uint8_t Second = 1 << Instruction.SecondRegister;
+
+        switch (Instruction.ID)
+        {
+        case HandlerID::MovRegister:
+        case HandlerID::LdaRegister:
+        case HandlerID::StaRegister:
+        case HandlerID::AddRegister:
+        case HandlerID::SubRegister:
+        case HandlerID::AndRegister:
+        case HandlerID::OrRegister:
+        case HandlerID::XorRegister:
+        case HandlerID::ShlRegister:
+        case HandlerID::ShrRegister:
+            return First | Second;
+        case HandlerID::MovImmediate:
+        case HandlerID::LdaImmediate:
+        case HandlerID::AddImmediate:
+        case HandlerID::SubImmediate:
+        case HandlerID::AndImmediate:
+        case HandlerID::OrImmediate:
+        case HandlerID::XorImmediate:
+        case HandlerID::ShlImmediate:
+        case HandlerID::ShrImmediate:
+        case HandlerID::Not:
+        case HandlerID::PushRegister:
+        case HandlerID::Pop:
+        case HandlerID::JmpRegister:
+        case HandlerID::JzRegister:
+        case HandlerID::JvRegister:
+        case HandlerID::JcRegister:
+        case HandlerID::JnRegister:
+        case HandlerID::CallRegister:
+            return First;
+        case HandlerID::StaImmediate:
+            return Second;
+        default:
+            return 0;
+        }
+    }
+
+    static bool IsShift(HandlerID ID)
+    {
+        return ID == HandlerID::ShlImmediate || ID == HandlerID::ShrImmediate;
+    }
+
+    static bool IsFlagSetting(HandlerID ID)
+    {
+        switch (ID)
+        {
+        case HandlerID::AddRegister:
+        case HandlerID::AddImmediate:
+        case HandlerID::SubRegister:
+        case HandlerID::SubImmediate:
+        case HandlerID::AndRegister:
+        case HandlerID::AndImmediate:
+        case HandlerID::OrRegister:
+        case HandlerID::OrImmediate:
+        case HandlerID::XorRegister:
+        case HandlerID::XorImmediate:
+        case HandlerID::Not:
+        case HandlerID::ShlImmediate:
+        case HandlerID::ShrImmediate:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    static bool IsConditionalJump(HandlerID ID)
+    {
+        switch (ID)
+        {
+        case HandlerID::JzRegister:
+        case HandlerID::JzImmediate:
+        case HandlerID::JvRegister:
+        case HandlerID::JvImmediate:
+        case HandlerID::JcRegister:
+        case HandlerID::JcImmediate:
+        case HandlerID::JnRegister:
+        case HandlerID::JnImmediate:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    static bool HasImmediateTarget(HandlerID ID)
+    {
+        switch (ID)
+        {
+        case HandlerID::JmpImmediate:
+        case HandlerID::JzImmediate:
+        case HandlerID::JvImmediate:
+        case HandlerID::JcImmediate:
+        case HandlerID::JnImmediate:
+        case HandlerID::CallImmediate:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    static bool CanCompile(const DecodedInstruction& Instruction)
+    {
+        // NOTE: the two registers past RFL are encodable but do not exist in hardware, so they are left to the interpreter
+        if (GetRegisterOperands(Instruction) >> std::size(GuestRegisterMap))
+            return false;
+
+        switch (Instruction.ID)
+        {
+        case HandlerID::Invalid:
+        case HandlerID::Breakpoint:
+        case HandlerID::ShlRegister:
+        case HandlerID::ShrRegister:
+            return false;
+        case HandlerID::ShlImmediate:
+        case HandlerID::ShrImmediate:
+            // Host shifts mask the count, so shifting out all bits does not produce the guest result
+            return Instruction.Immediate < 16;
+        case HandlerID::CallRegister:
+            // The target would have to be read before the return address is pushed
+            return Instruction.FirstRegister != static_cast<uint8_t>(Assembler::Register::RSP);
+        default:
+            return true;
+        }
+    }
+
+    JITCompiler::JITCompiler(CPU& Processor)
+        : m_CPU(Processor)
+    {
+        m_Context.Compiler = this;
+
+        m_CodeMemory = AllocateCodeMemory(CodeMemorySize);
+        if (!m_CodeMemory)
+            return;
+
+        m_CodeMemorySize = CodeMemorySize;
+        EmitRuntime();
+        SyncMemoryMap();
+    }
+
+    JITCompiler::~JITCompiler()
+    {
+        if (m_CodeMemory)
+            FreeCodeMemory(m_CodeMemory, m_CodeMemorySize);
+    }
+
+    bool JITCompiler::IsAvailable() const
+    {
+        return m_Enter != nullptr;
+    }
+
+    bool JITCompiler::Compile(const TranslatedBlock& Block)
+    {
+        if (!IsAvailable())
+            return false;
+
+        std::vector<GuestInstruction> Instructions;
+        uint32_t Address = Block.StartAddress;
+        bool ReachedUnsupportedInstruction = false;
+        for (const auto& Operation : Block.Operations)
+        {
+            for (const auto* Instruction : { &Operation.First, &Operation.Second })
+            {
+                // NOTE: operations that are not superinstructions leave the second instruction empty
+                if (!Instruction->Handler || ReachedUnsupportedInstruction)
+                    continue;
+
+                if (!CanCompile(*Instruction))
+                {
+                    ReachedUnsupportedInstruction = true;
+                    continue;
+                }
+
+                Instructions.push_back({ static_cast<uint16_t>(Address), *Instruction });
+                Address += Instruction->Length;
+            }
+        }
+
+        if (Instructions.empty())
+            return false;
+
+        size_t FirstPage = Block.StartAddress >> PageShift;
+        size_t LastPage = (Address - 1) >> PageShift;
+        for (size_t PageIndex = FirstPage; PageIndex <= LastPage; PageIndex++)
+        {
+            if (m_SelfModifyingPages.test(PageIndex))
+                return false;
+        }
+
+        const uint8_t* Entry = nullptr;
+        for (int Attempt = 0; Attempt < 2 && !Entry; Attempt++)
+        {
+            auto* Base = m_CodeMemory + m_CodeMemoryUsed;
+            X86::Emitter Emitter(Base);
+            EmitBlock(Emitter, Instructions, Address);
+
+            if (CommitCode(Emitter))
+                Entry = Base;
+            else if (Attempt == 0)
+                Flush(); // Code memory is full, start over with an empty one
+        }
+
+        if (!Entry)
+            return false;
+
+        auto& Entries = m_NativeEntries[FirstPage];
+        if (!Entries)
+        {
+            Entries = std::make_unique<std::array<const uint8_t*, PageSize>>();
+            m_Context.NativeCode[FirstPage] = Entries->data();
+        }
+        (*Entries)[Block.StartAddress & PageMask] = Entry;
+
+        for (size_t PageIndex = FirstPage; PageIndex <= LastPage; PageIndex++)
+        {
+            m_NativeBlocksByPage[PageIndex].push_back({ Block.StartAddress, Address });
+            m_NativeCodePages.set(PageIndex);
+            m_Context.WritePages[PageIndex] = nullptr;
+        }
+
+        return true;
+    }
+
+    void JITCompiler::Execute()
+    {
+        const auto* Entries = m_Context.NativeCode[m_CPU.m_IP >> PageShift];
+        assert(Entries && Entries[m_CPU.m_IP & PageMask]);
+
+        // NOTE: native code keeps RFL in a host register, so the flags that the CPU has not computed yet are needed now
+        m_CPU.MaterializeFlags();
+        std::copy_n(m_CPU.m_Registers, MappedRegisterCount, m_Context.Registers);
+        m_Context.IP = m_CPU.m_IP;
+        m_Context.IsHalted = false;
+
+        m_StartCycleCount = m_CPU.m_CycleCount;
+        m_CycleBudget = static_cast<int64_t>(std::min<uint64_t>(m_CPU.m_CycleLimit - m_CPU.m_CycleCount, INT64_MAX));
+        m_Context.CyclesLeft = m_CycleBudget;
+
+        m_IsExecuting = true;
+        m_Enter(&m_Context, Entries[m_CPU.m_IP & PageMask]);
+        m_IsExecuting = false;
+
+        std::copy_n(m_Context.Registers, MappedRegisterCount, m_CPU.m_Registers);
+        m_CPU.m_IP = m_Context.IP;
+        SyncCycleCount();
+        if (m_Context.IsHalted)
+            m_CPU.m_IsHalted = true;
+    }
+
+    void JITCompiler::LowerCycleLimit(uint64_t CycleLimit)
+    {
+        if (!m_IsExecuting)
+            return;
+
+        // NOTE: the budget shrinks together with the remaining cycles, so the cycle count is not affected
+        SyncCycleCount();
+        auto CyclesLeft = static_cast<int64_t>(std::min<uint64_t>(CycleLimit > m_CPU.m_CycleCount ? CycleLimit - m_CPU.m_CycleCount : 0, INT64_MAX));
+        if (CyclesLeft < m_Context.CyclesLeft)
+        {
+            m_CycleBudget -= m_Context.CyclesLeft - CyclesLeft;
+            m_Context.CyclesLeft = CyclesLeft;
+        }
+    }
+
+    void JITCompiler::OnCodeCached(uint16_t Address, uint8_t Length)
+    {
+        m_Context.WritePages[Address >> PageShift] = nullptr;
+        m_Context.WritePages[static_cast<uint16_t>(Address + Length - 1) >> PageShift] = nullptr;
+    }
+
+    void JITCompiler::SyncMemoryMap()
+    {
+        for (size_t PageIndex = 0; PageIndex < PageCount; PageIndex++)
+        {
+            const auto& Page = m_CPU.m_Pages[PageIndex];
+            bool ContainsCode = m_CPU.m_InstructionCache.ContainsCode(static_cast<uint16_t>(PageIndex << PageShift)) || m_NativeCodePages.test(PageIndex);
+
+            // NOTE: pages that are shared with snapshots are written through the CPU, which makes a private copy first
+            m_Context.ReadPages[PageIndex] = Page.HostMemory;
+            m_Context.WritePages[PageIndex] = ContainsCode ? nullptr : Page.WritableHostMemory;
+        }
+    }
+
+    void JITCompiler::Flush()
+    {
+        for (auto& Entries : m_NativeEntries)
+            Entries.reset();
+        m_Context.NativeCode.fill(nullptr);
+
+        for (auto& Blocks : m_NativeBlocksByPage)
+            Blocks.clear();
+        m_NativeCodePages.reset();
+
+        // NOTE: pages get another chance after a flush, e.g. code that was loaded over older code is not self-modifying
+        m_SelfModifyingPages.reset();
+
+        m_CodeMemoryUsed = m_RuntimeSize;
+    }
+
+    void JITCompiler::EmitRuntime()
+    {
+        X86::Emitter Emitter(m_CodeMemory);
+
+        // Dispatcher: looks up the native code of the block that starts at the guest address in EAX
+        Emitter.AluImmediate64(X86::AluOperation::Cmp, ContextRegister, offsetof(Context, CyclesLeft), 0);
+        auto BudgetExhausted = Emitter.JumpForward(X86::Condition::LessOrEqual);
+        Emitter.Mov32(Register::RCX, Register::RAX);
+        Emitter.ShiftImmediate32(X86::ShiftOperation::Shr, Register::RCX, PageShift);
+        Emitter.Load64(Register::RDX, ContextRegister, Register::RCX, 8, offsetof(Context, NativeCode));
+        Emitter.Test64(Register::RDX, Register::RDX);
+        auto PageNotCompiled = Emitter.JumpForward(X86::Condition::Zero);
+        Emitter.MovZeroExtend8(Register::RCX, Register::RAX);
+        Emitter.Load64(Register::RDX, Register::RDX, Register::RCX, 8, 0);
+        Emitter.Test64(Register::RDX, Register::RDX);
+        auto BlockNotCompiled = Emitter.JumpForward(X86::Condition::Zero);
+        Emitter.Jump(Register::RDX);
+
+        // Exit: stores the guest state and returns to the caller of the entry point
+        Emitter.Bind(BudgetExhausted);
+        Emitter.Bind(PageNotCompiled);
+        Emitter.Bind(BlockNotCompiled);
+        auto ExitOffset = Emitter.Code().size();
+        Emitter.Store16(ContextRegister, offsetof(Context, IP), Register::RAX);
+        for (size_t Index = 0; Index < MappedRegisterCount; Index++)
+            Emitter.Store16(ContextRegister, offsetof(Context, Registers) + Index * sizeof(uint16_t), GuestRegisterMap[Index]);
+        Emitter.AddImmediate64(Register::RSP, 8);
+        for (auto It = std::rbegin(CalleeSavedRegisters); It != std::rend(CalleeSavedRegisters); ++It)
+            Emitter.Pop(*It);
+        Emitter.Return();
+
+        // Entry: void Enter(Context* Context, const uint8_t* Target)
+        auto EntryOffset = Emitter.Code().size();
+        for (auto SavedRegister : CalleeSavedRegisters)
+            Emitter.Push(SavedRegister);
+        // NOTE: keeps the stack 16-byte aligned for calls into the CPU
+        Emitter.SubImmediate64(Register::RSP, 8);
+        Emitter.Mov64(ContextRegister, Register::RDI);
+        for (size_t Index = 0; Index < MappedRegisterCount; Index++)
+            Emitter.LoadZeroExtend16(GuestRegisterMap[Index], ContextRegister, offsetof(Context, Registers) + Index * sizeof(uint16_t));
+        Emitter.Jump(Register::RSI);
+
+        if (!CommitCode(Emitter))
+            return;
+
+        m_RuntimeSize = m_CodeMemoryUsed;
+        m_Dispatcher = m_CodeMemory;
+        m_Exit = m_CodeMemory + ExitOffset;
+        m_Enter = reinterpret_cast<EntryFunction>(m_CodeMemory + EntryOffset);
+    }
+
+    void JITCompiler::EmitBlock(X86::Emitter& Emitter, const std::vector<GuestInstruction>& Instructions, uint32_t EndAddress) const
+    {
+        // NOTE: FlagsPending means that the flag bits of the previous instruction are in EAX but have not been merged
+        //       into RFL yet, HostFlagsValid that the host condition codes still describe the same result
+        bool FlagsPending = false;
+        bool HostFlagsValid = false;
+
+        Emitter.AluImmediate64(X86::AluOperation::Sub, ContextRegister, offsetof(Context, CyclesLeft), static_cast<int32_t>(Instructions.size()));
+
+        for (size_t Index = 0; Index < Instructions.size(); Index++)
+        {
+            const auto& [Address, Instruction] = Instructions[Index];
+            const auto* Following = Index + 1 < Instructions.size() ? &Instructions[Index + 1].Instruction : nullptr;
+            auto NextAddress = static_cast<uint16_t>(Address + Instruction.Length);
+            auto FollowingInstructionCount = static_cast<uint32_t>(Instructions.size() - Index - 1);
+
+            if (IsFlagSetting(Instruction.ID))
+            {
+                EmitFlagSettingInstruction(Emitter, Instruction);
+
+                // Flags that are overwritten by the next instruction before anything could read them are never stored
+                constexpr uint8_t FlagsRegisterBit = 1 << static_cast<uint8_t>(Assembler::Register::RFL);
+                if (Following && IsFlagSetting(Following->ID) && !(GetRegisterOperands(*Following) & FlagsRegisterBit))
+                    continue;
+
+                // NOTE: host shifts leave the overflow flag undefined, while the guest always clears it
+                EmitMaterializeFlags(Emitter, !IsShift(Instruction.ID));
+                if (Following && IsConditionalJump(Following->ID))
+                {
+                    FlagsPending = true;
+                    HostFlagsValid = !IsShift(Instruction.ID);
+                    continue;
+                }
+
+                EmitMergeFlags(Emitter);
+                continue;
+            }
+
+            switch (Instruction.ID)
+            {
+            case HandlerID::MovRegister:
+                Emitter.Mov16(MapRegister(Instruction.FirstRegister), MapRegister(Instruction.SecondRegister));
+                break;
+            case HandlerID::MovImmediate:
+                Emitter.MovImmediate16(MapRegister(Instruction.FirstRegister), Instruction.Immediate);
+                break;
+            case HandlerID::LdaRegister:
+            case HandlerID::LdaImmediate:
+                if (Instruction.ID == HandlerID::LdaImmediate)
+                    Emitter.MovImmediate32(Register::RCX, Instruction.Immediate);
+                else
+                    Emitter.MovZeroExtend16(Register::RCX, MapRegister(Instruction.SecondRegister));
+                EmitReadWord(Emitter);
+                Emitter.Mov16(MapRegister(Instruction.FirstRegister), Register::RAX);
+                break;
+            case HandlerID::StaRegister:
+            case HandlerID::StaImmediate:
+                if (Instruction.ID == HandlerID::StaImmediate)
+                    Emitter.MovImmediate32(Register::RCX, Instruction.Immediate);
+                else
+                    Emitter.MovZeroExtend16(Register::RCX, MapRegister(Instruction.FirstRegister));
+                Emitter.MovZeroExtend16(Register::RDX, MapRegister(Instruction.SecondRegister));
+                EmitWriteWord(Emitter, Instruction, NextAddress, FollowingInstructionCount);
+                break;
+            case HandlerID::PushRegister:
+            case HandlerID::PushImmediate:
+                if (Instruction.ID == HandlerID::PushImmediate)
+                    Emitter.MovImmediate32(Register::RDX, Instruction.Immediate);
+                else
+                    Emitter.MovZeroExtend16(Register::RDX, MapRegister(Instruction.FirstRegister));
+                Emitter.MovZeroExtend16(Register::RCX, StackRegister);
+                Emitter.AluImmediate16(X86::AluOperation::Add, StackRegister, 2);
+                EmitWriteWord(Emitter, Instruction, NextAddress, FollowingInstructionCount);
+                break;
+            case HandlerID::Pop:
+                Emitter.AluImmediate16(X86::AluOperation::Sub, StackRegister, 2);
+                Emitter.MovZeroExtend16(Register::RCX, StackRegister);
+                EmitReadWord(Emitter);
+                Emitter.Mov16(MapRegister(Instruction.FirstRegister), Register::RAX);
+                break;
+            case HandlerID::JmpRegister:
+            case HandlerID::JmpImmediate:
+                EmitLoadJumpTarget(Emitter, Instruction);
+                Emitter.Jump(m_Dispatcher);
+                return;
+            case HandlerID::JzRegister:
+            case HandlerID::JzImmediate:
+            case HandlerID::JvRegister:
+            case HandlerID::JvImmediate:
+            case HandlerID::JcRegister:
+            case HandlerID::JcImmediate:
+            case HandlerID::JnRegister:
+            case HandlerID::JnImmediate:
+                EmitConditionalJump(Emitter, Instruction, NextAddress, FlagsPending, HostFlagsValid);
+                return;
+            case HandlerID::CallRegister:
+            case HandlerID::CallImmediate:
+                Emitter.MovImmediate32(Register::RDX, NextAddress);
+                Emitter.MovZeroExtend16(Register::RCX, StackRegister);
+                Emitter.AluImmediate16(X86::AluOperation::Add, StackRegister, 2);
+                EmitWriteWord(Emitter, Instruction, NextAddress, FollowingInstructionCount);
+                EmitLoadJumpTarget(Emitter, Instruction);
+                Emitter.Jump(m_Dispatcher);
+                return;
+            case HandlerID::Ret:
+                Emitter.AluImmediate16(X86::AluOperation::Sub, StackRegister, 2);
+                Emitter.MovZeroExtend16(Register::RCX, StackRegister);
+                EmitReadWord(Emitter);
+                Emitter.Jump(m_Dispatcher);
+                return;
+            case HandlerID::Nop:
+                break;
+            case HandlerID::Hlt:
+                Emitter.StoreImmediate8(ContextRegister, offsetof(Context, IsHalted), 1);
+                Emitter.MovImmediate32(Register::RAX, NextAddress);
+                Emitter.Jump(m_Exit);
+                return;
+            default:
+                assert(false && "Instruction can not be compiled");
+                break;
+            }
+        }
+
+        // The block does not end with a jump (or was cut short), so execution continues right after it
+        Emitter.MovImmediate32(Register::RAX, static_cast<uint16_t>(EndAddress));
+        Emitter.Jump(m_Dispatcher);
+    }
+
+    bool JITCompiler::CommitCode(const X86::Emitter& Emitter)
+    {
+        // NOTE: blocks are aligned to 16 bytes, which is what the host fetches at once
+        auto Size = (Emitter.Code().size() + 15) & ~static_cast<size_t>(15);
+        if (m_CodeMemoryUsed + Size > m_CodeMemorySize)
+            return false;
+
+        if (!SetCodeMemoryWritable(m_CodeMemory, m_CodeMemorySize, true))
+            return false;
+        std::memcpy(m_CodeMemory + m_CodeMemoryUsed, Emitter.Code().data(), Emitter.Code().size());
+        SetCodeMemoryWritable(m_CodeMemory, m_CodeMemorySize, false);
+
+        m_CodeMemoryUsed += Size;
+        return true;
+    }
+
+    void JITCompiler::EmitFlagSettingInstruction(X86::Emitter& Emitter, const DecodedInstruction& Instruction) const
+    {
+        auto Destination = MapRegister(Instruction.FirstRegister);
+
+        X86::AluOperation Operation;
+        switch (Instruction.Opcode)
+        {
+        case Assembler::Opcode::Add:
+            Operation = X86::AluOperation::Add;
+            break;
+        case Assembler::Opcode::Sub:
+            Operation = X86::AluOperation::Sub;
+            break;
+        case Assembler::Opcode::And:
+            Operation = X86::AluOperation::And;
+            break;
+        case Assembler::Opcode::Or:
+            Operation = X86::AluOperation::Or;
+            break;
+        case Assembler::Opcode::Xor:
+            Operation = X86::AluOperation::Xor;
+            break;
+        case Assembler::Opcode::Not:
+            // NOTE: not does not modify host flags, test sets zero and sign and clears carry and overflow
+            Emitter.Not16(Destination);
+            Emitter.Test16(Destination, Destination);
+            return;
+        case Assembler::Opcode::Shl:
+        case Assembler::Opcode::Shr:
+            // A shift by zero leaves host flags untouched, while the guest still sets them from the value
+            if (Instruction.Immediate == 0)
+                Emitter.Test16(Destination, Destination);
+            else
+                Emitter.ShiftImmediate16(Instruction.Opcode == Assembler::Opcode::Shl ? X86::ShiftOperation::Shl : X86::ShiftOperation::Shr, Destination, static_cast<uint8_t>(Instruction.Immediate));
+            return;
+        default:
+            assert(false && "Instruction does not set flags");
+            return;
+        }
+
+        if (Instruction.ID == HandlerID::AddImmediate || Instruction.ID == HandlerID::SubImmediate || Instruction.ID == HandlerID::AndImmediate ||
+            Instruction.ID == HandlerID::OrImmediate || Instruction.ID == HandlerID::XorImmediate)
+            Emitter.AluImmediate16(Operation, Destination, Instruction.Immediate);
+        else
+            Emitter.Alu16(Operation, Destination, MapRegister(Instruction.SecondRegister));
+    }
+
+    void JITCompiler::EmitMaterializeFlags(X86::Emitter& Emitter, bool IncludeOverflow) const
+    {
+        // Builds the guest flag bits in EAX using only instructions that do not modify host flags
+        Emitter.SetCondition(X86::Condition::Zero, Register::RAX);
+        Emitter.SetCondition(X86::Condition::Sign, Register::RCX);
+        Emitter.SetCondition(X86::Condition::Carry, Register::RDX);
+        if (IncludeOverflow)
+            Emitter.SetCondition(X86::Condition::Overflow, Register::R8);
+
+        Emitter.MovZeroExtend8(Register::RAX, Register::RAX);
+        Emitter.MovZeroExtend8(Register::RCX, Register::RCX);
+        Emitter.MovZeroExtend8(Register::RDX, Register::RDX);
+        Emitter.Lea32(Register::RAX, Register::RAX, Register::RCX, 2);
+        Emitter.Lea32(Register::RAX, Register::RAX, Register::RDX, 4);
+        if (IncludeOverflow)
+        {
+            Emitter.MovZeroExtend8(Register::R8, Register::R8);
+            Emitter.Lea32(Register::RAX, Register::RAX, Register::R8, 8);
+        }
+    }
+
+    void JITCompiler::EmitMergeFlags(X86::Emitter& Emitter) const
+    {
+        // NOTE: the rest of the bits are reserved, so we leave them untouched
+        Emitter.AluImmediate32(X86::AluOperation::And, FlagsRegister, ~GuestFlagMask);
+        Emitter.Alu32(X86::AluOperation::Or, FlagsRegister, Register::RAX);
+    }
+
+    void JITCompiler::EmitConditionalJump(X86::Emitter& Emitter, const DecodedInstruction& Instruction, uint16_t NextAddress, bool FlagsPending, bool HostFlagsValid) const
+    {
+        X86::Condition HostCondition;
+        Flag GuestFlag;
+        switch (Instruction.Opcode)
+        {
+        case Assembler::Opcode::Jz:
+            HostCondition = X86::Condition::Zero;
+            GuestFlag = Flag::Zero;
+            break;
+        case Assembler::Opcode::Jn:
+            HostCondition = X86::Condition::Sign;
+            GuestFlag = Flag::Negative;
+            break;
+        case Assembler::Opcode::Jc:
+            HostCondition = X86::Condition::Carry;
+            GuestFlag = Flag::Carry;
+            break;
+        default:
+            HostCondition = X86::Condition::Overflow;
+            GuestFlag = Flag::Overflow;
+            break;
+        }
+
+        X86::Emitter::Fixup Taken;
+        if (FlagsPending && HostFlagsValid)
+        {
+            Taken = Emitter.JumpForward(HostCondition);
+        }
+        else
+        {
+            Emitter.TestImmediate32(FlagsPending ? Register::RAX : FlagsRegister, static_cast<uint16_t>(GuestFlag));
+            Taken = Emitter.JumpForward(X86::Condition::NotZero);
+        }
+
+        if (FlagsPending)
+            EmitMergeFlags(Emitter);
+        Emitter.MovImmediate32(Register::RAX, NextAddress);
+        Emitter.Jump(m_Dispatcher);
+
+        Emitter.Bind(Taken);
+        if (FlagsPending)
+            EmitMergeFlags(Emitter);
+        EmitLoadJumpTarget(Emitter, Instruction);
+        Emitter.Jump(m_Dispatcher);
+    }
+
+    void JITCompiler::EmitLoadJumpTarget(X86::Emitter& Emitter, const DecodedInstruction& Instruction) const
+    {
+        if (HasImmediateTarget(Instruction.ID))
+            Emitter.MovImmediate32(Register::RAX, Instruction.Immediate);
+        else
+            Emitter.MovZeroExtend16(Register::RAX, MapRegister(Instruction.FirstRegister));
+    }
+
+    void JITCompiler::EmitReadWord(X86::Emitter& Emitter) const
+    {
+        // Reads the word at the guest address in ECX into EAX
+
+        // NOTE: words that cross a page boundary always take the slow path
+        Emitter.CmpImmediate8(Register::RCX, PageMask);
+        auto CrossesPage = Emitter.JumpForward(X86::Condition::Zero);
+        Emitter.Mov32(Register::RDX, Register::RCX);
+        Emitter.ShiftImmediate32(X86::ShiftOperation::Shr, Register::RDX, PageShift);
+        Emitter.Load64(Register::RDX, ContextRegister, Register::RDX, 8, offsetof(Context, ReadPages));
+        Emitter.Test64(Register::RDX, Register::RDX);
+        auto NotHostMemory = Emitter.JumpForward(X86::Condition::Zero);
+        Emitter.MovZeroExtend8(Register::RCX, Register::RCX);
+        Emitter.LoadZeroExtend16(Register::RAX, Register::RDX, Register::RCX, 0);
+        auto Done = Emitter.JumpForward();
+
+        Emitter.Bind(CrossesPage);
+        Emitter.Bind(NotHostMemory);
+        EmitHelperCall(Emitter, reinterpret_cast<const void*>(&ReadWordFromGuest));
+
+        Emitter.Bind(Done);
+    }
+
+    void JITCompiler::EmitWriteWord(X86::Emitter& Emitter, const DecodedInstruction& Instruction, uint16_t NextAddress, uint32_t FollowingInstructionCount) const
+    {
+        // Writes the word in EDX to the guest address in ECX
+        Emitter.CmpImmediate8(Register::RCX, PageMask);
+        auto CrossesPage = Emitter.JumpForward(X86::Condition::Zero);
+        Emitter.Mov32(Register::RAX, Register::RCX);
+        Emitter.ShiftImmediate32(X86::ShiftOperation::Shr, Register::RAX, PageShift);
+        Emitter.Load64(Register::RAX, ContextRegister, Register::RAX, 8, offsetof(Context, WritePages));
+        Emitter.Test64(Register::RAX, Register::RAX);
+        auto NotHostMemory = Emitter.JumpForward(X86::Condition::Zero);
+        Emitter.MovZeroExtend8(Register::RCX, Register::RCX);
+        Emitter.Store16(Register::RAX, Register::RCX, 0, Register::RDX);
+        auto Done = Emitter.JumpForward();
+
+        Emitter.Bind(CrossesPage);
+        Emitter.Bind(NotHostMemory);
+        EmitHelperCall(Emitter, reinterpret_cast<const void*>(&WriteWordToGuest));
+
+        // The write has overwritten compiled code, which might include the rest of this block
+        Emitter.TestImmediate32(Register::RAX, 1);
+        auto CodeIsValid = Emitter.JumpForward(X86::Condition::Zero);
+        // NOTE: the rest of the block is skipped, so its cycles are given back
+        if (FollowingInstructionCount > 0)
+            Emitter.AluImmediate64(X86::AluOperation::Add, ContextRegister, offsetof(Context, CyclesLeft), static_cast<int32_t>(FollowingInstructionCount));
+        if (Instruction.Opcode == Assembler::Opcode::Call)
+            EmitLoadJumpTarget(Emitter, Instruction);
+        else
+            Emitter.MovImmediate32(Register::RAX, NextAddress);
+        Emitter.Jump(m_Dispatcher);
+
+        Emitter.Bind(CodeIsValid);
+        Emitter.Bind(Done);
+    }
+
+    void JITCompiler::EmitHelperCall(X86::Emitter& Emitter, const void* Helper) const
+    {
+        // Calls Helper(Compiler, ECX, EDX) and leaves the result in EAX
+        Emitter.Push(FlagsRegister);
+        Emitter.SubImmediate64(Register::RSP, 8);
+        Emitter.Load64(Register::RDI, ContextRegister, offsetof(Context, Compiler));
+        Emitter.Mov32(Register::RSI, Register::RCX);
+        Emitter.MovImmediate64(Register::RAX, reinterpret_cast<uint64_t>(Helper));
+        Emitter.Call(Register::RAX);
+        Emitter.AddImmediate64(Register::RSP, 8);
+        Emitter.Pop(FlagsRegister);
+    }
+
+    void JITCompiler::InvalidateNativeCodeContaining(uint16_t Address)
+    {
+        if (!DropNativeCodeContaining(Address))
+            return;
+
+        m_SelfModifyingPages.set(Address >> PageShift);
+        m_NativeCodeInvalidated = true;
+    }
+
+    bool JITCompiler::DropNativeCodeContaining(uint16_t Address)
+    {
+        bool HasDroppedCode = false;
+        auto& Blocks = m_NativeBlocksByPage[Address >> PageShift];
+        size_t Index = 0;
+        while (Index < Blocks.size())
+        {
+            auto Block = Blocks[Index];
+            if (Address < Block.StartAddress || Address >= Block.EndAddress)
+            {
+                Index++;
+                continue;
+            }
+
+            // NOTE: the code itself stays in memory until the next flush, since it might be executing right now
+            (*m_NativeEntries[Block.StartAddress >> PageShift])[Block.StartAddress & PageMask] = nullptr;
+            for (size_t PageIndex = Block.StartAddress >> PageShift; PageIndex <= (Block.EndAddress - 1) >> PageShift; PageIndex++)
+                std::erase_if(m_NativeBlocksByPage[PageIndex], [&](const NativeBlock& Other) { return Other.StartAddress == Block.StartAddress; });
+            HasDroppedCode = true;
+        }
+        return HasDroppedCode;
+    }
+
+    void JITCompiler::SyncCycleCount()
+    {
+        m_CPU.m_CycleCount = m_StartCycleCount + static_cast<uint64_t>(m_CycleBudget - m_Context.CyclesLeft);
+    }
+
+    uint32_t JITCompiler::ReadWordFromGuest(JITCompiler* Compiler, uint32_t Address)
+    {
+        Compiler->SyncCycleCount();
+        return Compiler->m_CPU.ReadWord(static_cast<uint16_t>(Address));
+    }
+
+    uint32_t JITCompiler::WriteWordToGuest(JITCompiler* Compiler, uint32_t Address, uint32_t Value)
+    {
+        Compiler->SyncCycleCount();
+        Compiler->m_NativeCodeInvalidated = false;
+        Compiler->m_CPU.WriteWord(static_cast<uint16_t>(Address), static_cast<uint16_t>(Value));
+        return Compiler->m_NativeCodeInvalidated;
+    }
+} // namespace lce::Emulator
@@ -0,0 +1,143 @@
+#include "MappedFileMemoryBlock.h"
+
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "ErrorReporting.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define LCE_MAPPED_FILE_USE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace lce::Emulator
+{
+#ifdef LCE_MAPPED_FILE_USE_MMAP
+    std::shared_ptr<const MappedFile> MappedFile::Open(const std::filesystem::path& Path, uint16_t Size)
+    {
+        int Descriptor = open(Path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (Descriptor < 0)
+            return nullptr;
+
+        struct stat Status;
+        if (fstat(Descriptor, &Status) != 0 || !S_ISREG(Status.st_mode) || static_cast<uint64_t>(Status.st_size) > Size)
+        {
+            close(Descriptor);
+            return nullptr;
+        }
+
+        auto HostPageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        auto FileSize = static_cast<size_t>(Status.st_size);
+
+        /*
+         * Pages of a file mapping that lie entirely past the end of the file can not be accessed, so the whole view is
+         * reserved as anonymous zero pages first and the file is mapped over its beginning. The rest of the last page
+         * of the file reads as zero.
+         */
+        auto MappingSize = (static_cast<size_t>(Size) + HostPageSize - 1) / HostPageSize * HostPageSize;
+        void* Mapping = mmap(nullptr, MappingSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (Mapping == MAP_FAILED)
+        {
+            close(Descriptor);
+            return nullptr;
+        }
+
+        if (FileSize > 0 && mmap(Mapping, FileSize, PROT_READ, MAP_PRIVATE | MAP_FIXED, Descriptor, 0) == MAP_FAILED)
+        {
+            munmap(Mapping, MappingSize);
+            close(Descriptor);
+            return nullptr;
+        }
+
+        // NOTE: the mapping keeps its own reference to the file
+        close(Descriptor);
+
+        std::shared_ptr<MappedFile> File(new MappedFile);
+        File->m_Data = static_cast<const uint8_t*>(Mapping);
+        File->m_Size = Size;
+        File->m_FileSize = FileSize;
+        File->m_MappingSize = MappingSize;
+        return File;
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (m_MappingSize)
+            munmap(const_cast<uint8_t*>(m_Data), m_MappingSize);
+    }
+#else
+    std::shared_ptr<const MappedFile> MappedFile::Open(const std::filesystem::path& Path, uint16_t Size)
+    {
+        std::ifstream Input(Path, std::ios::binary);
+        if (!Input.is_open())
+            return nullptr;
+
+        std::shared_ptr<MappedFile> File(new MappedFile);
+        File->m_Buffer.assign(std::istreambuf_iterator<char>(Input), std::istreambuf_iterator<char>());
+        if (File->m_Buffer.size() > Size)
+            return nullptr;
+
+        File->m_FileSize = File->m_Buffer.size();
+        File->m_Buffer.resize(Size);
+        File->m_Data = File->m_Buffer.data();
+        File->m_Size = Size;
+        return File;
+    }
+
+    MappedFile::~MappedFile() = default;
+#endif
+
+    MappedFileMemoryBlock::MappedFileMemoryBlock(std::shared_ptr<const MappedFile> File)
+        : m_File(std::move(File))
+    {
+        assert(m_File);
+    }
+
+    uint8_t MappedFileMemoryBlock::Read(uint16_t RelativeAddress) const
+    {
+        return m_File->Data()[RelativeAddress];
+    }
+
+    void MappedFileMemoryBlock::Write(uint16_t RelativeAddress, uint8_t)
+    {
+        Common::ReportError(Common::ErrorSeverity::Warning, { __FILE__, 0, __LINE__, 0 }, "Writing to read-only memory at offset 0x{0:X}", RelativeAddress);
+    }
+
+    uint16_t MappedFileMemoryBlock::Size() const
+    {
+        return m_File->Size();
+    }
+
+    void MappedFileMemoryBlock::ReadRange(uint16_t RelativeAddress, std::span<uint8_t> Bytes) const
+    {
+        assert(RelativeAddress + Bytes.size() <= m_File->Size());
+        std::memcpy(Bytes.data(), m_File->Data() + RelativeAddress, Bytes.size());
+    }
+
+    void MappedFileMemoryBlock::WriteRange(uint16_t RelativeAddress, std::span<const uint8_t> Bytes)
+    {
+        Common::ReportError(Common::ErrorSeverity::Warning, { __FILE__, 0, __LINE__, 0 }, "Writing 0x{0:X} bytes to read-only memory at offset 0x{1:X}", Bytes.size(), RelativeAddress);
+    }
+
+    uint16_t MappedFileMemoryBlock::ReadWord(uint16_t RelativeAddress) const
+    {
+        assert(RelativeAddress + 2 <= m_File->Size());
+        const auto* Bytes = m_File->Data() + RelativeAddress;
+        return Bytes[0] | (Bytes[1] << 8);
+    }
+
+    const uint8_t* MappedFileMemoryBlock::DirectPointer(uint16_t RelativeAddress) const
+    {
+        return m_File->Data() + RelativeAddress;
+    }
+
+    std::unique_ptr<MemoryBlock> MappedFileMemoryBlock::Clone() const
+    {
+        return std::make_unique<MappedFileMemoryBlock>(m_File);
+    }
+} // namespace lce::Emulator
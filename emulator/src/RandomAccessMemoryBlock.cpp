@@ -1,24 +1,113 @@
 #include "RandomAccessMemoryBlock.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+
 namespace lce::Emulator
 {
     RandomAccessMemoryBlock::RandomAccessMemoryBlock(uint16_t Size)
+        : m_Size(Size)
     {
-        m_Memory.resize(Size, 0);
+        m_Pages.resize((Size + PageSize - 1) / PageSize);
+        for (auto& Entry : m_Pages)
+            Entry = std::make_shared<Page>();
     }
 
     uint8_t RandomAccessMemoryBlock::Read(uint16_t RelativeAddress) const
     {
-        return m_Memory[RelativeAddress];
+        return DirectPointer(RelativeAddress)[0];
     }
 
     void RandomAccessMemoryBlock::Write(uint16_t RelativeAddress, uint8_t Value)
     {
-        m_Memory[RelativeAddress] = Value;
+        MakePagePrivate(RelativeAddress)[RelativeAddress % PageSize] = Value;
     }
 
     uint16_t RandomAccessMemoryBlock::Size() const
     {
-        return static_cast<uint16_t>(m_Memory.size());
+        return m_Size;
+    }
+
+    void RandomAccessMemoryBlock::ReadRange(uint16_t RelativeAddress, std::span<uint8_t> Bytes) const
+    {
+        assert(RelativeAddress + Bytes.size() <= m_Size);
+
+        size_t Offset = 0;
+        while (Offset < Bytes.size())
+        {
+            auto Address = static_cast<uint16_t>(RelativeAddress + Offset);
+            auto ChunkSize = std::min(Bytes.size() - Offset, PageSize - Address % PageSize);
+            std::memcpy(Bytes.data() + Offset, DirectPointer(Address), ChunkSize);
+            Offset += ChunkSize;
+        }
+    }
+
+    void RandomAccessMemoryBlock::WriteRange(uint16_t RelativeAddress, std::span<const uint8_t> Bytes)
+    {
+        assert(RelativeAddress + Bytes.size() <= m_Size);
+
+        size_t Offset = 0;
+        while (Offset < Bytes.size())
+        {
+            auto Address = static_cast<uint16_t>(RelativeAddress + Offset);
+            auto ChunkSize = std::min(Bytes.size() - Offset, PageSize - Address % PageSize);
+            std::memcpy(MakePagePrivate(Address) + Address % PageSize, Bytes.data() + Offset, ChunkSize);
+            Offset += ChunkSize;
+        }
+    }
+
+    uint16_t RandomAccessMemoryBlock::ReadWord(uint16_t RelativeAddress) const
+    {
+        if (RelativeAddress % PageSize == PageSize - 1)
+            return MemoryBlock::ReadWord(RelativeAddress);
+
+        const auto* Bytes = DirectPointer(RelativeAddress);
+        return Bytes[0] | (Bytes[1] << 8);
+    }
+
+    void RandomAccessMemoryBlock::WriteWord(uint16_t RelativeAddress, uint16_t Value)
+    {
+        if (RelativeAddress % PageSize == PageSize - 1)
+        {
+            MemoryBlock::WriteWord(RelativeAddress, Value);
+            return;
+        }
+
+        auto* Bytes = MakePagePrivate(RelativeAddress) + RelativeAddress % PageSize;
+        Bytes[0] = static_cast<uint8_t>(Value & 0xFF);
+        Bytes[1] = static_cast<uint8_t>(Value >> 8);
+    }
+
+    const uint8_t* RandomAccessMemoryBlock::DirectPointer(uint16_t RelativeAddress) const
+    {
+        return m_Pages[RelativeAddress >> PageShift]->data() + RelativeAddress % PageSize;
+    }
+
+    uint8_t* RandomAccessMemoryBlock::DirectWritePointer(uint16_t RelativeAddress)
+    {
+        auto& Entry = m_Pages[RelativeAddress >> PageShift];
+        if (Entry.use_count() > 1)
+            return nullptr;
+
+        // NOTE: other blocks could have read the page on other threads right before releasing it
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return Entry->data() + RelativeAddress % PageSize;
+    }
+
+    std::unique_ptr<MemoryBlock> RandomAccessMemoryBlock::Clone() const
+    {
+        return std::make_unique<RandomAccessMemoryBlock>(*this);
+    }
+
+    uint8_t* RandomAccessMemoryBlock::MakePagePrivate(uint16_t RelativeAddress)
+    {
+        auto& Entry = m_Pages[RelativeAddress >> PageShift];
+        if (Entry.use_count() > 1)
+            Entry = std::make_shared<Page>(*Entry);
+        else
+            std::atomic_thread_fence(std::memory_order_acquire);
+        return Entry->data();
     }
 }
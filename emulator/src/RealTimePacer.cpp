@@ -0,0 +1,103 @@
+#include "RealTimePacer.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace lce::Emulator
+{
+    // Bounds of the part of a wait that is spent spinning instead of sleeping
+    static constexpr std::chrono::nanoseconds MinSpinWindow{ 20'000 };
+    static constexpr std::chrono::nanoseconds MaxSpinWindow{ 2'000'000 };
+    static constexpr std::chrono::nanoseconds InitialSpinWindow{ 200'000 };
+
+    static void PauseWhileSpinning()
+    {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        __builtin_ia32_pause();
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+    RealTimePacer::RealTimePacer(const PacingOptions& Options)
+        : m_Options(Options)
+        , m_SpinWindow(InitialSpinWindow)
+    {
+    }
+
+    void RealTimePacer::Start()
+    {
+        m_StartTime = Clock::now();
+        m_LastWakeTime = m_StartTime;
+        m_ScheduleStart = m_StartTime;
+        m_ScheduleStartCycle = 0;
+
+        m_Cycles = 0;
+        m_Slices = 0;
+        m_Resyncs = 0;
+        m_TotalError = {};
+        m_MaxError = {};
+    }
+
+    void RealTimePacer::WaitForCycle(uint64_t Cycles)
+    {
+        m_Cycles = Cycles;
+        m_Slices++;
+
+        auto Deadline = m_ScheduleStart + CyclesToTime(Cycles - m_ScheduleStartCycle);
+        auto Now = Clock::now();
+
+        // NOTE: catching up after a long stall would run the guest flat out for just as long, so we start over instead
+        if (Now - Deadline > m_Options.MaxLag)
+        {
+            m_Resyncs++;
+            m_ScheduleStart = Now;
+            m_ScheduleStartCycle = Cycles;
+            m_LastWakeTime = Now;
+            return;
+        }
+
+        if (Deadline - Now > m_SpinWindow)
+        {
+            auto WakeTime = Deadline - m_SpinWindow;
+            std::this_thread::sleep_until(WakeTime);
+
+            // The spin window follows how late sleeps return, with a margin of twice the average delay
+            auto Overshoot = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - WakeTime);
+            m_SpinWindow = std::clamp((m_SpinWindow * 7 + Overshoot * 2) / 8, MinSpinWindow, MaxSpinWindow);
+        }
+
+        while ((Now = Clock::now()) < Deadline)
+            PauseWhileSpinning();
+
+        auto Error = std::chrono::duration_cast<std::chrono::nanoseconds>(Now - Deadline);
+        m_TotalError += Error;
+        m_MaxError = std::max(m_MaxError, Error);
+        m_LastWakeTime = Now;
+    }
+
+    PacingStatistics RealTimePacer::GetStatistics() const
+    {
+        PacingStatistics Statistics;
+        Statistics.Cycles = m_Cycles;
+        Statistics.Slices = m_Slices;
+        Statistics.Resyncs = m_Resyncs;
+        Statistics.WallTime = std::chrono::duration_cast<std::chrono::nanoseconds>(m_LastWakeTime - m_StartTime);
+        Statistics.GuestTime = CyclesToTime(m_Cycles);
+
+        // NOTE: slices that restarted the schedule did not wait for a deadline, so they have no error
+        if (m_Slices > m_Resyncs)
+            Statistics.MeanError = m_TotalError / static_cast<int64_t>(m_Slices - m_Resyncs);
+        Statistics.MaxError = m_MaxError;
+        return Statistics;
+    }
+
+    std::chrono::nanoseconds RealTimePacer::CyclesToTime(uint64_t Cycles) const
+    {
+        // NOTE: split into whole seconds and a remainder so that long sessions do not overflow 64 bits
+        constexpr uint64_t NanosecondsPerSecond = 1'000'000'000;
+        auto Seconds = Cycles / m_Options.ClockFrequency;
+        auto Remainder = Cycles % m_Options.ClockFrequency;
+        return std::chrono::nanoseconds(Seconds * NanosecondsPerSecond + Remainder * NanosecondsPerSecond / m_Options.ClockFrequency);
+    }
+} // namespace lce::Emulator
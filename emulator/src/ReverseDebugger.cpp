@@ -0,0 +1,177 @@
+#include "ReverseDebugger.h"
+
+#include <algorithm>
+#include <cassert>
+#include <optional>
+
+namespace lce::Emulator
+{
+    ReverseDebugger::ReverseDebugger(CPU& Processor, const ReverseDebuggerOptions& Options)
+        : m_CPU(Processor)
+        , m_Options(Options)
+        , m_Interval(std::max<uint64_t>(Options.InitialInterval, 1))
+    {
+        assert(m_Options.MaxCheckpoints >= 2);
+        TakeCheckpoint();
+    }
+
+    RunResult ReverseDebugger::RunFor(uint64_t MaxCycles)
+    {
+        return RunForward(MaxCycles, [this](uint64_t Cycles) { return m_CPU.RunFor(Cycles); });
+    }
+
+    RunResult ReverseDebugger::RunUntil(uint16_t Address, uint64_t MaxCycles)
+    {
+        return RunForward(MaxCycles, [this, Address](uint64_t Cycles) { return m_CPU.RunUntil(Address, Cycles); });
+    }
+
+    bool ReverseDebugger::ReverseStep()
+    {
+        auto Cycle = m_CPU.GetCycleCount();
+        if (Cycle <= GetOldestCycle())
+            return false;
+        return GoToCycle(Cycle - 1);
+    }
+
+    bool ReverseDebugger::ReverseContinue(uint16_t Address)
+    {
+        return ReverseContinue([Address](const CPU& Processor) { return Processor.GetIP() == Address; });
+    }
+
+    bool ReverseDebugger::ReverseContinue(const std::function<bool(const CPU&)>& Predicate)
+    {
+        // Searches the stretches between checkpoints from the latest to the oldest one, each of them is re-executed
+        // forward and the last point at which the predicate holds is the one that the CPU is moved to
+        auto EndCycle = m_CPU.GetCycleCount();
+        while (EndCycle > GetOldestCycle())
+        {
+            const auto& Start = RestoreCheckpointBefore(EndCycle - 1);
+
+            std::optional<uint64_t> Hit;
+            if (Predicate(m_CPU))
+                Hit = Start.Cycle;
+            while (!m_CPU.IsHalted() && m_CPU.GetCycleCount() < EndCycle)
+            {
+                auto Result = m_CPU.RunUntil(Predicate, EndCycle - m_CPU.GetCycleCount());
+                if (Result.Reason != StopReason::Breakpoint || m_CPU.GetCycleCount() >= EndCycle)
+                    break;
+                Hit = m_CPU.GetCycleCount();
+            }
+
+            if (Hit)
+                return GoToCycle(*Hit);
+            EndCycle = Start.Cycle;
+        }
+
+        GoToCycle(GetOldestCycle());
+        return false;
+    }
+
+    bool ReverseDebugger::GoToCycle(uint64_t Cycle)
+    {
+        if (m_Checkpoints.empty() || Cycle < GetOldestCycle())
+            return false;
+
+        // NOTE: RunUntil executes exactly one instruction at a time, so it stops on the requested cycle on every engine
+        RestoreCheckpointBefore(Cycle);
+        if (m_CPU.GetCycleCount() < Cycle)
+            m_CPU.RunUntil([](const CPU&) { return false; }, Cycle - m_CPU.GetCycleCount());
+        return m_CPU.GetCycleCount() == Cycle;
+    }
+
+    uint64_t ReverseDebugger::GetOldestCycle() const
+    {
+        return m_Checkpoints.empty() ? m_CPU.GetCycleCount() : m_Checkpoints.front().Cycle;
+    }
+
+    size_t ReverseDebugger::GetCheckpointCount() const
+    {
+        return m_Checkpoints.size();
+    }
+
+    uint64_t ReverseDebugger::GetCheckpointInterval() const
+    {
+        return m_Interval;
+    }
+
+    template <typename RunFunction>
+    RunResult ReverseDebugger::RunForward(uint64_t MaxCycles, const RunFunction& Run)
+    {
+        if (m_Checkpoints.empty())
+            return Run(MaxCycles);
+
+        auto StartTime = std::chrono::steady_clock::now();
+        auto StartCycle = m_CPU.GetCycleCount();
+        auto CycleLimit = MaxCycles > UINT64_MAX - StartCycle ? UINT64_MAX : StartCycle + MaxCycles;
+
+        // The CPU may have been moved back in time, checkpoints past that point could describe another future
+        while (m_Checkpoints.size() > 1 && m_Checkpoints.back().Cycle > StartCycle)
+            m_Checkpoints.pop_back();
+
+        RunResult Result;
+        Result.Reason = StopReason::CycleLimit;
+        while (!m_CPU.IsHalted() && m_CPU.GetCycleCount() < CycleLimit)
+        {
+            auto NextCheckpointCycle = m_Checkpoints.back().Cycle + m_Interval;
+            if (m_CPU.GetCycleCount() >= NextCheckpointCycle)
+            {
+                TakeCheckpoint();
+                continue;
+            }
+
+            auto SliceEnd = std::min(CycleLimit, NextCheckpointCycle);
+            auto Slice = Run(SliceEnd - m_CPU.GetCycleCount());
+            Result.Reason = Slice.Reason;
+            if (Slice.Reason != StopReason::CycleLimit)
+                break;
+        }
+
+        if (m_CPU.IsHalted())
+            Result.Reason = m_CPU.GetStopReason();
+        Result.Instructions = m_CPU.GetCycleCount() - StartCycle;
+        Result.WallTime = std::chrono::steady_clock::now() - StartTime;
+        return Result;
+    }
+
+    void ReverseDebugger::TakeCheckpoint()
+    {
+        Checkpoint NewCheckpoint;
+        NewCheckpoint.Cycle = m_CPU.GetCycleCount();
+        if (!m_CPU.Snapshot(NewCheckpoint.State))
+            return;
+
+        m_Checkpoints.push_back(std::move(NewCheckpoint));
+        if (m_Checkpoints.size() > m_Options.MaxCheckpoints)
+            ThinOutCheckpoints();
+    }
+
+    void ReverseDebugger::ThinOutCheckpoints()
+    {
+        if (m_Interval * 2 > m_Options.MaxInterval)
+        {
+            // NOTE: reverse steps must stay cheap, so the history gets shorter instead of sparser
+            m_Checkpoints.erase(m_Checkpoints.begin());
+            return;
+        }
+
+        // Drops every other checkpoint, counting from the latest one, but keeps the oldest so that the history stays as long
+        m_Interval *= 2;
+        std::vector<Checkpoint> Kept;
+        Kept.reserve(m_Checkpoints.size() / 2 + 1);
+        Kept.push_back(std::move(m_Checkpoints.front()));
+        auto FirstKept = m_Checkpoints.size() % 2 == 0 ? 1 : 2;
+        for (size_t Index = FirstKept; Index < m_Checkpoints.size(); Index += 2)
+            Kept.push_back(std::move(m_Checkpoints[Index]));
+        m_Checkpoints = std::move(Kept);
+    }
+
+    const ReverseDebugger::Checkpoint& ReverseDebugger::RestoreCheckpointBefore(uint64_t Cycle)
+    {
+        auto Next = std::upper_bound(m_Checkpoints.begin(), m_Checkpoints.end(), Cycle, [](uint64_t Value, const Checkpoint& Element) { return Value < Element.Cycle; });
+        assert(Next != m_Checkpoints.begin());
+
+        const auto& Found = *(Next - 1);
+        m_CPU.Restore(Found.State);
+        return Found;
+    }
+} // namespace lce::Emulator
@@ -0,0 +1,370 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cxxopts.hpp>
+
+#include "CPU.h"
+#include "ErrorReporting.h"
+#include "GDBServer.h"
+#include "MappedFileMemoryBlock.h"
+#include "RandomAccessMemoryBlock.h"
+
+using namespace lce::Emulator;
+
+// Address range given on the command line as ADDRESS:SIZE
+struct AddressRange
+{
+    uint16_t Address = 0;
+    uint16_t Size = 0;
+};
+
+// File that is copied into RAM before the program starts, given as FILE@ADDRESS
+struct LoadedFile
+{
+    std::filesystem::path Path;
+    uint16_t Address = 0;
+    std::vector<uint8_t> Bytes;
+};
+
+struct RunOptions
+{
+    std::filesystem::path ImagePath;
+    ExecutionEngine Engine = ExecutionEngine::Interpreter;
+
+    AddressRange ROM;
+    std::vector<AddressRange> RAM;
+    std::vector<LoadedFile> Files;
+
+    uint16_t StartAddress = 0x7FF0;
+    uint16_t StackAddress = 0x8000;
+    uint64_t MaxCycles = 0;
+
+    std::vector<AddressRange> Dumps;
+    std::string OutputFileName;
+    bool PrintStatistics = false;
+
+    // TCP port or path of a Unix domain socket to wait for a debugger on, empty if the program runs on its own
+    std::string GDBAddress;
+};
+
+// Accepts decimal numbers and hexadecimal numbers with a 0x prefix
+static bool ParseNumber(std::string_view Text, uint32_t Limit, uint32_t& Value)
+{
+    int Base = 10;
+    if (Text.starts_with("0x") || Text.starts_with("0X"))
+    {
+        Text.remove_prefix(2);
+        Base = 16;
+    }
+
+    auto [End, Error] = std::from_chars(Text.data(), Text.data() + Text.size(), Value, Base);
+    return !Text.empty() && Error == std::errc() && End == Text.data() + Text.size() && Value <= Limit;
+}
+
+static bool ParseAddressRange(std::string_view Text, AddressRange& Range)
+{
+    auto Separator = Text.find(':');
+    uint32_t Address, Size;
+    if (Separator == std::string_view::npos || !ParseNumber(Text.substr(0, Separator), 0xFFFF, Address) ||
+        !ParseNumber(Text.substr(Separator + 1), 0xFFFF, Size) || Size == 0 || Address + Size > 0x10000)
+    {
+        lce::Common::ReportError(lce::Common::ErrorSeverity::Fatal, {}, "Invalid address range '{}', expected ADDRESS:SIZE within the 64 KiB address space", Text);
+        return false;
+    }
+
+    Range.Address = static_cast<uint16_t>(Address);
+    Range.Size = static_cast<uint16_t>(Size);
+    return true;
+}
+
+static bool ReadLoadedFile(std::string_view Text, LoadedFile& File)
+{
+    auto Separator = Text.rfind('@');
+    uint32_t Address;
+    if (Separator == std::string_view::npos || !ParseNumber(Text.substr(Separator + 1), 0xFFFF, Address))
+    {
+        lce::Common::ReportError(lce::Common::ErrorSeverity::Fatal, {}, "Invalid file to load '{}', expected FILE@ADDRESS", Text);
+        return false;
+    }
+
+    File.Path = std::string(Text.substr(0, Separator));
+    File.Address = static_cast<uint16_t>(Address);
+
+    std::ifstream Input(File.Path, std::ios::binary);
+    if (!Input.is_open())
+    {
+        lce::Common::ReportError(lce::Common::ErrorSeverity::Fatal, {}, "Cannot open file {} for reading", File.Path.string());
+        return false;
+    }
+    File.Bytes.assign(std::istreambuf_iterator<char>(Input), std::istreambuf_iterator<char>());
+    return true;
+}
+
+static bool IsInRange(const AddressRange& Range, uint32_t Address, size_t Size)
+{
+    return Address >= Range.Address && Address + Size <= static_cast<uint32_t>(Range.Address) + Range.Size;
+}
+
+/*
+ * Builds a CPU with the memory map from the options: the image mapped read-only at the start of the ROM, every RAM
+ * range as its own block and the loaded files copied into RAM
+ */
+static std::unique_ptr<CPU> CreateCPU(const RunOptions& Options)
+{
+    auto Processor = std::make_unique<CPU>(Options.Engine);
+    Processor->Reset();
+
+    auto AddBlock = [&](std::unique_ptr<MemoryBlock> Block, uint16_t Address)
+    {
+        if (!Processor->AddMemoryBlock(std::move(Block), Address))
+        {
+            lce::Common::ReportError(lce::Common::ErrorSeverity::Fatal, {}, "Memory block at 0x{:04X} overlaps with another block", Address);
+            return false;
+        }
+        return true;
+    };
+
+    auto Image = MappedFile::Open(Options.ImagePath, Options.ROM.Size);
+    if (!Image)
+    {
+        lce::Common::ReportError(lce::Common::ErrorSeverity::Fatal, {}, "Cannot map image {}, it does not exist or is larger than the ROM ({} bytes)",
+                                 Options.ImagePath.string(), Options.ROM.Size);
+        return nullptr;
+    }
+    if (!AddBlock(std::make_unique<MappedFileMemoryBlock>(std::move(Image)), Options.ROM.Address))
+        return nullptr;
+
+    std::vector<RandomAccessMemoryBlock*> RAMBlocks;
+    for (const auto& Range : Options.RAM)
+    {
+        auto RAM = std::make_unique<RandomAccessMemoryBlock>(Range.Size);
+        RAMBlocks.push_back(RAM.get());
+        if (!AddBlock(std::move(RAM), Range.Address))
+            return nullptr;
+    }
+
+    // NOTE: files are written straight into the blocks, which is faster than going through the CPU
+    for (const auto& File : Options.Files)
+    {
+        size_t Index = 0;
+        while (Index < Options.RAM.size() && !IsInRange(Options.RAM[Index], File.Address, File.Bytes.size()))
+            Index++;
+        if (Index == Options.RAM.size())
+        {
+            lce::Common::ReportError(lce::Common::ErrorSeverity::Fatal, {}, "File {} does not fit into a single RAM block at 0x{:04X}", File.Path.string(),
+                                     File.Address);
+            return nullptr;
+        }
+        RAMBlocks[Index]->WriteRange(static_cast<uint16_t>(File.Address - Options.RAM[Index].Address), File.Bytes);
+    }
+    Processor->InvalidateInstructionCache();
+
+    Processor->SetRegister(lce::Assembler::Register::RSP, Options.StackAddress);
+    Processor->SetIP(Options.StartAddress);
+    return Processor;
+}
+
+// Prints 16 bytes per line, prefixed with the address of the first one
+static void PrintDump(std::FILE* Output, const std::vector<uint8_t>& Bytes, const AddressRange& Range)
+{
+    for (size_t Offset = 0; Offset < Bytes.size(); Offset += 16)
+    {
+        std::string Line = fmt::format("{:04x}:", Range.Address + Offset);
+        for (size_t Index = Offset; Index < std::min(Offset + 16, Bytes.size()); Index++)
+            Line += fmt::format(" {:02x}", Bytes[Index]);
+        Line += '\n';
+        std::fwrite(Line.data(), 1, Line.size(), Output);
+    }
+}
+
+/*
+ * Waits for a debugger and lets it control the CPU until it detaches, after which the program continues on its own.
+ * Returns false if the server could not be started or the debugger killed the program.
+ */
+static bool ServeDebugger(CPU& Processor, const std::string& Address)
+{
+    GDBServer Server(Processor);
+
+    uint32_t Port;
+    bool IsPort = ParseNumber(Address, 0xFFFF, Port);
+    if (IsPort ? !Server.ListenTCP(static_cast<uint16_t>(Port)) : !Server.ListenUnix(Address))
+        return false;
+
+    if (IsPort)
+        std::cerr << fmt::format("Waiting for a debugger on port {}", Server.GetPort()) << std::endl;
+    else
+        std::cerr << fmt::format("Waiting for a debugger on {}", Address) << std::endl;
+
+    return Server.Serve() && !Server.HasKilled();
+}
+
+static std::string DescribeBlock(const RunOptions& Options, size_t BlockIndex)
+{
+    if (BlockIndex == 0)
+        return fmt::format("rom 0x{:04X}-0x{:04X}", Options.ROM.Address, Options.ROM.Address + Options.ROM.Size - 1);
+
+    const auto& Range = Options.RAM[BlockIndex - 1];
+    return fmt::format("ram 0x{:04X}-0x{:04X}", Range.Address, Range.Address + Range.Size - 1);
+}
+
+int main(int ArgumentCount, char** Arguments)
+{
+    cxxopts::Options CommandLine("lce-run", "Loads an image into the ROM of a Little Computer and runs it");
+    CommandLine.add_options()
+        ("image", "Image that is mapped read-only at the start of the ROM", cxxopts::value<std::string>())
+        ("e,engine", "Execution engine: interpreter, threaded, blocks or jit", cxxopts::value<std::string>()->default_value("interpreter"))
+        ("rom", "Address range of the ROM as ADDRESS:SIZE", cxxopts::value<std::string>()->default_value("0x0000:0x8000"))
+        ("ram", "Address range of a RAM block as ADDRESS:SIZE, can be given several times", cxxopts::value<std::vector<std::string>>()->default_value("0x8000:0x4000"))
+        ("load", "File to copy into RAM before the program starts as FILE@ADDRESS, can be given several times", cxxopts::value<std::vector<std::string>>())
+        ("s,start-address", "Address at which the program starts", cxxopts::value<uint16_t>()->default_value("0x7FF0"))
+        ("stack-address", "Initial value of the stack pointer", cxxopts::value<uint16_t>()->default_value("0x8000"))
+        ("c,max-cycles", "Stop the program if it has not halted after this many cycles, 0 means no limit", cxxopts::value<uint64_t>()->default_value("0"))
+        ("dump", "Memory to print after the program stops as ADDRESS:SIZE, can be given several times", cxxopts::value<std::vector<std::string>>())
+        ("o,output", "File to write the final state and memory dumps to instead of the standard output", cxxopts::value<std::string>())
+        ("stats", "Print instructions retired, wall time, guest MIPS and the accesses to every memory block to the standard error")
+        ("gdb", "Wait for a GDB debugger on a TCP port of the loopback interface or on a Unix domain socket before running", cxxopts::value<std::string>())
+        ("h,help", "Print usage");
+    CommandLine.parse_positional("image");
+
+    RunOptions Options;
+    try
+    {
+        auto Result = CommandLine.parse(ArgumentCount, Arguments);
+        if (Result.count("help"))
+        {
+            std::cout << CommandLine.help() << std::endl;
+            return 0;
+        }
+
+        Options.ImagePath = Result["image"].as<std::string>();
+        Options.StartAddress = Result["start-address"].as<uint16_t>();
+        Options.StackAddress = Result["stack-address"].as<uint16_t>();
+        Options.MaxCycles = Result["max-cycles"].as<uint64_t>();
+        Options.PrintStatistics = Result["stats"].as<bool>();
+        if (Result.count("output"))
+            Options.OutputFileName = Result["output"].as<std::string>();
+        if (Result.count("gdb"))
+            Options.GDBAddress = Result["gdb"].as<std::string>();
+
+        auto EngineName = Result["engine"].as<std::string>();
+        if (!ParseExecutionEngine(EngineName, Options.Engine))
+        {
+            std::cout << "Unknown execution engine " << EngineName << std::endl;
+            return 1;
+        }
+
+        if (!ParseAddressRange(Result["rom"].as<std::string>(), Options.ROM))
+            return 1;
+        for (const auto& Text : Result["ram"].as<std::vector<std::string>>())
+        {
+            if (!ParseAddressRange(Text, Options.RAM.emplace_back()))
+                return 1;
+        }
+        if (Result.count("load"))
+        {
+            for (const auto& Text : Result["load"].as<std::vector<std::string>>())
+            {
+                if (!ReadLoadedFile(Text, Options.Files.emplace_back()))
+                    return 1;
+            }
+        }
+        if (Result.count("dump"))
+        {
+            for (const auto& Text : Result["dump"].as<std::vector<std::string>>())
+            {
+                if (!ParseAddressRange(Text, Options.Dumps.emplace_back()))
+                    return 1;
+            }
+        }
+    }
+    catch (...)
+    {
+        std::cout << "No image provided" << std::endl;
+        std::cout << CommandLine.help() << std::endl;
+        return 1;
+    }
+
+    auto Processor = CreateCPU(Options);
+    if (!Processor)
+        return 1;
+
+    if (!Options.GDBAddress.empty() && !ServeDebugger(*Processor, Options.GDBAddress))
+        return 1;
+
+    /*
+     * Counting makes every access go through the memory blocks, so the wall time and MIPS reported with --stats are
+     * those of a slower run. Accesses made while a debugger was attached are not counted.
+     */
+    if (Options.PrintStatistics)
+        Processor->CountMemoryAccesses(true);
+
+    auto MaxCycles = Options.MaxCycles ? Options.MaxCycles : UINT64_MAX;
+    auto Result = Processor->RunFor(MaxCycles);
+
+    std::FILE* Output = stdout;
+    if (!Options.OutputFileName.empty())
+    {
+        Output = std::fopen(Options.OutputFileName.c_str(), "w");
+        if (!Output)
+        {
+            lce::Common::ReportError(lce::Common::ErrorSeverity::Fatal, {}, "Cannot open output file {} for writing", Options.OutputFileName);
+            return 1;
+        }
+    }
+
+    auto State = fmt::format("{}: {}\n", GetStopReasonName(Result.Reason), Processor->SerializeState());
+    std::fwrite(State.data(), 1, State.size(), Output);
+    if (!Options.Dumps.empty())
+    {
+        // NOTE: memory is read from a snapshot, since the blocks themselves are owned by the CPU
+        CPUSnapshot Snapshot;
+        if (!Processor->Snapshot(Snapshot))
+        {
+            lce::Common::ReportError(lce::Common::ErrorSeverity::Fatal, {}, "Cannot dump memory, the memory blocks cannot be copied");
+            if (Output != stdout)
+                std::fclose(Output);
+            return 1;
+        }
+        for (const auto& Range : Options.Dumps)
+        {
+            std::vector<uint8_t> Bytes(Range.Size, 0);
+            for (const auto& [BlockAddress, Block] : Snapshot.MemoryBlocks)
+            {
+                for (size_t Offset = 0; Offset < Range.Size; Offset++)
+                {
+                    auto Address = Range.Address + Offset;
+                    if (Address >= BlockAddress && Address < BlockAddress + static_cast<size_t>(Block->Size()))
+                        Bytes[Offset] = Block->Read(static_cast<uint16_t>(Address - BlockAddress));
+                }
+            }
+            PrintDump(Output, Bytes, Range);
+        }
+    }
+    if (Output != stdout)
+        std::fclose(Output);
+
+    if (Options.PrintStatistics)
+    {
+        auto Seconds = std::chrono::duration<double>(Result.WallTime).count();
+        std::cerr << fmt::format("Instructions retired: {}\n", Result.Instructions);
+        std::cerr << fmt::format("Wall time: {:.3f} ms\n", Seconds * 1e3);
+        std::cerr << fmt::format("Guest MIPS: {:.1f}\n", Seconds > 0 ? Result.Instructions / Seconds / 1e6 : 0.0);
+
+        const auto& Counts = Processor->GetMemoryAccessCounts();
+        std::cerr << "Memory accesses in bytes (reads include instruction fetches):\n";
+        for (size_t Index = 0; Index < Counts.size(); Index++)
+            std::cerr << fmt::format("  {}: {} read, {} written\n", DescribeBlock(Options, Index), Counts[Index].BytesRead, Counts[Index].BytesWritten);
+        std::cerr << std::flush;
+    }
+
+    return Result.Reason == StopReason::Halted ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+#include "WorkStealingThreadPool.h"
+
+#include <algorithm>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "ErrorReporting.h"
+
+namespace lce::Emulator
+{
+    WorkStealingThreadPool::WorkStealingThreadPool(size_t ThreadCount, bool PinThreads)
+    {
+        if (ThreadCount == 0)
+            ThreadCount = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+        m_Queues = std::make_unique<WorkerQueue[]>(ThreadCount);
+        m_Threads.reserve(ThreadCount);
+        for (size_t WorkerIndex = 0; WorkerIndex < ThreadCount; WorkerIndex++)
+        {
+            m_Threads.emplace_back([this, WorkerIndex, PinThreads]()
+            {
+                if (PinThreads)
+                    PinCurrentThread(WorkerIndex);
+                WorkerMain(WorkerIndex);
+            });
+        }
+    }
+
+    WorkStealingThreadPool::~WorkStealingThreadPool()
+    {
+        {
+            std::lock_guard Lock(m_Mutex);
+            m_IsStopping = true;
+        }
+        m_WorkAvailable.notify_all();
+
+        for (auto& Thread : m_Threads)
+            Thread.join();
+    }
+
+    size_t WorkStealingThreadPool::GetThreadCount() const
+    {
+        return m_Threads.size();
+    }
+
+    void WorkStealingThreadPool::Run(size_t TaskCount, const Task& Function)
+    {
+        auto ThreadCount = m_Threads.size();
+        for (size_t WorkerIndex = 0; WorkerIndex < ThreadCount; WorkerIndex++)
+        {
+            std::lock_guard QueueLock(m_Queues[WorkerIndex].Mutex);
+            m_Queues[WorkerIndex].Begin = TaskCount * WorkerIndex / ThreadCount;
+            m_Queues[WorkerIndex].End = TaskCount * (WorkerIndex + 1) / ThreadCount;
+        }
+
+        std::unique_lock Lock(m_Mutex);
+        m_Task = &Function;
+        m_FinishedWorkers = 0;
+        m_Generation++;
+        m_WorkAvailable.notify_all();
+
+        m_WorkFinished.wait(Lock, [&]() { return m_FinishedWorkers == ThreadCount; });
+        m_Task = nullptr;
+    }
+
+    void WorkStealingThreadPool::WorkerMain(size_t WorkerIndex)
+    {
+        uint64_t LastGeneration = 0;
+        while (true)
+        {
+            const Task* Function;
+            {
+                std::unique_lock Lock(m_Mutex);
+                m_WorkAvailable.wait(Lock, [&]() { return m_IsStopping || m_Generation != LastGeneration; });
+                if (m_IsStopping)
+                    return;
+
+                LastGeneration = m_Generation;
+                Function = m_Task;
+            }
+
+            size_t TaskIndex;
+            while (PopTask(WorkerIndex, TaskIndex) || (StealTasks(WorkerIndex) && PopTask(WorkerIndex, TaskIndex)))
+                (*Function)(TaskIndex, WorkerIndex);
+
+            {
+                std::lock_guard Lock(m_Mutex);
+                m_FinishedWorkers++;
+            }
+            m_WorkFinished.notify_one();
+        }
+    }
+
+    bool WorkStealingThreadPool::PopTask(size_t WorkerIndex, size_t& TaskIndex)
+    {
+        auto& Queue = m_Queues[WorkerIndex];
+        std::lock_guard Lock(Queue.Mutex);
+        if (Queue.Begin == Queue.End)
+            return false;
+
+        TaskIndex = Queue.Begin++;
+        return true;
+    }
+
+    bool WorkStealingThreadPool::StealTasks(size_t WorkerIndex)
+    {
+        auto ThreadCount = m_Threads.size();
+        for (size_t Offset = 1; Offset < ThreadCount; Offset++)
+        {
+            auto& Victim = m_Queues[(WorkerIndex + Offset) % ThreadCount];
+
+            size_t Begin, End;
+            {
+                std::lock_guard Lock(Victim.Mutex);
+                if (Victim.Begin == Victim.End)
+                    continue;
+
+                // NOTE: the victim keeps working from the front of its range, so we take the back half (rounded up)
+                Begin = Victim.Begin + (Victim.End - Victim.Begin) / 2;
+                End = Victim.End;
+                Victim.End = Begin;
+            }
+
+            auto& Queue = m_Queues[WorkerIndex];
+            std::lock_guard Lock(Queue.Mutex);
+            Queue.Begin = Begin;
+            Queue.End = End;
+            return true;
+        }
+        return false;
+    }
+
+    void WorkStealingThreadPool::PinCurrentThread(size_t WorkerIndex)
+    {
+#if defined(__linux__)
+        auto CoreCount = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+        cpu_set_t CPUs;
+        CPU_ZERO(&CPUs);
+        CPU_SET(WorkerIndex % CoreCount, &CPUs);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(CPUs), &CPUs) != 0)
+            Common::ReportError(Common::ErrorSeverity::Warning, {}, "Cannot pin worker thread {} to a core", WorkerIndex);
+#else
+        Common::ReportError(Common::ErrorSeverity::Warning, {}, "Thread pinning is not supported on this platform");
+#endif
+    }
+} // namespace lce::Emulator
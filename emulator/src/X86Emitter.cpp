@@ -0,0 +1,409 @@
+#include "X86Emitter.h"
+
+#include <cassert>
+#include <cstring>
+
+namespace lce::Emulator::X86
+{
+    static constexpr uint8_t OperandSizePrefix = 0x66;
+
+    static uint8_t Encode(Register Register)
+    {
+        return static_cast<uint8_t>(Register);
+    }
+
+    // Without a REX prefix the encodings of SPL, BPL, SIL and DIL refer to AH, CH, DH and BH instead
+    static bool NeedsRexForByteAccess(Register Register)
+    {
+        return Encode(Register) >= 4 && Encode(Register) < 8;
+    }
+
+    static uint8_t EncodeScale(uint8_t Scale)
+    {
+        switch (Scale)
+        {
+        case 1:
+            return 0;
+        case 2:
+            return 1;
+        case 4:
+            return 2;
+        case 8:
+            return 3;
+        default:
+            assert(false && "Invalid scale");
+            return 0;
+        }
+    }
+
+    Emitter::Emitter(const uint8_t* BaseAddress)
+        : m_BaseAddress(BaseAddress)
+    {
+    }
+
+    const std::vector<uint8_t>& Emitter::Code() const
+    {
+        return m_Code;
+    }
+
+    const uint8_t* Emitter::CurrentAddress() const
+    {
+        return m_BaseAddress + m_Code.size();
+    }
+
+    void Emitter::MovImmediate16(Register Destination, uint16_t Value)
+    {
+        Emit8(OperandSizePrefix);
+        EmitRex(false, 0, 0, Encode(Destination));
+        Emit8(0xB8 + (Encode(Destination) & 7));
+        Emit16(Value);
+    }
+
+    void Emitter::Mov16(Register Destination, Register Source)
+    {
+        Emit8(OperandSizePrefix);
+        EmitRex(false, Encode(Source), 0, Encode(Destination));
+        Emit8(0x89);
+        EmitRegisterOperand(Encode(Source), Encode(Destination));
+    }
+
+    void Emitter::Alu16(AluOperation Operation, Register Destination, Register Source)
+    {
+        Emit8(OperandSizePrefix);
+        EmitRex(false, Encode(Source), 0, Encode(Destination));
+        Emit8((static_cast<uint8_t>(Operation) << 3) | 0x01);
+        EmitRegisterOperand(Encode(Source), Encode(Destination));
+    }
+
+    void Emitter::AluImmediate16(AluOperation Operation, Register Destination, uint16_t Value)
+    {
+        Emit8(OperandSizePrefix);
+        EmitRex(false, 0, 0, Encode(Destination));
+        Emit8(0x81);
+        EmitRegisterOperand(static_cast<uint8_t>(Operation), Encode(Destination));
+        Emit16(Value);
+    }
+
+    void Emitter::Not16(Register Destination)
+    {
+        Emit8(OperandSizePrefix);
+        EmitRex(false, 0, 0, Encode(Destination));
+        Emit8(0xF7);
+        EmitRegisterOperand(2, Encode(Destination));
+    }
+
+    void Emitter::Test16(Register Left, Register Right)
+    {
+        Emit8(OperandSizePrefix);
+        EmitRex(false, Encode(Right), 0, Encode(Left));
+        Emit8(0x85);
+        EmitRegisterOperand(Encode(Right), Encode(Left));
+    }
+
+    void Emitter::ShiftImmediate16(ShiftOperation Operation, Register Destination, uint8_t Count)
+    {
+        Emit8(OperandSizePrefix);
+        EmitRex(false, 0, 0, Encode(Destination));
+        Emit8(0xC1);
+        EmitRegisterOperand(static_cast<uint8_t>(Operation), Encode(Destination));
+        Emit8(Count);
+    }
+
+    void Emitter::MovImmediate32(Register Destination, uint32_t Value)
+    {
+        EmitRex(false, 0, 0, Encode(Destination));
+        Emit8(0xB8 + (Encode(Destination) & 7));
+        Emit32(Value);
+    }
+
+    void Emitter::Mov32(Register Destination, Register Source)
+    {
+        EmitRex(false, Encode(Source), 0, Encode(Destination));
+        Emit8(0x89);
+        EmitRegisterOperand(Encode(Source), Encode(Destination));
+    }
+
+    void Emitter::MovZeroExtend16(Register Destination, Register Source)
+    {
+        EmitRex(false, Encode(Destination), 0, Encode(Source));
+        Emit8(0x0F);
+        Emit8(0xB7);
+        EmitRegisterOperand(Encode(Destination), Encode(Source));
+    }
+
+    void Emitter::MovZeroExtend8(Register Destination, Register Source)
+    {
+        EmitRex(false, Encode(Destination), 0, Encode(Source), NeedsRexForByteAccess(Source));
+        Emit8(0x0F);
+        Emit8(0xB6);
+        EmitRegisterOperand(Encode(Destination), Encode(Source));
+    }
+
+    void Emitter::AluImmediate32(AluOperation Operation, Register Destination, uint32_t Value)
+    {
+        EmitRex(false, 0, 0, Encode(Destination));
+        Emit8(0x81);
+        EmitRegisterOperand(static_cast<uint8_t>(Operation), Encode(Destination));
+        Emit32(Value);
+    }
+
+    void Emitter::Alu32(AluOperation Operation, Register Destination, Register Source)
+    {
+        EmitRex(false, Encode(Source), 0, Encode(Destination));
+        Emit8((static_cast<uint8_t>(Operation) << 3) | 0x01);
+        EmitRegisterOperand(Encode(Source), Encode(Destination));
+    }
+
+    void Emitter::ShiftImmediate32(ShiftOperation Operation, Register Destination, uint8_t Count)
+    {
+        EmitRex(false, 0, 0, Encode(Destination));
+        Emit8(0xC1);
+        EmitRegisterOperand(static_cast<uint8_t>(Operation), Encode(Destination));
+        Emit8(Count);
+    }
+
+    void Emitter::TestImmediate32(Register Destination, uint32_t Value)
+    {
+        EmitRex(false, 0, 0, Encode(Destination));
+        Emit8(0xF7);
+        EmitRegisterOperand(0, Encode(Destination));
+        Emit32(Value);
+    }
+
+    void Emitter::CmpImmediate8(Register Destination, uint8_t Value)
+    {
+        EmitRex(false, 0, 0, Encode(Destination), NeedsRexForByteAccess(Destination));
+        Emit8(0x80);
+        EmitRegisterOperand(static_cast<uint8_t>(AluOperation::Cmp), Encode(Destination));
+        Emit8(Value);
+    }
+
+    void Emitter::SetCondition(Condition Condition, Register Destination)
+    {
+        EmitRex(false, 0, 0, Encode(Destination), NeedsRexForByteAccess(Destination));
+        Emit8(0x0F);
+        Emit8(0x90 + static_cast<uint8_t>(Condition));
+        EmitRegisterOperand(0, Encode(Destination));
+    }
+
+    void Emitter::Lea32(Register Destination, Register Base, Register Index, uint8_t Scale)
+    {
+        EmitRex(false, Encode(Destination), Encode(Index), Encode(Base));
+        Emit8(0x8D);
+        EmitMemoryOperand(Encode(Destination), Base, Index, Scale, 0);
+    }
+
+    void Emitter::MovImmediate64(Register Destination, uint64_t Value)
+    {
+        EmitRex(true, 0, 0, Encode(Destination));
+        Emit8(0xB8 + (Encode(Destination) & 7));
+        Emit64(Value);
+    }
+
+    void Emitter::Mov64(Register Destination, Register Source)
+    {
+        EmitRex(true, Encode(Source), 0, Encode(Destination));
+        Emit8(0x89);
+        EmitRegisterOperand(Encode(Source), Encode(Destination));
+    }
+
+    void Emitter::Test64(Register Left, Register Right)
+    {
+        EmitRex(true, Encode(Right), 0, Encode(Left));
+        Emit8(0x85);
+        EmitRegisterOperand(Encode(Right), Encode(Left));
+    }
+
+    void Emitter::AddImmediate64(Register Destination, int8_t Value)
+    {
+        EmitRex(true, 0, 0, Encode(Destination));
+        Emit8(0x83);
+        EmitRegisterOperand(static_cast<uint8_t>(AluOperation::Add), Encode(Destination));
+        Emit8(static_cast<uint8_t>(Value));
+    }
+
+    void Emitter::SubImmediate64(Register Destination, int8_t Value)
+    {
+        EmitRex(true, 0, 0, Encode(Destination));
+        Emit8(0x83);
+        EmitRegisterOperand(static_cast<uint8_t>(AluOperation::Sub), Encode(Destination));
+        Emit8(static_cast<uint8_t>(Value));
+    }
+
+    void Emitter::Push(Register Source)
+    {
+        EmitRex(false, 0, 0, Encode(Source));
+        Emit8(0x50 + (Encode(Source) & 7));
+    }
+
+    void Emitter::Pop(Register Destination)
+    {
+        EmitRex(false, 0, 0, Encode(Destination));
+        Emit8(0x58 + (Encode(Destination) & 7));
+    }
+
+    void Emitter::Load64(Register Destination, Register Base, Register Index, uint8_t Scale, int32_t Displacement)
+    {
+        EmitRex(true, Encode(Destination), Encode(Index), Encode(Base));
+        Emit8(0x8B);
+        EmitMemoryOperand(Encode(Destination), Base, Index, Scale, Displacement);
+    }
+
+    void Emitter::Load64(Register Destination, Register Base, int32_t Displacement)
+    {
+        EmitRex(true, Encode(Destination), 0, Encode(Base));
+        Emit8(0x8B);
+        EmitMemoryOperand(Encode(Destination), Base, Displacement);
+    }
+
+    void Emitter::LoadZeroExtend16(Register Destination, Register Base, Register Index, int32_t Displacement)
+    {
+        EmitRex(false, Encode(Destination), Encode(Index), Encode(Base));
+        Emit8(0x0F);
+        Emit8(0xB7);
+        EmitMemoryOperand(Encode(Destination), Base, Index, 1, Displacement);
+    }
+
+    void Emitter::LoadZeroExtend16(Register Destination, Register Base, int32_t Displacement)
+    {
+        EmitRex(false, Encode(Destination), 0, Encode(Base));
+        Emit8(0x0F);
+        Emit8(0xB7);
+        EmitMemoryOperand(Encode(Destination), Base, Displacement);
+    }
+
+    void Emitter::Store16(Register Base, Register Index, int32_t Displacement, Register Source)
+    {
+        Emit8(OperandSizePrefix);
+        EmitRex(false, Encode(Source), Encode(Index), Encode(Base));
+        Emit8(0x89);
+        EmitMemoryOperand(Encode(Source), Base, Index, 1, Displacement);
+    }
+
+    void Emitter::Store16(Register Base, int32_t Displacement, Register Source)
+    {
+        Emit8(OperandSizePrefix);
+        EmitRex(false, Encode(Source), 0, Encode(Base));
+        Emit8(0x89);
+        EmitMemoryOperand(Encode(Source), Base, Displacement);
+    }
+
+    void Emitter::StoreImmediate8(Register Base, int32_t Displacement, uint8_t Value)
+    {
+        EmitRex(false, 0, 0, Encode(Base));
+        Emit8(0xC6);
+        EmitMemoryOperand(0, Base, Displacement);
+        Emit8(Value);
+    }
+
+    void Emitter::AluImmediate64(AluOperation Operation, Register Base, int32_t Displacement, int32_t Value)
+    {
+        // NOTE: the immediate is sign-extended to 64 bits
+        EmitRex(true, 0, 0, Encode(Base));
+        Emit8(0x81);
+        EmitMemoryOperand(static_cast<uint8_t>(Operation), Base, Displacement);
+        Emit32(static_cast<uint32_t>(Value));
+    }
+
+    Emitter::Fixup Emitter::JumpForward()
+    {
+        Emit8(0xE9);
+        auto Position = m_Code.size();
+        Emit32(0);
+        return Position;
+    }
+
+    Emitter::Fixup Emitter::JumpForward(Condition Condition)
+    {
+        Emit8(0x0F);
+        Emit8(0x80 + static_cast<uint8_t>(Condition));
+        auto Position = m_Code.size();
+        Emit32(0);
+        return Position;
+    }
+
+    void Emitter::Bind(Fixup Fixup)
+    {
+        auto Offset = static_cast<uint32_t>(m_Code.size() - (Fixup + 4));
+        std::memcpy(m_Code.data() + Fixup, &Offset, sizeof(Offset));
+    }
+
+    void Emitter::Jump(const uint8_t* Target)
+    {
+        Emit8(0xE9);
+        auto Offset = Target - (CurrentAddress() + 4);
+        assert(Offset >= INT32_MIN && Offset <= INT32_MAX);
+        Emit32(static_cast<uint32_t>(Offset));
+    }
+
+    void Emitter::Jump(Register Target)
+    {
+        EmitRex(false, 0, 0, Encode(Target));
+        Emit8(0xFF);
+        EmitRegisterOperand(4, Encode(Target));
+    }
+
+    void Emitter::Call(Register Target)
+    {
+        EmitRex(false, 0, 0, Encode(Target));
+        Emit8(0xFF);
+        EmitRegisterOperand(2, Encode(Target));
+    }
+
+    void Emitter::Return()
+    {
+        Emit8(0xC3);
+    }
+
+    void Emitter::Emit8(uint8_t Value)
+    {
+        m_Code.push_back(Value);
+    }
+
+    void Emitter::Emit16(uint16_t Value)
+    {
+        Emit8(static_cast<uint8_t>(Value));
+        Emit8(static_cast<uint8_t>(Value >> 8));
+    }
+
+    void Emitter::Emit32(uint32_t Value)
+    {
+        Emit16(static_cast<uint16_t>(Value));
+        Emit16(static_cast<uint16_t>(Value >> 16));
+    }
+
+    void Emitter::Emit64(uint64_t Value)
+    {
+        Emit32(static_cast<uint32_t>(Value));
+        Emit32(static_cast<uint32_t>(Value >> 32));
+    }
+
+    void Emitter::EmitRex(bool Wide, uint8_t Reg, uint8_t Index, uint8_t Base, bool ForceRex)
+    {
+        uint8_t Rex = 0x40 | (Wide << 3) | ((Reg >> 3) << 2) | ((Index >> 3) << 1) | (Base >> 3);
+        if (Rex != 0x40 || ForceRex)
+            Emit8(Rex);
+    }
+
+    void Emitter::EmitRegisterOperand(uint8_t Reg, uint8_t RM)
+    {
+        Emit8(0xC0 | ((Reg & 7) << 3) | (RM & 7));
+    }
+
+    void Emitter::EmitMemoryOperand(uint8_t Reg, Register Base, Register Index, uint8_t Scale, int32_t Displacement)
+    {
+        // NOTE: always uses the SIB form with a 32-bit displacement, which works for every base register
+        assert(Index != Register::RSP && "RSP can not be used as an index");
+        Emit8(0x80 | ((Reg & 7) << 3) | 0x04);
+        Emit8((EncodeScale(Scale) << 6) | ((Encode(Index) & 7) << 3) | (Encode(Base) & 7));
+        Emit32(static_cast<uint32_t>(Displacement));
+    }
+
+    void Emitter::EmitMemoryOperand(uint8_t Reg, Register Base, int32_t Displacement)
+    {
+        // Index field 0b100 means that there is no index register
+        Emit8(0x80 | ((Reg & 7) << 3) | 0x04);
+        Emit8(0x20 | (Encode(Base) & 7));
+        Emit32(static_cast<uint32_t>(Displacement));
+    }
+} // namespace lce::Emulator::X86
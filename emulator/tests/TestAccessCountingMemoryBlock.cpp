@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#include "AccessCountingMemoryBlock.h"
+#include "CodeGenerator.h"
+#include "CPU.h"
+#include "Instruction.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "RandomAccessMemoryBlock.h"
+
+using namespace lce::Assembler;
+using namespace lce::Emulator;
+
+TEST(TestAccessCountingMemoryBlock, CountsBytesAndForwardsAccesses)
+{
+    AccessCountingMemoryBlock Block(std::make_unique<RandomAccessMemoryBlock>(16));
+    EXPECT_EQ(Block.Size(), 16);
+
+    Block.WriteWord(0, 0x1234);
+    Block.Write(2, 0x56);
+    uint8_t Bytes[3] = {};
+    Block.ReadRange(0, Bytes);
+    EXPECT_EQ(Block.Read(1), 0x12);
+    EXPECT_EQ(Block.ReadWord(1), 0x5612);
+
+    EXPECT_EQ(Bytes[0], 0x34);
+    EXPECT_EQ(Bytes[2], 0x56);
+    EXPECT_EQ(Block.GetBytesWritten(), 3);
+    EXPECT_EQ(Block.GetBytesRead(), 6);
+    EXPECT_EQ(Block.DirectPointer(0), nullptr);
+
+    auto Copy = Block.Clone();
+    ASSERT_NE(Copy, nullptr);
+    EXPECT_EQ(Copy->ReadWord(0), 0x1234);
+}
+
+TEST(TestAccessCountingMemoryBlock, CountsEveryAccessOfTheCPU)
+{
+    Lexer Lexer("mov rsp, 40960 \n"
+                "mov r0, 42     \n"
+                "sta 40962, r0  \n"
+                "push r0        \n"
+                "lda r1, 40962  \n"
+                "hlt            \n", "test_program.lca");
+    std::vector<Instruction> Instructions;
+    ASSERT_TRUE(Parse(Lexer, Instructions));
+    auto Program = GenerateMachineCode(Instructions);
+
+    auto ProgramBlock = std::make_unique<RandomAccessMemoryBlock>(0x2000);
+    ProgramBlock->WriteRange(0, Program);
+    auto Code = std::make_unique<AccessCountingMemoryBlock>(std::move(ProgramBlock));
+    auto Data = std::make_unique<AccessCountingMemoryBlock>(std::make_unique<RandomAccessMemoryBlock>(0x2000));
+    auto* CodePointer = Code.get();
+    auto* DataPointer = Data.get();
+
+    CPU Processor;
+    Processor.Reset();
+    ASSERT_TRUE(Processor.AddMemoryBlock(std::move(Code), 0x8000));
+    ASSERT_TRUE(Processor.AddMemoryBlock(std::move(Data), 0xA000));
+    Processor.Run(0x8000);
+
+    EXPECT_EQ(Processor.GetRegister(Register::R1), 42);
+    EXPECT_EQ(CodePointer->GetBytesRead(), Program.size());
+    EXPECT_EQ(CodePointer->GetBytesWritten(), 0);
+    EXPECT_EQ(DataPointer->GetBytesRead(), 2);
+    EXPECT_EQ(DataPointer->GetBytesWritten(), 4);
+}
@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include "BatchRunner.h"
+#include "CodeGenerator.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "WorkStealingThreadPool.h"
+
+using namespace lce::Assembler;
+using namespace lce::Emulator;
+
+TEST(TestBatchRunner, PoolRunsEveryTaskOnce)
+{
+    constexpr size_t TaskCount = 1000;
+    std::vector<std::atomic<int>> Calls(TaskCount);
+
+    WorkStealingThreadPool Pool(4);
+    for (int Round = 0; Round < 2; Round++)
+    {
+        Pool.Run(TaskCount, [&](size_t TaskIndex, size_t WorkerIndex)
+        {
+            EXPECT_LT(WorkerIndex, Pool.GetThreadCount());
+
+            // NOTE: the first worker gets the slow tasks, so the others have to steal them to finish
+            if (TaskIndex < TaskCount / 4)
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            Calls[TaskIndex]++;
+        });
+    }
+
+    for (size_t TaskIndex = 0; TaskIndex < TaskCount; TaskIndex++)
+        EXPECT_EQ(Calls[TaskIndex], 2) << "task " << TaskIndex;
+}
+
+TEST(TestBatchRunner, ParseManifest)
+{
+    std::vector<BatchJob> Jobs;
+    ASSERT_TRUE(ParseBatchManifest("# comment\n"
+                                   "first.bin\n"
+                                   "\n"
+                                   "  second.bin   input.bin  \n", "jobs.txt", "base", Jobs));
+
+    ASSERT_EQ(Jobs.size(), 2);
+    EXPECT_EQ(Jobs[0].ROMPath, std::filesystem::path("base") / "first.bin");
+    EXPECT_TRUE(Jobs[0].InputPath.empty());
+    EXPECT_EQ(Jobs[1].ROMPath, std::filesystem::path("base") / "second.bin");
+    EXPECT_EQ(Jobs[1].InputPath, std::filesystem::path("base") / "input.bin");
+
+    EXPECT_FALSE(ParseBatchManifest("rom.bin input.bin extra\n", "jobs.txt", "base", Jobs));
+}
+
+TEST(TestBatchRunner, RunJob)
+{
+    // Doubles the word at 0xA000 and stores it at 0xA002
+    Lexer Lexer("lda r0, 40960   \n"
+                "add r0, r0      \n"
+                "sta 40962, r0   \n"
+                "hlt             \n", "test_program.lca");
+    std::vector<lce::Assembler::Instruction> Instructions;
+    ASSERT_TRUE(Parse(Lexer, Instructions));
+    auto Program = GenerateMachineCode(Instructions);
+
+    auto Directory = std::filesystem::temp_directory_path();
+    BatchJob Job = { Directory / "lce_batch_test_rom.bin", Directory / "lce_batch_test_input.bin" };
+
+    // NOTE: programs start at 0x7FF0, so the code is placed at the end of the ROM image
+    std::vector<uint8_t> ROMImage(0x7FF0, 0);
+    ROMImage.insert(ROMImage.end(), Program.begin(), Program.end());
+    std::ofstream(Job.ROMPath, std::ios::binary).write(reinterpret_cast<const char*>(ROMImage.data()), ROMImage.size());
+    std::ofstream(Job.InputPath, std::ios::binary).write("\x34\x12", 2);
+
+    BatchJobOptions Options;
+    Options.OutputSize = 4;
+    auto Result = RunBatchJob(Job, Options);
+
+    EXPECT_TRUE(Result.Succeeded) << Result.State;
+    EXPECT_EQ(Result.Output, std::vector<uint8_t>({ 0x34, 0x12, 0x68, 0x24 }));
+
+    std::filesystem::remove(Job.ROMPath);
+    std::filesystem::remove(Job.InputPath);
+
+    EXPECT_FALSE(RunBatchJob(Job, Options).Succeeded);
+}
+
+TEST(TestBatchRunner, RunawayJobIsStopped)
+{
+    Lexer Lexer("add r0, 1       \n" // 0x7FF0
+                "jmp 32752       \n", "test_program.lca");
+    std::vector<lce::Assembler::Instruction> Instructions;
+    ASSERT_TRUE(Parse(Lexer, Instructions));
+    auto Program = GenerateMachineCode(Instructions);
+
+    BatchJob Job = { std::filesystem::temp_directory_path() / "lce_batch_runaway_rom.bin", {} };
+    std::vector<uint8_t> ROMImage(0x7FF0, 0);
+    ROMImage.insert(ROMImage.end(), Program.begin(), Program.end());
+    std::ofstream(Job.ROMPath, std::ios::binary).write(reinterpret_cast<const char*>(ROMImage.data()), ROMImage.size());
+
+    BatchJobOptions Options;
+    Options.MaxCycles = 100000;
+    auto Result = RunBatchJob(Job, Options);
+    std::filesystem::remove(Job.ROMPath);
+
+    EXPECT_FALSE(Result.Succeeded);
+    EXPECT_EQ(Result.Run.Reason, StopReason::CycleLimit);
+    EXPECT_GE(Result.Run.Instructions, 100000);
+    EXPECT_NE(Result.State.find("ip: 0x7ff"), std::string::npos) << Result.State;
+}
+
+TEST(TestBatchRunner, FaultingJobFails)
+{
+    Lexer Lexer("mov r0, 5       \n", "test_program.lca"); // 0x7FF0
+    std::vector<lce::Assembler::Instruction> Instructions;
+    ASSERT_TRUE(Parse(Lexer, Instructions));
+    auto Program = GenerateMachineCode(Instructions);
+
+    BatchJob Job = { std::filesystem::temp_directory_path() / "lce_batch_fault_rom.bin", {} };
+    std::vector<uint8_t> ROMImage(0x7FF0, 0);
+    ROMImage.insert(ROMImage.end(), Program.begin(), Program.end());
+    ROMImage.push_back(0xFC); // Opcode 0b111111 does not exist
+    std::ofstream(Job.ROMPath, std::ios::binary).write(reinterpret_cast<const char*>(ROMImage.data()), ROMImage.size());
+
+    BatchJobOptions Options;
+    Options.MaxCycles = 100000;
+    auto Result = RunBatchJob(Job, Options);
+    std::filesystem::remove(Job.ROMPath);
+
+    EXPECT_FALSE(Result.Succeeded);
+    EXPECT_EQ(Result.Run.Reason, StopReason::Fault);
+    EXPECT_TRUE(Result.State.starts_with("invalid instruction at 0x7FF3")) << Result.State;
+}
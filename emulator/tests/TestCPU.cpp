@@ -1,9 +1,17 @@
 #include <gtest/gtest.h>
 
 #include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
 
+#include "CodeGenerator.h"
 #include "CPU.h"
 #include "Instruction.h"
+#include "InstructionDecoder.h"
+#include "JITCompiler.h"
+#include "Lexer.h"
+#include "Parser.h"
 #include "RandomAccessMemoryBlock.h"
 
 using namespace lce::Assembler;
@@ -23,6 +31,16 @@ protected:
         Memory = RAM.get();
         CPU.AddMemoryBlock(std::move(RAM), 0x8000);
     }
+
+    void LoadProgram(std::string_view Source, uint16_t Address = 0x8000)
+    {
+        Lexer Lexer(Source, "test_program.lca");
+        std::vector<lce::Assembler::Instruction> Instructions;
+        ASSERT_TRUE(Parse(Lexer, Instructions));
+
+        auto Bytes = GenerateMachineCode(Instructions);
+        Memory->WriteRange(static_cast<uint16_t>(Address - 0x8000), Bytes);
+    }
 };
 
 TEST_F(TestCPU, TestReset)
@@ -61,3 +79,765 @@ TEST_F(TestCPU, TestMovRegTwoByteImm)
     CPU.ExecuteSingleInstruction(Instruction);
     EXPECT_EQ(CPU.GetRegister(lce::Assembler::Register::R1), 0xFACE);
 }
+
+TEST_F(TestCPU, TestAddMemoryBlockRejectsOverlap)
+{
+    EXPECT_FALSE(CPU.AddMemoryBlock(std::make_unique<RandomAccessMemoryBlock>(16), 0xBFF8));
+    EXPECT_FALSE(CPU.AddMemoryBlock(std::make_unique<RandomAccessMemoryBlock>(16), 0xFFF8));
+    EXPECT_TRUE(CPU.AddMemoryBlock(std::make_unique<RandomAccessMemoryBlock>(16), 0xC000));
+    EXPECT_TRUE(CPU.AddMemoryBlock(std::make_unique<RandomAccessMemoryBlock>(16), 0xC010));
+}
+
+TEST_F(TestCPU, TestAddMemoryBlockChecksSize)
+{
+    EXPECT_FALSE(CPU.AddMemoryBlock(std::make_unique<RandomAccessMemoryBlock>(0), 0xC000));
+    EXPECT_FALSE(CPU.AddMemoryBlock(std::make_unique<RandomAccessMemoryBlock>(0x11), 0xFFF0));
+    EXPECT_TRUE(CPU.AddMemoryBlock(std::make_unique<RandomAccessMemoryBlock>(0x10), 0xFFF0));
+}
+
+TEST_F(TestCPU, TestAddMemoryBlockRejectsBlockContainingAnother)
+{
+    EXPECT_TRUE(CPU.AddMemoryBlock(std::make_unique<RandomAccessMemoryBlock>(0x10), 0xC010));
+    EXPECT_FALSE(CPU.AddMemoryBlock(std::make_unique<RandomAccessMemoryBlock>(0x100), 0xC000));
+
+    // The smaller block still serves its addresses
+    uint8_t Value = 0x5A;
+    ASSERT_TRUE(CPU.WriteMemory(0xC010, { &Value, 1 }));
+    uint8_t Bytes[2] = {};
+    EXPECT_FALSE(CPU.ReadMemory(0xC00F, Bytes));
+    ASSERT_TRUE(CPU.ReadMemory(0xC010, { Bytes, 1 }));
+    EXPECT_EQ(Bytes[0], 0x5A);
+}
+
+TEST_F(TestCPU, TestAddSetsFlags)
+{
+    uint8_t Instruction[] = { 0b00010000, 0b10000000, 0x01 }; // add r0, 1
+
+    CPU.SetRegister(Register::R0, 0xFFFF);
+    CPU.ExecuteSingleInstruction(Instruction);
+    EXPECT_EQ(CPU.GetRegister(Register::R0), 0);
+    EXPECT_EQ(CPU.GetRegister(Register::RFL), static_cast<uint16_t>(Flag::Zero) | static_cast<uint16_t>(Flag::Carry));
+
+    CPU.SetRegister(Register::R0, 0x7FFF);
+    CPU.ExecuteSingleInstruction(Instruction);
+    EXPECT_EQ(CPU.GetRegister(Register::R0), 0x8000);
+    EXPECT_EQ(CPU.GetRegister(Register::RFL), static_cast<uint16_t>(Flag::Negative) | static_cast<uint16_t>(Flag::Overflow));
+}
+
+TEST_F(TestCPU, TestFlagsKeepReservedBits)
+{
+    uint8_t Instruction[] = { 0b00010000, 0b10000000, 0x01 }; // add r0, 1
+
+    CPU.SetRegister(Register::RFL, 0xFF00 | static_cast<uint16_t>(Flag::Carry));
+    CPU.SetRegister(Register::R0, 0x7FFF);
+    CPU.ExecuteSingleInstruction(Instruction);
+    EXPECT_EQ(CPU.GetRegister(Register::RFL), 0xFF00 | static_cast<uint16_t>(Flag::Negative) | static_cast<uint16_t>(Flag::Overflow));
+}
+
+TEST_F(TestCPU, TestCountedLoop)
+{
+    LoadProgram("mov r0, 0   \n" // 0x8000
+                "mov r1, 10  \n" // 0x8003
+                "add r0, r1  \n" // 0x8006
+                "sub r1, 1   \n" // 0x8008
+                "jz 32785    \n" // 0x800B
+                "jmp 32774   \n" // 0x800E
+                "hlt         \n" // 0x8011
+    );
+
+    CPU.Run(0x8000);
+    EXPECT_EQ(CPU.GetRegister(Register::R0), 55);
+    EXPECT_EQ(CPU.GetRegister(Register::R1), 0);
+}
+
+TEST_F(TestCPU, TestRunUntilAddress)
+{
+    LoadProgram("mov r0, 0   \n" // 0x8000
+                "mov r1, 10  \n" // 0x8003
+                "add r0, r1  \n" // 0x8006
+                "sub r1, 1   \n" // 0x8008
+                "jz 32785    \n" // 0x800B
+                "jmp 32774   \n" // 0x800E
+                "hlt         \n" // 0x8011
+    );
+
+    CPU.SetIP(0x8000);
+    size_t Iterations = 0;
+    RunResult Result;
+    while ((Result = CPU.RunUntil(0x8006)).Reason == StopReason::Breakpoint)
+    {
+        EXPECT_EQ(CPU.GetIP(), 0x8006);
+        Iterations++;
+    }
+
+    EXPECT_EQ(Iterations, 10);
+    EXPECT_EQ(Result.Reason, StopReason::Halted);
+    EXPECT_EQ(CPU.GetRegister(Register::R0), 55);
+    EXPECT_EQ(CPU.GetRetiredInstructionCount(), 2 + 10 * 4 - 1 + 1);
+}
+
+TEST_F(TestCPU, TestRunUntilPredicate)
+{
+    LoadProgram("mov r1, 10  \n" // 0x8000
+                "add r0, r1  \n" // 0x8003
+                "sub r1, 1   \n" // 0x8005
+                "jmp 32771   \n" // 0x8008
+    );
+
+    CPU.SetIP(0x8000);
+    auto Result = CPU.RunUntil([](const lce::Emulator::CPU& Processor) { return Processor.GetRegister(Register::R0) > 20; });
+    EXPECT_EQ(Result.Reason, StopReason::Breakpoint);
+    EXPECT_EQ(Result.Instructions, 1 + 2 * 3 + 1);
+    EXPECT_EQ(CPU.GetRegister(Register::R0), 10 + 9 + 8);
+
+    EXPECT_EQ(CPU.RunUntil(0x9000, 100).Reason, StopReason::CycleLimit);
+    EXPECT_EQ(CPU.GetCycleCount(), 1 + 2 * 3 + 1 + 100);
+}
+
+TEST_F(TestCPU, TestRunReportsFault)
+{
+    Memory->Write(0, 0xFC); // Opcode 0b111111 does not exist
+
+    CPU.SetIP(0x8000);
+    auto Result = CPU.RunFor(100);
+    EXPECT_EQ(Result.Reason, StopReason::Fault);
+    EXPECT_EQ(Result.Instructions, 1);
+    EXPECT_EQ(CPU.GetIP(), 0x8000);
+    EXPECT_EQ(CPU.RunFor(100).Reason, StopReason::Fault);
+}
+
+TEST_F(TestCPU, TestCallAndReturn)
+{
+    LoadProgram("mov rsp, 40960 \n" // 0x8000
+                "call 32776     \n" // 0x8004
+                "hlt            \n" // 0x8007
+                "mov r0, 42     \n" // 0x8008
+                "push r0        \n" // 0x800B
+                "pop r1         \n" // 0x800D
+                "ret            \n" // 0x800F
+    );
+
+    CPU.Run(0x8000);
+    EXPECT_EQ(CPU.GetRegister(Register::R0), 42);
+    EXPECT_EQ(CPU.GetRegister(Register::R1), 42);
+    EXPECT_EQ(CPU.GetRegister(Register::RSP), 40960);
+}
+
+TEST_F(TestCPU, TestWatchpointOnStackSlot)
+{
+    // The return address is stored in a word that crosses a page boundary
+    LoadProgram("mov rsp, 33023 \n" // 0x8000
+                "call 32776     \n" // 0x8004
+                "hlt            \n" // 0x8007
+                "mov r0, 42     \n" // 0x8008
+                "push r0        \n" // 0x800B
+                "pop r1         \n" // 0x800D
+                "ret            \n" // 0x800F
+    );
+
+    EXPECT_FALSE(CPU.AddWatchpoint({ 0x8100, 3, WatchpointKind::Write, 0x8007 }));
+    EXPECT_FALSE(CPU.AddWatchpoint({ 0x8100, 0, WatchpointKind::Write }));
+    ASSERT_TRUE(CPU.AddWatchpoint({ 0x8100, 1, WatchpointKind::Write }));
+    CPU.SetIP(0x8000);
+
+    WatchpointHit Hit;
+    EXPECT_EQ(CPU.RunFor(1000).Reason, StopReason::Watchpoint);
+    EXPECT_EQ(CPU.GetIP(), 0x8008);
+    ASSERT_TRUE(CPU.GetWatchpointHit(Hit));
+    EXPECT_EQ(Hit.Address, 0x8100);
+    EXPECT_EQ(Hit.AccessAddress, 0x80FF);
+    EXPECT_EQ(Hit.Value, 0x8007);
+    EXPECT_TRUE(Hit.IsWrite);
+
+    // The push writes to the same page, but not to the watched byte
+    ASSERT_TRUE(CPU.RemoveWatchpoint({ 0x8100, 1, WatchpointKind::Write }));
+    EXPECT_FALSE(CPU.RemoveWatchpoint({ 0x8100, 1, WatchpointKind::Write }));
+    ASSERT_TRUE(CPU.AddWatchpoint({ 0x8100, 1, WatchpointKind::Access }));
+    EXPECT_EQ(CPU.RunFor(1000).Reason, StopReason::Watchpoint);
+    EXPECT_EQ(CPU.GetIP(), 0x8007);
+    ASSERT_TRUE(CPU.GetWatchpointHit(Hit));
+    EXPECT_FALSE(Hit.IsWrite);
+    EXPECT_EQ(CPU.GetRegister(Register::R1), 42);
+
+    EXPECT_EQ(CPU.RunFor(1000).Reason, StopReason::Halted);
+    EXPECT_FALSE(CPU.GetWatchpointHit(Hit));
+}
+
+TEST_F(TestCPU, TestLoadFromBlocksSharingPage)
+{
+    auto FirstBlock = std::make_unique<RandomAccessMemoryBlock>(16);
+    auto SecondBlock = std::make_unique<RandomAccessMemoryBlock>(16);
+    FirstBlock->Write(0, 0x34);
+    FirstBlock->Write(1, 0x12);
+    SecondBlock->Write(0, 0x78);
+    SecondBlock->Write(1, 0x56);
+    ASSERT_TRUE(CPU.AddMemoryBlock(std::move(FirstBlock), 0xC000));
+    ASSERT_TRUE(CPU.AddMemoryBlock(std::move(SecondBlock), 0xC010));
+
+    LoadProgram("lda r0, 49152 \n"
+                "lda r1, 49168 \n"
+                "hlt           \n");
+
+    CPU.Run(0x8000);
+    EXPECT_EQ(CPU.GetRegister(Register::R0), 0x1234);
+    EXPECT_EQ(CPU.GetRegister(Register::R1), 0x5678);
+}
+
+TEST_F(TestCPU, TestSelfModifyingCode)
+{
+    LoadProgram("mov r0, 5       \n" // 0x8000
+                "mov r2, 2       \n" // 0x8003
+                "mov r1, 257     \n" // 0x8006, immediate is stored at 0x8008
+                "add r3, r1      \n" // 0x800A
+                "sta 32776, r0   \n" // 0x800C
+                "sub r2, 1       \n" // 0x8010
+                "jz 32793        \n" // 0x8013
+                "jmp 32774       \n" // 0x8016
+                "hlt             \n" // 0x8019
+    );
+
+    CPU.Run(0x8000);
+    EXPECT_EQ(CPU.GetRegister(Register::R3), 257 + 5);
+}
+
+TEST_F(TestCPU, TestForkedCPUsHaveSeparateMemory)
+{
+    // Increments the counter at 0xA000 and leaves its new value in r0
+    LoadProgram("lda r0, 40960   \n"
+                "add r0, 1       \n"
+                "sta 40960, r0   \n"
+                "hlt             \n");
+    CPU.Run(0x8000);
+
+    auto Child = CPU.Fork();
+    ASSERT_NE(Child, nullptr);
+    EXPECT_EQ(Child->SerializeState(), CPU.SerializeState());
+
+    // NOTE: Reset only clears the registers, so the counter in memory keeps its value
+    for (int Iteration = 0; Iteration < 2; Iteration++)
+    {
+        Child->Reset();
+        Child->Run(0x8000);
+    }
+    EXPECT_EQ(Child->GetRegister(Register::R0), 3);
+
+    CPU.Reset();
+    CPU.Run(0x8000);
+    EXPECT_EQ(CPU.GetRegister(Register::R0), 2);
+}
+
+TEST_F(TestCPU, TestRestoreSnapshot)
+{
+    LoadProgram("lda r0, 40960   \n"
+                "add r0, 1       \n"
+                "sta 40960, r0   \n"
+                "hlt             \n");
+    CPU.SetRegister(Register::R3, 0x1234);
+
+    CPUSnapshot Snapshot;
+    ASSERT_TRUE(CPU.Snapshot(Snapshot));
+    for (int Iteration = 0; Iteration < 5; Iteration++)
+    {
+        CPU.Reset();
+        CPU.Run(0x8000);
+    }
+    EXPECT_EQ(CPU.GetRegister(Register::R0), 5);
+
+    CPU.Restore(Snapshot);
+    EXPECT_EQ(CPU.GetRegister(Register::R0), 0);
+    EXPECT_EQ(CPU.GetRegister(Register::R3), 0x1234);
+
+    CPU.Run(0x8000);
+    EXPECT_EQ(CPU.GetRegister(Register::R0), 1);
+}
+
+TEST(TestRandomAccessMemoryBlock, CloneCopiesPagesOnWrite)
+{
+    RandomAccessMemoryBlock Original(1024);
+    Original.Write(0, 1);
+    Original.Write(512, 2);
+
+    auto Copy = Original.Clone();
+    EXPECT_EQ(Original.DirectWritePointer(0), nullptr);
+
+    Copy->Write(0, 3);
+    EXPECT_EQ(Original.Read(0), 1);
+    EXPECT_EQ(Copy->Read(0), 3);
+    EXPECT_EQ(Copy->Read(512), 2);
+
+    // NOTE: the copy got its own version of the first page, so the original is the only owner of it now
+    EXPECT_NE(Original.DirectWritePointer(0), nullptr);
+    EXPECT_EQ(Original.DirectWritePointer(512), nullptr);
+}
+
+TEST(TestRandomAccessMemoryBlock, RangeAndWordAccessAcrossPages)
+{
+    RandomAccessMemoryBlock Memory(1024);
+    std::vector<uint8_t> Bytes(600);
+    for (size_t Offset = 0; Offset < Bytes.size(); Offset++)
+        Bytes[Offset] = static_cast<uint8_t>(Offset * 7);
+    Memory.WriteRange(200, Bytes);
+
+    std::vector<uint8_t> ReadBack(Bytes.size());
+    Memory.ReadRange(200, ReadBack);
+    EXPECT_EQ(ReadBack, Bytes);
+    EXPECT_EQ(Memory.Read(255), Bytes[55]);
+    EXPECT_EQ(Memory.DirectPointer(256)[0], Bytes[56]);
+
+    Memory.WriteWord(255, 0xBEEF);
+    EXPECT_EQ(Memory.Read(255), 0xEF);
+    EXPECT_EQ(Memory.Read(256), 0xBE);
+    EXPECT_EQ(Memory.ReadWord(255), 0xBEEF);
+    EXPECT_EQ(Memory.ReadWord(300), Bytes[100] | (Bytes[101] << 8));
+}
+
+TEST_F(TestCPU, TestWordsCrossingPages)
+{
+    LoadProgram("mov r0, 4660     \n"
+                "sta 33279, r0    \n" // 0x81FF
+                "lda r1, 33279    \n"
+                "push r0          \n"
+                "pop r2           \n"
+                "hlt              \n");
+
+    CPU.SetRegister(Register::RSP, 0x82FF);
+    CPU.Run(0x8000);
+    EXPECT_EQ(CPU.GetRegister(Register::R1), 4660);
+    EXPECT_EQ(CPU.GetRegister(Register::R2), 4660);
+    EXPECT_EQ(Memory->Read(0x1FF), 0x34);
+    EXPECT_EQ(Memory->Read(0x200), 0x12);
+}
+
+// Memory mapped device that serves fixed bytes and counts how many times it was read
+class ReadCountingDevice : public MemoryBlock
+{
+public:
+    explicit ReadCountingDevice(std::vector<uint8_t> Bytes)
+        : m_Bytes(std::move(Bytes))
+    {
+    }
+
+    virtual uint8_t Read(uint16_t RelativeAddress) const override
+    {
+        m_ReadCount++;
+        return m_Bytes[RelativeAddress];
+    }
+
+    virtual void Write(uint16_t, uint8_t) override
+    {
+    }
+
+    virtual uint16_t Size() const override
+    {
+        return static_cast<uint16_t>(m_Bytes.size());
+    }
+
+    size_t GetReadCount() const
+    {
+        return m_ReadCount;
+    }
+
+private:
+    std::vector<uint8_t> m_Bytes;
+    mutable size_t m_ReadCount = 0;
+};
+
+TEST_F(TestCPU, TestFetchFromDeviceReadsOnlyTheInstruction)
+{
+    Lexer Lexer("mov r0, r1 \n"
+                "hlt        \n", "test_program.lca");
+    std::vector<lce::Assembler::Instruction> Instructions;
+    ASSERT_TRUE(Parse(Lexer, Instructions));
+    auto Bytes = GenerateMachineCode(Instructions);
+    ASSERT_EQ(Bytes.size(), 3);
+
+    // NOTE: padded so that reading past the end of the program would still be inside the device
+    Bytes.resize(16, EncodedNOP);
+    auto Device = std::make_unique<ReadCountingDevice>(Bytes);
+    auto* DevicePointer = Device.get();
+    ASSERT_TRUE(CPU.AddMemoryBlock(std::move(Device), 0x0000));
+
+    CPU.Run(0x0000);
+    EXPECT_TRUE(CPU.IsHalted());
+    EXPECT_EQ(DevicePointer->GetReadCount(), 3);
+}
+
+// Memory mapped device that returns a different value on every read
+class CounterDevice : public MemoryBlock
+{
+public:
+    virtual uint8_t Read(uint16_t RelativeAddress) const override
+    {
+        return static_cast<uint8_t>(m_Counter++ * 3 + RelativeAddress);
+    }
+
+    virtual void Write(uint16_t, uint8_t Value) override
+    {
+        m_Counter += Value;
+    }
+
+    virtual uint16_t Size() const override
+    {
+        return 16;
+    }
+
+private:
+    mutable uint8_t m_Counter = 0;
+};
+
+static std::unique_ptr<lce::Emulator::CPU> LoadProgramOnEngine(ExecutionEngine Engine, std::string_view Program)
+{
+    auto Processor = std::make_unique<lce::Emulator::CPU>(Engine);
+    Processor->Reset();
+
+    auto RAM = std::make_unique<RandomAccessMemoryBlock>(16384);
+    Lexer Lexer(Program, "test_program.lca");
+    std::vector<lce::Assembler::Instruction> Instructions;
+    EXPECT_TRUE(Parse(Lexer, Instructions));
+    auto Bytes = GenerateMachineCode(Instructions);
+    RAM->WriteRange(0, Bytes);
+    Processor->AddMemoryBlock(std::move(RAM), 0x8000);
+    Processor->AddMemoryBlock(std::make_unique<CounterDevice>(), 0xC000);
+    return Processor;
+}
+
+static std::string RunProgramOnEngine(ExecutionEngine Engine, std::string_view Program)
+{
+    auto Processor = LoadProgramOnEngine(Engine, Program);
+    Processor->Run(0x8000);
+    return Processor->SerializeState() + "; cycles: " + std::to_string(Processor->GetCycleCount());
+}
+
+TEST(TestCPUEngines, AllEnginesMatchInterpreter)
+{
+    // Sums 1..10 inside a subroutine while exercising the stack, logic and shift instructions
+    constexpr std::string_view Program = "mov rsp, 40960  \n" // 0x8000
+                                         "mov r1, 10      \n" // 0x8004
+                                         "call 32784      \n" // 0x8007
+                                         "hlt             \n" // 0x800A
+                                         "nop             \n" // 0x800B
+                                         "nop             \n" // 0x800C
+                                         "nop             \n" // 0x800D
+                                         "nop             \n" // 0x800E
+                                         "nop             \n" // 0x800F
+                                         "add r0, r1      \n" // 0x8010
+                                         "push r0         \n" // 0x8012
+                                         "xor r2, r0      \n" // 0x8014
+                                         "shl r2, 1       \n" // 0x8016
+                                         "pop r3          \n" // 0x8019
+                                         "sub r1, 1       \n" // 0x801B
+                                         "jz 32804        \n" // 0x801E
+                                         "jmp 32784       \n" // 0x8021
+                                         "ret             \n"; // 0x8024
+
+    auto Expected = RunProgramOnEngine(ExecutionEngine::Interpreter, Program);
+    EXPECT_EQ(RunProgramOnEngine(ExecutionEngine::Threaded, Program), Expected);
+    EXPECT_EQ(RunProgramOnEngine(ExecutionEngine::BasicBlocks, Program), Expected);
+    EXPECT_EQ(RunProgramOnEngine(ExecutionEngine::JIT, Program), Expected);
+    EXPECT_EQ(Expected.substr(0, 22), "ip: 0x800b; r0: 0x0037");
+    EXPECT_NE(Expected.find("halted: true"), std::string::npos);
+}
+
+TEST(TestCPUEngines, CountMemoryAccessesPerBlock)
+{
+    constexpr std::string_view Program = "mov rsp, 40960  \n"
+                                         "mov r0, 42      \n"
+                                         "sta 40962, r0   \n"
+                                         "push r0         \n"
+                                         "lda r1, 40962   \n"
+                                         "lda r2, 49152   \n"
+                                         "hlt             \n";
+    Lexer Lexer(Program, "test_program.lca");
+    std::vector<lce::Assembler::Instruction> Instructions;
+    ASSERT_TRUE(Parse(Lexer, Instructions));
+    auto ProgramSize = GenerateMachineCode(Instructions).size();
+
+    for (auto Engine : { ExecutionEngine::Interpreter, ExecutionEngine::Threaded, ExecutionEngine::BasicBlocks, ExecutionEngine::JIT })
+    {
+        auto Processor = LoadProgramOnEngine(Engine, Program);
+        EXPECT_TRUE(Processor->GetMemoryAccessCounts().empty());
+        Processor->CountMemoryAccesses(true);
+        Processor->Run(0x8000);
+
+        const auto& Counts = Processor->GetMemoryAccessCounts();
+        ASSERT_EQ(Counts.size(), 2);
+        EXPECT_EQ(Processor->GetRegister(Register::R1), 42);
+        EXPECT_EQ(Counts[0].BytesRead, ProgramSize + 2);
+        EXPECT_EQ(Counts[0].BytesWritten, 4);
+        EXPECT_EQ(Counts[1].BytesRead, 2);
+        EXPECT_EQ(Counts[1].BytesWritten, 0);
+    }
+}
+
+TEST(TestCPUEngines, FlagsAreVisibleThroughRFL)
+{
+    // Reads flags that were set but not tested yet, and overwrites them before a jump could test them
+    constexpr std::string_view Program = "mov r0, 32767   \n" // 0x8000
+                                         "add r0, 1       \n" // 0x8004
+                                         "mov r1, rfl     \n" // 0x8007
+                                         "sub r0, r0      \n" // 0x8009
+                                         "mov rfl, 0      \n" // 0x800B
+                                         "jz 32803        \n" // 0x800E
+                                         "mov r3, 49153   \n" // 0x8011
+                                         "shl r3, 1       \n" // 0x8015
+                                         "jc 32797        \n" // 0x8018
+                                         "hlt             \n" // 0x801B
+                                         "hlt             \n" // 0x801C
+                                         "mov r2, rfl     \n" // 0x801D
+                                         "hlt             \n" // 0x801F
+                                         "nop             \n" // 0x8020
+                                         "nop             \n" // 0x8021
+                                         "nop             \n" // 0x8022
+                                         "hlt             \n"; // 0x8023
+
+    auto Expected = RunProgramOnEngine(ExecutionEngine::Interpreter, Program);
+    EXPECT_EQ(RunProgramOnEngine(ExecutionEngine::Threaded, Program), Expected);
+    EXPECT_EQ(RunProgramOnEngine(ExecutionEngine::BasicBlocks, Program), Expected);
+    EXPECT_EQ(RunProgramOnEngine(ExecutionEngine::JIT, Program), Expected);
+    EXPECT_EQ(Expected.substr(0, Expected.find("; halted")), "ip: 0x8020; r0: 0x0000; r1: 0x000a; r2: 0x0006; r3: 0x8002; rsp: 0x0000; rfl: 0x0006");
+}
+
+TEST(TestCPUEngines, RunForStopsRunawayPrograms)
+{
+    constexpr std::string_view Program = "add r0, 1       \n" // 0x8000
+                                         "jmp 32768       \n"; // 0x8003
+
+    for (auto Engine : { ExecutionEngine::Interpreter, ExecutionEngine::Threaded, ExecutionEngine::BasicBlocks, ExecutionEngine::JIT })
+    {
+        auto Processor = LoadProgramOnEngine(Engine, Program);
+        Processor->SetIP(0x8000);
+
+        for (uint64_t Run = 1; Run <= 3; Run++)
+        {
+            auto Result = Processor->RunFor(10000);
+            EXPECT_EQ(Result.Reason, StopReason::CycleLimit);
+            EXPECT_GE(Result.Instructions, 10000);
+            EXPECT_LT(Result.Instructions, 10000 + 64);
+        }
+
+        // NOTE: every engine stops on an instruction boundary, so the counter matches the work that was done
+        auto Cycles = Processor->GetCycleCount();
+        EXPECT_GE(Cycles, 30000);
+        EXPECT_EQ(Processor->GetRegister(Register::R0), static_cast<uint16_t>((Cycles + 1) / 2));
+        EXPECT_FALSE(Processor->IsHalted());
+    }
+}
+
+TEST(TestCPUEngines, BreakpointsStopEveryEngine)
+{
+    constexpr std::string_view Program = "mov r1, 40      \n" // 0x8000
+                                         "add r0, r1      \n" // 0x8003
+                                         "xor r2, r0      \n" // 0x8005
+                                         "sub r1, 1       \n" // 0x8007
+                                         "jz 32784        \n" // 0x800A
+                                         "jmp 32771       \n" // 0x800D
+                                         "hlt             \n"; // 0x8010
+
+    for (auto Engine : { ExecutionEngine::Interpreter, ExecutionEngine::Threaded, ExecutionEngine::BasicBlocks, ExecutionEngine::JIT })
+    {
+        auto Processor = LoadProgramOnEngine(Engine, Program);
+        Processor->SetIP(0x8000);
+
+        // NOTE: the loop has to be hot already, so that the breakpoint lands in translated and compiled code
+        EXPECT_EQ(Processor->RunFor(100).Reason, StopReason::CycleLimit);
+        Processor->AddBreakpoint(0x8005);
+        EXPECT_TRUE(Processor->HasBreakpoint(0x8005));
+
+        auto Result = Processor->RunFor(1000);
+        EXPECT_EQ(Result.Reason, StopReason::Breakpoint);
+        EXPECT_EQ(Processor->GetStopReason(), StopReason::Breakpoint);
+        EXPECT_EQ(Processor->GetIP(), 0x8005);
+        auto Counter = Processor->GetRegister(Register::R1);
+        auto Cycles = Processor->GetCycleCount();
+
+        // The instruction at the breakpoint runs first, so every run goes once around the loop
+        for (uint16_t Iteration = 1; Iteration <= 3; Iteration++)
+        {
+            EXPECT_EQ(Processor->RunFor(1000).Reason, StopReason::Breakpoint);
+            EXPECT_EQ(Processor->GetIP(), 0x8005);
+            EXPECT_EQ(Processor->GetRegister(Register::R1), Counter - Iteration);
+            EXPECT_EQ(Processor->GetCycleCount(), Cycles + 5 * Iteration);
+        }
+
+        EXPECT_EQ(Processor->RunUntil(0x800A).Reason, StopReason::Breakpoint);
+        EXPECT_EQ(Processor->GetIP(), 0x800A);
+
+        Processor->RemoveBreakpoint(0x8005);
+        EXPECT_FALSE(Processor->HasBreakpoint(0x8005));
+        EXPECT_EQ(Processor->RunFor(1000).Reason, StopReason::Halted);
+        EXPECT_EQ(Processor->GetRegister(Register::R0), 820);
+        EXPECT_EQ(Processor->GetCycleCount(), 1 + 40 * 5);
+    }
+}
+
+TEST(TestCPUEngines, JITCompilesCodeAgainAfterBreakpointIsRemoved)
+{
+    constexpr std::string_view Program = "mov r1, 1000    \n" // 0x8000
+                                         "add r0, r1      \n" // 0x8004
+                                         "xor r2, r0      \n" // 0x8006
+                                         "sub r1, 1       \n" // 0x8008
+                                         "jz 32785        \n" // 0x800B
+                                         "jmp 32772       \n" // 0x800E
+                                         "hlt             \n"; // 0x8011
+
+    auto Processor = LoadProgramOnEngine(ExecutionEngine::JIT, Program);
+    if (!JITCompiler(*Processor).IsAvailable())
+        GTEST_SKIP() << "Native code can not be generated on this host";
+
+    Processor->SetIP(0x8000);
+    EXPECT_EQ(Processor->RunFor(200).Reason, StopReason::CycleLimit);
+    ASSERT_TRUE(Processor->HasNativeCode(0x8004));
+
+    Processor->AddBreakpoint(0x8006);
+    EXPECT_FALSE(Processor->HasNativeCode(0x8004));
+    EXPECT_EQ(Processor->RunFor(200).Reason, StopReason::Breakpoint);
+    Processor->RemoveBreakpoint(0x8006);
+
+    // A breakpoint is not a write to the code, so the page can be compiled again
+    EXPECT_EQ(Processor->RunFor(200).Reason, StopReason::CycleLimit);
+    EXPECT_TRUE(Processor->HasNativeCode(0x8004));
+
+    EXPECT_EQ(Processor->RunFor(10000).Reason, StopReason::Halted);
+    EXPECT_EQ(Processor->GetRegister(Register::R0), static_cast<uint16_t>(1000 * 1001 / 2));
+}
+
+TEST(TestCPUEngines, WatchpointsStopEveryEngineAfterTheAccess)
+{
+    constexpr std::string_view Program = "mov r1, 40      \n" // 0x8000
+                                         "add r0, 3       \n" // 0x8003
+                                         "sta 40962, r0   \n" // 0x8006
+                                         "lda r2, 40962   \n" // 0x800A
+                                         "sub r1, 1       \n" // 0x800E
+                                         "jz 32791        \n" // 0x8011
+                                         "jmp 32771       \n" // 0x8014
+                                         "hlt             \n"; // 0x8017
+
+    for (auto Engine : { ExecutionEngine::Interpreter, ExecutionEngine::Threaded, ExecutionEngine::BasicBlocks, ExecutionEngine::JIT })
+    {
+        auto Processor = LoadProgramOnEngine(Engine, Program);
+        Processor->SetIP(0x8000);
+
+        // NOTE: the loop has to be hot already, so that the engine has translated and compiled it
+        EXPECT_EQ(Processor->RunFor(100).Reason, StopReason::CycleLimit);
+        Watchpoint Stores = { 40962, 2, WatchpointKind::Write };
+        ASSERT_TRUE(Processor->AddWatchpoint(Stores));
+
+        WatchpointHit Hit;
+        EXPECT_EQ(Processor->RunFor(1000).Reason, StopReason::Watchpoint);
+        EXPECT_EQ(Processor->GetStopReason(), StopReason::Watchpoint);
+        EXPECT_EQ(Processor->GetIP(), 0x800A);
+        ASSERT_TRUE(Processor->GetWatchpointHit(Hit));
+        EXPECT_EQ(Hit.Trigger, Stores);
+        EXPECT_EQ(Hit.Value, Processor->GetRegister(Register::R0));
+        auto Cycles = Processor->GetCycleCount();
+
+        EXPECT_EQ(Processor->RunFor(1000).Reason, StopReason::Watchpoint);
+        EXPECT_EQ(Processor->GetIP(), 0x800A);
+        EXPECT_EQ(Processor->GetCycleCount(), Cycles + 6);
+
+        // Only the access that reads or writes the value stops the CPU
+        Processor->RemoveWatchpoint(Stores);
+        ASSERT_TRUE(Processor->AddWatchpoint({ 40962, 2, WatchpointKind::Access, 90 }));
+        EXPECT_EQ(Processor->RunFor(1000).Reason, StopReason::Watchpoint);
+        EXPECT_EQ(Processor->GetIP(), 0x800A);
+        EXPECT_EQ(Processor->GetRegister(Register::R0), 90);
+        EXPECT_EQ(Processor->RunUntil(0x8017).Reason, StopReason::Watchpoint);
+        EXPECT_EQ(Processor->GetIP(), 0x800E);
+        ASSERT_TRUE(Processor->GetWatchpointHit(Hit));
+        EXPECT_FALSE(Hit.IsWrite);
+
+        EXPECT_EQ(Processor->RunFor(1000).Reason, StopReason::Halted);
+        EXPECT_EQ(Processor->GetRegister(Register::R0), 120);
+        EXPECT_EQ(Processor->GetCycleCount(), 1 + 40 * 6);
+    }
+}
+
+TEST(TestCPUEngines, SelfModifyingCodeInsideBlock)
+{
+    // The sta rewrites the immediate of a mov that belongs to the block being executed
+    constexpr std::string_view Program = "mov r0, 5       \n" // 0x8000
+                                         "mov r2, 2       \n" // 0x8003
+                                         "mov r1, 257     \n" // 0x8006, immediate is stored at 0x8008
+                                         "add r3, r1      \n" // 0x800A
+                                         "sta 32776, r0   \n" // 0x800C
+                                         "sub r2, 1       \n" // 0x8010
+                                         "jz 32793        \n" // 0x8013
+                                         "jmp 32774       \n" // 0x8016
+                                         "hlt             \n"; // 0x8019
+
+    auto Expected = RunProgramOnEngine(ExecutionEngine::Interpreter, Program);
+    EXPECT_EQ(RunProgramOnEngine(ExecutionEngine::Threaded, Program), Expected);
+    EXPECT_EQ(RunProgramOnEngine(ExecutionEngine::BasicBlocks, Program), Expected);
+    EXPECT_EQ(RunProgramOnEngine(ExecutionEngine::JIT, Program), Expected);
+    EXPECT_NE(Expected.find("r3: 0x0106"), std::string::npos);
+}
+
+TEST(TestCPUEngines, JITMatchesInterpreterOnHotCode)
+{
+    // Runs long enough for the loop and the subroutine to be compiled, and reads every flag through RFL
+    constexpr std::string_view Program = "mov rsp, 40960  \n" // 0x8000
+                                         "mov r1, 300     \n" // 0x8004
+                                         "mov r2, r1      \n" // 0x8008
+                                         "shl r2, 3       \n" // 0x800A
+                                         "xor r0, r2      \n" // 0x800D
+                                         "add r0, 40000   \n" // 0x800F
+                                         "jc 32793        \n" // 0x8013
+                                         "or r3, 1        \n" // 0x8016
+                                         "mov r2, rfl     \n" // 0x8019
+                                         "push r2         \n" // 0x801B
+                                         "call 32832      \n" // 0x801D
+                                         "pop r2          \n" // 0x8020
+                                         "sta 41984, r0   \n" // 0x8022
+                                         "lda r3, 41984   \n" // 0x8026
+                                         "sub r1, 1       \n" // 0x802A
+                                         "jz 32819        \n" // 0x802D
+                                         "jmp 32776       \n" // 0x8030
+                                         "hlt             \n" // 0x8033
+                                         "nop             \n" // 0x8034
+                                         "nop             \n" // 0x8035
+                                         "nop             \n" // 0x8036
+                                         "nop             \n" // 0x8037
+                                         "nop             \n" // 0x8038
+                                         "nop             \n" // 0x8039
+                                         "nop             \n" // 0x803A
+                                         "nop             \n" // 0x803B
+                                         "nop             \n" // 0x803C
+                                         "nop             \n" // 0x803D
+                                         "nop             \n" // 0x803E
+                                         "nop             \n" // 0x803F
+                                         "not r3          \n" // 0x8040
+                                         "shr r3, 2       \n" // 0x8042
+                                         "and r3, 4095    \n" // 0x8045
+                                         "sub r0, r3      \n" // 0x8049
+                                         "jn 32849        \n" // 0x804B
+                                         "add r0, 7       \n" // 0x804E
+                                         "jv 32853        \n" // 0x8051
+                                         "nop             \n" // 0x8054
+                                         "ret             \n"; // 0x8055
+
+    auto Expected = RunProgramOnEngine(ExecutionEngine::Interpreter, Program);
+    EXPECT_EQ(RunProgramOnEngine(ExecutionEngine::JIT, Program), Expected);
+    EXPECT_EQ(Expected.substr(0, 10), "ip: 0x8034");
+}
+
+TEST(TestCPUEngines, JITHandlesSelfModifyingAndDeviceCode)
+{
+    // Every iteration rewrites the immediate of the first mov and reads and writes a memory mapped device
+    constexpr std::string_view Program = "mov r2, 100     \n" // 0x8000
+                                         "mov r1, 257     \n" // 0x8003, immediate is stored at 0x8005
+                                         "add r3, r1      \n" // 0x8007
+                                         "mov r0, r2      \n" // 0x8009
+                                         "sta 32773, r0   \n" // 0x800B
+                                         "lda r0, 49152   \n" // 0x800F
+                                         "add r3, r0      \n" // 0x8013
+                                         "sta 49154, r3   \n" // 0x8015
+                                         "sub r2, 1       \n" // 0x8019
+                                         "jz 32802        \n" // 0x801C
+                                         "jmp 32771       \n" // 0x801F
+                                         "hlt             \n"; // 0x8022
+
+    auto Expected = RunProgramOnEngine(ExecutionEngine::Interpreter, Program);
+    EXPECT_EQ(RunProgramOnEngine(ExecutionEngine::BasicBlocks, Program), Expected);
+    EXPECT_EQ(RunProgramOnEngine(ExecutionEngine::JIT, Program), Expected);
+    EXPECT_EQ(Expected.substr(0, 10), "ip: 0x8023");
+}
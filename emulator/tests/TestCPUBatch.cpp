@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "CodeGenerator.h"
+#include "CPU.h"
+#include "CPUBatch.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "RandomAccessMemoryBlock.h"
+
+using namespace lce::Assembler;
+using namespace lce::Emulator;
+
+// Counts the steps of the Collatz sequence of the number at 0x4000, so that every lane branches differently
+constexpr std::string_view CollatzProgram = "lda r0, 16384   \n" // 0x8000
+                                            "mov r1, 0       \n" // 0x8004
+                                            "mov r2, r0      \n" // 0x8007
+                                            "sub r2, 1       \n" // 0x8009
+                                            "jz 32809        \n" // 0x800C
+                                            "add r1, 1       \n" // 0x800F
+                                            "mov r2, r0      \n" // 0x8012
+                                            "and r2, 1       \n" // 0x8014
+                                            "jz 32803        \n" // 0x8017
+                                            "mov r2, r0      \n" // 0x801A
+                                            "add r0, r0      \n" // 0x801C
+                                            "add r0, r2      \n" // 0x801E
+                                            "add r0, 1       \n" // 0x8020
+                                            "shr r0, 1       \n" // 0x8023
+                                            "jmp 32775       \n" // 0x8026
+                                            "sta 16386, r1   \n" // 0x8029
+                                            "push r1         \n" // 0x802D
+                                            "pop r3          \n" // 0x802F
+                                            "shl r3, r1      \n" // 0x8031
+                                            "hlt             \n"; // 0x8033
+
+constexpr uint16_t LaneMemoryAddress = 0x4000;
+constexpr uint16_t LaneMemorySize = 512;
+constexpr uint16_t StackAddress = 0x4100;
+
+static std::vector<uint8_t> AssembleProgram(std::string_view Program)
+{
+    Lexer Lexer(Program, "test_program.lca");
+    std::vector<lce::Assembler::Instruction> Instructions;
+    EXPECT_TRUE(Parse(Lexer, Instructions));
+    return GenerateMachineCode(Instructions);
+}
+
+static std::unique_ptr<RandomAccessMemoryBlock> CreateProgramMemory(const std::vector<uint8_t>& Bytes)
+{
+    auto RAM = std::make_unique<RandomAccessMemoryBlock>(16384);
+    RAM->WriteRange(0, Bytes);
+    return RAM;
+}
+
+static void ExpectLanesMatchCPU(BatchKernelSet KernelSet, size_t LaneCount)
+{
+    auto Bytes = AssembleProgram(CollatzProgram);
+
+    CPUBatch Batch(LaneCount, KernelSet);
+    ASSERT_TRUE(Batch.AddMemoryBlock(CreateProgramMemory(Bytes), 0x8000));
+    ASSERT_TRUE(Batch.AddLaneMemory(LaneMemoryAddress, LaneMemorySize));
+    for (size_t Lane = 0; Lane < LaneCount; Lane++)
+    {
+        uint8_t Input[] = { static_cast<uint8_t>(Lane + 1), 0 };
+        ASSERT_TRUE(Batch.WriteLaneMemory(Lane, LaneMemoryAddress, Input));
+        Batch.SetRegister(Lane, Register::RSP, StackAddress);
+    }
+    Batch.Run(0x8000);
+
+    for (size_t Lane = 0; Lane < LaneCount; Lane++)
+    {
+        CPU Processor;
+        Processor.Reset();
+        Processor.AddMemoryBlock(CreateProgramMemory(Bytes), 0x8000);
+
+        auto Data = std::make_unique<RandomAccessMemoryBlock>(LaneMemorySize);
+        Data->Write(0, static_cast<uint8_t>(Lane + 1));
+        auto* DataPointer = Data.get();
+        Processor.AddMemoryBlock(std::move(Data), LaneMemoryAddress);
+        Processor.SetRegister(Register::RSP, StackAddress);
+        Processor.Run(0x8000);
+
+        EXPECT_EQ(Batch.SerializeState(Lane), Processor.SerializeState()) << "lane " << Lane;
+        EXPECT_EQ(Batch.ReadLaneMemory(Lane, LaneMemoryAddress + 2), DataPointer->Read(2)) << "lane " << Lane;
+    }
+}
+
+TEST(TestCPUBatch, LanesMatchCPU)
+{
+    for (auto KernelSet : { BatchKernelSet::Scalar, BatchKernelSet::SSE2, BatchKernelSet::AVX2 })
+    {
+        if (!CPUBatch::IsKernelSetSupported(KernelSet))
+            continue;
+
+        SCOPED_TRACE(CPUBatch(1, KernelSet).GetKernelName());
+        ExpectLanesMatchCPU(KernelSet, 37);
+    }
+}
+
+TEST(TestCPUBatch, LaneMemoryCanHoldDifferentCode)
+{
+    // Every lane runs the code in its own memory, which sets r0 to the lane index
+    CPUBatch Batch(20);
+    ASSERT_TRUE(Batch.AddLaneMemory(0x8000, 16));
+    for (size_t Lane = 0; Lane < Batch.GetLaneCount(); Lane++)
+    {
+        auto Bytes = AssembleProgram(Lane % 2 ? "mov r0, 1000 \n hlt \n" : "mov r0, 7 \n nop \n hlt \n");
+        ASSERT_TRUE(Batch.WriteLaneMemory(Lane, 0x8000, Bytes));
+    }
+    Batch.Run(0x8000);
+
+    for (size_t Lane = 0; Lane < Batch.GetLaneCount(); Lane++)
+    {
+        EXPECT_TRUE(Batch.IsHalted(Lane));
+        EXPECT_EQ(Batch.GetRegister(Lane, Register::R0), Lane % 2 ? 1000 : 7);
+    }
+}
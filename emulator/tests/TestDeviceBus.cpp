@@ -0,0 +1,185 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "CodeGenerator.h"
+#include "CPU.h"
+#include "DeviceBus.h"
+#include "Instruction.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "RandomAccessMemoryBlock.h"
+
+using namespace lce::Assembler;
+using namespace lce::Emulator;
+
+// Free running cycle counter that can be read as a word
+class CycleCounterDevice : public Device
+{
+public:
+    uint64_t Cycles = 0;
+    uint64_t AdvanceCalls = 0;
+
+    virtual uint16_t Size() const override
+    {
+        return 2;
+    }
+
+    virtual uint8_t Read(uint16_t Register) override
+    {
+        return static_cast<uint8_t>(Cycles >> (Register * 8));
+    }
+
+    virtual void Write(uint16_t, uint8_t) override
+    {
+    }
+
+    virtual void Advance(uint64_t Elapsed) override
+    {
+        Cycles += Elapsed;
+        AdvanceCalls++;
+    }
+};
+
+// Delivers the byte written to its first register to the host a fixed number of cycles later
+class DelayedOutputDevice : public Device
+{
+public:
+    constexpr static uint64_t Delay = 100;
+
+    uint64_t Cycles = 0;
+    uint64_t AdvanceCalls = 0;
+    std::vector<std::pair<uint8_t, uint64_t>> Delivered;
+
+    virtual uint16_t Size() const override
+    {
+        return 2;
+    }
+
+    virtual uint8_t Read(uint16_t) override
+    {
+        return 0;
+    }
+
+    virtual void Write(uint16_t Register, uint8_t Value) override
+    {
+        if (Register != 0)
+            return;
+        m_Pending = Value;
+        m_CyclesUntilDelivery = Delay;
+    }
+
+    virtual void Advance(uint64_t Elapsed) override
+    {
+        Cycles += Elapsed;
+        AdvanceCalls++;
+        if (m_CyclesUntilDelivery == 0)
+            return;
+
+        if (Elapsed >= m_CyclesUntilDelivery)
+        {
+            Delivered.emplace_back(m_Pending, Cycles);
+            m_CyclesUntilDelivery = 0;
+        }
+        else
+        {
+            m_CyclesUntilDelivery -= Elapsed;
+        }
+    }
+
+    virtual uint64_t GetCyclesUntilNextEvent() const override
+    {
+        return m_CyclesUntilDelivery ? m_CyclesUntilDelivery : UINT64_MAX;
+    }
+
+private:
+    uint8_t m_Pending = 0;
+    uint64_t m_CyclesUntilDelivery = 0;
+};
+
+template <typename DeviceType>
+static std::unique_ptr<CPU> CreateCPUWithDevice(ExecutionEngine Engine, std::string_view Source, DeviceType*& DevicePointer)
+{
+    auto Processor = std::make_unique<CPU>(Engine);
+    Processor->Reset();
+
+    Lexer Lexer(Source, "test_program.lca");
+    std::vector<lce::Assembler::Instruction> Instructions;
+    EXPECT_TRUE(Parse(Lexer, Instructions));
+    auto RAM = std::make_unique<RandomAccessMemoryBlock>(16384);
+    RAM->WriteRange(0, GenerateMachineCode(Instructions));
+    Processor->AddMemoryBlock(std::move(RAM), 0x8000);
+
+    auto NewDevice = std::make_unique<DeviceType>();
+    DevicePointer = NewDevice.get();
+    auto Bus = std::make_unique<DeviceBus>(0x4000);
+    EXPECT_TRUE(Bus->AddDevice(std::move(NewDevice), 0x0000));
+    EXPECT_TRUE(Processor->AddDeviceBus(std::move(Bus), 0xC000));
+    return Processor;
+}
+
+TEST(TestDeviceBus, DevicesCatchUpWhenAccessed)
+{
+    constexpr std::string_view Program = "lda r0, 49152   \n"
+                                         "nop             \n"
+                                         "nop             \n"
+                                         "nop             \n"
+                                         "nop             \n"
+                                         "nop             \n"
+                                         "lda r1, 49152   \n"
+                                         "hlt             \n";
+
+    CycleCounterDevice* Counter = nullptr;
+    auto Processor = CreateCPUWithDevice(ExecutionEngine::Interpreter, Program, Counter);
+    Processor->Run(0x8000);
+
+    EXPECT_EQ(Processor->GetRegister(Register::R0), 1);
+    EXPECT_EQ(Processor->GetRegister(Register::R1), 7);
+
+    // NOTE: both bytes of a word are read in the same cycle, so the device is only advanced once per lda
+    EXPECT_EQ(Counter->AdvanceCalls, 2);
+}
+
+TEST(TestDeviceBus, EventsAreDeliveredWhileTheGuestRuns)
+{
+    constexpr std::string_view Program = "mov r0, 7       \n" // 0x8000
+                                         "sta 49152, r0   \n" // 0x8003
+                                         "mov r1, 1000    \n" // 0x8007
+                                         "sub r1, 1       \n" // 0x800B
+                                         "jz 32788        \n" // 0x800E
+                                         "jmp 32779       \n" // 0x8011
+                                         "hlt             \n"; // 0x8014
+
+    for (auto Engine : { ExecutionEngine::Interpreter, ExecutionEngine::Threaded, ExecutionEngine::BasicBlocks, ExecutionEngine::JIT })
+    {
+        DelayedOutputDevice* Output = nullptr;
+        auto Processor = CreateCPUWithDevice(Engine, Program, Output);
+        Processor->Run(0x8000);
+        EXPECT_TRUE(Processor->IsHalted());
+
+        // The store retires in the second cycle, engines that work with blocks can deliver the event up to a block late
+        ASSERT_EQ(Output->Delivered.size(), 1);
+        EXPECT_EQ(Output->Delivered[0].first, 7);
+        EXPECT_GE(Output->Delivered[0].second, 2 + DelayedOutputDevice::Delay);
+        EXPECT_LE(Output->Delivered[0].second, 2 + DelayedOutputDevice::Delay + 64);
+        if (Engine == ExecutionEngine::Interpreter || Engine == ExecutionEngine::Threaded)
+        {
+            EXPECT_EQ(Output->Delivered[0].second, 2 + DelayedOutputDevice::Delay);
+        }
+
+        // The device is advanced for the store and the event, not for every instruction of the loop
+        EXPECT_LE(Output->AdvanceCalls, 4);
+        EXPECT_GT(Processor->GetCycleCount(), 3000);
+    }
+}
+
+TEST(TestDeviceBus, AddDeviceRejectsOverlap)
+{
+    DeviceBus Bus(16);
+    EXPECT_TRUE(Bus.AddDevice(std::make_unique<CycleCounterDevice>(), 0));
+    EXPECT_FALSE(Bus.AddDevice(std::make_unique<CycleCounterDevice>(), 1));
+    EXPECT_FALSE(Bus.AddDevice(std::make_unique<CycleCounterDevice>(), 15));
+    EXPECT_TRUE(Bus.AddDevice(std::make_unique<CycleCounterDevice>(), 14));
+}
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "CodeGenerator.h"
+#include "CPU.h"
+#include "ExecutionProfiler.h"
+#include "Instruction.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "RandomAccessMemoryBlock.h"
+
+using namespace lce::Assembler;
+using namespace lce::Emulator;
+
+// Calls the outer subroutine twice, which calls the inner one that loops four times
+constexpr std::string_view ProfiledProgram = "mov rsp, 40960  \n" // 0x8000
+                                             "call 32784      \n" // 0x8004
+                                             "call 32784      \n" // 0x8007
+                                             "hlt             \n" // 0x800A
+                                             "nop             \n" // 0x800B
+                                             "nop             \n" // 0x800C
+                                             "nop             \n" // 0x800D
+                                             "nop             \n" // 0x800E
+                                             "nop             \n" // 0x800F
+                                             "call 32800      \n" // 0x8010
+                                             "ret             \n" // 0x8013
+                                             "nop             \n" // 0x8014
+                                             "nop             \n" // 0x8015
+                                             "nop             \n" // 0x8016
+                                             "nop             \n" // 0x8017
+                                             "nop             \n" // 0x8018
+                                             "nop             \n" // 0x8019
+                                             "nop             \n" // 0x801A
+                                             "nop             \n" // 0x801B
+                                             "nop             \n" // 0x801C
+                                             "nop             \n" // 0x801D
+                                             "nop             \n" // 0x801E
+                                             "nop             \n" // 0x801F
+                                             "mov r0, 4       \n" // 0x8020
+                                             "sub r0, 1       \n" // 0x8023
+                                             "jz 32812        \n" // 0x8026
+                                             "jmp 32803       \n" // 0x8029
+                                             "ret             \n"; // 0x802C
+
+class TestExecutionProfiler : public ::testing::Test
+{
+protected:
+    CPU CPU { ExecutionEngine::BasicBlocks };
+    ExecutionProfiler Profiler;
+
+    void SetUp() override
+    {
+        CPU.Reset();
+
+        Lexer Lexer(ProfiledProgram, "profiled.lca");
+        std::vector<lce::Assembler::Instruction> Instructions;
+        ASSERT_TRUE(Parse(Lexer, Instructions));
+
+        std::vector<SourceMapEntry> SourceMap;
+        auto RAM = std::make_unique<RandomAccessMemoryBlock>(16384);
+        RAM->WriteRange(0, GenerateMachineCode(Instructions, SourceMap));
+        CPU.AddMemoryBlock(std::move(RAM), 0x8000);
+        Profiler.AddSourceMap(SourceMap, 0x8000);
+
+        CPU.SetProfiler(&Profiler);
+        CPU.Run(0x8000);
+        ASSERT_TRUE(CPU.IsHalted());
+    }
+};
+
+TEST_F(TestExecutionProfiler, CountsAddressesAndHandlers)
+{
+    EXPECT_EQ(Profiler.GetInstructionCount(), CPU.GetCycleCount());
+    EXPECT_EQ(Profiler.GetExecutionCount(0x8000), 1);
+    EXPECT_EQ(Profiler.GetExecutionCount(0x8010), 2);
+    EXPECT_EQ(Profiler.GetExecutionCount(0x8023), 8);
+    EXPECT_EQ(Profiler.GetExecutionCount(0x8029), 6);
+    EXPECT_EQ(Profiler.GetExecutionCount(0x800B), 0);
+
+    EXPECT_EQ(Profiler.GetExecutionCount(HandlerID::CallImmediate), 4);
+    EXPECT_EQ(Profiler.GetExecutionCount(HandlerID::Ret), 4);
+    EXPECT_EQ(Profiler.GetExecutionCount(HandlerID::SubImmediate), 8);
+}
+
+TEST_F(TestExecutionProfiler, AttributesCyclesToCallEdges)
+{
+    // The inner subroutine runs 1 + 4 * 3 - 1 + 1 = 13 instructions, the outer one adds its call and ret
+    auto Edges = Profiler.GetCallEdges();
+    ASSERT_EQ(Edges.size(), 3);
+    EXPECT_EQ(Edges[0].CallSite, 0x8010);
+    EXPECT_EQ(Edges[0].Target, 0x8020);
+    EXPECT_EQ(Edges[0].Calls, 2);
+    EXPECT_EQ(Edges[0].Cycles, 2 * (1 + 13));
+    EXPECT_EQ(Edges[1].CallSite, 0x8004);
+    EXPECT_EQ(Edges[1].Cycles, 1 + 1 + 13 + 1);
+    EXPECT_EQ(Edges[2].CallSite, 0x8007);
+    EXPECT_EQ(Edges[2].Cycles, Edges[1].Cycles);
+}
+
+TEST_F(TestExecutionProfiler, WritesFoldedStacksAndReport)
+{
+    std::ostringstream FoldedStacks;
+    Profiler.WriteFoldedStacks(FoldedStacks);
+    EXPECT_EQ(FoldedStacks.str(), "0x8000 profiled.lca:1 4\n"
+                                  "0x8000 profiled.lca:1;0x8010 profiled.lca:10 4\n"
+                                  "0x8000 profiled.lca:1;0x8010 profiled.lca:10;0x8020 profiled.lca:24 26\n");
+
+    std::ostringstream Report;
+    Profiler.WriteReport(Report, 3);
+    auto Text = Report.str();
+    EXPECT_NE(Text.find("Instructions executed: 34"), std::string::npos);
+    EXPECT_NE(Text.find("8  23.53%  0x8023 profiled.lca:25"), std::string::npos);
+    EXPECT_NE(Text.find("SubImmediate"), std::string::npos);
+    EXPECT_NE(Text.find("2 calls  0x8010 profiled.lca:10 -> 0x8020 profiled.lca:24"), std::string::npos);
+}
@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "CodeGenerator.h"
+#include "CPU.h"
+#include "ExecutionTracer.h"
+#include "Instruction.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "RandomAccessMemoryBlock.h"
+
+using namespace lce::Assembler;
+using namespace lce::Emulator;
+
+// Calls a subroutine that goes through the stack and memory three times
+constexpr std::string_view TracedProgram = "mov rsp, 40960  \n" // 0x8000
+                                           "mov r1, 3       \n" // 0x8004
+                                           "call 32800      \n" // 0x8007
+                                           "sub r1, 1       \n" // 0x800A
+                                           "jz 32787        \n" // 0x800D
+                                           "jmp 32775       \n" // 0x8010
+                                           "hlt             \n" // 0x8013
+                                           "nop             \n" // 0x8014
+                                           "nop             \n" // 0x8015
+                                           "nop             \n" // 0x8016
+                                           "nop             \n" // 0x8017
+                                           "nop             \n" // 0x8018
+                                           "nop             \n" // 0x8019
+                                           "nop             \n" // 0x801A
+                                           "nop             \n" // 0x801B
+                                           "nop             \n" // 0x801C
+                                           "nop             \n" // 0x801D
+                                           "nop             \n" // 0x801E
+                                           "nop             \n" // 0x801F
+                                           "push r1         \n" // 0x8020
+                                           "pop r2          \n" // 0x8022
+                                           "sta 41984, r2   \n" // 0x8024
+                                           "lda r0, 41984   \n" // 0x8028
+                                           "add r3, r0      \n" // 0x802C
+                                           "ret             \n"; // 0x802E
+
+static std::unique_ptr<CPU> CreateCPU(ExecutionEngine Engine, std::string_view Source)
+{
+    auto Processor = std::make_unique<CPU>(Engine);
+    Processor->Reset();
+
+    Lexer Lexer(Source, "test_program.lca");
+    std::vector<lce::Assembler::Instruction> Instructions;
+    EXPECT_TRUE(Parse(Lexer, Instructions));
+    auto RAM = std::make_unique<RandomAccessMemoryBlock>(16384);
+    RAM->WriteRange(0, GenerateMachineCode(Instructions));
+    Processor->AddMemoryBlock(std::move(RAM), 0x8000);
+    return Processor;
+}
+
+static std::vector<uint8_t> ReadBinaryFile(const std::filesystem::path& Path)
+{
+    std::ifstream File(Path, std::ios::binary);
+    return { std::istreambuf_iterator<char>(File), std::istreambuf_iterator<char>() };
+}
+
+TEST(TestExecutionTracer, TraceMatchesSteppedExecution)
+{
+    auto Path = std::filesystem::temp_directory_path() / "lce_execution_trace.bin";
+
+    // NOTE: the JIT engine is used to check that tracing falls back to the interpreter
+    auto Processor = CreateCPU(ExecutionEngine::JIT, TracedProgram);
+    auto Tracer = ExecutionTracer::Open(Path);
+    ASSERT_NE(Tracer, nullptr);
+    Processor->SetTracer(Tracer.get());
+    Processor->Run(0x8000);
+    EXPECT_EQ(Processor->GetRegister(Register::R3), 6);
+    Tracer.reset();
+
+    std::vector<TraceRecord> Records;
+    ASSERT_TRUE(DecodeTrace(ReadBinaryFile(Path), Records));
+    ASSERT_EQ(Records.size(), Processor->GetCycleCount());
+
+    auto Reference = CreateCPU(ExecutionEngine::Interpreter, TracedProgram);
+    Reference->SetIP(0x8000);
+    for (const auto& Record : Records)
+    {
+        EXPECT_EQ(Record.IP, Reference->GetIP());
+        Reference->RunUntil([](const CPU&) { return true; });
+        for (size_t Index = 0; Index < TracedRegisterCount; Index++)
+            EXPECT_EQ(Record.Registers[Index], Reference->GetRegister(static_cast<Register>(Index)));
+    }
+    EXPECT_TRUE(Reference->IsHalted());
+
+    // The first pass through the subroutine: push, pop, sta, lda, add and ret
+    ASSERT_GT(Records.size(), 8);
+    EXPECT_EQ(Records[2].ID, HandlerID::CallImmediate);
+    EXPECT_TRUE(Records[2].IsWrite);
+    EXPECT_EQ(Records[2].Address, 40960);
+    EXPECT_EQ(Records[2].Value, 0x800A);
+    EXPECT_EQ(Records[3].ID, HandlerID::PushRegister);
+    EXPECT_EQ(Records[3].Address, 40962);
+    EXPECT_EQ(Records[3].Value, 3);
+    EXPECT_EQ(Records[4].ID, HandlerID::Pop);
+    EXPECT_FALSE(Records[4].IsWrite);
+    EXPECT_EQ(Records[4].Address, 40962);
+    EXPECT_EQ(Records[5].ID, HandlerID::StaImmediate);
+    EXPECT_TRUE(Records[5].IsWrite);
+    EXPECT_EQ(Records[5].Address, 41984);
+    EXPECT_EQ(Records[6].ID, HandlerID::LdaImmediate);
+    EXPECT_EQ(Records[6].Value, 3);
+    EXPECT_FALSE(Records[7].HasMemoryAccess);
+    EXPECT_EQ(Records[8].ID, HandlerID::Ret);
+    EXPECT_EQ(Records[8].Address, 40960);
+    EXPECT_EQ(Records[8].Value, 0x800A);
+
+    std::filesystem::remove(Path);
+}
+
+TEST(TestExecutionTracer, StraightLineCodeIsCompact)
+{
+    constexpr std::string_view Program = "add r0, 1       \n" // 0x8000
+                                         "sub r1, 1       \n" // 0x8003
+                                         "jz 32780        \n" // 0x8006
+                                         "jmp 32768       \n" // 0x8009
+                                         "hlt             \n"; // 0x800C
+
+    auto Path = std::filesystem::temp_directory_path() / "lce_execution_trace_compact.bin";
+    auto Processor = CreateCPU(ExecutionEngine::Interpreter, Program);
+    Processor->SetRegister(Register::R1, 10000);
+    auto Tracer = ExecutionTracer::Open(Path, 16384);
+    ASSERT_NE(Tracer, nullptr);
+    Processor->SetTracer(Tracer.get());
+    Processor->Run(0x8000);
+    Tracer->Flush();
+
+    auto Statistics = Tracer->GetStatistics();
+    EXPECT_EQ(Statistics.Records, Processor->GetCycleCount());
+    EXPECT_EQ(std::filesystem::file_size(Path), Statistics.Bytes + 9);
+
+    // Most records only hold the header and one or two changed registers, the IP is only stored after jumps
+    EXPECT_LT(Statistics.Bytes, Statistics.Records * 5);
+
+    std::vector<TraceRecord> Records;
+    ASSERT_TRUE(DecodeTrace(ReadBinaryFile(Path), Records));
+    ASSERT_EQ(Records.size(), Statistics.Records);
+    EXPECT_EQ(Records.back().ID, HandlerID::Hlt);
+    EXPECT_EQ(Records.back().Registers[0], 10000);
+
+    Tracer.reset();
+    std::filesystem::remove(Path);
+}
+
+TEST(TestExecutionTracer, DecodeRejectsMalformedTraces)
+{
+    std::vector<TraceRecord> Records;
+    const uint8_t WrongMagic[] = { 'N', 'O', 'T', 'A', 'T', 'R', 'A', 'C', 1 };
+    EXPECT_FALSE(DecodeTrace(WrongMagic, Records));
+
+    // The header announces an IP that is missing
+    const uint8_t Truncated[] = { 'L', 'C', 'E', 'T', 'R', 'A', 'C', 'E', 1, 0x40 | static_cast<uint8_t>(HandlerID::Nop), 0 };
+    EXPECT_FALSE(DecodeTrace(Truncated, Records));
+}
@@ -0,0 +1,191 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "CodeGenerator.h"
+#include "CPU.h"
+#include "FixedMapCPU.h"
+#include "Instruction.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "RandomAccessMemoryBlock.h"
+
+using namespace lce::Assembler;
+using namespace lce::Emulator;
+
+static std::vector<uint8_t> AssembleProgram(std::string_view Source)
+{
+    Lexer Lexer(Source, "test_program.lca");
+    std::vector<lce::Assembler::Instruction> Instructions;
+    EXPECT_TRUE(Parse(Lexer, Instructions));
+    return GenerateMachineCode(Instructions);
+}
+
+// Memory mapped device that returns a different value on every read
+class CounterDevice : public MemoryBlock
+{
+public:
+    virtual uint8_t Read(uint16_t RelativeAddress) const override
+    {
+        return static_cast<uint8_t>(m_Counter++ * 3 + RelativeAddress);
+    }
+
+    virtual void Write(uint16_t, uint8_t Value) override
+    {
+        m_Counter += Value;
+    }
+
+    virtual uint16_t Size() const override
+    {
+        return 16;
+    }
+
+private:
+    mutable uint8_t m_Counter = 0;
+};
+
+class TestFixedMapCPU : public ::testing::Test
+{
+protected:
+    StandardCPU CPU;
+
+    void SetUp() override
+    {
+        CPU.Reset();
+        ASSERT_TRUE(CPU.AddDevice(std::make_unique<CounterDevice>(), 0xC000));
+    }
+
+    void LoadProgram(std::string_view Source, uint16_t Address)
+    {
+        auto Bytes = AssembleProgram(Source);
+        ASSERT_TRUE(CPU.LoadMemory(Address, Bytes));
+    }
+};
+
+TEST_F(TestFixedMapCPU, MatchesDynamicCPU)
+{
+    // Exercises the stack, arithmetic, flags and a device whose reads have side effects
+    constexpr std::string_view Program = "mov rsp, 40960  \n" // 0x8000
+                                         "mov r1, 10      \n" // 0x8004
+                                         "call 32784      \n" // 0x8007
+                                         "hlt             \n" // 0x800A
+                                         "nop             \n" // 0x800B
+                                         "nop             \n" // 0x800C
+                                         "nop             \n" // 0x800D
+                                         "nop             \n" // 0x800E
+                                         "nop             \n" // 0x800F
+                                         "add r0, r1      \n" // 0x8010
+                                         "push r0         \n" // 0x8012
+                                         "lda r2, 49152   \n" // 0x8014
+                                         "sta 49153, r0   \n" // 0x8018
+                                         "shl r2, 1       \n" // 0x801C
+                                         "pop r3          \n" // 0x801F
+                                         "sub r1, 1       \n" // 0x8021
+                                         "jz 32810        \n" // 0x8024
+                                         "jmp 32784       \n" // 0x8027
+                                         "ret             \n"; // 0x802A
+
+    lce::Emulator::CPU Reference;
+    Reference.Reset();
+    auto RAM = std::make_unique<RandomAccessMemoryBlock>(16384);
+    RAM->WriteRange(0, AssembleProgram(Program));
+    Reference.AddMemoryBlock(std::move(RAM), 0x8000);
+    Reference.AddMemoryBlock(std::make_unique<CounterDevice>(), 0xC000);
+    Reference.Run(0x8000);
+
+    LoadProgram(Program, 0x8000);
+    CPU.Run(0x8000);
+
+    EXPECT_EQ(CPU.SerializeState(), Reference.SerializeState());
+    EXPECT_EQ(CPU.GetCycleCount(), Reference.GetCycleCount());
+    EXPECT_EQ(CPU.GetRegister(Register::R0), 55);
+}
+
+TEST_F(TestFixedMapCPU, RunsFromROMAndIgnoresWritesToIt)
+{
+    LoadProgram("mov r0, 4660    \n"
+                "sta 32768, r0   \n"
+                "sta 0, r0       \n"
+                "lda r1, 32768   \n"
+                "hlt             \n",
+                StandardMemoryMap::EntryPoint);
+    auto OriginalByte = CPU.PeekMemory(0);
+
+    CPU.Run(StandardMemoryMap::EntryPoint);
+    EXPECT_TRUE(CPU.IsHalted());
+    EXPECT_EQ(CPU.GetRegister(Register::R1), 4660);
+    EXPECT_EQ(CPU.PeekMemory(0), OriginalByte);
+    EXPECT_EQ(CPU.PeekMemory(0x8000), 0x34);
+    EXPECT_EQ(CPU.PeekMemory(0x8001), 0x12);
+}
+
+TEST_F(TestFixedMapCPU, SelfModifyingCode)
+{
+    LoadProgram("mov r0, 5       \n" // 0x8000
+                "mov r2, 2       \n" // 0x8003
+                "mov r1, 257     \n" // 0x8006, immediate is stored at 0x8008
+                "add r3, r1      \n" // 0x800A
+                "sta 32776, r0   \n" // 0x800C
+                "sub r2, 1       \n" // 0x8010
+                "jz 32793        \n" // 0x8013
+                "jmp 32774       \n" // 0x8016
+                "hlt             \n", // 0x8019
+                0x8000);
+
+    CPU.Run(0x8000);
+    EXPECT_EQ(CPU.GetRegister(Register::R3), 257 + 5);
+}
+
+TEST_F(TestFixedMapCPU, AddDeviceOnlyAcceptsTheIOWindow)
+{
+    EXPECT_FALSE(CPU.AddDevice(std::make_unique<RandomAccessMemoryBlock>(16), 0xBFF8));
+    EXPECT_FALSE(CPU.AddDevice(std::make_unique<RandomAccessMemoryBlock>(16), 0xC008));
+    EXPECT_FALSE(CPU.AddDevice(std::make_unique<RandomAccessMemoryBlock>(16), 0xFFF8));
+    EXPECT_TRUE(CPU.AddDevice(std::make_unique<RandomAccessMemoryBlock>(16), 0xC010));
+    EXPECT_FALSE(CPU.LoadMemory(0xBFFF, std::vector<uint8_t>(2)));
+}
+
+TEST_F(TestFixedMapCPU, StopsAtBreakpoints)
+{
+    LoadProgram("mov r1, 3       \n" // 0x8000
+                "add r0, r1      \n" // 0x8003
+                "sub r1, 1       \n" // 0x8005
+                "jz 32782        \n" // 0x8008
+                "jmp 32771       \n" // 0x800B
+                "hlt             \n", // 0x800E
+                0x8000);
+    CPU.SetIP(0x8000);
+
+    CPU.AddBreakpoint(0x8005);
+    EXPECT_TRUE(CPU.HasBreakpoint(0x8005));
+    for (uint16_t Expected : { 3, 5, 6 })
+    {
+        EXPECT_EQ(CPU.RunFor(1000).Reason, StopReason::Breakpoint);
+        EXPECT_EQ(CPU.GetIP(), 0x8005);
+        EXPECT_EQ(CPU.GetRegister(Register::R0), Expected);
+    }
+
+    CPU.RemoveBreakpoint(0x8005);
+    EXPECT_EQ(CPU.RunFor(1000).Reason, StopReason::Halted);
+    EXPECT_EQ(CPU.GetRegister(Register::RFL), static_cast<uint16_t>(Flag::Zero));
+}
+
+TEST_F(TestFixedMapCPU, RunForStopsRunawayPrograms)
+{
+    LoadProgram("add r0, 1       \n" // 0x8000
+                "jmp 32768       \n", // 0x8003
+                0x8000);
+    CPU.SetIP(0x8000);
+
+    auto Result = CPU.RunFor(1000);
+    EXPECT_EQ(Result.Reason, StopReason::CycleLimit);
+    EXPECT_EQ(Result.Instructions, 1000);
+    EXPECT_EQ(CPU.GetRegister(Register::R0), 500);
+
+    LoadProgram("hlt", 0x8000);
+    Result = CPU.RunFor(1000);
+    EXPECT_EQ(Result.Reason, StopReason::Halted);
+}
@@ -0,0 +1,268 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "CodeGenerator.h"
+#include "CPU.h"
+#include "GDBServer.h"
+#include "Instruction.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "RandomAccessMemoryBlock.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace lce::Assembler;
+using namespace lce::Emulator;
+
+// Adds 5 + 4 + 3 + 2 + 1 to r0
+constexpr std::string_view Program = "mov r1, 5    \n" // 0x8000
+                                     "add r0, r1   \n" // 0x8003
+                                     "sub r1, 1    \n" // 0x8005
+                                     "jz 32782     \n" // 0x8008
+                                     "jmp 32771    \n" // 0x800B
+                                     "hlt          \n"; // 0x800E
+
+static std::unique_ptr<CPU> CreateCPU(std::string_view Source = Program)
+{
+    auto Processor = std::make_unique<CPU>();
+    Processor->Reset();
+
+    Lexer Lexer(Source, "test_program.lca");
+    std::vector<lce::Assembler::Instruction> Instructions;
+    EXPECT_TRUE(Parse(Lexer, Instructions));
+    auto RAM = std::make_unique<RandomAccessMemoryBlock>(16384);
+    RAM->WriteRange(0, GenerateMachineCode(Instructions));
+    Processor->AddMemoryBlock(std::move(RAM), 0x8000);
+    Processor->SetIP(0x8000);
+    return Processor;
+}
+
+TEST(TestGDBServer, ReadsAndWritesRegisters)
+{
+    auto Processor = CreateCPU();
+    GDBServer Server(*Processor);
+
+    Processor->SetRegister(Register::R0, 0x1234);
+    auto Registers = Server.HandlePacket("g");
+    ASSERT_EQ(Registers.size(), 7 * 4);
+    EXPECT_EQ(Registers.substr(0, 4), "3412");
+    EXPECT_EQ(Registers.substr(6 * 4), "0080");
+    EXPECT_EQ(Server.HandlePacket("p6"), "0080");
+
+    EXPECT_EQ(Server.HandlePacket("P1=cdab"), "OK");
+    EXPECT_EQ(Processor->GetRegister(Register::R1), 0xABCD);
+    EXPECT_EQ(Server.HandlePacket("P6=0380"), "OK");
+    EXPECT_EQ(Processor->GetIP(), 0x8003);
+    EXPECT_EQ(Server.HandlePacket("P7=0000"), "E01");
+
+    EXPECT_EQ(Server.HandlePacket("G" + std::string(6 * 4, '0') + "0080"), "OK");
+    EXPECT_EQ(Processor->GetRegister(Register::R1), 0);
+    EXPECT_EQ(Processor->GetIP(), 0x8000);
+    EXPECT_EQ(Server.HandlePacket("G0000"), "E01");
+}
+
+TEST(TestGDBServer, ReadsAndWritesMemory)
+{
+    auto Processor = CreateCPU();
+    GDBServer Server(*Processor);
+
+    uint8_t Code[4];
+    ASSERT_TRUE(Processor->ReadMemory(0x8000, Code));
+    EXPECT_EQ(Server.HandlePacket("m8000,4"), fmt::format("{:02x}{:02x}{:02x}{:02x}", Code[0], Code[1], Code[2], Code[3]));
+
+    EXPECT_EQ(Server.HandlePacket("Ma000,3:beef01"), "OK");
+    EXPECT_EQ(Server.HandlePacket("ma000,3"), "beef01");
+    EXPECT_EQ(Server.HandlePacket("Ma000,2:beef01"), "E01");
+
+    // Nothing is mapped past the RAM
+    EXPECT_EQ(Server.HandlePacket("mc000,2"), "E14");
+    EXPECT_EQ(Server.HandlePacket("Mbfff,2:0102"), "E14");
+    EXPECT_EQ(Server.HandlePacket("mbfff,1"), "00");
+}
+
+TEST(TestGDBServer, StopsAtBreakpointsAndReportsTheExit)
+{
+    auto Processor = CreateCPU();
+    GDBServer Server(*Processor);
+
+    EXPECT_EQ(Server.HandlePacket("Z0,8003,1"), "OK");
+    EXPECT_EQ(Server.HandlePacket("c"), "S05");
+    EXPECT_EQ(Processor->GetIP(), 0x8003);
+    EXPECT_EQ(Processor->GetRegister(Register::R0), 0);
+
+    EXPECT_EQ(Server.HandlePacket("c"), "S05");
+    EXPECT_EQ(Processor->GetIP(), 0x8003);
+    EXPECT_EQ(Processor->GetRegister(Register::R0), 5);
+    EXPECT_EQ(Server.HandlePacket("?"), "S05");
+
+    EXPECT_EQ(Server.HandlePacket("z0,8003,1"), "OK");
+    EXPECT_EQ(Server.HandlePacket("c"), "W00");
+    EXPECT_EQ(Processor->GetRegister(Register::R0), 15);
+    EXPECT_EQ(Server.HandlePacket("?"), "W00");
+}
+
+TEST(TestGDBServer, StopsAtWatchpoints)
+{
+    auto Processor = CreateCPU("mov r0, 7      \n" // 0x8000
+                               "sta 40962, r0  \n" // 0x8003
+                               "lda r1, 40962  \n" // 0x8007
+                               "hlt            \n"); // 0x800B
+    GDBServer Server(*Processor);
+
+    EXPECT_EQ(Server.HandlePacket("Z2,a002,2"), "OK");
+    EXPECT_EQ(Server.HandlePacket("Z3,a003,1"), "OK");
+    EXPECT_EQ(Server.HandlePacket("c"), "T05watch:a002;");
+    EXPECT_EQ(Processor->GetIP(), 0x8007);
+    EXPECT_EQ(Server.HandlePacket("?"), "T05watch:a002;");
+
+    EXPECT_EQ(Server.HandlePacket("z2,a002,2"), "OK");
+    EXPECT_EQ(Server.HandlePacket("z2,a002,2"), "E01");
+    EXPECT_EQ(Server.HandlePacket("c"), "T05rwatch:a003;");
+    EXPECT_EQ(Processor->GetIP(), 0x800B);
+
+    EXPECT_EQ(Server.HandlePacket("z3,a003,1"), "OK");
+    EXPECT_EQ(Server.HandlePacket("Z4,a002,0"), "E01");
+    EXPECT_EQ(Server.HandlePacket("c"), "W00");
+}
+
+TEST(TestGDBServer, StepsOneInstruction)
+{
+    auto Processor = CreateCPU();
+    GDBServer Server(*Processor);
+
+    // A breakpoint on the first instruction is hit before it runs, the next step leaves it
+    EXPECT_EQ(Server.HandlePacket("Z0,8000,1"), "OK");
+    EXPECT_EQ(Server.HandlePacket("s"), "S05");
+    EXPECT_EQ(Processor->GetIP(), 0x8000);
+    EXPECT_EQ(Server.HandlePacket("s"), "S05");
+    EXPECT_EQ(Processor->GetIP(), 0x8003);
+    EXPECT_EQ(Processor->GetRegister(Register::R1), 5);
+
+    EXPECT_EQ(Server.HandlePacket("z0,8000,1"), "OK");
+    EXPECT_EQ(Server.HandlePacket("s8000"), "S05");
+    EXPECT_EQ(Processor->GetIP(), 0x8003);
+}
+
+TEST(TestGDBServer, InterruptsARunningProgram)
+{
+    auto Processor = CreateCPU("jmp 32768 \n");
+    GDBServer Server(*Processor, 1000);
+
+    int Checks = 0;
+    Server.SetInterruptCheck([&] { return ++Checks == 3; });
+    EXPECT_EQ(Server.HandlePacket("c"), "S02");
+    EXPECT_EQ(Checks, 3);
+    EXPECT_GE(Processor->GetCycleCount(), 3000);
+}
+
+TEST(TestGDBServer, AnswersQueriesAndRejectsUnsupportedPackets)
+{
+    auto Processor = CreateCPU();
+    GDBServer Server(*Processor);
+
+    EXPECT_NE(Server.HandlePacket("qSupported:multiprocess+;swbreak+").find("qXfer:features:read+"), std::string::npos);
+    EXPECT_EQ(Server.HandlePacket("qAttached"), "1");
+    EXPECT_EQ(Server.HandlePacket("Hg0"), "OK");
+    EXPECT_EQ(Server.HandlePacket("vMustReplyEmpty"), "");
+    EXPECT_EQ(Server.HandlePacket("Z5,a000,2"), "");
+    EXPECT_EQ(Server.HandlePacket("X8000,0:"), "");
+
+    // The target description read in small chunks is the same as when it is read at once
+    auto Whole = Server.HandlePacket("qXfer:features:read:target.xml:0,fff");
+    ASSERT_TRUE(Whole.starts_with("l<?xml"));
+    EXPECT_NE(Whole.find("name=\"ip\""), std::string::npos);
+
+    std::string Chunked;
+    for (size_t Offset = 0;; Offset += 0x20)
+    {
+        auto Reply = Server.HandlePacket(fmt::format("qXfer:features:read:target.xml:{:x},20", Offset));
+        ASSERT_FALSE(Reply.empty());
+        Chunked += Reply.substr(1);
+        if (Reply[0] == 'l')
+            break;
+    }
+    EXPECT_EQ("l" + Chunked, Whole);
+
+    EXPECT_FALSE(Server.HasDetached());
+    EXPECT_EQ(Server.HandlePacket("D"), "OK");
+    EXPECT_TRUE(Server.HasDetached());
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+static std::string FramePacket(std::string_view Packet)
+{
+    uint8_t Checksum = 0;
+    for (auto Character : Packet)
+        Checksum += static_cast<uint8_t>(Character);
+    return fmt::format("${}#{:02x}", Packet, Checksum);
+}
+
+static std::string ReceiveExactly(int Socket, size_t Size)
+{
+    std::string Result;
+    while (Result.size() < Size)
+    {
+        char Buffer[256];
+        auto Received = recv(Socket, Buffer, std::min(sizeof(Buffer), Size - Result.size()), 0);
+        if (Received <= 0)
+            break;
+        Result.append(Buffer, Received);
+    }
+    return Result;
+}
+
+TEST(TestGDBServer, ServesADebuggerOverASocket)
+{
+    auto Processor = CreateCPU();
+    GDBServer Server(*Processor);
+
+    auto SocketPath = std::filesystem::temp_directory_path() / fmt::format("lce-gdb-test-{}.sock", getpid());
+    ASSERT_TRUE(Server.ListenUnix(SocketPath));
+    std::thread ServerThread([&] { Server.Serve(); });
+
+    int Client = socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_GE(Client, 0);
+    sockaddr_un Address = {};
+    Address.sun_family = AF_UNIX;
+    std::strncpy(Address.sun_path, SocketPath.c_str(), sizeof(Address.sun_path) - 1);
+    ASSERT_EQ(connect(Client, reinterpret_cast<sockaddr*>(&Address), sizeof(Address)), 0);
+
+    auto Exchange = [&](std::string_view Request, std::string_view Reply)
+    {
+        auto Framed = FramePacket(Request);
+        send(Client, Framed.data(), Framed.size(), 0);
+        auto Expected = "+" + FramePacket(Reply);
+        EXPECT_EQ(ReceiveExactly(Client, Expected.size()), Expected);
+    };
+
+    // A corrupted packet is rejected and the last reply is sent again when asked for
+    send(Client, "$g#00", 5, 0);
+    EXPECT_EQ(ReceiveExactly(Client, 1), "-");
+    Exchange("p6", "0080");
+    send(Client, "-", 1, 0);
+    EXPECT_EQ(ReceiveExactly(Client, FramePacket("0080").size()), FramePacket("0080"));
+
+    Exchange("Z0,8003,1", "OK");
+    Exchange("c", "S05");
+    Exchange("D", "OK");
+
+    ServerThread.join();
+    close(Client);
+    EXPECT_TRUE(Server.HasDetached());
+    EXPECT_EQ(Processor->GetIP(), 0x8003);
+}
+#endif
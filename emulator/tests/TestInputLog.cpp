@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "CodeGenerator.h"
+#include "CPU.h"
+#include "DeviceBus.h"
+#include "InputLog.h"
+#include "Instruction.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "RandomAccessMemoryBlock.h"
+
+using namespace lce::Assembler;
+using namespace lce::Emulator;
+
+// Stands in for a device that exposes host state, every instance returns a different sequence
+class NondeterministicDevice : public Device
+{
+public:
+    inline static uint8_t NextSeed = 1;
+
+    uint64_t Reads = 0;
+    uint64_t Writes = 0;
+
+    virtual uint16_t Size() const override
+    {
+        return 2;
+    }
+
+    virtual uint8_t Read(uint16_t) override
+    {
+        Reads++;
+        m_State = static_cast<uint8_t>(m_State * 5 + 3);
+        return m_State;
+    }
+
+    virtual void Write(uint16_t, uint8_t) override
+    {
+        Writes++;
+    }
+
+    virtual void Advance(uint64_t) override
+    {
+    }
+
+private:
+    uint8_t m_State = NextSeed++;
+};
+
+// Sums 50 words read from the device and writes every partial sum back to it
+constexpr std::string_view Program = "mov r1, 50      \n" // 0x8000
+                                     "lda r0, 49152   \n" // 0x8003
+                                     "add r2, r0      \n" // 0x8007
+                                     "sta 49152, r2   \n" // 0x8009
+                                     "sub r1, 1       \n" // 0x800D
+                                     "jz 32790        \n" // 0x8010
+                                     "jmp 32771       \n" // 0x8013
+                                     "hlt             \n"; // 0x8016
+
+static std::unique_ptr<CPU> CreateCPU(ExecutionEngine Engine, NondeterministicDevice*& DevicePointer)
+{
+    auto Processor = std::make_unique<CPU>(Engine);
+    Processor->Reset();
+
+    Lexer Lexer(Program, "test_program.lca");
+    std::vector<lce::Assembler::Instruction> Instructions;
+    EXPECT_TRUE(Parse(Lexer, Instructions));
+    auto RAM = std::make_unique<RandomAccessMemoryBlock>(16384);
+    RAM->WriteRange(0, GenerateMachineCode(Instructions));
+    Processor->AddMemoryBlock(std::move(RAM), 0x8000);
+
+    auto NewDevice = std::make_unique<NondeterministicDevice>();
+    DevicePointer = NewDevice.get();
+    auto Bus = std::make_unique<DeviceBus>(0x4000);
+    EXPECT_TRUE(Bus->AddDevice(std::move(NewDevice), 0x0000));
+    EXPECT_TRUE(Processor->AddDeviceBus(std::move(Bus), 0xC000));
+    return Processor;
+}
+
+TEST(TestInputLog, ReplayReproducesRecordedRun)
+{
+    for (auto Engine : { ExecutionEngine::Interpreter, ExecutionEngine::BasicBlocks, ExecutionEngine::JIT })
+    {
+        NondeterministicDevice* RecordedDevice = nullptr;
+        auto Recorded = CreateCPU(Engine, RecordedDevice);
+        InputLog Log;
+        Recorded->RecordInputs(&Log);
+        Recorded->Run(0x8000);
+        ASSERT_TRUE(Recorded->IsHalted());
+
+        // Every lda reads two bytes
+        ASSERT_EQ(Log.GetEvents().size(), 100);
+        EXPECT_EQ(Log.GetEvents()[0].Address, 0xC000);
+        EXPECT_EQ(Log.GetEvents()[1].Address, 0xC001);
+        EXPECT_LT(Log.GetEvents()[0].Cycle, Log.GetEvents()[99].Cycle);
+
+        NondeterministicDevice* ReplayedDevice = nullptr;
+        auto Replayed = CreateCPU(ExecutionEngine::Interpreter, ReplayedDevice);
+        Replayed->ReplayInputs(&Log);
+        Replayed->Run(0x8000);
+
+        EXPECT_EQ(Replayed->SerializeState(), Recorded->SerializeState());
+        EXPECT_EQ(Replayed->GetCycleCount(), Recorded->GetCycleCount());
+        EXPECT_TRUE(Log.IsExhausted());
+        EXPECT_EQ(ReplayedDevice->Reads, 0);
+        EXPECT_EQ(ReplayedDevice->Writes, 0);
+    }
+}
+
+TEST(TestInputLog, SaveAndLoad)
+{
+    InputLog Log;
+    Log.Record(3, 0xC000, 0x12);
+    Log.Record(1ull << 40, 0xFFFF, 0xFE);
+
+    auto Path = std::filesystem::temp_directory_path() / "lce_input_log.bin";
+    ASSERT_TRUE(Log.Save(Path));
+    auto Loaded = InputLog::Load(Path);
+    std::filesystem::remove(Path);
+
+    ASSERT_NE(Loaded, nullptr);
+    ASSERT_EQ(Loaded->GetEvents().size(), 2);
+    EXPECT_EQ(Loaded->GetEvents()[1].Cycle, 1ull << 40);
+    EXPECT_EQ(Loaded->GetEvents()[1].Address, 0xFFFF);
+    EXPECT_EQ(Loaded->GetEvents()[1].Value, 0xFE);
+
+    uint8_t Value = 0;
+    EXPECT_FALSE(Loaded->Replay(0xC001, Value));
+    EXPECT_TRUE(Loaded->Replay(0xC000, Value));
+    EXPECT_EQ(Value, 0x12);
+}
+
+TEST(TestInputLog, DivergedReplayFaults)
+{
+    // The log runs out after the first read
+    InputLog Log;
+    Log.Record(2, 0xC000, 1);
+
+    NondeterministicDevice* Device = nullptr;
+    auto Processor = CreateCPU(ExecutionEngine::Interpreter, Device);
+    Processor->ReplayInputs(&Log);
+    Processor->SetIP(0x8000);
+    auto Result = Processor->RunFor(1000);
+    EXPECT_EQ(Result.Reason, StopReason::Fault);
+    EXPECT_EQ(Processor->GetCycleCount(), 2);
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#include "CodeGenerator.h"
+#include "CPU.h"
+#include "Instruction.h"
+#include "Lexer.h"
+#include "MappedFileMemoryBlock.h"
+#include "Parser.h"
+#include "RandomAccessMemoryBlock.h"
+
+using namespace lce::Assembler;
+using namespace lce::Emulator;
+
+static void WriteBinaryFile(const std::filesystem::path& Path, const std::vector<uint8_t>& Bytes)
+{
+    std::ofstream(Path, std::ios::binary).write(reinterpret_cast<const char*>(Bytes.data()), Bytes.size());
+}
+
+TEST(TestMappedFileMemoryBlock, ReadsFileAndPadsWithZeros)
+{
+    auto Path = std::filesystem::temp_directory_path() / "lce_mapped_file_test.bin";
+    WriteBinaryFile(Path, { 0x11, 0x22, 0x33 });
+
+    auto File = MappedFile::Open(Path, 0x8000);
+    std::filesystem::remove(Path);
+    ASSERT_NE(File, nullptr);
+    EXPECT_EQ(File->FileSize(), 3);
+
+    MappedFileMemoryBlock Block(File);
+    EXPECT_EQ(Block.Size(), 0x8000);
+    EXPECT_EQ(Block.ReadWord(0), 0x2211);
+    EXPECT_EQ(Block.Read(2), 0x33);
+    EXPECT_EQ(Block.Read(3), 0);
+    EXPECT_EQ(Block.Read(0x7FFF), 0);
+
+    Block.Write(0, 0xFF);
+    Block.WriteWord(0x7000, 0xFFFF);
+    EXPECT_EQ(Block.Read(0), 0x11);
+    EXPECT_EQ(Block.Read(0x7000), 0);
+    EXPECT_EQ(Block.DirectWritePointer(0), nullptr);
+
+    // Every block that is created from the same file reads from the same host memory
+    auto Copy = Block.Clone();
+    MappedFileMemoryBlock Other(File);
+    EXPECT_EQ(Copy->DirectPointer(0x100), Block.DirectPointer(0x100));
+    EXPECT_EQ(Other.DirectPointer(0x100), Block.DirectPointer(0x100));
+}
+
+TEST(TestMappedFileMemoryBlock, RejectsMissingAndOversizedFiles)
+{
+    auto Path = std::filesystem::temp_directory_path() / "lce_mapped_file_oversized.bin";
+    WriteBinaryFile(Path, std::vector<uint8_t>(0x101, 0));
+
+    EXPECT_EQ(MappedFile::Open(Path, 0x100), nullptr);
+    EXPECT_NE(MappedFile::Open(Path, 0x101), nullptr);
+    std::filesystem::remove(Path);
+    EXPECT_EQ(MappedFile::Open(Path, 0x101), nullptr);
+}
+
+TEST(TestMappedFileMemoryBlock, CPUsShareOneImage)
+{
+    // Copies the word at 0x0000 into r1 and tries to write it back to ROM
+    Lexer Lexer("lda r0, 0        \n" // 0x7FF0
+                "add r1, r0       \n" // 0x7FF4
+                "sta 0, r1        \n" // 0x7FF6
+                "sta 32768, r1    \n" // 0x7FFA
+                "hlt              \n", "test_program.lca");
+    std::vector<lce::Assembler::Instruction> Instructions;
+    ASSERT_TRUE(Parse(Lexer, Instructions));
+    auto Program = GenerateMachineCode(Instructions);
+
+    std::vector<uint8_t> Image(0x7FF0, 0);
+    Image[0] = 0x05;
+    Image.insert(Image.end(), Program.begin(), Program.end());
+
+    auto Path = std::filesystem::temp_directory_path() / "lce_mapped_file_rom.bin";
+    WriteBinaryFile(Path, Image);
+    auto File = MappedFile::Open(Path, 0x8000);
+    std::filesystem::remove(Path);
+    ASSERT_NE(File, nullptr);
+
+    for (auto Engine : { ExecutionEngine::Interpreter, ExecutionEngine::BasicBlocks, ExecutionEngine::JIT })
+    {
+        CPU Processor(Engine);
+        Processor.Reset();
+        ASSERT_TRUE(Processor.AddMemoryBlock(std::make_unique<MappedFileMemoryBlock>(File), 0x0000));
+        ASSERT_TRUE(Processor.AddMemoryBlock(std::make_unique<RandomAccessMemoryBlock>(0x4000), 0x8000));
+
+        Processor.Run(0x7FF0);
+        EXPECT_EQ(Processor.GetRegister(Register::R1), 5);
+        EXPECT_TRUE(Processor.IsHalted());
+    }
+
+    // NOTE: the write to address 0 was dropped, so the image is unchanged for every CPU
+    EXPECT_EQ(File->Data()[0], 0x05);
+}
@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "CodeGenerator.h"
+#include "CPU.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "RandomAccessMemoryBlock.h"
+
+using namespace lce::Assembler;
+using namespace lce::Emulator;
+
+TEST(TestRealTimePacer, WaitsUntilGuestTime)
+{
+    PacingOptions Options;
+    Options.ClockFrequency = 1'000'000;
+
+    RealTimePacer Pacer(Options);
+    auto StartTime = std::chrono::steady_clock::now();
+    Pacer.Start();
+    for (uint64_t Cycles = 1000; Cycles <= 10000; Cycles += 1000)
+        Pacer.WaitForCycle(Cycles);
+    auto Elapsed = std::chrono::steady_clock::now() - StartTime;
+
+    auto Statistics = Pacer.GetStatistics();
+    EXPECT_GE(Elapsed, std::chrono::milliseconds(10));
+    EXPECT_EQ(Statistics.Slices, 10);
+    EXPECT_EQ(Statistics.GuestTime, std::chrono::milliseconds(10));
+    EXPECT_GE(Statistics.WallTime, Statistics.GuestTime);
+    EXPECT_LE(Statistics.MeanError, Statistics.MaxError);
+}
+
+TEST(TestRealTimePacer, RestartsScheduleAfterStall)
+{
+    PacingOptions Options;
+    Options.MaxLag = std::chrono::milliseconds(1);
+
+    RealTimePacer Pacer(Options);
+    Pacer.Start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    // NOTE: the guest is 19 ms behind, so the pacer must not try to make up for it
+    Pacer.WaitForCycle(1000);
+    auto BeforeWait = std::chrono::steady_clock::now();
+    Pacer.WaitForCycle(2000);
+    auto Waited = std::chrono::steady_clock::now() - BeforeWait;
+
+    auto Statistics = Pacer.GetStatistics();
+    EXPECT_EQ(Statistics.Resyncs, 1);
+    EXPECT_GE(Waited, std::chrono::microseconds(900));
+}
+
+TEST(TestRealTimePacer, CPURunsAtClockFrequency)
+{
+    // 15001 cycles, which take 15 ms at 1 MHz
+    constexpr std::string_view Program = "mov r1, 5000    \n" // 0x8000
+                                         "sub r1, 1       \n" // 0x8004
+                                         "jz 32781        \n" // 0x8007
+                                         "jmp 32772       \n" // 0x800A
+                                         "hlt             \n"; // 0x800D
+
+    Lexer Lexer(Program, "test_program.lca");
+    std::vector<lce::Assembler::Instruction> Instructions;
+    ASSERT_TRUE(Parse(Lexer, Instructions));
+    auto Bytes = GenerateMachineCode(Instructions);
+
+    for (auto Engine : { ExecutionEngine::Interpreter, ExecutionEngine::Threaded, ExecutionEngine::BasicBlocks, ExecutionEngine::JIT })
+    {
+        CPU Processor(Engine);
+        Processor.Reset();
+
+        auto RAM = std::make_unique<RandomAccessMemoryBlock>(16384);
+        RAM->WriteRange(0, Bytes);
+        Processor.AddMemoryBlock(std::move(RAM), 0x8000);
+
+        PacingOptions Options;
+        Options.SliceCycles = 1000;
+        Options.MaxLag = std::chrono::seconds(1);
+        auto Statistics = Processor.RunRealTime(0x8000, Options);
+
+        EXPECT_EQ(Processor.GetCycleCount(), 15001);
+        EXPECT_EQ(Statistics.Cycles, 15001);
+        EXPECT_GE(Statistics.Slices, 14);
+        EXPECT_EQ(Statistics.Resyncs, 0);
+        EXPECT_GE(Statistics.WallTime, std::chrono::milliseconds(15));
+        EXPECT_LT(Statistics.WallTime, std::chrono::seconds(1));
+    }
+}
@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "CodeGenerator.h"
+#include "CPU.h"
+#include "Instruction.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "RandomAccessMemoryBlock.h"
+#include "ReverseDebugger.h"
+
+using namespace lce::Assembler;
+using namespace lce::Emulator;
+
+// Keeps a running value in memory, so that going back has to restore memory as well as registers
+constexpr std::string_view Program = "mov r1, 2000    \n" // 0x8000
+                                     "lda r0, 40960   \n" // 0x8004
+                                     "add r0, r1      \n" // 0x8008
+                                     "xor r0, 21845   \n" // 0x800A
+                                     "sta 40960, r0   \n" // 0x800E
+                                     "sub r1, 1       \n" // 0x8012
+                                     "jz 32795        \n" // 0x8015
+                                     "jmp 32772       \n" // 0x8018
+                                     "hlt             \n"; // 0x801B
+
+static std::unique_ptr<CPU> CreateCPU(ExecutionEngine Engine)
+{
+    auto Processor = std::make_unique<CPU>(Engine);
+    Processor->Reset();
+
+    Lexer Lexer(Program, "test_program.lca");
+    std::vector<lce::Assembler::Instruction> Instructions;
+    EXPECT_TRUE(Parse(Lexer, Instructions));
+    auto RAM = std::make_unique<RandomAccessMemoryBlock>(16384);
+    RAM->WriteRange(0, GenerateMachineCode(Instructions));
+    Processor->AddMemoryBlock(std::move(RAM), 0x8000);
+    Processor->SetIP(0x8000);
+    return Processor;
+}
+
+// State after every cycle, as seen by stepping one instruction at a time
+static std::vector<std::string> RecordStates(uint64_t Cycles)
+{
+    auto Processor = CreateCPU(ExecutionEngine::Interpreter);
+    std::vector<std::string> States = { Processor->SerializeState() };
+    while (States.size() <= Cycles && !Processor->IsHalted())
+    {
+        Processor->RunUntil([](const CPU&) { return true; });
+        States.push_back(Processor->SerializeState());
+    }
+    return States;
+}
+
+TEST(TestReverseDebugger, ReverseStepMatchesForwardExecution)
+{
+    // NOTE: the block engines can run up to a block past the budget
+    auto Expected = RecordStates(5000 + 64);
+
+    for (auto Engine : { ExecutionEngine::Interpreter, ExecutionEngine::BasicBlocks, ExecutionEngine::JIT })
+    {
+        auto Processor = CreateCPU(Engine);
+        ReverseDebugger Debugger(*Processor, { .InitialInterval = 300 });
+        Debugger.RunFor(5000);
+        auto Cycle = Processor->GetCycleCount();
+        ASSERT_GE(Cycle, 5000);
+        ASSERT_LT(Cycle, Expected.size());
+
+        for (int Step = 0; Step < 700; Step++)
+        {
+            ASSERT_TRUE(Debugger.ReverseStep());
+            ASSERT_EQ(Processor->GetCycleCount(), --Cycle);
+            ASSERT_EQ(Processor->SerializeState(), Expected[Cycle]);
+        }
+
+        for (uint64_t Target : { 0, 1, 299, 300, 301, 4321 })
+        {
+            ASSERT_TRUE(Debugger.GoToCycle(Target));
+            EXPECT_EQ(Processor->SerializeState(), Expected[Target]);
+        }
+
+        // Running forward again from the past gives the same future
+        Debugger.RunFor(5000 - 4321);
+        EXPECT_EQ(Processor->SerializeState(), Expected[Processor->GetCycleCount()]);
+    }
+}
+
+TEST(TestReverseDebugger, ReverseContinueStopsAtLatestHit)
+{
+    auto Expected = RecordStates(3000);
+
+    auto Processor = CreateCPU(ExecutionEngine::BasicBlocks);
+    ReverseDebugger Debugger(*Processor, { .InitialInterval = 100 });
+    Debugger.RunFor(3000);
+    auto Cycle = Processor->GetCycleCount();
+
+    // The loop body is 7 instructions long, so the previous store is at most 7 cycles back
+    ASSERT_TRUE(Debugger.ReverseContinue(0x800E));
+    EXPECT_EQ(Processor->GetIP(), 0x800E);
+    EXPECT_LT(Processor->GetCycleCount(), Cycle);
+    EXPECT_GE(Processor->GetCycleCount() + 7, Cycle);
+    EXPECT_EQ(Processor->SerializeState(), Expected[Processor->GetCycleCount()]);
+
+    // Continuing backwards from a hit finds the one before it
+    auto Hit = Processor->GetCycleCount();
+    ASSERT_TRUE(Debugger.ReverseContinue(0x800E));
+    EXPECT_EQ(Processor->GetCycleCount(), Hit - 7);
+
+    // The first instruction is only ever executed at the very beginning
+    ASSERT_TRUE(Debugger.ReverseContinue(0x8000));
+    EXPECT_EQ(Processor->GetCycleCount(), 0);
+    EXPECT_FALSE(Debugger.ReverseContinue(0x8000));
+    EXPECT_FALSE(Debugger.ReverseStep());
+}
+
+TEST(TestReverseDebugger, CheckpointsStayBounded)
+{
+    auto Processor = CreateCPU(ExecutionEngine::Interpreter);
+    ReverseDebugger Debugger(*Processor, { .InitialInterval = 16, .MaxInterval = 128, .MaxCheckpoints = 8 });
+    auto Result = Debugger.RunFor(UINT64_MAX);
+    EXPECT_EQ(Result.Reason, StopReason::Halted);
+
+    EXPECT_LE(Debugger.GetCheckpointCount(), 8);
+    EXPECT_EQ(Debugger.GetCheckpointInterval(), 128);
+    EXPECT_GT(Debugger.GetOldestCycle(), 0);
+
+    // Going back is still possible within the history that is left
+    auto Cycle = Processor->GetCycleCount();
+    ASSERT_TRUE(Debugger.ReverseStep());
+    EXPECT_EQ(Processor->GetCycleCount(), Cycle - 1);
+    EXPECT_FALSE(Processor->IsHalted());
+    EXPECT_FALSE(Debugger.GoToCycle(Debugger.GetOldestCycle() - 1));
+}
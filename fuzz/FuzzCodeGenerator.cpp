@@ -0,0 +1,73 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+#include <vector>
+
+#include "CodeGenerator.h"
+#include "ErrorReporting.h"
+#include "Instruction.h"
+#include "InstructionDecoder.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "TypeChecker.h"
+
+using namespace lce;
+using namespace lce::Assembler;
+using namespace lce::Emulator;
+
+/*
+ * Assembles arbitrary text and decodes the machine code again. Every instruction that passed the type checker has to
+ * decode to a valid instruction with the same opcode, length and immediate value that the code generator produced.
+ */
+
+static const Operand* FindImmediate(const Instruction& Source)
+{
+    for (const auto& Operand : Source.Operands)
+    {
+        if (Operand.Type == OperandType::Immediate)
+            return &Operand;
+    }
+    return nullptr;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* Data, size_t Size)
+{
+    static bool IsInitialized = [] { Common::SetLoggingLevel(Common::ErrorSeverity::Fatal); return true; }();
+    (void)IsInitialized;
+
+    Lexer Lexems(std::string_view(reinterpret_cast<const char*>(Data), Size), "fuzz.lca");
+    std::vector<Instruction> Instructions;
+    if (!Parse(Lexems, Instructions) || !CheckInstructionSequence(Instructions))
+        return 0;
+
+    std::vector<SourceMapEntry> SourceMap;
+    auto Bytes = GenerateMachineCode(Instructions, SourceMap);
+
+    // Offsets in the source map are 16-bit, like the address space, so longer programs can not be checked
+    if (Bytes.size() > UINT16_MAX)
+        return 0;
+    if (SourceMap.size() != Instructions.size())
+        std::abort();
+
+    // NOTE: the decoder always reads 4 bytes, the padding decodes as nops
+    auto CodeSize = Bytes.size();
+    Bytes.resize(CodeSize + 4, EncodedNOP);
+
+    for (size_t Index = 0; Index < Instructions.size(); Index++)
+    {
+        auto Offset = SourceMap[Index].Offset;
+        auto NextOffset = Index + 1 < SourceMap.size() ? SourceMap[Index + 1].Offset : CodeSize;
+        auto Decoded = DecodeInstruction(Bytes.data() + Offset);
+
+        if (Decoded.ID == HandlerID::Invalid || Decoded.Opcode != Instructions[Index].Opcode || Offset + Decoded.Length != NextOffset)
+            std::abort();
+
+        // NOTE: the code generator truncates immediates to 16 bits
+        const auto* Immediate = FindImmediate(Instructions[Index]);
+        if (Immediate && Decoded.Immediate != static_cast<uint16_t>(std::get<uint64_t>(Immediate->Value)))
+            std::abort();
+    }
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "CPU.h"
+#include "ErrorReporting.h"
+#include "Instruction.h"
+#include "RandomAccessMemoryBlock.h"
+
+using namespace lce;
+using namespace lce::Emulator;
+
+/*
+ * Decodes and executes arbitrary bytes. The first byte of the input selects the engine that is compared against the
+ * interpreter, the rest is loaded at 0x8000 and executed for a bounded number of cycles on both. If both halt, they
+ * have to agree on the whole state of the CPU, including memory.
+ */
+
+static constexpr uint16_t ProgramAddress = 0x8000;
+static constexpr uint16_t HalfAddressSpace = 0x8000;
+static constexpr uint64_t MaxCycles = 4096;
+
+static constexpr ExecutionEngine ComparedEngines[] = { ExecutionEngine::Threaded, ExecutionEngine::BasicBlocks, ExecutionEngine::JIT };
+
+struct FuzzedCPU
+{
+    std::unique_ptr<CPU> Processor;
+    std::array<RandomAccessMemoryBlock*, 2> Memory = {};
+
+    explicit FuzzedCPU(ExecutionEngine Engine)
+        : Processor(std::make_unique<CPU>(Engine))
+    {
+        for (size_t Index = 0; Index < Memory.size(); Index++)
+        {
+            auto Block = std::make_unique<RandomAccessMemoryBlock>(HalfAddressSpace);
+            Memory[Index] = Block.get();
+            Processor->AddMemoryBlock(std::move(Block), static_cast<uint16_t>(Index * HalfAddressSpace));
+        }
+    }
+
+    // NOTE: the CPU and its memory are created once and reused, so that every input starts from the same state cheaply
+    void Load(std::span<const uint8_t> Program)
+    {
+        static const std::vector<uint8_t> Zeroes(HalfAddressSpace, 0);
+        for (auto* Block : Memory)
+            Block->WriteRange(0, Zeroes);
+        Memory[1]->WriteRange(0, Program.first(std::min<size_t>(Program.size(), HalfAddressSpace)));
+
+        Processor->InvalidateInstructionCache();
+        Processor->Reset();
+        Processor->SetIP(ProgramAddress);
+    }
+
+    bool HasSameState(const FuzzedCPU& Other) const
+    {
+        if (Processor->GetIP() != Other.Processor->GetIP() || Processor->GetCycleCount() != Other.Processor->GetCycleCount() ||
+            Processor->GetStopReason() != Other.Processor->GetStopReason())
+            return false;
+
+        for (size_t Index = 0; Index < static_cast<size_t>(Assembler::Register::Count_); Index++)
+        {
+            auto Register = static_cast<Assembler::Register>(Index);
+            if (Processor->GetRegister(Register) != Other.Processor->GetRegister(Register))
+                return false;
+        }
+
+        static std::vector<uint8_t> Left(HalfAddressSpace), Right(HalfAddressSpace);
+        for (size_t Index = 0; Index < Memory.size(); Index++)
+        {
+            Memory[Index]->ReadRange(0, Left);
+            Other.Memory[Index]->ReadRange(0, Right);
+            if (Left != Right)
+                return false;
+        }
+
+        return true;
+    }
+};
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* Data, size_t Size)
+{
+    static bool IsInitialized = [] { Common::SetLoggingLevel(Common::ErrorSeverity::Fatal); return true; }();
+    static FuzzedCPU Reference(ExecutionEngine::Interpreter);
+    static std::vector<std::unique_ptr<FuzzedCPU>> Compared = []
+    {
+        std::vector<std::unique_ptr<FuzzedCPU>> Result;
+        for (auto Engine : ComparedEngines)
+            Result.push_back(std::make_unique<FuzzedCPU>(Engine));
+        return Result;
+    }();
+    (void)IsInitialized;
+
+    if (Size < 2)
+        return 0;
+
+    auto& Other = *Compared[Data[0] % std::size(ComparedEngines)];
+    std::span<const uint8_t> Program(Data + 1, Size - 1);
+
+    // A single instruction decoded straight from the input, without going through memory or the instruction cache
+    uint8_t FirstInstruction[4] = {};
+    auto FirstInstructionSize = std::min(Program.size(), std::size(FirstInstruction));
+    std::copy_n(Program.begin(), FirstInstructionSize, FirstInstruction);
+    Reference.Load(Program);
+    Reference.Processor->ExecuteSingleInstruction({ FirstInstruction, FirstInstructionSize });
+
+    Reference.Load(Program);
+    Other.Load(Program);
+    Reference.Processor->RunFor(MaxCycles);
+    Other.Processor->RunFor(MaxCycles);
+
+    // NOTE: the block engines may run past the cycle limit, so states can only be compared once both have halted
+    if (Reference.Processor->IsHalted() && Other.Processor->IsHalted() && !Reference.HasSameState(Other))
+        std::abort();
+
+    return 0;
+}
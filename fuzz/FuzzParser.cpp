@@ -0,0 +1,43 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+#include <vector>
+
+#include "ErrorReporting.h"
+#include "Instruction.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "TypeChecker.h"
+
+using namespace lce;
+using namespace lce::Assembler;
+
+/*
+ * Runs arbitrary text through the lexer on its own and then through the parser and the type checker, the same way the
+ * assembler does with a source file.
+ */
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* Data, size_t Size)
+{
+    static bool IsInitialized = [] { Common::SetLoggingLevel(Common::ErrorSeverity::Fatal); return true; }();
+    (void)IsInitialized;
+
+    std::string_view Source(reinterpret_cast<const char*>(Data), Size);
+
+    // NOTE: every lexem consumes at least one character, so a lexer that does not reach the end of the file is stuck
+    Lexer Lexems(Source, "fuzz.lca");
+    size_t LexemCount = 0;
+    while (Lexems.Pop().Type != LexemType::EndOfFile)
+    {
+        if (++LexemCount > Size)
+            std::abort();
+    }
+
+    Lexer ParserLexems(Source, "fuzz.lca");
+    std::vector<Instruction> Instructions;
+    if (Parse(ParserLexems, Instructions))
+        CheckInstructionSequence(Instructions);
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* Data, size_t Size);
+
+/*
+ * Stands in for libFuzzer on compilers that do not ship it. Runs every file given on the command line (directories are
+ * searched recursively) through the fuzz target in the same process, the same way libFuzzer runs a corpus, or the
+ * standard input if there are no arguments.
+ */
+
+static void RunInput(const std::vector<uint8_t>& Bytes)
+{
+    // NOTE: copied so that reads past the end of the input are caught by the address sanitizer
+    std::vector<uint8_t> Input(Bytes);
+    LLVMFuzzerTestOneInput(Input.data(), Input.size());
+}
+
+static bool RunFile(const std::filesystem::path& Path)
+{
+    std::ifstream Input(Path, std::ios::binary);
+    if (!Input.is_open())
+    {
+        std::cerr << "Cannot open input file " << Path << std::endl;
+        return false;
+    }
+
+    RunInput({ std::istreambuf_iterator<char>(Input), std::istreambuf_iterator<char>() });
+    return true;
+}
+
+int main(int ArgumentCount, char** Arguments)
+{
+    if (ArgumentCount < 2)
+    {
+        RunInput({ std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>() });
+        return 0;
+    }
+
+    size_t InputCount = 0;
+    for (int Index = 1; Index < ArgumentCount; Index++)
+    {
+        std::filesystem::path Path = Arguments[Index];
+        if (!std::filesystem::is_directory(Path))
+        {
+            if (!RunFile(Path))
+                return 1;
+            InputCount++;
+            continue;
+        }
+
+        for (const auto& Entry : std::filesystem::recursive_directory_iterator(Path))
+        {
+            if (Entry.is_regular_file() && RunFile(Entry.path()))
+                InputCount++;
+        }
+    }
+
+    std::cerr << "Executed " << InputCount << " inputs" << std::endl;
+    return 0;
+}